@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares async net executors on a wide DAG of fine-grained operators:
+// `width` independent chains of `depth` small Scale ops, joined by a Sum.
+
+#include <cstdio>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/utils/proto_utils.h"
+#include "caffe2/utils/string_utils.h"
+
+CAFFE2_DEFINE_string(
+    net_types,
+    "async_scheduling,async_work_stealing",
+    "Comma separated list of net types to compare.");
+CAFFE2_DEFINE_int(width, 256, "Number of parallel chains.");
+CAFFE2_DEFINE_int(depth, 8, "Number of ops per chain.");
+CAFFE2_DEFINE_int(tensor_size, 64, "Number of floats per tensor.");
+CAFFE2_DEFINE_int(warmup, 10, "Number of warmup runs.");
+CAFFE2_DEFINE_int(iterations, 100, "Number of timed runs.");
+
+namespace caffe2 {
+
+NetDef WideNet(const string& type) {
+  NetDef net_def;
+  net_def.set_name("wide_" + type);
+  net_def.set_type(type);
+  net_def.add_external_input("in");
+  std::vector<string> chain_outputs;
+  for (int i = 0; i < FLAGS_width; ++i) {
+    string prev = "in";
+    for (int j = 0; j < FLAGS_depth; ++j) {
+      string out = "x_" + caffe2::to_string(i) + "_" + caffe2::to_string(j);
+      net_def.add_op()->CopyFrom(CreateOperatorDef(
+          "Scale",
+          "",
+          std::vector<string>{prev},
+          std::vector<string>{out},
+          std::vector<Argument>{MakeArgument<float>("scale", 1.0f)}));
+      prev = out;
+    }
+    chain_outputs.push_back(prev);
+  }
+  net_def.add_op()->CopyFrom(CreateOperatorDef(
+      "Sum", "", chain_outputs, std::vector<string>{"out"}));
+  return net_def;
+}
+
+void RunAsyncNetBenchmark(const string& type) {
+  Workspace ws;
+  auto* in = ws.CreateBlob("in")->GetMutable<TensorCPU>();
+  in->Resize(FLAGS_tensor_size);
+  in->mutable_data<float>();
+  auto* net = ws.CreateNet(WideNet(type));
+  CAFFE_ENFORCE(net, "Failed to create net of type ", type);
+  for (int i = 0; i < FLAGS_warmup; ++i) {
+    CAFFE_ENFORCE(net->Run());
+  }
+  Timer timer;
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    CAFFE_ENFORCE(net->Run());
+  }
+  double elapsed_seconds = timer.Seconds();
+  int num_ops = FLAGS_width * FLAGS_depth + 1;
+  printf(
+      "Net type %s, %d ops, took %4.5f seconds per run, throughput %f "
+      "ops/sec.\n",
+      type.c_str(),
+      num_ops,
+      elapsed_seconds / FLAGS_iterations,
+      num_ops * FLAGS_iterations / elapsed_seconds);
+}
+
+} // namespace caffe2
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  for (const auto& type : caffe2::split(',', caffe2::FLAGS_net_types)) {
+    caffe2::RunAsyncNetBenchmark(type);
+  }
+  return 0;
+}
@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Contention benchmark for BlobsQueue. Spawns an equal number of writer and
+// reader threads that push records through a single queue and reports the
+// throughput of the mutex based BlobsQueue and of LockFreeBlobsQueue for each
+// thread count.
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/queue/blobs_queue.h"
+#include "caffe2/queue/lock_free_blobs_queue.h"
+#include "caffe2/utils/string_utils.h"
+
+CAFFE2_DEFINE_string(
+    thread_counts,
+    "1,2,4,8,16",
+    "Number of reader and of writer threads to sweep.");
+CAFFE2_DEFINE_int(capacity, 64, "Capacity of the queue.");
+CAFFE2_DEFINE_int(num_blobs, 2, "Number of blobs per record.");
+CAFFE2_DEFINE_int(payload_size, 16, "Number of floats per blob.");
+CAFFE2_DEFINE_int(
+    records_per_writer,
+    100000,
+    "Number of records enqueued by each writer thread.");
+
+namespace caffe2 {
+
+std::vector<int> ParseInts(const string& list) {
+  std::vector<int> values;
+  for (const auto& value : split(',', list)) {
+    values.push_back(std::stoi(value));
+  }
+  return values;
+}
+
+template <typename Queue>
+double RunQueue(int num_threads) {
+  Workspace ws;
+  auto queue = std::make_shared<Queue>(
+      &ws, "queue", FLAGS_capacity, FLAGS_num_blobs, false);
+  std::atomic<int64_t> dequeued{0};
+
+  Timer timer;
+  std::vector<std::thread> writers;
+  std::vector<std::thread> readers;
+  for (int t = 0; t < num_threads; ++t) {
+    writers.emplace_back([&]() {
+      std::vector<Blob> blobs(FLAGS_num_blobs);
+      std::vector<Blob*> inputs;
+      for (auto& blob : blobs) {
+        inputs.push_back(&blob);
+      }
+      for (int i = 0; i < FLAGS_records_per_writer; ++i) {
+        for (auto* blob : inputs) {
+          auto* tensor = blob->GetMutable<TensorCPU>();
+          tensor->Resize(FLAGS_payload_size);
+          tensor->template mutable_data<float>()[0] = i;
+        }
+        CAFFE_ENFORCE(queue->blockingWrite(inputs));
+      }
+    });
+    readers.emplace_back([&]() {
+      std::vector<Blob> blobs(FLAGS_num_blobs);
+      std::vector<Blob*> outputs;
+      for (auto& blob : blobs) {
+        outputs.push_back(&blob);
+      }
+      int64_t count = 0;
+      while (queue->blockingRead(outputs)) {
+        ++count;
+      }
+      dequeued += count;
+    });
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  // Readers drain the remaining records before observing the close.
+  queue->close();
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  const double seconds = timer.Seconds();
+  CAFFE_ENFORCE_EQ(
+      dequeued.load(), int64_t(num_threads) * FLAGS_records_per_writer);
+  return dequeued.load() / seconds;
+}
+
+} // namespace caffe2
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  for (int threads : caffe2::ParseInts(caffe2::FLAGS_thread_counts)) {
+    const double mutex_rate = caffe2::RunQueue<caffe2::BlobsQueue>(threads);
+    const double lock_free_rate =
+        caffe2::RunQueue<caffe2::LockFreeBlobsQueue>(threads);
+    printf(
+        "%2d readers, %2d writers: mutex %8.3f, lock-free %8.3f M records/sec "
+        "(%.2fx).\n",
+        threads,
+        threads,
+        mutex_rate / 1e6,
+        lock_free_rate / 1e6,
+        lock_free_rate / mutex_rate);
+  }
+  return 0;
+}
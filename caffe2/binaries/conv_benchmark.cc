@@ -0,0 +1,141 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Times the CPU Conv engines on a suite of layer shapes taken from common
+// image classification networks, and checks each engine against the default
+// im2col + GEMM implementation. Engines that do not support a shape fall back
+// to the default one, which is reported as such.
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/utils/proto_utils.h"
+#include "caffe2/utils/string_utils.h"
+
+CAFFE2_DEFINE_string(
+    engines,
+    ",DIRECT,WINOGRAD,EIGEN",
+    "Comma-separated Conv engines to time, the empty name being the default.");
+CAFFE2_DEFINE_int(batch_size, 1, "Number of images per run.");
+CAFFE2_DEFINE_int(iterations, 10, "Number of runs to average.");
+CAFFE2_DEFINE_int(winograd_tile, 2, "Output tile size of the WINOGRAD engine.");
+CAFFE2_DEFINE_bool(
+    precompute,
+    false,
+    "If true, let engines transform the filters once instead of every run.");
+
+namespace caffe2 {
+
+struct LayerShape {
+  const char* name;
+  int C, H, W, M, kernel, stride, pad;
+};
+
+// Input channels, input size, output channels, kernel, stride and padding.
+const std::vector<LayerShape> kLayerShapes = {
+    {"alexnet.conv2", 64, 27, 27, 192, 5, 1, 2},
+    {"vgg.conv1_2", 64, 224, 224, 64, 3, 1, 1},
+    {"vgg.conv3_2", 256, 56, 56, 256, 3, 1, 1},
+    {"vgg.conv5_2", 512, 14, 14, 512, 3, 1, 1},
+    {"resnet.conv1", 3, 224, 224, 64, 7, 2, 3},
+    {"resnet.res2_3x3", 64, 56, 56, 64, 3, 1, 1},
+    {"resnet.res2_1x1", 256, 56, 56, 64, 1, 1, 0},
+    {"resnet.res3_3x3", 128, 28, 28, 128, 3, 1, 1},
+    {"resnet.res4_3x3", 256, 14, 14, 256, 3, 1, 1},
+    {"resnet.res5_1x1", 512, 7, 7, 2048, 1, 1, 0},
+};
+
+void FillUniform(
+    const vector<TIndex>& shape,
+    const string& name,
+    Workspace* ws) {
+  DeviceOption option;
+  CPUContext context(option);
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(shape);
+  math::RandUniform<float, CPUContext>(
+      tensor->size(), -1, 1, tensor->mutable_data<float>(), &context);
+}
+
+void RunConvBenchmark(const LayerShape& shape) {
+  Workspace ws;
+  FillUniform({FLAGS_batch_size, shape.C, shape.H, shape.W}, "X", &ws);
+  FillUniform({shape.M, shape.C, shape.kernel, shape.kernel}, "w", &ws);
+  FillUniform({shape.M}, "b", &ws);
+
+  const TensorCPU* expected = nullptr;
+  for (const auto& engine : split(',', FLAGS_engines)) {
+    const string output = "Y_" + engine;
+    OperatorDef def = CreateOperatorDef(
+        "Conv",
+        "",
+        std::vector<string>{"X", "w", "b"},
+        std::vector<string>{output},
+        std::vector<Argument>{
+            MakeArgument<int>("kernel", shape.kernel),
+            MakeArgument<int>("stride", shape.stride),
+            MakeArgument<int>("pad", shape.pad),
+            MakeArgument<int>("winograd_tile", FLAGS_winograd_tile),
+            MakeArgument<string>(
+                "convolution_transform_strategy",
+                FLAGS_precompute ? "PRECOMPUTE" : "COMPUTE")});
+    def.set_engine(engine);
+    auto op = CreateOperator(def, &ws);
+    CAFFE_ENFORCE(op->Run());
+    Timer timer;
+    for (int i = 0; i < FLAGS_iterations; ++i) {
+      CAFFE_ENFORCE(op->Run());
+    }
+    const double seconds = timer.Seconds() / FLAGS_iterations;
+
+    const auto& Y = ws.GetBlob(output)->Get<TensorCPU>();
+    if (!expected) {
+      expected = &Y;
+    }
+    float max_error = 0;
+    for (int i = 0; i < Y.size(); ++i) {
+      max_error = std::max(
+          max_error, std::abs(Y.data<float>()[i] - expected->data<float>()[i]));
+    }
+    const double flops = 2.0 * Y.size() * shape.C * shape.kernel * shape.kernel;
+    printf(
+        "%-18s %-9s%s %9.3f ms %8.2f GFLOPS, max error %g\n",
+        shape.name,
+        engine.empty() ? "DEFAULT" : engine.c_str(),
+        op->engine() == engine ? " " : "*",
+        seconds * 1e3,
+        flops / seconds / 1e9,
+        max_error);
+  }
+}
+
+} // namespace caffe2
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  printf("* marks engines that fell back to the default implementation.\n");
+  for (const auto& shape : caffe2::kLayerShapes) {
+    caffe2::RunConvBenchmark(shape);
+  }
+  return 0;
+}
@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures how fast records go from a feeder process to a reader process on
+// the same host. A child process writes synthetic records as fast as it can,
+// the way shm_feeder and zmq_feeder do, and the parent times reading them
+// through a cursor. shmdb is always measured; zmqdb is measured as well when
+// Caffe2 is built with ZeroMQ.
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <functional>
+
+#include "caffe2/core/db.h"
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/timer.h"
+#ifdef CAFFE2_DB_FEED_BENCHMARK_WITH_ZMQ
+#include "caffe2/utils/zmq_helper.h"
+#endif
+
+CAFFE2_DEFINE_int(num_records, 100000, "Number of records to read.");
+CAFFE2_DEFINE_int(value_size, 4096, "Number of bytes per record value.");
+CAFFE2_DEFINE_string(
+    shm_source,
+    "/caffe2_db_feed_benchmark",
+    "Name of the shared memory object used by shmdb.");
+CAFFE2_DEFINE_string(
+    zmq_source,
+    "ipc:///tmp/caffe2_db_feed_benchmark",
+    "Address used by zmqdb.");
+
+namespace caffe2 {
+
+// Runs writer in a child process until it is killed, and returns the pid.
+pid_t StartFeeder(std::function<void(const string&, const string&)> writer) {
+  pid_t pid = fork();
+  CAFFE_ENFORCE(pid >= 0, "fork failed.");
+  if (pid == 0) {
+    const string value(FLAGS_value_size, 'x');
+    char key[32];
+    for (int64_t i = 0;; ++i) {
+      snprintf(key, sizeof(key), "%016lld", static_cast<long long>(i));
+      writer(key, value);
+    }
+  }
+  return pid;
+}
+
+void StopFeeder(pid_t pid) {
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+}
+
+double TimeReads(const string& db_type, const string& source) {
+  auto in_db = db::CreateDB(db_type, source, db::READ);
+  CAFFE_ENFORCE(in_db, "Cannot open ", db_type, " ", source);
+  // The first record is read when the cursor is created, which also waits for
+  // the feeder to start.
+  auto cursor = in_db->NewCursor();
+  Timer timer;
+  size_t bytes = cursor->value().size();
+  for (int i = 1; i < FLAGS_num_records; ++i) {
+    cursor->Next();
+    bytes += cursor->value().size();
+  }
+  const double seconds = timer.Seconds();
+  CAFFE_ENFORCE_EQ(bytes, size_t(FLAGS_num_records) * FLAGS_value_size);
+  return seconds;
+}
+
+void Report(const string& db_type, double seconds) {
+  printf(
+      "%8s: %10.0f records/sec, %8.2f MB/sec.\n",
+      db_type.c_str(),
+      FLAGS_num_records / seconds,
+      double(FLAGS_num_records) * FLAGS_value_size / seconds / (1 << 20));
+}
+
+void RunShmDBBenchmark() {
+  // Start from a fresh ring in case an earlier run was interrupted.
+  shm_unlink(FLAGS_shm_source.c_str());
+  pid_t pid = StartFeeder([](const string& key, const string& value) {
+    static auto out_db = db::CreateDB("shmdb", FLAGS_shm_source, db::NEW);
+    static auto transaction = out_db->NewTransaction();
+    transaction->Put(key, value);
+  });
+  const double seconds = TimeReads("shmdb", FLAGS_shm_source);
+  StopFeeder(pid);
+  // The killed feeder never detaches, so remove the ring here.
+  shm_unlink(FLAGS_shm_source.c_str());
+  Report("shmdb", seconds);
+}
+
+#ifdef CAFFE2_DB_FEED_BENCHMARK_WITH_ZMQ
+void RunZmqDBBenchmark() {
+  pid_t pid = StartFeeder([](const string& key, const string& value) {
+    static ZmqSocket* sender = [] {
+      auto* socket = new ZmqSocket(ZMQ_PUSH);
+      socket->Bind(FLAGS_zmq_source);
+      return socket;
+    }();
+    sender->SendTillSuccess(key, ZMQ_SNDMORE);
+    sender->SendTillSuccess(value, 0);
+  });
+  const double seconds = TimeReads("zmqdb", FLAGS_zmq_source);
+  StopFeeder(pid);
+  Report("zmqdb", seconds);
+}
+#endif
+
+} // namespace caffe2
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  caffe2::RunShmDBBenchmark();
+#ifdef CAFFE2_DB_FEED_BENCHMARK_WITH_ZMQ
+  caffe2::RunZmqDBBenchmark();
+#endif
+  return 0;
+}
@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures how long the Load operator takes to bring a set of float tensors
+// into a workspace from different db types. A cold load is measured after
+// asking the kernel to drop the db file from the page cache, and warm loads
+// are measured right after that. For mmapdb, tensors are saved as single raw
+// chunks so that Load can alias the mapping instead of copying.
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "caffe2/core/blob_serialization.h"
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/utils/proto_utils.h"
+#include "caffe2/utils/string_utils.h"
+
+CAFFE2_DEFINE_string(db_types, "minidb,mmapdb", "Comma-separated db types.");
+CAFFE2_DEFINE_string(folder, "/tmp", "Folder to write the dbs to.");
+CAFFE2_DEFINE_int(num_blobs, 16, "Number of tensors to save and load.");
+CAFFE2_DEFINE_int(blob_size, 1 << 22, "Number of floats per tensor.");
+CAFFE2_DEFINE_int(warm_iterations, 5, "Number of warm loads to average.");
+
+namespace caffe2 {
+
+void DropFromPageCache(const string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  CAFFE_ENFORCE(fd >= 0, "Cannot open file: ", path);
+  fdatasync(fd);
+  if (posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) != 0) {
+    LOG(WARNING) << "Could not drop " << path << " from the page cache; the "
+                 << "cold load below is likely warm.";
+  }
+  close(fd);
+}
+
+double LoadOnce(const string& db_type, const string& path, int* shared) {
+  Workspace ws;
+  Timer timer;
+  CAFFE_ENFORCE(ws.RunOperatorOnce(CreateOperatorDef(
+      "Load",
+      "",
+      std::vector<string>{},
+      std::vector<string>{},
+      std::vector<Argument>{MakeArgument<string>("db_type", db_type),
+                            MakeArgument<string>("db", path),
+                            MakeArgument<int>("absolute_path", 1),
+                            MakeArgument<int>("load_all", 1)})));
+  double seconds = timer.Seconds();
+  *shared = 0;
+  for (const auto& name : ws.Blobs()) {
+    *shared += ws.GetBlob(name)->Get<TensorCPU>().shares_data();
+  }
+  return seconds;
+}
+
+void RunDBLoadBenchmark(const string& db_type) {
+  const string path = FLAGS_folder + "/db_load_benchmark." + db_type;
+  {
+    Workspace ws;
+    std::vector<string> names;
+    for (int i = 0; i < FLAGS_num_blobs; ++i) {
+      names.push_back(MakeString("blob", i));
+      auto* tensor = ws.CreateBlob(names.back())->GetMutable<TensorCPU>();
+      tensor->Resize(FLAGS_blob_size);
+      float* data = tensor->mutable_data<float>();
+      for (int j = 0; j < FLAGS_blob_size; ++j) {
+        data[j] = j;
+      }
+    }
+    const bool raw_flag = FLAGS_caffe2_serialize_raw_tensors;
+    FLAGS_caffe2_serialize_raw_tensors = raw_flag || db_type == "mmapdb";
+    CAFFE_ENFORCE(ws.RunOperatorOnce(CreateOperatorDef(
+        "Save",
+        "",
+        names,
+        std::vector<string>{},
+        std::vector<Argument>{MakeArgument<string>("db_type", db_type),
+                              MakeArgument<string>("db", path),
+                              MakeArgument<int>("absolute_path", 1),
+                              MakeArgument<int>("chunk_size", kNoChunking)})));
+    FLAGS_caffe2_serialize_raw_tensors = raw_flag;
+  }
+
+  int shared = 0;
+  DropFromPageCache(path);
+  const double cold_seconds = LoadOnce(db_type, path, &shared);
+  double warm_seconds = 0;
+  for (int i = 0; i < FLAGS_warm_iterations; ++i) {
+    warm_seconds += LoadOnce(db_type, path, &shared);
+  }
+  warm_seconds /= std::max(FLAGS_warm_iterations, 1);
+  const double mbytes = static_cast<double>(FLAGS_num_blobs) *
+      FLAGS_blob_size * sizeof(float) / (1 << 20);
+  printf(
+      "%s: %.1f MB, cold load %4.5f seconds, warm load %4.5f seconds, "
+      "%d of %d tensors alias the db.\n",
+      db_type.c_str(),
+      mbytes,
+      cold_seconds,
+      warm_seconds,
+      shared,
+      FLAGS_num_blobs);
+  remove(path.c_str());
+}
+
+} // namespace caffe2
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  for (const auto& db_type : caffe2::split(',', caffe2::FLAGS_db_types)) {
+    caffe2::RunDBLoadBenchmark(db_type);
+  }
+  return 0;
+}
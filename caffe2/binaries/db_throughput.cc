@@ -30,6 +30,9 @@ CAFFE2_DEFINE_int(repeat, 10, "The number to repeat the throughput test.");
 CAFFE2_DEFINE_bool(use_reader, false, "If true, use the reader interface.");
 CAFFE2_DEFINE_int(num_read_threads, 1,
                    "The number of concurrent reading threads.");
+CAFFE2_DEFINE_bool(split_cursors, false,
+                   "If true, each reading thread reads through its own "
+                   "cursor, see DBReader::SplitCursors.");
 
 using caffe2::db::Cursor;
 using caffe2::db::DB;
@@ -63,7 +66,11 @@ void TestThroughputWithReaderWorker(const DBReader* reader, int thread_id) {
   for (int iter_id = 0; iter_id < caffe2::FLAGS_repeat; ++iter_id) {
     caffe2::Timer timer;
     for (int i = 0; i < caffe2::FLAGS_report_interval; ++i) {
-      reader->Read(&key, &value);
+      if (caffe2::FLAGS_split_cursors) {
+        reader->Read(thread_id, &key, &value);
+      } else {
+        reader->Read(&key, &value);
+      }
     }
     double elapsed_seconds = timer.Seconds();
     printf("Thread %03d iteration %03d, took %4.5f seconds, "
@@ -76,6 +83,9 @@ void TestThroughputWithReaderWorker(const DBReader* reader, int thread_id) {
 void TestThroughputWithReader() {
   caffe2::db::DBReader reader(
       caffe2::FLAGS_input_db_type, caffe2::FLAGS_input_db);
+  if (caffe2::FLAGS_split_cursors) {
+    reader.SplitCursors(caffe2::FLAGS_num_read_threads);
+  }
   std::vector<std::unique_ptr<std::thread>> reading_threads(
       caffe2::FLAGS_num_read_threads);
   for (int i = 0; i < reading_threads.size(); ++i) {
@@ -0,0 +1,195 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the throughput of the EmbeddingLookup perfkernels for float,
+// float16, uint8 with separate scale and bias, and fused 8-bit rowwise
+// embedding tables. The sweep covers block sizes, the number of indices
+// looked up per call and the prefetch distance used by the kernels, so that
+// the best prefetch distance for a table shape can be read off the output.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/core/types.h"
+#include "caffe2/perfkernels/embedding_lookup.h"
+#include "caffe2/perfkernels/fused_8bit_rowwise_embedding_lookup.h"
+#include "caffe2/utils/string_utils.h"
+
+CAFFE2_DEFINE_string(block_sizes, "16,32,64,128", "Embedding dims to sweep.");
+CAFFE2_DEFINE_string(
+    index_sizes,
+    "1000,100000",
+    "Number of indices looked up per call to sweep.");
+CAFFE2_DEFINE_string(
+    prefetch_distances,
+    "0,4,8,16,32,64",
+    "Prefetch distances to sweep.");
+CAFFE2_DEFINE_int64(num_rows, 1000000, "Number of rows of the table.");
+CAFFE2_DEFINE_int(average_length, 20, "Number of indices per segment.");
+CAFFE2_DEFINE_int(iterations, 20, "Number of lookups to average.");
+
+namespace caffe2 {
+
+std::vector<int> ParseInts(const string& list) {
+  std::vector<int> values;
+  for (const auto& value : split(',', list)) {
+    values.push_back(std::stoi(value));
+  }
+  return values;
+}
+
+template <typename Lookup>
+double TimeLookup(Lookup lookup) {
+  // Warm up once so that the timed runs do not include page faults.
+  lookup();
+  Timer timer;
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    lookup();
+  }
+  return timer.Seconds() / FLAGS_iterations;
+}
+
+void RunEmbeddingLookupBenchmark(int block_size, int index_size) {
+  std::mt19937 gen(block_size + index_size);
+  std::uniform_int_distribution<int64_t> row_dist(0, FLAGS_num_rows - 1);
+  std::vector<int64_t> indices(index_size);
+  for (auto& index : indices) {
+    index = row_dist(gen);
+  }
+  std::vector<int> lengths;
+  for (int remaining = index_size; remaining > 0;) {
+    lengths.push_back(std::min(remaining, FLAGS_average_length));
+    remaining -= lengths.back();
+  }
+  const TIndex output_size = lengths.size();
+  const TIndex table_size = FLAGS_num_rows * block_size;
+
+  std::vector<float> float_table(table_size);
+  std::uniform_real_distribution<float> value_dist(-1, 1);
+  for (auto& value : float_table) {
+    value = value_dist(gen);
+  }
+  std::vector<float16> half_table(table_size);
+  std::vector<uint8_t> uint8_table(table_size);
+  for (TIndex i = 0; i < table_size; ++i) {
+    half_table[i].x = static_cast<uint16_t>(gen());
+    uint8_table[i] = static_cast<uint8_t>(gen());
+  }
+  std::vector<float> scale_bias(2 * FLAGS_num_rows, 0.5f);
+  const TIndex fused_block_size = block_size + 2 * sizeof(float);
+  std::vector<uint8_t> fused_table(FLAGS_num_rows * fused_block_size);
+  for (TIndex row = 0; row < FLAGS_num_rows; ++row) {
+    memcpy(
+        &fused_table[row * fused_block_size],
+        &uint8_table[row * block_size],
+        block_size);
+    memcpy(
+        &fused_table[row * fused_block_size + block_size],
+        &scale_bias[2 * row],
+        2 * sizeof(float));
+  }
+  std::vector<float> out(output_size * block_size);
+
+  for (int prefetch_distance : ParseInts(FLAGS_prefetch_distances)) {
+    const double float_seconds = TimeLookup([&]() {
+      EmbeddingLookup(
+          block_size,
+          output_size,
+          index_size,
+          FLAGS_num_rows,
+          float_table.data(),
+          indices.data(),
+          lengths.data(),
+          nullptr,
+          nullptr,
+          false,
+          out.data(),
+          prefetch_distance);
+    });
+    const double half_seconds = TimeLookup([&]() {
+      EmbeddingLookup(
+          block_size,
+          output_size,
+          index_size,
+          FLAGS_num_rows,
+          half_table.data(),
+          indices.data(),
+          lengths.data(),
+          nullptr,
+          nullptr,
+          false,
+          out.data(),
+          prefetch_distance);
+    });
+    const double uint8_seconds = TimeLookup([&]() {
+      EmbeddingLookup(
+          block_size,
+          output_size,
+          index_size,
+          FLAGS_num_rows,
+          uint8_table.data(),
+          indices.data(),
+          lengths.data(),
+          nullptr,
+          scale_bias.data(),
+          false,
+          out.data(),
+          prefetch_distance);
+    });
+    const double fused_seconds = TimeLookup([&]() {
+      Fused8BitRowwiseEmbeddingLookup(
+          block_size,
+          output_size,
+          index_size,
+          FLAGS_num_rows,
+          fused_table.data(),
+          indices.data(),
+          lengths.data(),
+          nullptr,
+          false,
+          out.data(),
+          prefetch_distance);
+    });
+    printf(
+        "block_size %4d, indices %7d, prefetch %3d: float %8.2f, "
+        "float16 %8.2f, uint8 %8.2f, fused uint8 %8.2f M rows/sec.\n",
+        block_size,
+        index_size,
+        prefetch_distance,
+        index_size / float_seconds / 1e6,
+        index_size / half_seconds / 1e6,
+        index_size / uint8_seconds / 1e6,
+        index_size / fused_seconds / 1e6);
+  }
+}
+
+} // namespace caffe2
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  for (int block_size : caffe2::ParseInts(caffe2::FLAGS_block_sizes)) {
+    for (int index_size : caffe2::ParseInts(caffe2::FLAGS_index_sizes)) {
+      caffe2::RunEmbeddingLookupBenchmark(block_size, index_size);
+    }
+  }
+  return 0;
+}
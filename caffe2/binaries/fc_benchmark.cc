@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Times the CPU FC engines on the layer shapes of online inference models,
+// where a few rows at a time are multiplied with a large constant weight
+// matrix, and checks each engine against the default GEMM implementation.
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/utils/proto_utils.h"
+#include "caffe2/utils/string_utils.h"
+
+CAFFE2_DEFINE_string(
+    engines,
+    ",PREPACKED,PACKED",
+    "Comma-separated FC engines to time, the empty name being the default.");
+CAFFE2_DEFINE_string(batch_sizes, "1,4,16,64,256", "Batch sizes to sweep.");
+CAFFE2_DEFINE_string(
+    shapes,
+    "256x256,512x1024,1024x1024,4096x1024,1024x4096",
+    "Comma-separated NxK weight shapes (outputs x inputs) to sweep.");
+CAFFE2_DEFINE_int(iterations, 100, "Number of runs to average.");
+
+namespace caffe2 {
+
+void FillUniform(
+    const vector<TIndex>& shape,
+    const string& name,
+    Workspace* ws) {
+  DeviceOption option;
+  CPUContext context(option);
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(shape);
+  math::RandUniform<float, CPUContext>(
+      tensor->size(), -1, 1, tensor->mutable_data<float>(), &context);
+}
+
+void RunFCBenchmark(int M, int N, int K) {
+  Workspace ws;
+  FillUniform({M, K}, "X", &ws);
+  FillUniform({N, K}, "W", &ws);
+  FillUniform({N}, "b", &ws);
+
+  const TensorCPU* expected = nullptr;
+  for (const auto& engine : split(',', FLAGS_engines)) {
+    const string output = "Y_" + engine;
+    OperatorDef def = CreateOperatorDef(
+        "FC",
+        "",
+        std::vector<string>{"X", "W", "b"},
+        std::vector<string>{output});
+    def.set_engine(engine);
+    auto op = CreateOperator(def, &ws);
+    // The first run also packs the weights for the engines that do so.
+    CAFFE_ENFORCE(op->Run());
+    Timer timer;
+    for (int i = 0; i < FLAGS_iterations; ++i) {
+      CAFFE_ENFORCE(op->Run());
+    }
+    const double seconds = timer.Seconds() / FLAGS_iterations;
+
+    const auto& Y = ws.GetBlob(output)->Get<TensorCPU>();
+    if (!expected) {
+      expected = &Y;
+    }
+    float max_error = 0;
+    for (int i = 0; i < Y.size(); ++i) {
+      max_error = std::max(
+          max_error, std::abs(Y.data<float>()[i] - expected->data<float>()[i]));
+    }
+    printf(
+        "M %4d N %5d K %5d %-13s%s %9.4f ms %8.2f GFLOPS, max error %g\n",
+        M,
+        N,
+        K,
+        engine.empty() ? "DEFAULT" : engine.c_str(),
+        op->engine() == engine ? " " : "*",
+        seconds * 1e3,
+        2.0 * M * N * K / seconds / 1e9,
+        max_error);
+  }
+}
+
+} // namespace caffe2
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  printf("* marks engines that fell back to the default implementation.\n");
+  for (const auto& shape : caffe2::split(',', caffe2::FLAGS_shapes)) {
+    const auto dims = caffe2::split('x', shape);
+    CAFFE_ENFORCE_EQ(dims.size(), 2, "Invalid shape ", shape);
+    for (const auto& M : caffe2::split(',', caffe2::FLAGS_batch_sizes)) {
+      caffe2::RunFCBenchmark(
+          std::stoi(M), std::stoi(dims[0]), std::stoi(dims[1]));
+    }
+  }
+  return 0;
+}
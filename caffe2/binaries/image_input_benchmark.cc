@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the decode throughput of ImageInputOp in images/sec, overall and
+// per decode thread. Reads --input_db if given, otherwise a minidb of
+// generated JPEG images of --image_height x --image_width.
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "caffe2/core/db.h"
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
+#include "caffe2/utils/string_utils.h"
+
+CAFFE2_DEFINE_string(input_db, "", "Image db to read; generated if empty.");
+CAFFE2_DEFINE_string(input_db_type, "minidb", "Type of --input_db.");
+CAFFE2_DEFINE_int(num_images, 512, "Images in the generated db.");
+CAFFE2_DEFINE_int(image_height, 375, "Height of the generated images.");
+CAFFE2_DEFINE_int(image_width, 500, "Width of the generated images.");
+CAFFE2_DEFINE_string(thread_counts, "1,2,4,8", "Decode threads to sweep.");
+CAFFE2_DEFINE_int(batch_size, 64, "Images per batch.");
+CAFFE2_DEFINE_int(scale, 256, "Size of the shorter side after scaling.");
+CAFFE2_DEFINE_int(crop, 224, "Size of the crop.");
+CAFFE2_DEFINE_bool(mirror, true, "Randomly mirror the images.");
+CAFFE2_DEFINE_bool(color_jitter, false, "Apply color jitter.");
+CAFFE2_DEFINE_int(iterations, 20, "Batches to time per thread count.");
+
+namespace caffe2 {
+
+std::vector<int> ParseInts(const string& list) {
+  std::vector<int> values;
+  for (const auto& value : split(',', list)) {
+    values.push_back(std::stoi(value));
+  }
+  return values;
+}
+
+// Writes JPEGs of smooth gradients with some noise, which compress roughly
+// like photos, as TensorProtos of (encoded image, int label).
+string GenerateInput() {
+  const string db_name = std::tmpnam(nullptr);
+  std::unique_ptr<db::DB> out(
+      db::CreateDB(FLAGS_input_db_type, db_name, db::NEW));
+  std::unique_ptr<db::Transaction> transaction(out->NewTransaction());
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> noise(-16, 16);
+  cv::Mat img(FLAGS_image_height, FLAGS_image_width, CV_8UC3);
+  std::vector<uchar> encoded;
+  TensorProtos protos;
+  TensorProto* data = protos.add_protos();
+  TensorProto* label = protos.add_protos();
+  data->set_data_type(TensorProto::STRING);
+  data->add_dims(1);
+  data->add_string_data("");
+  label->set_data_type(TensorProto::INT32);
+  label->add_dims(1);
+  label->add_int32_data(0);
+  string value;
+  for (int i = 0; i < FLAGS_num_images; ++i) {
+    for (int h = 0; h < img.rows; ++h) {
+      uchar* row = img.ptr<uchar>(h);
+      for (int w = 0; w < img.cols; ++w) {
+        for (int c = 0; c < 3; ++c) {
+          const int base = (h * (c + 1) + w * (3 - c) + i * 7) % 256;
+          row[w * 3 + c] = std::max(0, std::min(255, base + noise(gen)));
+        }
+      }
+    }
+    cv::imencode(".jpg", img, encoded);
+    data->set_string_data(0, encoded.data(), encoded.size());
+    label->set_int32_data(0, i % 1000);
+    protos.SerializeToString(&value);
+    transaction->Put(caffe2::to_string(i), value);
+  }
+  transaction->Commit();
+  return db_name;
+}
+
+double RunImageInput(const string& db_name, int num_threads) {
+  Workspace ws;
+  ws.CreateBlob("reader")->Reset(
+      new db::DBReader(FLAGS_input_db_type, db_name));
+  OperatorDef def = CreateOperatorDef(
+      "ImageInput",
+      "",
+      std::vector<string>{"reader"},
+      std::vector<string>{"data", "label"},
+      std::vector<Argument>{
+          MakeArgument<int>("batch_size", FLAGS_batch_size),
+          MakeArgument<int>("scale", FLAGS_scale),
+          MakeArgument<int>("crop", FLAGS_crop),
+          MakeArgument<int>("mirror", FLAGS_mirror),
+          MakeArgument<int>("color_jitter", FLAGS_color_jitter),
+          MakeArgument<int>("decode_threads", num_threads),
+          MakeArgument<float>("mean", 128.f),
+          MakeArgument<float>("std", 64.f)});
+  auto op = CreateOperator(def, &ws);
+  // The first run waits for the first batch, which also allocates the
+  // output and the decode buffers.
+  CAFFE_ENFORCE(op->Run());
+  Timer timer;
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    CAFFE_ENFORCE(op->Run());
+  }
+  return FLAGS_iterations * FLAGS_batch_size / timer.Seconds();
+}
+
+} // namespace caffe2
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  std::string db_name = caffe2::FLAGS_input_db;
+  if (db_name.empty()) {
+    db_name = caffe2::GenerateInput();
+  }
+  for (int num_threads : caffe2::ParseInts(caffe2::FLAGS_thread_counts)) {
+    const double images_per_sec = caffe2::RunImageInput(db_name, num_threads);
+    printf(
+        "decode threads %2d: %8.1f images/sec, %7.1f images/sec per thread.\n",
+        num_threads,
+        images_per_sec,
+        images_per_sec / num_threads);
+  }
+  if (caffe2::FLAGS_input_db.empty()) {
+    std::remove(db_name.c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,121 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures IndexGet throughput on a single LongIndexCreate index shared by a
+// growing number of threads. Each thread runs its own IndexGet operator in a
+// child workspace, so the only shared state is the index itself.
+
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/utils/proto_utils.h"
+
+CAFFE2_DEFINE_int(max_threads, 8, "Max number of concurrent IndexGet threads.");
+CAFFE2_DEFINE_int(batch_size, 256, "Number of keys per IndexGet call.");
+CAFFE2_DEFINE_int(iterations, 10000, "Number of IndexGet calls per thread.");
+CAFFE2_DEFINE_int64(key_space, 1000000, "Keys are drawn from [0, key_space).");
+CAFFE2_DEFINE_bool(freeze, false, "If true, benchmark a frozen index.");
+CAFFE2_DEFINE_bool(
+    preload,
+    false,
+    "If true, load all of [0, key_space) into the index first, as for a large "
+    "static vocabulary.");
+
+namespace caffe2 {
+
+void RunIndexGetWorker(Workspace* parent, int thread_id, double* seconds) {
+  Workspace ws(parent);
+  auto* keys = ws.CreateBlob("keys")->GetMutable<TensorCPU>();
+  keys->Resize(FLAGS_batch_size);
+  auto* keys_data = keys->mutable_data<int64_t>();
+  std::mt19937 gen(thread_id);
+  std::uniform_int_distribution<int64_t> dist(0, FLAGS_key_space - 1);
+  for (int i = 0; i < FLAGS_batch_size; ++i) {
+    keys_data[i] = dist(gen);
+  }
+  auto op = CreateOperator(
+      CreateOperatorDef("IndexGet", "", {"index", "keys"}, {"values"}), &ws);
+  Timer timer;
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    // Shuffle between calls so threads keep inserting new keys.
+    keys_data[i % FLAGS_batch_size] = dist(gen);
+    CAFFE_ENFORCE(op->Run());
+  }
+  *seconds = timer.Seconds();
+}
+
+void RunIndexGetBenchmark(int num_threads) {
+  Workspace ws;
+  ws.RunOperatorOnce(CreateOperatorDef(
+      "LongIndexCreate",
+      "",
+      std::vector<string>{},
+      std::vector<string>{"index"},
+      std::vector<Argument>{
+          MakeArgument<int64_t>("max_elements", FLAGS_key_space + 1)}));
+  if (FLAGS_preload) {
+    auto* items = ws.CreateBlob("items")->GetMutable<TensorCPU>();
+    items->Resize(FLAGS_key_space);
+    auto* items_data = items->mutable_data<int64_t>();
+    for (int64_t i = 0; i < FLAGS_key_space; ++i) {
+      items_data[i] = i;
+    }
+    ws.RunOperatorOnce(
+        CreateOperatorDef("IndexLoad", "", {"index", "items"}, {"index"}));
+  }
+  if (FLAGS_freeze) {
+    // Populate the index single-threaded before freezing it.
+    double warmup_seconds;
+    RunIndexGetWorker(&ws, num_threads, &warmup_seconds);
+    ws.RunOperatorOnce(
+        CreateOperatorDef("IndexFreeze", "", {"index"}, {"index"}));
+  }
+  std::vector<std::thread> threads;
+  std::vector<double> seconds(num_threads);
+  Timer timer;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back(RunIndexGetWorker, &ws, i, &seconds[i]);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  double elapsed_seconds = timer.Seconds();
+  double total_keys =
+      static_cast<double>(num_threads) * FLAGS_iterations * FLAGS_batch_size;
+  printf(
+      "Threads %03d, took %4.5f seconds, throughput %f keys/sec.\n",
+      num_threads,
+      elapsed_seconds,
+      total_keys / elapsed_seconds);
+}
+
+} // namespace caffe2
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  for (int num_threads = 1; num_threads <= caffe2::FLAGS_max_threads;
+       num_threads *= 2) {
+    caffe2::RunIndexGetBenchmark(num_threads);
+  }
+  return 0;
+}
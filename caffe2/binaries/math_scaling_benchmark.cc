@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Times the multithreaded CPU elementwise, broadcast and reduction kernels of
+// math_cpu.cc for a sweep of intra-op thread counts, reporting the memory
+// bandwidth they reach and their speedup over a single thread.
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/utils/parallel_for.h"
+#include "caffe2/utils/string_utils.h"
+
+CAFFE2_DEFINE_string(
+    threads,
+    "1,2,4,8,16,32,64",
+    "Comma-separated intra-op thread counts to sweep.");
+CAFFE2_DEFINE_int(rows, 4096, "Rows of the M x N inputs.");
+CAFFE2_DEFINE_int(cols, 4096, "Columns of the M x N inputs.");
+CAFFE2_DEFINE_int(iterations, 20, "Number of runs to average.");
+
+namespace caffe2 {
+
+struct Kernel {
+  std::string name;
+  // Bytes read and written by one run.
+  double bytes;
+  std::function<void()> run;
+};
+
+void RunScalingBenchmark() {
+  const int M = FLAGS_rows;
+  const int N = FLAGS_cols;
+  DeviceOption option;
+  CPUContext context(option);
+  std::vector<float> A(M * N);
+  std::vector<float> B(M * N);
+  std::vector<float> C(M * N);
+  std::vector<float> row(N);
+  std::vector<float> col(M);
+  math::RandUniform<float, CPUContext>(A.size(), -1, 1, A.data(), &context);
+  math::RandUniform<float, CPUContext>(B.size(), -1, 1, B.data(), &context);
+  math::RandUniform<float, CPUContext>(N, -1, 1, row.data(), &context);
+  math::RandUniform<float, CPUContext>(M, -1, 1, col.data(), &context);
+  // An outer product shaped broadcast, {M, 1} against {1, N}.
+  const std::vector<int> col_dims = {M, 1};
+  const std::vector<int> row_dims = {1, N};
+  float result = 0;
+
+  const double size = sizeof(float) * M * N;
+  const std::vector<Kernel> kernels = {
+      {"Add", 3 * size,
+       [&]() {
+         math::Add<float, CPUContext>(
+             M * N, A.data(), B.data(), C.data(), &context);
+       }},
+      {"AddToRow", 2 * size,
+       [&]() {
+         math::AddToRow<float, CPUContext>(
+             M, N, A.data(), row.data(), C.data(), &context);
+       }},
+      {"MulToCol", 2 * size,
+       [&]() {
+         math::MulToCol<float, CPUContext>(
+             M, N, col.data(), C.data(), &context);
+       }},
+      {"Mul {M,1}x{1,N}", size,
+       [&]() {
+         math::Mul<float, CPUContext>(
+             2,
+             col_dims.data(),
+             2,
+             row_dims.data(),
+             col.data(),
+             row.data(),
+             C.data(),
+             &context);
+       }},
+      {"RowwiseMax", size,
+       [&]() {
+         math::RowwiseMax<float, CPUContext>(
+             M, N, A.data(), col.data(), &context);
+       }},
+      {"ColwiseMax", size,
+       [&]() {
+         math::ColwiseMax<float, CPUContext>(
+             M, N, A.data(), row.data(), &context);
+       }},
+      {"Sum", size,
+       [&]() {
+         math::Sum<float, CPUContext>(M * N, A.data(), &result, &context);
+       }},
+      {"SumSqr", size,
+       [&]() {
+         math::SumSqr<float, CPUContext>(M * N, A.data(), &result, &context);
+       }},
+  };
+
+  std::vector<double> single_thread(kernels.size(), 0);
+  for (const auto& threads : split(',', FLAGS_threads)) {
+    SetIntraOpNumThreads(std::stoi(threads));
+    for (int k = 0; k < kernels.size(); ++k) {
+      const auto& kernel = kernels[k];
+      kernel.run();
+      Timer timer;
+      for (int i = 0; i < FLAGS_iterations; ++i) {
+        kernel.run();
+      }
+      const double seconds = timer.Seconds() / FLAGS_iterations;
+      if (single_thread[k] == 0) {
+        single_thread[k] = seconds;
+      }
+      printf(
+          "threads %3d %-16s %9.4f ms %8.2f GB/s %6.2fx\n",
+          GetIntraOpNumThreads(),
+          kernel.name.c_str(),
+          seconds * 1e3,
+          kernel.bytes / seconds / 1e9,
+          single_thread[k] / seconds);
+    }
+  }
+}
+
+} // namespace caffe2
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  printf("Speedups are relative to the first thread count.\n");
+  caffe2::RunScalingBenchmark();
+  return 0;
+}
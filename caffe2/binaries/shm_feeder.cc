@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This binary feeds the records of a Caffe2 db to processes on the same host
+// through a shmdb, the shared memory counterpart of zmq_feeder. Trainers read
+// the data with db_type "shmdb" and the same --output_db name, and the feeder
+// blocks whenever they fall behind.
+
+#include "caffe2/core/db.h"
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+
+CAFFE2_DEFINE_string(input_db, "", "The input db.");
+CAFFE2_DEFINE_string(input_db_type, "", "The input db type.");
+CAFFE2_DEFINE_string(
+    output_db,
+    "/caffe2_feed",
+    "Name of the shared memory object the records are written to.");
+
+using caffe2::db::DB;
+using caffe2::db::Cursor;
+using caffe2::string;
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+
+  LOG(INFO) << "Opening DB...";
+  auto in_db = caffe2::db::CreateDB(
+      caffe2::FLAGS_input_db_type, caffe2::FLAGS_input_db, caffe2::db::READ);
+  CAFFE_ENFORCE(
+      in_db,
+      "Cannot load input db " + caffe2::FLAGS_input_db + " of expected type " +
+          caffe2::FLAGS_input_db_type);
+  auto cursor = in_db->NewCursor();
+  LOG(INFO) << "DB opened.";
+
+  auto out_db = caffe2::db::CreateDB(
+      "shmdb", caffe2::FLAGS_output_db, caffe2::db::NEW);
+  auto transaction = out_db->NewTransaction();
+  LOG(INFO) << "Feeding " << caffe2::FLAGS_output_db;
+
+  while (1) {
+    VLOG(1) << "Sending " << cursor->key();
+    transaction->Put(cursor->key(), cursor->value());
+    cursor->Next();
+    if (!cursor->Valid()) {
+      cursor->SeekToFirst();
+    }
+  }
+  // We do not do an elegant quit since this binary is going to be terminated by
+  // control+C.
+  return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the throughput of ShardedTextFileReader, the multi-threaded reader
+// behind CreateTextFileReader(num_threads > 0), in MB/s and rows/s. Reads
+// --input if given, otherwise a generated TSV file of string and float fields.
+
+#include <sys/stat.h>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/operators/sharded_text_file_reader.h"
+#include "caffe2/utils/string_utils.h"
+
+CAFFE2_DEFINE_string(input, "", "TSV file to read; generated if empty.");
+CAFFE2_DEFINE_string(
+    field_types,
+    "",
+    "Comma separated TensorProto data types of the fields of --input.");
+CAFFE2_DEFINE_int64(num_rows, 2000000, "Rows of the generated file.");
+CAFFE2_DEFINE_string(thread_counts, "1,2,4,8", "Reader threads to sweep.");
+CAFFE2_DEFINE_bool(preserve_order, true, "Return rows in file order.");
+CAFFE2_DEFINE_int(read_buffer_size, 4 << 20, "Bytes per read call.");
+
+namespace caffe2 {
+
+std::vector<int> ParseInts(const string& list) {
+  std::vector<int> values;
+  for (const auto& value : split(',', list)) {
+    values.push_back(std::stoi(value));
+  }
+  return values;
+}
+
+std::string GenerateInput(std::vector<int>* fieldTypes) {
+  const std::string filename = std::tmpnam(nullptr);
+  std::ofstream out(filename);
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dist(-100, 100);
+  for (int64_t row = 0; row < FLAGS_num_rows; ++row) {
+    out << "key_" << gen() << '\t' << dist(gen) << '\t' << dist(gen) << '\t'
+        << "some free form text " << row << '\n';
+  }
+  *fieldTypes = {TensorProto_DataType_STRING,
+                 TensorProto_DataType_FLOAT,
+                 TensorProto_DataType_FLOAT,
+                 TensorProto_DataType_STRING};
+  return filename;
+}
+
+} // namespace caffe2
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  std::vector<int> fieldTypes;
+  std::string filename = caffe2::FLAGS_input;
+  const bool generated = filename.empty();
+  if (generated) {
+    filename = caffe2::GenerateInput(&fieldTypes);
+  } else {
+    fieldTypes = caffe2::ParseInts(caffe2::FLAGS_field_types);
+  }
+  struct stat st;
+  CAFFE_ENFORCE_EQ(stat(filename.c_str(), &st), 0, "Cannot stat ", filename);
+  const double megabytes = st.st_size / 1e6;
+
+  for (int threads : caffe2::ParseInts(caffe2::FLAGS_thread_counts)) {
+    caffe2::ShardedTextFileReaderOptions options;
+    options.numThreads = threads;
+    options.preserveOrder = caffe2::FLAGS_preserve_order;
+    options.readBufferSize = caffe2::FLAGS_read_buffer_size;
+    caffe2::Timer timer;
+    caffe2::ShardedTextFileReader reader({filename}, fieldTypes, options);
+    std::unique_ptr<caffe2::TextFileChunk> chunk;
+    int64_t rows = 0;
+    while (reader.next(chunk)) {
+      rows += chunk->numRows;
+    }
+    const double seconds = timer.Seconds();
+    printf(
+        "%2d threads, %3zu shards: %8.1f MB/s, %8.3f M rows/s.\n",
+        threads,
+        reader.numShards(),
+        megabytes / seconds,
+        rows / seconds / 1e6);
+  }
+  if (generated) {
+    std::remove(filename.c_str());
+  }
+  return 0;
+}
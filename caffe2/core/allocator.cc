@@ -50,6 +50,12 @@ void MemoryAllocationReporter::New(void* ptr, size_t nbytes) {
   allocated_ += nbytes;
   LOG(INFO) << "Caffe2 alloc " << nbytes << " bytes, total alloc " << allocated_
             << " bytes.";
+  CPUAllocatorCacheStats stats;
+  if (GetCPUAllocator()->GetCacheStats(&stats)) {
+    LOG(INFO) << "Caffe2 CPU allocator cache: " << stats.hits << " hits, "
+              << stats.misses << " misses, " << stats.cached_bytes
+              << " bytes cached.";
+  }
 }
 
 void MemoryAllocationReporter::Delete(void* ptr) {
@@ -34,12 +34,24 @@ using MemoryDeleter = void (*)(void*);
 // A helper function that is basically doing nothing.
 void NoDelete(void*);
 
+// Counters exported by allocators that keep freed blocks around for reuse.
+struct CPUAllocatorCacheStats {
+  size_t hits{0};
+  size_t misses{0};
+  size_t cached_bytes{0};
+};
+
 // A virtual allocator class to do memory allocation and deallocation.
 struct CPUAllocator {
   CPUAllocator() {}
   virtual ~CPUAllocator() noexcept {}
   virtual std::pair<void*, MemoryDeleter> New(size_t nbytes) = 0;
   virtual MemoryDeleter GetDeleter() = 0;
+  // Fills in the cache statistics of the allocator. Returns false if the
+  // allocator does not cache memory.
+  virtual bool GetCacheStats(CPUAllocatorCacheStats* /* stats */) {
+    return false;
+  }
 };
 
 // A virtual struct that is used to report Caffe2's memory allocation and
@@ -0,0 +1,251 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/core/batching_predictor.h"
+
+#include <algorithm>
+
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+constexpr int BatchingPredictorStats::kNumLatencyBuckets;
+
+namespace {
+
+// Whether two inputs can be concatenated along their first dimension.
+bool sameItemShape(const TensorCPU& a, const TensorCPU& b) {
+  if (a.meta() != b.meta() || a.ndim() != b.ndim()) {
+    return false;
+  }
+  for (int i = 1; i < a.ndim(); ++i) {
+    if (a.dim(i) != b.dim(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int latencyBucket(std::chrono::steady_clock::duration latency) {
+  const int64_t us =
+      std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+  int bucket = 0;
+  while (bucket + 1 < BatchingPredictorStats::kNumLatencyBuckets &&
+         (int64_t(1) << bucket) <= us) {
+    ++bucket;
+  }
+  return bucket;
+}
+
+} // namespace
+
+BatchingPredictor::BatchingPredictor(
+    std::unique_ptr<Predictor> predictor,
+    const BatchingPredictorOptions& options)
+    : predictor_(std::move(predictor)), options_(options) {
+  CAFFE_ENFORCE(predictor_);
+  CAFFE_ENFORCE_GT(options_.max_batch_size, 0);
+  stats_.batch_size_histogram.resize(options_.max_batch_size + 1);
+  stats_.latency_us_histogram.resize(
+      BatchingPredictorStats::kNumLatencyBuckets);
+  thread_ = std::thread([this]() { batchingLoop(); });
+}
+
+BatchingPredictor::~BatchingPredictor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+}
+
+std::future<BatchingPredictor::OutputVector> BatchingPredictor::runAsync(
+    const TensorVector& inputs) {
+  CAFFE_ENFORCE(!inputs.empty(), "BatchingPredictor needs batched inputs.");
+  CAFFE_ENFORCE_LE(inputs.size(), predictor_->def().external_input_size());
+  for (const auto* input : inputs) {
+    CAFFE_ENFORCE_GE(input->ndim(), 1, "Inputs need a batch dimension.");
+    CAFFE_ENFORCE_EQ(
+        input->dim(0),
+        inputs[0]->dim(0),
+        "All inputs of a request need the same batch size.");
+  }
+  std::unique_ptr<Request> request(new Request);
+  request->inputs = inputs;
+  request->rows = inputs[0]->dim(0);
+  request->enqueued = std::chrono::steady_clock::now();
+  auto future = request->promise.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CAFFE_ENFORCE(!stopping_, "BatchingPredictor is shutting down.");
+    queued_rows_ += request->rows;
+    queue_.push_back(std::move(request));
+  }
+  cv_.notify_one();
+  return future;
+}
+
+bool BatchingPredictor::run(const TensorVector& inputs, OutputVector* outputs) {
+  auto future = runAsync(inputs);
+  try {
+    *outputs = future.get();
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Batched run of " << predictor_->def().name()
+               << " failed: " << e.what();
+    return false;
+  }
+  return true;
+}
+
+BatchingPredictorStats BatchingPredictor::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void BatchingPredictor::batchingLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      // Only reached when stopping, after the queue has been drained.
+      return;
+    }
+    const auto deadline = queue_.front()->enqueued + options_.max_latency;
+    cv_.wait_until(lock, deadline, [this]() {
+      return stopping_ || queued_rows_ >= options_.max_batch_size;
+    });
+    auto batch = takeBatch();
+    lock.unlock();
+    runBatch(batch);
+    lock.lock();
+  }
+}
+
+std::vector<std::unique_ptr<BatchingPredictor::Request>>
+BatchingPredictor::takeBatch() {
+  std::vector<std::unique_ptr<Request>> batch;
+  TIndex rows = 0;
+  while (!queue_.empty()) {
+    auto& request = queue_.front();
+    if (!batch.empty()) {
+      if (rows + request->rows > options_.max_batch_size ||
+          request->inputs.size() != batch[0]->inputs.size()) {
+        break;
+      }
+      bool compatible = true;
+      for (int i = 0; i < request->inputs.size(); ++i) {
+        compatible &=
+            sameItemShape(*request->inputs[i], *batch[0]->inputs[i]);
+      }
+      if (!compatible) {
+        break;
+      }
+    }
+    rows += request->rows;
+    queued_rows_ -= request->rows;
+    batch.push_back(std::move(request));
+    queue_.pop_front();
+  }
+  return batch;
+}
+
+void BatchingPredictor::runBatch(std::vector<std::unique_ptr<Request>>& batch) {
+  const auto& first_inputs = batch[0]->inputs;
+  TIndex rows = 0;
+  for (const auto& request : batch) {
+    rows += request->rows;
+  }
+  bool success = true;
+  try {
+    // Concatenate the requests along the first dimension, unless there is
+    // only one of them to run.
+    TensorVector inputs;
+    if (batch.size() == 1) {
+      inputs = first_inputs;
+    } else {
+      CPUContext context;
+      while (batchInputs_.size() < first_inputs.size()) {
+        batchInputs_.emplace_back(new TensorCPU());
+      }
+      for (int i = 0; i < first_inputs.size(); ++i) {
+        auto* input = batchInputs_[i].get();
+        auto dims = first_inputs[i]->dims();
+        dims[0] = rows;
+        input->Resize(dims);
+        const auto& meta = first_inputs[i]->meta();
+        char* dst = static_cast<char*>(input->raw_mutable_data(meta));
+        for (const auto& request : batch) {
+          const auto* src = request->inputs[i];
+          context.CopyItems<CPUContext, CPUContext>(
+              meta, src->size(), src->raw_data(), dst);
+          dst += src->nbytes();
+        }
+        inputs.push_back(input);
+      }
+    }
+
+    TensorVector outputs;
+    CAFFE_ENFORCE(
+        predictor_->run(inputs, &outputs),
+        "Failed to run net ",
+        predictor_->def().name());
+
+    // Scatter the rows of every output back to the requests.
+    std::vector<OutputVector> results(batch.size());
+    for (const auto* output : outputs) {
+      CAFFE_ENFORCE_GE(output->ndim(), 1, "Outputs need a batch dimension.");
+      CAFFE_ENFORCE_EQ(
+          output->dim(0),
+          rows,
+          "Outputs need as many rows as the batched inputs.");
+      const auto& meta = output->meta();
+      const size_t row_items = output->size_from_dim(1);
+      const char* src = static_cast<const char*>(output->raw_data());
+      for (int r = 0; r < batch.size(); ++r) {
+        auto dims = output->dims();
+        dims[0] = batch[r]->rows;
+        std::unique_ptr<TensorCPU> result(new TensorCPU(dims));
+        const size_t items = batch[r]->rows * row_items;
+        CPUContext context;
+        context.CopyItems<CPUContext, CPUContext>(
+            meta, items, src, result->raw_mutable_data(meta));
+        src += items * meta.itemsize();
+        results[r].push_back(std::move(result));
+      }
+    }
+    for (int r = 0; r < batch.size(); ++r) {
+      batch[r]->promise.set_value(std::move(results[r]));
+    }
+  } catch (...) {
+    success = false;
+    for (auto& request : batch) {
+      request->promise.set_exception(std::current_exception());
+    }
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.num_requests += batch.size();
+  stats_.num_batches += 1;
+  stats_.num_failed_batches += !success;
+  stats_.batch_size_histogram[std::min(rows, options_.max_batch_size)] += 1;
+  for (const auto& request : batch) {
+    stats_.latency_us_histogram[latencyBucket(now - request->enqueued)] += 1;
+  }
+}
+
+} // namespace caffe2
@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/predictor.h"
+#include "caffe2/core/tensor.h"
+
+namespace caffe2 {
+
+struct BatchingPredictorOptions {
+  // A batch is run as soon as it holds this many rows (the sum of the first
+  // dimension of the requests in it). Requests are never split, so a single
+  // request larger than this runs on its own.
+  TIndex max_batch_size = 32;
+  // How long the oldest queued request may wait for more requests to join
+  // its batch before the batch is run anyway.
+  std::chrono::microseconds max_latency{1000};
+};
+
+// Histograms collected by a BatchingPredictor. Batch sizes are counted
+// exactly, up to max_batch_size; larger batches land in the last bucket.
+// Latencies, from runAsync() to the outputs being ready, are counted in
+// buckets of powers of two microseconds: bucket i holds latencies in
+// [2^(i-1), 2^i) us, and the last bucket everything above.
+struct BatchingPredictorStats {
+  static constexpr int kNumLatencyBuckets = 24;
+
+  int64_t num_requests = 0;
+  int64_t num_batches = 0;
+  int64_t num_failed_batches = 0;
+  std::vector<int64_t> batch_size_histogram;
+  std::vector<int64_t> latency_us_histogram;
+};
+
+/**
+ * Front end of a Predictor that serves concurrent requests by running them
+ * in batches.
+ *
+ * Each call to runAsync() queues a request. A background thread concatenates
+ * queued requests along their first (batch) dimension into one set of
+ * inputs, runs the net once on them, and slices the outputs back into one
+ * set per request. This trades a bit of latency, bounded by
+ * options.max_latency, for larger and more efficient ops, e.g. GEMMs in
+ * FullyConnectedOp.
+ *
+ * Every input of a request must have the same first dimension, and every
+ * output of the net must have the total number of rows of the batch as its
+ * first dimension, i.e. rows of the outputs may only depend on the same rows
+ * of the inputs. Requests whose inputs differ from the oldest queued request
+ * in anything but the first dimension are run in a later batch.
+ */
+class BatchingPredictor {
+ public:
+  using TensorVector = Predictor::TensorVector;
+  using OutputVector = std::vector<std::unique_ptr<TensorCPU>>;
+
+  BatchingPredictor(
+      std::unique_ptr<Predictor> predictor,
+      const BatchingPredictorOptions& options = BatchingPredictorOptions());
+  // Runs what is still queued, then stops the batching thread.
+  ~BatchingPredictor();
+
+  // Queues the inputs for the first inputs.size() external inputs of the
+  // net. The input tensors must stay alive, and unchanged, until the returned
+  // future is ready. The future holds one tensor per external output of the
+  // net, or the exception the net run threw.
+  std::future<OutputVector> runAsync(const TensorVector& inputs);
+
+  // Blocking version of runAsync(). Returns false if the net run failed.
+  bool run(const TensorVector& inputs, OutputVector* outputs);
+
+  BatchingPredictorStats stats() const;
+
+  const BatchingPredictorOptions& options() const {
+    return options_;
+  }
+
+ private:
+  struct Request {
+    TensorVector inputs;
+    TIndex rows;
+    std::promise<OutputVector> promise;
+    std::chrono::steady_clock::time_point enqueued;
+  };
+
+  void batchingLoop();
+  // Moves the requests of the next batch out of the queue. Called with
+  // mutex_ held.
+  std::vector<std::unique_ptr<Request>> takeBatch();
+  void runBatch(std::vector<std::unique_ptr<Request>>& batch);
+
+  const std::unique_ptr<Predictor> predictor_;
+  const BatchingPredictorOptions options_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::unique_ptr<Request>> queue_;
+  TIndex queued_rows_{0};
+  bool stopping_{false};
+  BatchingPredictorStats stats_;
+  std::vector<std::unique_ptr<TensorCPU>> batchInputs_;
+  std::thread thread_;
+
+  DISABLE_COPY_AND_ASSIGN(BatchingPredictor);
+};
+
+} // namespace caffe2
@@ -0,0 +1,200 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <google/protobuf/text_format.h>
+#include <thread>
+#include "caffe2/core/batching_predictor.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+const char* predictSpec = R"DOC(
+        name: "predict"
+        type: "dag"
+        external_input: "data"
+        external_input: "W"
+        external_input: "b"
+        external_output: "y"
+        op {
+          input: "data"
+          input: "W"
+          input: "b"
+          output: "y"
+          type: "FC"
+        }
+)DOC";
+
+const char* initSpec = R"DOC(
+        name: "init"
+        type: "dag"
+        op {
+          type: "GaussianFill"
+          output: "W"
+          arg {
+            name: "shape"
+            ints: 10
+            ints: 4
+          }
+        }
+        op {
+          type: "GaussianFill"
+          output: "b"
+          arg {
+            name: "shape"
+            ints: 10
+          }
+        }
+)DOC";
+
+NetDef parseNetDef(const std::string& value) {
+  NetDef def;
+  CAFFE_ENFORCE(
+      google::protobuf::TextFormat::ParseFromString(value, &def),
+      "Failed to parse NetDef with value: ",
+      value);
+  return def;
+}
+
+std::unique_ptr<TensorCPU> randomTensor(
+    const std::vector<TIndex>& dims,
+    CPUContext* ctx) {
+  std::unique_ptr<TensorCPU> t(new TensorCPU(dims));
+  math::RandUniform<float, CPUContext>(
+      t->size(), -1.0, 1.0, t->template mutable_data<float>(), ctx);
+  return t;
+}
+
+class BatchingPredictorTest : public testing::Test {
+ public:
+  void SetUp() override {
+    DeviceOption op;
+    op.set_random_seed(1701);
+    ctx_ = caffe2::make_unique<CPUContext>(op);
+    // Both predictors get the same weights from a shared parent workspace.
+    CAFFE_ENFORCE(parent_.RunNetOnce(parseNetDef(initSpec)));
+    reference_ = caffe2::make_unique<Predictor>(
+        NetDef(), parseNetDef(predictSpec), &parent_);
+  }
+
+  std::unique_ptr<BatchingPredictor> makeBatchingPredictor(
+      const BatchingPredictorOptions& options) {
+    return caffe2::make_unique<BatchingPredictor>(
+        caffe2::make_unique<Predictor>(
+            NetDef(), parseNetDef(predictSpec), &parent_),
+        options);
+  }
+
+  void expectMatchesReference(
+      TensorCPU* input,
+      const BatchingPredictor::OutputVector& outputs) {
+    Predictor::TensorVector reference_outputs;
+    EXPECT_TRUE(reference_->run({input}, &reference_outputs));
+    ASSERT_EQ(outputs.size(), 1);
+    ASSERT_EQ(outputs[0]->dims(), reference_outputs[0]->dims());
+    for (int i = 0; i < outputs[0]->size(); ++i) {
+      EXPECT_NEAR(
+          outputs[0]->data<float>()[i],
+          reference_outputs[0]->data<float>()[i],
+          1e-5);
+    }
+  }
+
+  Workspace parent_;
+  std::unique_ptr<CPUContext> ctx_;
+  std::unique_ptr<Predictor> reference_;
+};
+
+} // namespace
+
+TEST_F(BatchingPredictorTest, BatchesConcurrentRequests) {
+  BatchingPredictorOptions options;
+  options.max_batch_size = 6;
+  options.max_latency = std::chrono::seconds(10);
+  auto predictor = makeBatchingPredictor(options);
+
+  // Requests of 1, 2 and 3 rows fill a batch of 6 rows, so the net runs long
+  // before the latency deadline.
+  std::vector<std::unique_ptr<TensorCPU>> inputs;
+  for (int rows = 1; rows <= 3; ++rows) {
+    inputs.push_back(randomTensor({rows, 4}, ctx_.get()));
+  }
+  std::vector<std::thread> threads;
+  std::vector<BatchingPredictor::OutputVector> outputs(inputs.size());
+  for (int i = 0; i < inputs.size(); ++i) {
+    threads.emplace_back([&, i]() {
+      EXPECT_TRUE(predictor->run({inputs[i].get()}, &outputs[i]));
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (int i = 0; i < inputs.size(); ++i) {
+    expectMatchesReference(inputs[i].get(), outputs[i]);
+  }
+
+  auto stats = predictor->stats();
+  EXPECT_EQ(stats.num_requests, 3);
+  EXPECT_EQ(stats.num_batches, 1);
+  EXPECT_EQ(stats.batch_size_histogram[6], 1);
+}
+
+TEST_F(BatchingPredictorTest, RunsPartialBatchAtDeadline) {
+  BatchingPredictorOptions options;
+  options.max_batch_size = 64;
+  options.max_latency = std::chrono::milliseconds(1);
+  auto predictor = makeBatchingPredictor(options);
+
+  auto input = randomTensor({2, 4}, ctx_.get());
+  auto future = predictor->runAsync({input.get()});
+  auto outputs = future.get();
+  expectMatchesReference(input.get(), outputs);
+
+  auto stats = predictor->stats();
+  EXPECT_EQ(stats.num_batches, 1);
+  EXPECT_EQ(stats.batch_size_histogram[2], 1);
+  int64_t latencies = 0;
+  for (auto count : stats.latency_us_histogram) {
+    latencies += count;
+  }
+  EXPECT_EQ(latencies, 1);
+}
+
+TEST_F(BatchingPredictorTest, KeepsIncompatibleRequestsApart) {
+  BatchingPredictorOptions options;
+  options.max_batch_size = 8;
+  options.max_latency = std::chrono::milliseconds(20);
+  auto predictor = makeBatchingPredictor(options);
+
+  // The second request cannot be concatenated with the first one, and fails
+  // on its own without affecting the first.
+  auto good = randomTensor({2, 4}, ctx_.get());
+  auto bad = randomTensor({2, 5}, ctx_.get());
+  auto good_future = predictor->runAsync({good.get()});
+  auto bad_future = predictor->runAsync({bad.get()});
+  expectMatchesReference(good.get(), good_future.get());
+  EXPECT_ANY_THROW(bad_future.get());
+
+  auto stats = predictor->stats();
+  EXPECT_EQ(stats.num_batches, 2);
+  EXPECT_EQ(stats.num_failed_batches, 1);
+}
+
+} // namespace caffe2
@@ -213,6 +213,16 @@ class Blob {
       BlobSerializerBase::SerializationAcceptor acceptor,
       int chunk_size = kDefaultChunkSize) const;
 
+  /**
+   * Same as above, but tensor chunks are encoded with the given codec
+   * pipeline (see TensorChunkCodec) instead of --caffe2_tensor_chunk_codec.
+   */
+  void Serialize(
+      const string& name,
+      BlobSerializerBase::SerializationAcceptor acceptor,
+      int chunk_size,
+      const string& codec) const;
+
   /**
    * @brief Convenience function to serialize a blob to a string.
    *
@@ -236,9 +246,9 @@ class Blob {
   }
 
   /**
-   * Deserializes from a string containing either BlobProto or TensorProto. If
-   * the deserialization fails, the content in the blob should no longer be
-   * trusted.
+   * Deserializes from a string containing either BlobProto or TensorProto, or
+   * a raw tensor chunk (see RawTensorChunkHeader). If the deserialization
+   * fails, the content in the blob should no longer be trusted.
    */
   void Deserialize(const string& content);
   void Deserialize(const BlobProto& proto);
@@ -16,6 +16,7 @@
 
 #include "caffe2/core/blob_serialization.h"
 
+#include <cstring>
 #include <sstream>
 #include <mutex>
 
@@ -37,7 +38,146 @@ CAFFE2_DEFINE_bool(
     false,
     "Serialize FLOAT16 tensors using byte_data field");
 
+CAFFE2_DEFINE_bool(
+    caffe2_serialize_raw_tensors,
+    false,
+    "Serialize tensors of fixed-size types as raw tensor chunks instead of "
+    "TensorProto. Raw chunks avoid intermediate proto copies but are not "
+    "readable by older versions of Caffe2.");
+
+CAFFE2_DEFINE_string(
+    caffe2_tensor_chunk_codec,
+    "",
+    "Codec pipeline to encode tensor chunks with, e.g. shuffle+zstd. Implies "
+    "--caffe2_serialize_raw_tensors for the tensors it applies to.");
+
 namespace caffe2 {
+
+namespace {
+// A raw tensor chunk starts with a zero byte, which can never start a
+// serialized BlobProto (field number 0 is invalid in protobuf), so the two
+// formats can be told apart without parsing.
+constexpr char kRawTensorChunkMagic[] = {'\0', 'C', '2', 'R'};
+// Version 2 appends the codec of the chunk to the header. Chunks stored as is
+// are still written as version 1, so that older readers can load them.
+constexpr int32_t kRawTensorChunkVersion = 1;
+constexpr int32_t kEncodedRawTensorChunkVersion = 2;
+
+void CheckLittleEndian() {
+  const int kValue = 1;
+  CAFFE_ENFORCE_EQ(
+      reinterpret_cast<const char*>(&kValue)[0],
+      1,
+      "Raw tensor serialization on big endian platform is not written yet.");
+}
+
+template <typename T>
+void AppendPod(T value, string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T ReadPod(const char* data, size_t size, size_t* offset) {
+  CAFFE_ENFORCE_LE(*offset + sizeof(T), size, "Truncated raw tensor chunk.");
+  T value;
+  memcpy(&value, data + *offset, sizeof(T));
+  *offset += sizeof(T);
+  return value;
+}
+} // namespace
+
+bool IsRawTensorChunk(const char* data, size_t size) {
+  return size >= sizeof(kRawTensorChunkMagic) &&
+      memcmp(data, kRawTensorChunkMagic, sizeof(kRawTensorChunkMagic)) == 0;
+}
+
+bool CanSerializeAsRawTensor(const TypeMeta& meta) {
+  switch (TypeMetaToDataType(meta)) {
+    case TensorProto_DataType_FLOAT:
+    case TensorProto_DataType_INT32:
+    case TensorProto_DataType_BOOL:
+    case TensorProto_DataType_UINT8:
+    case TensorProto_DataType_INT8:
+    case TensorProto_DataType_UINT16:
+    case TensorProto_DataType_INT16:
+    case TensorProto_DataType_INT64:
+    case TensorProto_DataType_FLOAT16:
+    case TensorProto_DataType_DOUBLE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void AppendRawTensorChunkHeader(
+    TensorProto::DataType data_type,
+    const vector<TIndex>& dims,
+    int64_t begin,
+    int64_t end,
+    const string& codec,
+    string* out) {
+  CheckLittleEndian();
+  out->append(kRawTensorChunkMagic, sizeof(kRawTensorChunkMagic));
+  AppendPod<int32_t>(
+      codec.empty() ? kRawTensorChunkVersion : kEncodedRawTensorChunkVersion,
+      out);
+  AppendPod<int32_t>(data_type, out);
+  AppendPod<int32_t>(dims.size(), out);
+  AppendPod<int64_t>(begin, out);
+  AppendPod<int64_t>(end, out);
+  for (const auto d : dims) {
+    AppendPod<int64_t>(d, out);
+  }
+  if (!codec.empty()) {
+    AppendPod<int32_t>(codec.size(), out);
+    out->append(codec);
+  }
+}
+
+void ParseRawTensorChunkHeader(
+    const char* data,
+    size_t size,
+    RawTensorChunkHeader* header) {
+  CheckLittleEndian();
+  CAFFE_ENFORCE(IsRawTensorChunk(data, size), "Not a raw tensor chunk.");
+  size_t offset = sizeof(kRawTensorChunkMagic);
+  const auto version = ReadPod<int32_t>(data, size, &offset);
+  CAFFE_ENFORCE(
+      version == kRawTensorChunkVersion ||
+          version == kEncodedRawTensorChunkVersion,
+      "Unsupported raw tensor chunk version: ",
+      version);
+  const auto data_type = ReadPod<int32_t>(data, size, &offset);
+  CAFFE_ENFORCE(
+      TensorProto::DataType_IsValid(data_type),
+      "Invalid data type in raw tensor chunk: ",
+      data_type);
+  header->data_type = static_cast<TensorProto::DataType>(data_type);
+  CAFFE_ENFORCE(
+      CanSerializeAsRawTensor(DataTypeToTypeMeta(header->data_type)),
+      "Data type ",
+      data_type,
+      " cannot be stored in a raw tensor chunk.");
+  const auto ndim = ReadPod<int32_t>(data, size, &offset);
+  CAFFE_ENFORCE_GE(ndim, 0, "Invalid number of dims in raw tensor chunk.");
+  header->begin = ReadPod<int64_t>(data, size, &offset);
+  header->end = ReadPod<int64_t>(data, size, &offset);
+  header->dims.resize(ndim);
+  for (int i = 0; i < ndim; ++i) {
+    header->dims[i] = ReadPod<int64_t>(data, size, &offset);
+  }
+  header->codec.clear();
+  if (version == kEncodedRawTensorChunkVersion) {
+    const auto codec_size = ReadPod<int32_t>(data, size, &offset);
+    CAFFE_ENFORCE(
+        codec_size > 0 && offset + codec_size <= size,
+        "Invalid codec in raw tensor chunk.");
+    header->codec.assign(data + offset, codec_size);
+    offset += codec_size;
+  }
+  header->data_offset = offset;
+}
+
 /**
  * @brief StringSerializer is the serializer for String.
  *
@@ -87,6 +227,16 @@ void Blob::Serialize(
   serializer->SerializeWithChunkSize(*this, name, acceptor, chunk_size);
 }
 
+void Blob::Serialize(
+    const string& name,
+    BlobSerializerBase::SerializationAcceptor acceptor,
+    int chunk_size,
+    const string& codec) const {
+  std::unique_ptr<BlobSerializerBase> serializer(CreateSerializer(meta_.id()));
+  CAFFE_ENFORCE(serializer, "No known serializer for ", meta_.name());
+  serializer->SerializeWithCodec(*this, name, acceptor, chunk_size, codec);
+}
+
 // The blob serialization member function implementation.
 std::string Blob::Serialize(const string& name) const {
   std::string data;
@@ -115,6 +265,14 @@ CAFFE_DEFINE_TYPED_REGISTRY(
 CAFFE_DEFINE_REGISTRY(BlobDeserializerRegistry, BlobDeserializerBase);
 
 void Blob::Deserialize(const string& content) {
+  if (IsRawTensorChunk(content)) {
+    // Raw tensor chunks carry no device information and are always
+    // deserialized into a TensorCPU.
+    RawTensorChunkHeader header;
+    TensorDeserializer<CPUContext>().DeserializeRaw(
+        content.data(), content.size(), GetMutable<TensorCPU>(), &header);
+    return;
+  }
   BlobProto blob_proto;
   CAFFE_ENFORCE(
       blob_proto.ParseFromString(content),
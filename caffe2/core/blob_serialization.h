@@ -25,6 +25,7 @@
 #include "caffe2/core/blob.h"
 #include "caffe2/core/blob_serializer_base.h"
 #include "caffe2/core/tensor.h"
+#include "caffe2/core/tensor_chunk_codec.h"
 #include "caffe2/core/typeid.h"
 #include "caffe2/core/types.h"
 #include "caffe2/utils/simple_queue.h"
@@ -32,6 +33,8 @@
 CAFFE2_DECLARE_int(caffe2_tensor_chunk_size);
 CAFFE2_DECLARE_int(caffe2_max_tensor_serializer_threads);
 CAFFE2_DECLARE_bool(caffe2_serialize_fp16_as_bytes);
+CAFFE2_DECLARE_bool(caffe2_serialize_raw_tensors);
+CAFFE2_DECLARE_string(caffe2_tensor_chunk_codec);
 
 namespace caffe2 {
 
@@ -52,6 +55,63 @@ inline unique_ptr<BlobSerializerBase> CreateSerializer(CaffeTypeId id) {
   return BlobSerializerRegistry()->Create(id);
 }
 
+/**
+ * @brief RawTensorChunkHeader describes a raw tensor chunk.
+ *
+ * A raw tensor chunk is an alternative to a BlobProto for tensors of
+ * fixed-size types: a small binary header followed by the bytes of the
+ * chunk. It is produced by copying tensor memory directly into the output
+ * string and is read back without going through TensorProto repeated fields.
+ * That string is still handed to the SerializationAcceptor like any other
+ * chunk, so a sink that copies its value holds the bytes twice; there is no
+ * path writing tensor memory straight to a DB or file.
+ * Raw chunks are written when --caffe2_serialize_raw_tensors is set and can
+ * always be read by Blob::Deserialize and the Load operator.
+ *
+ * The bytes of a raw chunk can be encoded with a codec pipeline, e.g.
+ * "shuffle+zstd" (see TensorChunkCodec). The codec is recorded per chunk, and
+ * chunks that do not get smaller are stored as is.
+ */
+struct RawTensorChunkHeader {
+  TensorProto::DataType data_type;
+  vector<TIndex> dims;
+  int64_t begin;
+  int64_t end;
+  // Offset of the chunk bytes in the serialized content.
+  size_t data_offset;
+  // Codec pipeline the chunk bytes are encoded with, empty if stored as is.
+  string codec;
+};
+
+// Returns true if the serialized content is a raw tensor chunk rather than a
+// BlobProto.
+bool IsRawTensorChunk(const char* data, size_t size);
+inline bool IsRawTensorChunk(const string& content) {
+  return IsRawTensorChunk(content.data(), content.size());
+}
+// Returns true if tensors of the given type can be serialized as raw chunks.
+bool CanSerializeAsRawTensor(const TypeMeta& meta);
+// Appends the header of a raw tensor chunk to out. The caller is expected to
+// append (end - begin) items of chunk data right after it, encoded with codec
+// unless codec is empty.
+void AppendRawTensorChunkHeader(
+    TensorProto::DataType data_type,
+    const vector<TIndex>& dims,
+    int64_t begin,
+    int64_t end,
+    const string& codec,
+    string* out);
+// Parses and validates the header of a raw tensor chunk.
+void ParseRawTensorChunkHeader(
+    const char* data,
+    size_t size,
+    RawTensorChunkHeader* header);
+inline void ParseRawTensorChunkHeader(
+    const string& content,
+    RawTensorChunkHeader* header) {
+  ParseRawTensorChunkHeader(content.data(), content.size(), header);
+}
+
 /**
  * @brief TensorSerializer is the serializer for Tensors.
  *
@@ -76,9 +136,23 @@ class TensorSerializer : public BlobSerializerBase {
       const string& name,
       SerializationAcceptor acceptor,
       int chunk_size) override;
+  void SerializeWithCodec(
+      const Blob& blob,
+      const string& name,
+      SerializationAcceptor acceptor,
+      int chunk_size,
+      const string& codec) override;
 
   void Serialize(const Tensor<Context>& tensor, const string& name,
                  TensorProto* proto, size_t chunkBegin, int32_t chunkSize);
+  // Serializes a chunk of the tensor as a raw tensor chunk into out, encoding
+  // its bytes with codec if it is not empty.
+  void SerializeRaw(
+      const Tensor<Context>& tensor,
+      size_t chunkBegin,
+      int32_t chunkSize,
+      string* out,
+      const string& codec = "");
 
  private:
   // A utility function to store the device context detauls.
@@ -119,6 +193,20 @@ class TensorDeserializer : public BlobDeserializerBase {
  public:
   void Deserialize(const BlobProto& proto, Blob* blob) override;
   void Deserialize(const TensorProto& proto, Tensor<Context>* tensor);
+  // Parses the header of a raw tensor chunk into header, resizes the tensor
+  // and returns where the decoded chunk bytes go, without copying them.
+  char* PrepareRaw(
+      const char* data,
+      size_t size,
+      Tensor<Context>* tensor,
+      RawTensorChunkHeader* header);
+  // Deserializes a raw tensor chunk into a tensor living on the current
+  // device, and stores the parsed chunk header in header.
+  void DeserializeRaw(
+      const char* data,
+      size_t size,
+      Tensor<Context>* tensor,
+      RawTensorChunkHeader* header);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -212,6 +300,17 @@ void TensorSerializer<Context>::SerializeWithChunkSize(
     const string& name,
     BlobSerializerBase::SerializationAcceptor acceptor,
     int chunk_size) {
+  this->SerializeWithCodec(
+      blob, name, acceptor, chunk_size, FLAGS_caffe2_tensor_chunk_codec);
+}
+
+template <class Context>
+void TensorSerializer<Context>::SerializeWithCodec(
+    const Blob& blob,
+    const string& name,
+    BlobSerializerBase::SerializationAcceptor acceptor,
+    int chunk_size,
+    const string& codec) {
   CAFFE_ENFORCE(blob.IsType<Tensor<Context>>());
   const auto& tensor = blob.template Get<Tensor<Context>>();
   if (chunk_size == kNoChunking) {
@@ -220,7 +319,24 @@ void TensorSerializer<Context>::SerializeWithChunkSize(
     chunk_size = FLAGS_caffe2_tensor_chunk_size;
   }
 
+  // Codecs only apply to raw chunks, so setting one implies raw chunks.
+  const bool serializeRaw =
+      (FLAGS_caffe2_serialize_raw_tensors || !codec.empty()) &&
+      CanSerializeAsRawTensor(tensor.meta());
+  if (serializeRaw && !codec.empty()) {
+    ParseTensorChunkCodec(codec);
+  }
+  // Chunks are encoded by the same threads that serialize them, and written
+  // by the acceptor while other chunks are still being encoded.
   auto processChunk = [&](int64_t chunkStart) {
+    const string key =
+        MakeString(name, kChunkIdSeparator, chunkStart / chunk_size);
+    if (serializeRaw) {
+      string content;
+      this->SerializeRaw(tensor, chunkStart, chunk_size, &content, codec);
+      acceptor(key, content);
+      return;
+    }
     BlobProto blob_proto;
     blob_proto.set_name(name);
     blob_proto.set_type(kTensorBlobType);
@@ -228,9 +344,7 @@ void TensorSerializer<Context>::SerializeWithChunkSize(
     proto.set_name(name);
     this->Serialize(
         tensor, name, blob_proto.mutable_tensor(), chunkStart, chunk_size);
-    acceptor(
-        MakeString(name, kChunkIdSeparator, chunkStart / chunk_size),
-        blob_proto.SerializeAsString());
+    acceptor(key, blob_proto.SerializeAsString());
   };
 
 #ifndef __ANDROID__
@@ -431,6 +545,72 @@ void TensorSerializer<Context>::Serialize(
   }
 }
 
+template <class Context>
+void TensorSerializer<Context>::SerializeRaw(
+    const Tensor<Context>& input,
+    size_t chunkBegin,
+    int32_t chunkSize,
+    string* out,
+    const string& codec) {
+  CAFFE_ENFORCE(
+      chunkBegin <= input.size(),
+      "Chunk begin is out of tensor: ",
+      chunkBegin,
+      ' ',
+      input.size());
+  if (chunkBegin + chunkSize > input.size()) {
+    chunkSize = input.size() - chunkBegin;
+  }
+  CAFFE_ENFORCE(
+      input.raw_data() || chunkSize == 0,
+      "The input does not have data input yet. This is probably because you "
+      "created a tensor of non-zero shape but never filled its data via "
+      "mutable_data() calls. This means that it makes no sense to serialize "
+      "the tensor content.");
+
+  const size_t nbytes = chunkSize * input.itemsize();
+  const char* src = static_cast<const char*>(input.raw_data()) +
+      chunkBegin * input.itemsize();
+  string encoded;
+  bool isEncoded = false;
+  if (!codec.empty() && nbytes > 0) {
+    // Device tensors are copied to the host before being encoded.
+    std::unique_ptr<char[]> host;
+    if (!std::is_same<Context, CPUContext>::value) {
+      host.reset(new char[nbytes]);
+      this->context_.template CopyBytes<Context, CPUContext>(
+          nbytes, src, host.get());
+      this->context_.FinishDeviceComputation();
+    }
+    isEncoded = EncodeTensorChunk(
+        codec, host ? host.get() : src, nbytes, input.itemsize(), &encoded);
+  }
+
+  out->clear();
+  AppendRawTensorChunkHeader(
+      TypeMetaToDataType(input.meta()),
+      input.dims(),
+      chunkBegin,
+      chunkBegin + chunkSize,
+      isEncoded ? codec : "",
+      out);
+  if (isEncoded) {
+    out->append(encoded);
+    return;
+  }
+  const size_t offset = out->size();
+  if (nbytes == 0) {
+    return;
+  }
+  // The chunk bytes are copied straight from the tensor into the output, so
+  // unlike the proto path there is no TensorProto copy next to the encoded
+  // string.
+  out->resize(offset + nbytes);
+  this->context_.template CopyBytes<Context, CPUContext>(
+      nbytes, src, &(*out)[offset]);
+  this->context_.FinishDeviceComputation();
+}
+
 template <class Context>
 void TensorDeserializer<Context>::Deserialize(
     const BlobProto& blob_proto,
@@ -597,6 +777,67 @@ void TensorDeserializer<Context>::Deserialize(
   context.FinishDeviceComputation();
 }
 
+template <class Context>
+char* TensorDeserializer<Context>::PrepareRaw(
+    const char* data,
+    size_t size,
+    Tensor<Context>* tensor,
+    RawTensorChunkHeader* header) {
+  ParseRawTensorChunkHeader(data, size, header);
+  tensor->Resize(header->dims);
+  CAFFE_ENFORCE(
+      0 <= header->begin && header->begin <= header->end &&
+          header->end <= tensor->size(),
+      "Invalid chunk ",
+      header->begin,
+      ' ',
+      header->end,
+      " with total tensor size ",
+      tensor->size());
+  const TypeMeta& meta = DataTypeToTypeMeta(header->data_type);
+  if (header->codec.empty()) {
+    CAFFE_ENFORCE_EQ(
+        size - header->data_offset,
+        (header->end - header->begin) * meta.itemsize(),
+        "Incorrect raw tensor chunk size.");
+  }
+  return static_cast<char*>(tensor->raw_mutable_data(meta)) +
+      header->begin * meta.itemsize();
+}
+
+template <class Context>
+void TensorDeserializer<Context>::DeserializeRaw(
+    const char* data,
+    size_t size,
+    Tensor<Context>* tensor,
+    RawTensorChunkHeader* header) {
+  Context context;
+  context.SwitchToDevice(0);
+  char* dst = PrepareRaw(data, size, tensor, header);
+  const size_t itemsize = tensor->itemsize();
+  const size_t nbytes = (header->end - header->begin) * itemsize;
+  if (nbytes == 0) {
+    return;
+  }
+  const char* src = data + header->data_offset;
+  if (!header->codec.empty()) {
+    // Chunks are decoded on the host, straight into CPU tensors.
+    const size_t src_size = size - header->data_offset;
+    if (std::is_same<Context, CPUContext>::value) {
+      DecodeTensorChunk(header->codec, src, src_size, itemsize, dst, nbytes);
+      return;
+    }
+    std::unique_ptr<char[]> host(new char[nbytes]);
+    DecodeTensorChunk(
+        header->codec, src, src_size, itemsize, host.get(), nbytes);
+    context.template CopyBytes<CPUContext, Context>(nbytes, host.get(), dst);
+    context.FinishDeviceComputation();
+    return;
+  }
+  context.template CopyBytes<CPUContext, Context>(nbytes, src, dst);
+  context.FinishDeviceComputation();
+}
+
 }  // namespace caffe2
 
 #endif  // CAFFE2_CORE_BLOB_SERIALIZATION_H_
@@ -66,6 +66,20 @@ class BlobSerializerBase {
     // Base implementation.
     Serialize(blob, name, acceptor);
   }
+
+  /**
+   * @brief Serializes the blob, encoding its chunks with the given codec
+   * pipeline if the serializer supports it (see TensorChunkCodec).
+   */
+  virtual void SerializeWithCodec(
+      const Blob& blob,
+      const std::string& name,
+      SerializationAcceptor acceptor,
+      int chunk_size,
+      const std::string& /*codec*/) {
+    // Base implementation.
+    SerializeWithChunkSize(blob, name, acceptor, chunk_size);
+  }
 };
 
 } // namespace caffe2
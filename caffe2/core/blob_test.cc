@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <mutex>
@@ -877,6 +879,260 @@ TYPED_TEST(TypedTensorTest, BigTensorSerialization) {
   }
 }
 
+TYPED_TEST(TypedTensorTest, RawTensorChunkSerialization) {
+  const int64_t d1 = 3;
+  const int64_t d2 = 1001;
+  const int64_t size = d1 * d2;
+  string db_source = (string)std::tmpnam(nullptr);
+  bool raw_flag = FLAGS_caffe2_serialize_raw_tensors;
+  FLAGS_caffe2_serialize_raw_tensors = true;
+
+  {
+    Blob blob;
+    TensorCPU* tensor = blob.GetMutable<TensorCPU>();
+    tensor->Resize(d1, d2);
+    auto mutableData = tensor->mutable_data<TypeParam>();
+    for (int64_t i = 0; i < size; ++i) {
+      mutableData[i] = static_cast<TypeParam>(i);
+    }
+    StringMap data;
+    std::mutex mutex;
+    auto acceptor = [&](const std::string& key, const std::string& value) {
+      std::lock_guard<std::mutex> guard(mutex);
+      EXPECT_TRUE(IsRawTensorChunk(value));
+      data.emplace_back(key, value);
+    };
+    blob.Serialize("test", acceptor, 1000);
+    EXPECT_EQ(data.size(), 4);
+    VectorDB::registerData(db_source, std::move(data));
+
+    Blob single_chunk_blob;
+    single_chunk_blob.Deserialize(blob.Serialize("test"));
+    EXPECT_TRUE(single_chunk_blob.IsType<TensorCPU>());
+    const auto& single_chunk_tensor = single_chunk_blob.Get<TensorCPU>();
+    EXPECT_EQ(single_chunk_tensor.dims(), tensor->dims());
+    for (int64_t i = 0; i < size; ++i) {
+      EXPECT_EQ(mutableData[i], single_chunk_tensor.data<TypeParam>()[i]);
+    }
+  }
+  FLAGS_caffe2_serialize_raw_tensors = raw_flag;
+
+  {
+    DeviceOption option;
+    option.set_device_type(CPU);
+    Argument db_type_arg = MakeArgument<string>("db_type", "vector_db");
+    Argument absolute_path_arg = MakeArgument<bool>("absolute_path", true);
+    Argument db_source_arg = MakeArgument<string>("db", db_source);
+    auto op_def = CreateOperatorDef(
+        "Load",
+        "",
+        std::vector<string>{},
+        std::vector<string>({"test"}),
+        std::vector<Argument>{db_type_arg, db_source_arg, absolute_path_arg},
+        option,
+        "DUMMY_ENGINE");
+    Workspace ws;
+    auto load_op = CreateOperator(op_def, &ws);
+    EXPECT_TRUE(load_op != nullptr);
+    load_op->Run();
+    auto new_blob = ws.GetBlob("test");
+    EXPECT_TRUE(new_blob->IsType<TensorCPU>());
+    const auto& new_tensor = new_blob->Get<TensorCPU>();
+    EXPECT_EQ(new_tensor.ndim(), 2);
+    EXPECT_EQ(new_tensor.dim(0), d1);
+    EXPECT_EQ(new_tensor.dim(1), d2);
+    for (int64_t i = 0; i < size; ++i) {
+      EXPECT_EQ(static_cast<TypeParam>(i), new_tensor.data<TypeParam>()[i]);
+    }
+  }
+}
+
+// Run-length encoding of bytes, enough to exercise compressing codecs without
+// depending on an optional compression library.
+class RunLengthChunkCodec : public TensorChunkCodec {
+ public:
+  void Encode(const char* data, size_t size, size_t, string* out)
+      const override {
+    for (size_t i = 0; i < size;) {
+      size_t run = 1;
+      while (i + run < size && run < 255 && data[i + run] == data[i]) {
+        ++run;
+      }
+      out->push_back(static_cast<char>(run));
+      out->push_back(data[i]);
+      i += run;
+    }
+  }
+
+  void Decode(const char* data, size_t size, size_t, char* out, size_t out_size)
+      const override {
+    size_t decoded = 0;
+    for (size_t i = 0; i + 1 < size; i += 2) {
+      const size_t run = static_cast<unsigned char>(data[i]);
+      CAFFE_ENFORCE_LE(decoded + run, out_size);
+      memset(out + decoded, data[i + 1], run);
+      decoded += run;
+    }
+    CAFFE_ENFORCE_EQ(decoded, out_size);
+  }
+};
+
+REGISTER_TENSOR_CHUNK_CODEC(test_rle, RunLengthChunkCodec);
+
+TYPED_TEST(TypedTensorTest, EncodedRawTensorChunkSerialization) {
+  const int64_t d1 = 3;
+  const int64_t d2 = 1001;
+  const int64_t size = d1 * d2;
+  string db_source = (string)std::tmpnam(nullptr);
+  StringMap data;
+
+  {
+    Blob blob;
+    TensorCPU* tensor = blob.GetMutable<TensorCPU>();
+    tensor->Resize(d1, d2);
+    auto mutableData = tensor->mutable_data<TypeParam>();
+    for (int64_t i = 0; i < size; ++i) {
+      mutableData[i] = static_cast<TypeParam>(i / 100);
+    }
+    std::mutex mutex;
+    auto acceptor = [&](const std::string& key, const std::string& value) {
+      std::lock_guard<std::mutex> guard(mutex);
+      RawTensorChunkHeader header;
+      ParseRawTensorChunkHeader(value, &header);
+      EXPECT_EQ(header.codec, "shuffle+test_rle");
+      data.emplace_back(key, value);
+    };
+    blob.Serialize("test", acceptor, 1000, "shuffle+test_rle");
+    EXPECT_EQ(data.size(), 4);
+
+    Blob chunk_blob;
+    chunk_blob.Deserialize(data[0].second);
+    const auto& chunk_tensor = chunk_blob.Get<TensorCPU>();
+    EXPECT_EQ(chunk_tensor.dims(), tensor->dims());
+    for (int64_t i = 0; i < 1000; ++i) {
+      EXPECT_EQ(mutableData[i], chunk_tensor.data<TypeParam>()[i]);
+    }
+  }
+
+  for (const int decode_threads : {0, 2}) {
+    VectorDB::registerData(db_source, StringMap(data));
+    DeviceOption option;
+    option.set_device_type(CPU);
+    auto op_def = CreateOperatorDef(
+        "Load",
+        "",
+        std::vector<string>{},
+        std::vector<string>({"test"}),
+        std::vector<Argument>{MakeArgument<string>("db_type", "vector_db"),
+                              MakeArgument<string>("db", db_source),
+                              MakeArgument<bool>("absolute_path", true),
+                              MakeArgument<int>("decode_threads", decode_threads)},
+        option,
+        "DUMMY_ENGINE");
+    Workspace ws;
+    auto load_op = CreateOperator(op_def, &ws);
+    EXPECT_TRUE(load_op != nullptr);
+    load_op->Run();
+    const auto& new_tensor = ws.GetBlob("test")->Get<TensorCPU>();
+    EXPECT_EQ(new_tensor.ndim(), 2);
+    EXPECT_EQ(new_tensor.dim(0), d1);
+    EXPECT_EQ(new_tensor.dim(1), d2);
+    for (int64_t i = 0; i < size; ++i) {
+      EXPECT_EQ(
+          static_cast<TypeParam>(i / 100), new_tensor.data<TypeParam>()[i]);
+    }
+  }
+}
+
+TEST(TensorChunkCodecTest, LoadRejectsChunksOfAnotherShape) {
+  // Mixes the chunks of two tensors saved under the same name, so that the
+  // second chunk would resize the tensor the first one is decoded into.
+  StringMap data;
+  for (const int64_t d1 : {3, 2}) {
+    Blob blob;
+    TensorCPU* tensor = blob.GetMutable<TensorCPU>();
+    tensor->Resize(d1, 1001);
+    std::fill(
+        tensor->mutable_data<float>(),
+        tensor->mutable_data<float>() + tensor->size(),
+        1.f);
+    StringMap chunks;
+    std::mutex mutex;
+    blob.Serialize(
+        "test",
+        [&](const std::string& key, const std::string& value) {
+          std::lock_guard<std::mutex> guard(mutex);
+          chunks.emplace_back(key, value);
+        },
+        1000,
+        "shuffle+test_rle");
+    std::sort(chunks.begin(), chunks.end());
+    data.push_back(d1 == 3 ? chunks.front() : chunks.back());
+  }
+  string db_source = (string)std::tmpnam(nullptr);
+  VectorDB::registerData(db_source, std::move(data));
+  DeviceOption option;
+  option.set_device_type(CPU);
+  auto op_def = CreateOperatorDef(
+      "Load",
+      "",
+      std::vector<string>{},
+      std::vector<string>({"test"}),
+      std::vector<Argument>{MakeArgument<string>("db_type", "vector_db"),
+                            MakeArgument<string>("db", db_source),
+                            MakeArgument<bool>("absolute_path", true),
+                            MakeArgument<int>("decode_threads", 2)},
+      option,
+      "DUMMY_ENGINE");
+  Workspace ws;
+  auto load_op = CreateOperator(op_def, &ws);
+  ASSERT_TRUE(load_op != nullptr);
+  EXPECT_THROW(load_op->Run(), EnforceNotMet);
+}
+
+TEST(TensorChunkCodecTest, ChunksThatDoNotShrinkAreStoredAsIs) {
+  Blob blob;
+  auto* tensor = blob.GetMutable<TensorCPU>();
+  tensor->Resize(256);
+  for (int i = 0; i < 256; ++i) {
+    tensor->mutable_data<uint8_t>()[i] = i;
+  }
+  string content;
+  blob.Serialize(
+      "test",
+      [&](const string&, const string& value) { content = value; },
+      kNoChunking,
+      "test_rle");
+  RawTensorChunkHeader header;
+  ParseRawTensorChunkHeader(content, &header);
+  EXPECT_EQ(header.codec, "");
+  EXPECT_EQ(content.size() - header.data_offset, 256);
+}
+
+TEST(TensorChunkCodecTest, ShuffleRoundTrip) {
+  // 3 bytes at the end do not make up a whole item.
+  const string data = "abcdefghijklmnopqrs";
+  string shuffled;
+  EXPECT_FALSE(
+      EncodeTensorChunk("shuffle", data.data(), data.size(), 4, &shuffled));
+  std::unique_ptr<TensorChunkCodec> shuffle(
+      TensorChunkCodecRegistry()->Create("shuffle"));
+  shuffle->Encode(data.data(), data.size(), 4, &shuffled);
+  EXPECT_EQ(shuffled, "aeimbfjncgkodhlpqrs");
+  string decoded(data.size(), ' ');
+  DecodeTensorChunk(
+      "shuffle", shuffled.data(), shuffled.size(), 4, &decoded[0], data.size());
+  EXPECT_EQ(decoded, data);
+}
+
+TEST(TensorChunkCodecTest, InvalidCodecs) {
+  EXPECT_THROW(ParseTensorChunkCodec("no_such_codec"), EnforceNotMet);
+  EXPECT_THROW(ParseTensorChunkCodec("test_rle+shuffle"), EnforceNotMet);
+  EXPECT_EQ(
+      ParseTensorChunkCodec("shuffle+test_rle"),
+      (vector<string>{"shuffle", "test_rle"}));
+}
+
 struct DummyType {
   /* This struct is used to test serialization and deserialization of huge
    * blobs, that are not tensors.
@@ -27,6 +27,7 @@
 #include "caffe2/core/logging.h"
 #include "caffe2/core/typeid.h"
 #include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/parallel_for.h"
 
 CAFFE2_DECLARE_bool(caffe2_report_cpu_memory_usage);
 
@@ -108,6 +109,26 @@ class CPUContext final {
 
   inline void FinishDeviceComputation() {}
 
+  // The pool that operators running on this context split their work with,
+  // which defaults to the process-wide one. Operators get the pool of their
+  // workspace or net, see Workspace::SetIntraOpThreadPool.
+  inline IntraOpThreadPool* intraOpThreadPool() const {
+    return intra_op_pool_ ? intra_op_pool_.get()
+                          : GetDefaultIntraOpThreadPool();
+  }
+
+  inline void SetIntraOpThreadPool(std::shared_ptr<IntraOpThreadPool> pool) {
+    intra_op_pool_ = std::move(pool);
+  }
+
+  // Runs fn(begin, end) over [0, n) on the intra-op pool, see ParallelFor in
+  // caffe2/utils/parallel_for.h.
+  template <typename Func>
+  inline void ParallelFor(std::size_t n, std::size_t grain_size, Func&& fn) {
+    caffe2::ParallelFor(
+        intra_op_pool_.get(), n, grain_size, std::forward<Func>(fn));
+  }
+
   inline rand_gen_type& RandGenerator() {
     if (!random_generator_.get()) {
       random_generator_.reset(new rand_gen_type(random_seed_));
@@ -171,6 +192,7 @@ class CPUContext final {
   // TODO(jiayq): instead of hard-coding a generator, make it more flexible.
   int random_seed_{1701};
   std::unique_ptr<rand_gen_type> random_generator_;
+  std::shared_ptr<IntraOpThreadPool> intra_op_pool_;
   static MemoryAllocationReporter reporter_;
 
  private:
@@ -180,6 +202,19 @@ class CPUContext final {
   }
 };
 
+// Hands an intra-op pool to the context of an operator. Only CPUContext
+// splits work between threads this way, other contexts ignore it.
+template <class Context>
+inline void SetContextIntraOpThreadPool(
+    Context* /* unused */,
+    const std::shared_ptr<IntraOpThreadPool>& /* unused */) {}
+
+inline void SetContextIntraOpThreadPool(
+    CPUContext* context,
+    const std::shared_ptr<IntraOpThreadPool>& pool) {
+  context->SetIntraOpThreadPool(pool);
+}
+
 template<>
 inline void CPUContext::CopyBytes<CPUContext, CPUContext>(
     size_t nbytes, const void* src, void* dst) {
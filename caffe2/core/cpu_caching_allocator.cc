@@ -0,0 +1,326 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/core/cpu_caching_allocator.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "caffe2/core/init.h"
+
+CAFFE2_DEFINE_bool(
+    caffe2_cpu_allocator_use_caching,
+    false,
+    "If set, install a CachingCPUAllocator as the CPU allocator during "
+    "GlobalInit.");
+CAFFE2_DEFINE_int64(
+    caffe2_cpu_caching_allocator_max_block_bytes,
+    64 << 20,
+    "Blocks larger than this are never cached by the CachingCPUAllocator.");
+CAFFE2_DEFINE_int64(
+    caffe2_cpu_caching_allocator_thread_cache_bytes,
+    16 << 20,
+    "Max number of bytes kept in each per-thread cache of the "
+    "CachingCPUAllocator.");
+CAFFE2_DEFINE_int64(
+    caffe2_cpu_caching_allocator_global_cache_bytes,
+    1LL << 30,
+    "Max number of bytes kept in the global cache of the CachingCPUAllocator.");
+
+namespace caffe2 {
+
+namespace {
+
+// Four size classes per power of two, the smallest one being 64 bytes. The
+// last class covers blocks of up to 7 << 35 bytes, which is way beyond any
+// sensible max block size.
+constexpr int kNumSizeClasses = 128;
+constexpr int kUncached = -1;
+
+size_t SizeClassBytes(int size_class) {
+  return static_cast<size_t>(4 + size_class % 4) << (4 + size_class / 4);
+}
+
+int SizeClassOf(size_t nbytes) {
+  if (nbytes <= 64) {
+    return 0;
+  }
+  // Find the group such that (64 << group) < nbytes <= (128 << group).
+  int group = 0;
+  while ((static_cast<size_t>(128) << group) < nbytes) {
+    ++group;
+  }
+  size_t step = static_cast<size_t>(16) << group;
+  int m = static_cast<int>((nbytes + step - 1) / step); // in [5, 8]
+  return 4 * group + m - 4;
+}
+
+// Every block is prefixed with a header that records its size class, padded
+// to keep the user pointer aligned.
+struct BlockHeader {
+  int size_class;
+};
+static_assert(
+    sizeof(BlockHeader) <= gCaffe2Alignment,
+    "BlockHeader must fit in the alignment padding.");
+
+void* UserPtr(void* block) {
+  return static_cast<char*>(block) + gCaffe2Alignment;
+}
+
+void* BlockPtr(void* data) {
+  return static_cast<char*>(data) - gCaffe2Alignment;
+}
+
+void* SystemAlloc(size_t nbytes) {
+  void* data = nullptr;
+#ifdef __ANDROID__
+  data = memalign(gCaffe2Alignment, nbytes);
+#elif defined(_MSC_VER)
+  data = _aligned_malloc(nbytes, gCaffe2Alignment);
+#else
+  CAFFE_ENFORCE_EQ(posix_memalign(&data, gCaffe2Alignment, nbytes), 0);
+#endif
+  CAFFE_ENFORCE(data);
+  return data;
+}
+
+void SystemFree(void* data) {
+#ifdef _MSC_VER
+  _aligned_free(data);
+#else
+  free(data);
+#endif
+}
+
+std::atomic<size_t> g_hits{0};
+std::atomic<size_t> g_misses{0};
+std::atomic<size_t> g_cached_bytes{0};
+
+struct FreeLists {
+  std::vector<void*> blocks[kNumSizeClasses];
+  size_t bytes{0};
+
+  void* Pop(int size_class) {
+    auto& list = blocks[size_class];
+    if (list.empty()) {
+      return nullptr;
+    }
+    void* block = list.back();
+    list.pop_back();
+    bytes -= SizeClassBytes(size_class);
+    return block;
+  }
+
+  void Push(int size_class, void* block) {
+    blocks[size_class].push_back(block);
+    bytes += SizeClassBytes(size_class);
+  }
+};
+
+class GlobalCache {
+ public:
+  void* Pop(int size_class) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return lists_.Pop(size_class);
+  }
+
+  // Returns false if the cache is full, in which case the caller keeps the
+  // ownership of the block.
+  bool Push(int size_class, void* block) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (lists_.bytes + SizeClassBytes(size_class) >
+        FLAGS_caffe2_cpu_caching_allocator_global_cache_bytes) {
+      return false;
+    }
+    lists_.Push(size_class, block);
+    return true;
+  }
+
+  void Clear() {
+    FreeLists lists;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      std::swap(lists, lists_);
+    }
+    ReleaseAll(&lists);
+  }
+
+  static void ReleaseAll(FreeLists* lists) {
+    for (int i = 0; i < kNumSizeClasses; ++i) {
+      for (void* block : lists->blocks[i]) {
+        SystemFree(block);
+      }
+      lists->blocks[i].clear();
+    }
+    g_cached_bytes -= lists->bytes;
+    lists->bytes = 0;
+  }
+
+ private:
+  std::mutex mutex_;
+  FreeLists lists_;
+};
+
+GlobalCache& GetGlobalCache() {
+  // Intentionally leaked: tensors may still be freed during static
+  // destruction.
+  static GlobalCache* cache = new GlobalCache();
+  return *cache;
+}
+
+void ReleaseBlock(int size_class, void* block);
+
+struct ThreadCache {
+  FreeLists lists;
+
+  ~ThreadCache() {
+    for (int i = 0; i < kNumSizeClasses; ++i) {
+      for (void* block : lists.blocks[i]) {
+        if (!GetGlobalCache().Push(i, block)) {
+          g_cached_bytes -= SizeClassBytes(i);
+          SystemFree(block);
+        }
+      }
+    }
+  }
+};
+
+// The trivially destructible thread locals stay valid while the thread is
+// exiting, so blocks freed by other thread local destructors after the
+// thread cache is gone still end up in the global cache.
+thread_local ThreadCache* t_cache = nullptr;
+thread_local bool t_cache_destroyed = false;
+
+struct ThreadCacheHolder {
+  ~ThreadCacheHolder() {
+    delete t_cache;
+    t_cache = nullptr;
+    t_cache_destroyed = true;
+  }
+};
+thread_local ThreadCacheHolder t_cache_holder;
+
+ThreadCache* GetThreadCache() {
+  if (!t_cache && !t_cache_destroyed) {
+    // Touch the holder so that its destructor gets registered.
+    (void)&t_cache_holder;
+    t_cache = new ThreadCache();
+  }
+  return t_cache;
+}
+
+void ReleaseBlock(int size_class, void* block) {
+  auto* cache = GetThreadCache();
+  size_t nbytes = SizeClassBytes(size_class);
+  if (cache &&
+      cache->lists.bytes + nbytes <=
+          FLAGS_caffe2_cpu_caching_allocator_thread_cache_bytes) {
+    cache->lists.Push(size_class, block);
+  } else if (!GetGlobalCache().Push(size_class, block)) {
+    SystemFree(block);
+    return;
+  }
+  g_cached_bytes += nbytes;
+}
+
+void* AcquireBlock(int size_class) {
+  auto* cache = GetThreadCache();
+  void* block = cache ? cache->lists.Pop(size_class) : nullptr;
+  if (!block) {
+    block = GetGlobalCache().Pop(size_class);
+  }
+  if (block) {
+    g_cached_bytes -= SizeClassBytes(size_class);
+    ++g_hits;
+    return block;
+  }
+  ++g_misses;
+  return SystemAlloc(gCaffe2Alignment + SizeClassBytes(size_class));
+}
+
+} // namespace
+
+std::pair<void*, MemoryDeleter> CachingCPUAllocator::New(size_t nbytes) {
+  void* block;
+  int size_class;
+  if (nbytes <= FLAGS_caffe2_cpu_caching_allocator_max_block_bytes) {
+    CAFFE_ENFORCE_LE(
+        FLAGS_caffe2_cpu_caching_allocator_max_block_bytes,
+        SizeClassBytes(kNumSizeClasses - 1),
+        "caffe2_cpu_caching_allocator_max_block_bytes exceeds the largest "
+        "size class.");
+    size_class = SizeClassOf(nbytes);
+    block = AcquireBlock(size_class);
+  } else {
+    size_class = kUncached;
+    block = SystemAlloc(gCaffe2Alignment + nbytes);
+  }
+  static_cast<BlockHeader*>(block)->size_class = size_class;
+  void* data = UserPtr(block);
+  if (FLAGS_caffe2_cpu_allocator_do_zero_fill) {
+    memset(data, 0, nbytes);
+  }
+  return {data, Delete};
+}
+
+void CachingCPUAllocator::Delete(void* data) {
+  if (!data) {
+    return;
+  }
+  void* block = BlockPtr(data);
+  int size_class = static_cast<BlockHeader*>(block)->size_class;
+  if (size_class == kUncached) {
+    SystemFree(block);
+  } else {
+    ReleaseBlock(size_class, block);
+  }
+}
+
+bool CachingCPUAllocator::GetCacheStats(CPUAllocatorCacheStats* stats) {
+  stats->hits = g_hits;
+  stats->misses = g_misses;
+  stats->cached_bytes = g_cached_bytes;
+  return true;
+}
+
+void CachingCPUAllocator::EmptyCache() {
+  if (t_cache) {
+    GlobalCache::ReleaseAll(&t_cache->lists);
+  }
+  GetGlobalCache().Clear();
+}
+
+namespace {
+
+bool Caffe2SetCachingCPUAllocator(int*, char***) {
+  if (FLAGS_caffe2_cpu_allocator_use_caching) {
+    VLOG(1) << "Using CachingCPUAllocator as the CPU allocator.";
+    SetCPUAllocator(new CachingCPUAllocator());
+  }
+  return true;
+}
+
+} // namespace
+
+REGISTER_CAFFE2_INIT_FUNCTION(
+    Caffe2SetCachingCPUAllocator,
+    &Caffe2SetCachingCPUAllocator,
+    "Install the caching CPU allocator if requested.");
+
+} // namespace caffe2
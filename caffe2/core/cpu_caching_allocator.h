@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_CORE_CPU_CACHING_ALLOCATOR_H_
+#define CAFFE2_CORE_CPU_CACHING_ALLOCATOR_H_
+
+#include "caffe2/core/allocator.h"
+#include "caffe2/core/flags.h"
+
+CAFFE2_DECLARE_bool(caffe2_cpu_allocator_use_caching);
+CAFFE2_DECLARE_int64(caffe2_cpu_caching_allocator_max_block_bytes);
+CAFFE2_DECLARE_int64(caffe2_cpu_caching_allocator_thread_cache_bytes);
+CAFFE2_DECLARE_int64(caffe2_cpu_caching_allocator_global_cache_bytes);
+
+namespace caffe2 {
+
+/**
+ * A CPU allocator that keeps freed blocks in size classes and hands them out
+ * again instead of going back to the system allocator.
+ *
+ * Requested sizes are rounded up to one of four size classes per power of
+ * two, so at most 25% of a block is wasted. Freed blocks first go to a cache
+ * owned by the freeing thread, and spill over to a global cache shared by
+ * all threads once the thread cache is full. The global cache is bounded as
+ * well; blocks that do not fit anywhere are returned to the system. Blocks
+ * larger than caffe2_cpu_caching_allocator_max_block_bytes are never cached.
+ *
+ * The cache is process-wide, so blocks allocated by one instance can be freed
+ * after the instance has been replaced through SetCPUAllocator().
+ *
+ * Set --caffe2_cpu_allocator_use_caching to install it during GlobalInit.
+ */
+struct CachingCPUAllocator final : CPUAllocator {
+  CachingCPUAllocator() {}
+  ~CachingCPUAllocator() override {}
+  std::pair<void*, MemoryDeleter> New(size_t nbytes) override;
+  MemoryDeleter GetDeleter() override {
+    return Delete;
+  }
+  bool GetCacheStats(CPUAllocatorCacheStats* stats) override;
+
+  // Returns all cached blocks of the global cache and of the calling thread's
+  // cache to the system.
+  static void EmptyCache();
+
+ private:
+  static void Delete(void* data);
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_CORE_CPU_CACHING_ALLOCATOR_H_
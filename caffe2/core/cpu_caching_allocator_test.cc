@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <thread>
+
+#include "caffe2/core/cpu_caching_allocator.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+TEST(CachingCPUAllocatorTest, TestAlignment) {
+  CachingCPUAllocator allocator;
+  for (int i = 1; i < 1000; i += 37) {
+    auto data = allocator.New(i);
+    EXPECT_EQ((reinterpret_cast<size_t>(data.first) % gCaffe2Alignment), 0);
+    data.second(data.first);
+  }
+}
+
+TEST(CachingCPUAllocatorTest, TestReuse) {
+  CachingCPUAllocator allocator;
+  CachingCPUAllocator::EmptyCache();
+  CPUAllocatorCacheStats before;
+  EXPECT_TRUE(allocator.GetCacheStats(&before));
+  auto first = allocator.New(1000);
+  first.second(first.first);
+  // 1000 and 1020 bytes fall into the same size class.
+  auto second = allocator.New(1020);
+  EXPECT_EQ(first.first, second.first);
+  CPUAllocatorCacheStats after;
+  EXPECT_TRUE(allocator.GetCacheStats(&after));
+  EXPECT_EQ(after.hits, before.hits + 1);
+  EXPECT_EQ(after.misses, before.misses + 1);
+  second.second(second.first);
+  CachingCPUAllocator::EmptyCache();
+  EXPECT_TRUE(allocator.GetCacheStats(&after));
+  EXPECT_EQ(after.cached_bytes, 0);
+}
+
+TEST(CachingCPUAllocatorTest, TestZeroFillOnReuse) {
+  CachingCPUAllocator allocator;
+  auto first = allocator.New(100 * sizeof(float));
+  float* data = static_cast<float*>(first.first);
+  for (int i = 0; i < 100; ++i) {
+    data[i] = i + 1;
+  }
+  first.second(first.first);
+  auto second = allocator.New(100 * sizeof(float));
+  data = static_cast<float*>(second.first);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(data[i], 0);
+  }
+  second.second(second.first);
+}
+
+TEST(CachingCPUAllocatorTest, TestLargeBlocksAreNotCached) {
+  CachingCPUAllocator allocator;
+  CachingCPUAllocator::EmptyCache();
+  auto data = allocator.New(
+      FLAGS_caffe2_cpu_caching_allocator_max_block_bytes + 1);
+  data.second(data.first);
+  CPUAllocatorCacheStats stats;
+  EXPECT_TRUE(allocator.GetCacheStats(&stats));
+  EXPECT_EQ(stats.cached_bytes, 0);
+}
+
+TEST(CachingCPUAllocatorTest, TestMaxBlockBytesBeyondSizeClasses) {
+  CachingCPUAllocator allocator;
+  const auto max_block_bytes =
+      FLAGS_caffe2_cpu_caching_allocator_max_block_bytes;
+  FLAGS_caffe2_cpu_caching_allocator_max_block_bytes = 1LL << 40;
+  EXPECT_THROW(allocator.New(64), EnforceNotMet);
+  FLAGS_caffe2_cpu_caching_allocator_max_block_bytes = max_block_bytes;
+}
+
+TEST(CachingCPUAllocatorTest, TestFreeOnOtherThread) {
+  CachingCPUAllocator allocator;
+  CachingCPUAllocator::EmptyCache();
+  auto data = allocator.New(4096);
+  std::thread t([&data]() { data.second(data.first); });
+  t.join();
+  // The block went through the other thread's cache into the global one.
+  auto reused = allocator.New(4096);
+  EXPECT_EQ(data.first, reused.first);
+  reused.second(reused.first);
+  CachingCPUAllocator::EmptyCache();
+}
+
+}  // namespace caffe2
@@ -185,6 +185,122 @@ class MiniDB : public DB {
 REGISTER_CAFFE2_DB(MiniDB, MiniDB);
 REGISTER_CAFFE2_DB(minidb, MiniDB);
 
+void DBReader::SplitCursors(int num_cursors) const {
+  CAFFE_ENFORCE(db_ != nullptr, "Reader not initialized.");
+  CAFFE_ENFORCE_GE(num_cursors, 1);
+  std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
+  if (!parallel_cursors_.empty()) {
+    CAFFE_ENFORCE_EQ(
+        parallel_cursors_.size(),
+        num_cursors,
+        "DBReader cursors were already split in a different number of parts.");
+    return;
+  }
+
+  std::vector<std::unique_ptr<ParallelCursor>> parts(num_cursors);
+  for (auto& part : parts) {
+    part.reset(new ParallelCursor());
+    part->cursor = db_->NewCursor();
+  }
+
+  key_ranges_ = false;
+  if (num_cursors > 1 && num_shards_ == 1 &&
+      parts[0]->cursor->SupportsSeek()) {
+    // Sample every step-th key, halving the sample whenever it grows too big,
+    // so that the split keys can be picked in a single pass.
+    const size_t max_samples = 64 * num_cursors;
+    std::vector<string> samples;
+    int64_t step = 1;
+    int64_t index = 0;
+    auto* cursor = parts[0]->cursor.get();
+    for (cursor->SeekToFirst(); cursor->Valid(); cursor->Next(), ++index) {
+      if (index % step != 0) {
+        continue;
+      }
+      samples.push_back(cursor->key());
+      if (samples.size() == 2 * max_samples) {
+        for (size_t i = 0; i < max_samples; ++i) {
+          samples[i] = std::move(samples[2 * i]);
+        }
+        samples.resize(max_samples);
+        step *= 2;
+      }
+    }
+    if (samples.size() >= num_cursors) {
+      key_ranges_ = true;
+      for (int i = 0; i < num_cursors; ++i) {
+        if (i > 0) {
+          parts[i]->begin_key = samples[i * samples.size() / num_cursors];
+        }
+        if (i + 1 < num_cursors) {
+          parts[i]->end_key = samples[(i + 1) * samples.size() / num_cursors];
+        }
+      }
+    }
+  }
+  if (!key_ranges_) {
+    for (int i = 0; i < num_cursors; ++i) {
+      parts[i]->offset = shard_id_ + static_cast<int64_t>(i) * num_shards_;
+    }
+  }
+  parallel_cursors_ = std::move(parts);
+  for (auto& part : parallel_cursors_) {
+    MoveToBeginning(part.get());
+  }
+}
+
+void DBReader::MoveToBeginning(ParallelCursor* part) const {
+  auto* cursor = part->cursor.get();
+  if (key_ranges_) {
+    if (part->begin_key.empty()) {
+      cursor->SeekToFirst();
+    } else {
+      cursor->Seek(part->begin_key);
+    }
+    CAFFE_ENFORCE(cursor->Valid(), "Empty key range: ", part->begin_key);
+    return;
+  }
+  cursor->SeekToFirst();
+  for (int64_t s = 0; s < part->offset; s++) {
+    cursor->Next();
+    CAFFE_ENFORCE(
+        cursor->Valid(),
+        "Db has less rows than the offset of the cursor: ",
+        s,
+        " vs ",
+        part->offset);
+  }
+}
+
+void DBReader::Read(int cursor_id, string* key, string* value) const {
+  CAFFE_ENFORCE_GE(cursor_id, 0);
+  CAFFE_ENFORCE_LT(
+      cursor_id, parallel_cursors_.size(), "Call SplitCursors() first.");
+  auto* part = parallel_cursors_[cursor_id].get();
+  std::unique_lock<std::mutex> mutex_lock(part->mutex);
+  auto* cursor = part->cursor.get();
+  *key = cursor->key();
+  *value = cursor->value();
+
+  if (key_ranges_) {
+    cursor->Next();
+    if (!cursor->Valid() ||
+        (!part->end_key.empty() && cursor->key() >= part->end_key)) {
+      MoveToBeginning(part);
+    }
+    return;
+  }
+  const int64_t stride =
+      static_cast<int64_t>(num_shards_) * parallel_cursors_.size();
+  for (int64_t s = 0; s < stride; s++) {
+    cursor->Next();
+    if (!cursor->Valid()) {
+      MoveToBeginning(part);
+      break;
+    }
+  }
+}
+
 void DBReaderSerializer::Serialize(
     const Blob& blob,
     const string& name,
@@ -17,7 +17,9 @@
 #ifndef CAFFE2_CORE_DB_H_
 #define CAFFE2_CORE_DB_H_
 
+#include <memory>
 #include <mutex>
+#include <vector>
 
 #include "caffe2/core/blob_serialization.h"
 #include "caffe2/core/registry.h"
@@ -62,6 +64,19 @@ class Cursor {
    * Returns the current value.
    */
   virtual string value() = 0;
+  /**
+   * Returns the current value without copying it, as a pointer into memory
+   * owned by the database such as a memory-mapped file. The memory stays valid
+   * for as long as *owner is alive, even after the cursor and the database are
+   * destroyed. This is optional for dbs, and in default it returns false
+   * meaning that value() has to be used instead.
+   */
+  virtual bool MappedValue(
+      const char** /*data*/,
+      size_t* /*size*/,
+      std::shared_ptr<void>* /*owner*/) {
+    return false;
+  }
   /**
    * Returns whether the current location is valid - for example, if we have
    * reached the end of the database, return false.
@@ -198,6 +213,7 @@ class DBReader {
       const int32_t shard_id = 0) {
     // Note(jiayq): resetting is needed when we re-open e.g. leveldb where no
     // concurrent access is allowed.
+    parallel_cursors_.clear();
     cursor_.reset();
     db_.reset();
     db_type_ = db_type;
@@ -211,6 +227,7 @@ class DBReader {
       unique_ptr<DB>&& db,
       const int32_t num_shards = 1,
       const int32_t shard_id = 0) {
+    parallel_cursors_.clear();
     cursor_.reset();
     db_.reset();
     db_ = std::move(db);
@@ -251,6 +268,39 @@ class DBReader {
     }
   }
 
+  /**
+   * Opens num_cursors cursors over disjoint parts of the db, so that several
+   * threads can read concurrently with Read(cursor_id, ...). They are
+   * independent of the cursor used by Read(key, value).
+   *
+   * If the db supports Seek and the reader is not sharded, every cursor
+   * covers a contiguous key range holding about the same number of records.
+   * Finding the split keys costs one pass over the db. Otherwise cursor i
+   * reads records i, i + num_cursors, ... of the reader's shard, so reading
+   * the cursors round robin yields the same sequence as Read(). Either way,
+   * each cursor wraps around to the start of its part when exhausted.
+   *
+   * The db has to allow several open cursors, which is not the case for
+   * minidb. Calling it again with the same number of cursors is a no-op,
+   * which lets several ops share a reader. Thread safe.
+   */
+  void SplitCursors(int num_cursors) const;
+
+  /**
+   * Returns the number of cursors opened by SplitCursors(), 0 if none.
+   */
+  int NumCursors() const {
+    std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
+    return parallel_cursors_.size();
+  }
+
+  /**
+   * Reads a key and value with the given cursor and moves it to the next
+   * record of its part. Thread safe; reads through different cursors do not
+   * block each other.
+   */
+  void Read(int cursor_id, string* key, string* value) const;
+
   /**
    * @brief Seeks to the first key. Thread safe.
    */
@@ -293,6 +343,19 @@ class DBReader {
     }
   }
 
+  struct ParallelCursor {
+    unique_ptr<Cursor> cursor;
+    // Key range mode: the part is [begin_key, end_key), an empty end_key
+    // meaning until the end of the db.
+    string begin_key;
+    string end_key;
+    // Strided mode: index of the first record of the part.
+    int64_t offset{0};
+    std::mutex mutex;
+  };
+
+  void MoveToBeginning(ParallelCursor* part) const;
+
   string db_type_;
   string source_;
   unique_ptr<DB> db_;
@@ -300,6 +363,8 @@ class DBReader {
   mutable std::mutex reader_mutex_;
   uint32_t num_shards_;
   uint32_t shard_id_;
+  mutable std::vector<std::unique_ptr<ParallelCursor>> parallel_cursors_;
+  mutable bool key_ranges_{false};
 
   DISABLE_COPY_AND_ASSIGN(DBReader);
 };
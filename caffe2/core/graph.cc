@@ -70,6 +70,12 @@ Graph::Graph(const NetDef& net) : netdef_(net) {
       edge_child[blob] = i;
     }
   }
+
+  // Blobs the net declares as outputs are read by its caller, even if they
+  // are also read by later ops.
+  for (const string& blob : net.external_output()) {
+    external_output_.insert(blob);
+  }
 }
 
 const std::vector<std::pair<string, int>> Graph::GetSubgraphInput(
@@ -17,7 +17,9 @@
 #include "caffe2/core/net.h"
 #include "caffe2/core/net_simple.h"
 
+#include <algorithm>
 #include <set>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -114,6 +116,38 @@ void SetGlobalNetObserverCreator(NetObserverCreator creator) {
   VLOG(1) << "Have set custom GlobalNetObserverCreator";
 }
 
+namespace {
+void SetUpIntraOpThreadPool(
+    NetBase* net,
+    const NetDef& net_def,
+    Workspace* ws) {
+  ArgumentHelper args(net_def);
+  IntraOpThreadPoolOptions options;
+  if (args.HasArgument("intra_op_num_threads") ||
+      args.HasArgument("intra_op_cpus") ||
+      args.HasArgument("intra_op_numa_node")) {
+    options.numThreads =
+        args.GetSingleArgument<int>("intra_op_num_threads", 0);
+    options.cpus = args.GetRepeatedArgument<int>("intra_op_cpus");
+    options.numaNode = args.GetSingleArgument<int>("intra_op_numa_node", -1);
+  } else if (!ws->GetIntraOpThreadPool() && net->InterOpNumThreads() > 1) {
+    const int num_cores = std::max(1u, std::thread::hardware_concurrency());
+    options.numThreads = std::max(1, num_cores / net->InterOpNumThreads());
+    if (options.numThreads >= GetIntraOpNumThreads()) {
+      return;
+    }
+  } else {
+    return;
+  }
+  const auto pool = GetSharedIntraOpThreadPool(options);
+  VLOG(1) << "Net " << net->Name() << " splits operators between "
+          << pool->numThreads() << " intra-op threads";
+  for (auto* op : net->GetOperators()) {
+    op->SetIntraOpThreadPool(pool);
+  }
+}
+} // namespace
+
 unique_ptr<NetBase> CreateNet(const NetDef& net_def, Workspace* ws) {
   std::shared_ptr<NetDef> tmp_net_def(new NetDef(net_def));
   return CreateNet(tmp_net_def, ws);
@@ -130,6 +164,9 @@ unique_ptr<NetBase> CreateNet(
   } else {
     net = NetRegistry()->Create(net_def->type(), net_def, ws);
   }
+  if (net) {
+    SetUpIntraOpThreadPool(net.get(), *net_def, ws);
+  }
   VLOG(1) << "Adding a global observer to a net";
   if (net) {
     net->AttachObserver(GlobalNetObserverCreator(net.get()));
@@ -113,6 +113,12 @@ class NetBase : public Observable<NetBase> {
    */
   virtual vector<OperatorBase*> GetOperators() const = 0;
 
+  // Number of operators the net may run at the same time on CPU, which
+  // bounds the intra-op threads its operators get by default, see CreateNet.
+  virtual int InterOpNumThreads() const {
+    return 1;
+  }
+
   const string& Name() const {
     return name_;
   }
@@ -155,6 +161,13 @@ CAFFE_DECLARE_REGISTRY(
  * Note that this is different from Workspace::CreateNet. The latter adds the
  * created net object to the workspace's net map, while this function returns
  * a standalone net object.
+ *
+ * The CPU operators of the net split their work with the intra-op pool of the
+ * workspace, or the process-wide one. The net arguments intra_op_num_threads,
+ * intra_op_cpus and intra_op_numa_node give them a pool of their own instead,
+ * see IntraOpThreadPoolOptions. Nets that run several operators at once on
+ * the process-wide pool get a smaller pool, so that their inter-op and
+ * intra-op threads together do not exceed the number of cores.
  */
 unique_ptr<NetBase> CreateNet(const NetDef& net_def, Workspace* ws);
 unique_ptr<NetBase> CreateNet(
@@ -263,6 +263,10 @@ void AsyncNetBase::finalizeEvents() {
   }
 }
 
+int AsyncNetBase::InterOpNumThreads() const {
+  return GetAsyncNetCPUPoolSize();
+}
+
 AsyncNetBase::~AsyncNetBase() {}
 
 CAFFE_DEFINE_SHARED_REGISTRY(
@@ -291,12 +295,7 @@ std::shared_ptr<TaskThreadPool> GetAsyncNetCPUThreadPool() {
 
   auto shared_pool = pool.lock();
   if (!shared_pool) {
-    auto pool_size = FLAGS_caffe2_net_async_cpu_pool_size;
-    if (pool_size <= 0) {
-      auto num_cores = std::thread::hardware_concurrency();
-      CAFFE_ENFORCE(num_cores > 0, "Failed to get number of CPU cores");
-      pool_size = num_cores;
-    }
+    auto pool_size = GetAsyncNetCPUPoolSize();
     LOG(INFO) << "Using cpu pool size: " << pool_size;
     shared_pool = std::make_shared<TaskThreadPool>(pool_size);
     pool = shared_pool;
@@ -304,4 +303,14 @@ std::shared_ptr<TaskThreadPool> GetAsyncNetCPUThreadPool() {
   return shared_pool;
 }
 
+int GetAsyncNetCPUPoolSize() {
+  auto pool_size = FLAGS_caffe2_net_async_cpu_pool_size;
+  if (pool_size <= 0) {
+    auto num_cores = std::thread::hardware_concurrency();
+    CAFFE_ENFORCE(num_cores > 0, "Failed to get number of CPU cores");
+    pool_size = num_cores;
+  }
+  return pool_size;
+}
+
 } // namespace caffe2
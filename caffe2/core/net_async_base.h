@@ -43,6 +43,8 @@ class AsyncNetBase : public NetBase {
     return operators_;
   }
 
+  int InterOpNumThreads() const override;
+
  protected:
   bool canSchedule(
       int chain_id,
@@ -89,6 +91,10 @@ CAFFE_DECLARE_SHARED_REGISTRY(
 
 std::shared_ptr<TaskThreadPool> GetAsyncNetCPUThreadPool();
 
+// Number of threads of the CPU pools of async nets,
+// --caffe2_net_async_cpu_pool_size or one per core.
+int GetAsyncNetCPUPoolSize();
+
 } // namespace caffe2
 
 #endif // CAFFE2_CORE_NET_ASYNC_POLLING_H_
@@ -70,9 +70,15 @@ void AsyncSchedulingNet::Wait() {
   }
 }
 
+void AsyncSchedulingNet::runTask(
+    const DeviceOption& device_option,
+    const std::function<void()>& task) {
+  pool(device_option)->run(task);
+}
+
 void AsyncSchedulingNet::schedule(int task_id) {
   const auto& device_option = event(task_id).GetDeviceOption();
-  pool(device_option)->run([this, task_id]() {
+  runTask(device_option, [this, task_id]() {
     if (success_) {
       int stream_id = stream(task_id);
       asyncWait(task_id, stream_id, parents(task_id));
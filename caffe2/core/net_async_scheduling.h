@@ -35,6 +35,10 @@ class AsyncSchedulingNet : public AsyncNetBase {
 
   void pollAndSchedule(int thread_id);
   void schedule(int task_id);
+  // Hands a task that is ready to run over to a thread pool.
+  virtual void runTask(
+      const DeviceOption& device_option,
+      const std::function<void()>& task);
   void reset();
   void finishRun();
   int updateParentCount(int child_id);
@@ -0,0 +1,59 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/core/net_async_work_stealing.h"
+
+CAFFE2_DECLARE_bool(caffe2_net_async_use_single_pool);
+
+namespace caffe2 {
+
+AsyncWorkStealingNet::AsyncWorkStealingNet(
+    const std::shared_ptr<const NetDef>& net_def,
+    Workspace* ws)
+    : AsyncSchedulingNet(net_def, ws),
+      work_stealing_pool_(GetAsyncNetWorkStealingCPUThreadPool()) {}
+
+AsyncWorkStealingNet::~AsyncWorkStealingNet() {}
+
+void AsyncWorkStealingNet::runTask(
+    const DeviceOption& device_option,
+    const std::function<void()>& task) {
+  if (FLAGS_caffe2_net_async_use_single_pool ||
+      device_option.device_type() == CPU) {
+    work_stealing_pool_->run(task);
+  } else {
+    AsyncSchedulingNet::runTask(device_option, task);
+  }
+}
+
+std::shared_ptr<WorkStealingThreadPool> GetAsyncNetWorkStealingCPUThreadPool() {
+  static std::weak_ptr<WorkStealingThreadPool> pool;
+  static std::mutex pool_mutex;
+  std::lock_guard<std::mutex> lock(pool_mutex);
+
+  auto shared_pool = pool.lock();
+  if (!shared_pool) {
+    auto pool_size = GetAsyncNetCPUPoolSize();
+    LOG(INFO) << "Using work stealing cpu pool size: " << pool_size;
+    shared_pool = std::make_shared<WorkStealingThreadPool>(pool_size);
+    pool = shared_pool;
+  }
+  return shared_pool;
+}
+
+REGISTER_NET(async_work_stealing, AsyncWorkStealingNet);
+
+} // namespace caffe2
@@ -0,0 +1,50 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_CORE_NET_ASYNC_WORK_STEALING_H_
+#define CAFFE2_CORE_NET_ASYNC_WORK_STEALING_H_
+
+#include "caffe2/core/net_async_scheduling.h"
+#include "caffe2/utils/work_stealing_thread_pool.h"
+
+namespace caffe2 {
+
+// Same scheduling as AsyncSchedulingNet, but CPU chains run on a
+// WorkStealingThreadPool: a chain made ready by a finishing chain is queued
+// on the same worker and runs there next, and idle workers steal instead of
+// contending on one central queue.
+class AsyncWorkStealingNet : public AsyncSchedulingNet {
+ public:
+  AsyncWorkStealingNet(
+      const std::shared_ptr<const NetDef>& net_def,
+      Workspace* ws);
+  ~AsyncWorkStealingNet() override;
+
+ protected:
+  void runTask(
+      const DeviceOption& device_option,
+      const std::function<void()>& task) override;
+
+  std::shared_ptr<WorkStealingThreadPool> work_stealing_pool_;
+
+  DISABLE_COPY_AND_ASSIGN(AsyncWorkStealingNet);
+};
+
+std::shared_ptr<WorkStealingThreadPool> GetAsyncNetWorkStealingCPUThreadPool();
+
+} // namespace caffe2
+
+#endif // CAFFE2_CORE_NET_ASYNC_WORK_STEALING_H_
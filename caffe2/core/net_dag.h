@@ -64,6 +64,10 @@ class DAGNetBase : public NetBase {
     return operators_;
   }
 
+  int InterOpNumThreads() const override {
+    return num_workers_;
+  }
+
  protected:
   bool DoRunAsync() override;
 
@@ -16,12 +16,15 @@
 
 #include <google/protobuf/text_format.h>
 #include <gtest/gtest.h>
+#include <thread>
 #include "caffe2/core/net.h"
 #include "caffe2/core/net_dag.h"
 #include "caffe2/core/operator.h"
 #include "caffe2/core/scope_guard.h"
 
 CAFFE2_DECLARE_bool(caffe2_disable_chaining);
+CAFFE2_DECLARE_int(caffe2_intra_op_num_threads);
+CAFFE2_DECLARE_int(caffe2_net_async_cpu_pool_size);
 
 namespace caffe2 {
 
@@ -66,6 +69,22 @@ REGISTER_CUDA_OPERATOR(NetTestDummy, NetTestDummyOp);
 REGISTER_CPU_OPERATOR(NetTestDummy2, NetTestDummyOp);
 REGISTER_CUDA_OPERATOR(NetTestDummy2, NetTestDummyOp);
 
+// Async nets only schedule an operator once the events of its parents are
+// set, which Operator<Context> does and OperatorBase does not.
+class NetTestCPUDummyOp final : public Operator<CPUContext> {
+ public:
+  using Operator<CPUContext>::Operator;
+
+  bool RunOnDevice() override {
+    counter.fetch_add(1);
+    return true;
+  }
+};
+
+REGISTER_CPU_OPERATOR(NetTestCPUDummy, NetTestCPUDummyOp);
+
+OPERATOR_SCHEMA(NetTestCPUDummy).NumInputs(0, INT_MAX).NumOutputs(0, INT_MAX);
+
 OPERATOR_SCHEMA(NetTestDummy)
     .NumInputs(0, INT_MAX)
     .NumOutputs(0, INT_MAX)
@@ -75,6 +94,38 @@ OPERATOR_SCHEMA(NetTestDummy2)
     .NumOutputs(0, INT_MAX)
     .AllowInplace({{1, 0}});
 
+// Outputs the number of intra-op threads its context splits work between.
+class NetTestIntraOpThreadsOp final : public Operator<CPUContext> {
+ public:
+  using Operator<CPUContext>::Operator;
+
+  bool RunOnDevice() override {
+    auto* output = Output(0);
+    output->Resize(1);
+    std::atomic<int> items(0);
+    context_.ParallelFor(100, 1, [&](size_t begin, size_t end) {
+      items += end - begin;
+    });
+    CAFFE_ENFORCE_EQ(items, 100);
+    *output->mutable_data<int>() = context_.intraOpThreadPool()->numThreads();
+    return true;
+  }
+};
+
+REGISTER_CPU_OPERATOR(NetTestIntraOpThreads, NetTestIntraOpThreadsOp);
+
+OPERATOR_SCHEMA(NetTestIntraOpThreads).NumInputs(0).NumOutputs(1);
+
+int RunIntraOpThreadsNet(Workspace* ws, const NetDef& base_def) {
+  NetDef net_def(base_def);
+  auto* op = net_def.add_op();
+  op->set_type("NetTestIntraOpThreads");
+  op->add_output("threads");
+  std::unique_ptr<NetBase> net(CreateNet(net_def, ws));
+  CAFFE_ENFORCE(net->Run());
+  return *ws->GetBlob("threads")->Get<TensorCPU>().data<int>();
+}
+
 unique_ptr<NetBase> CreateNetTestHelper(
     Workspace* ws,
     const vector<string>& input,
@@ -638,4 +689,83 @@ TEST(NetTest, FailingOperator) {
   }
 }
 
+TEST(NetTest, AsyncWorkStealingForkJoin) {
+  NetDef net_def;
+  net_def.set_type("async_work_stealing");
+  net_def.add_external_input("in");
+  const int kWidth = 16;
+  const int kDepth = 4;
+  for (int i = 0; i < kWidth; ++i) {
+    std::string prev = "in";
+    for (int j = 0; j < kDepth; ++j) {
+      auto* op = net_def.add_op();
+      op->set_type("NetTestCPUDummy");
+      op->add_input(prev);
+      prev = "hidden_" + caffe2::to_string(i) + "_" + caffe2::to_string(j);
+      op->add_output(prev);
+    }
+  }
+  {
+    auto* op = net_def.add_op();
+    op->set_type("NetTestCPUDummy");
+    for (int i = 0; i < kWidth; ++i) {
+      op->add_input(
+          "hidden_" + caffe2::to_string(i) + "_" +
+          caffe2::to_string(kDepth - 1));
+    }
+    op->add_output("out");
+  }
+
+  Workspace ws;
+  ws.CreateBlob("in");
+  std::unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  for (int i = 0; i < 10; i++) {
+    counter.exchange(0);
+    ASSERT_TRUE(net->Run());
+    ASSERT_EQ(kWidth * kDepth + 1, counter.load());
+  }
+}
+
+TEST(NetTest, IntraOpThreadPool) {
+  SetIntraOpNumThreads(64);
+  auto g = MakeGuard(
+      []() { SetIntraOpNumThreads(FLAGS_caffe2_intra_op_num_threads); });
+  const int num_cores = std::max(1u, std::thread::hardware_concurrency());
+
+  Workspace ws;
+  NetDef net_def;
+  EXPECT_EQ(64, RunIntraOpThreadsNet(&ws, net_def));
+
+  // Nets running several operators at once get fewer threads per operator.
+  net_def.set_type("dag");
+  net_def.set_num_workers(4);
+  EXPECT_EQ(std::max(1, num_cores / 4), RunIntraOpThreadsNet(&ws, net_def));
+  {
+    auto old = FLAGS_caffe2_net_async_cpu_pool_size;
+    auto restore =
+        MakeGuard([&]() { FLAGS_caffe2_net_async_cpu_pool_size = old; });
+    FLAGS_caffe2_net_async_cpu_pool_size = 2;
+    net_def.set_type("async_scheduling");
+    EXPECT_EQ(std::max(1, num_cores / 2), RunIntraOpThreadsNet(&ws, net_def));
+  }
+
+  // The net's arguments take precedence over everything else.
+  auto* arg = net_def.add_arg();
+  arg->set_name("intra_op_num_threads");
+  arg->set_i(3);
+  EXPECT_EQ(3, RunIntraOpThreadsNet(&ws, net_def));
+
+  // So does the pool of the workspace over the default ones, and workspaces
+  // on top of it inherit it.
+  IntraOpThreadPoolOptions options;
+  options.numThreads = 2;
+  ws.SetIntraOpThreadPool(GetSharedIntraOpThreadPool(options));
+  net_def.clear_arg();
+  EXPECT_EQ(2, RunIntraOpThreadsNet(&ws, net_def));
+  net_def.clear_type();
+  EXPECT_EQ(2, RunIntraOpThreadsNet(&ws, net_def));
+  Workspace child(&ws);
+  EXPECT_EQ(2, RunIntraOpThreadsNet(&child, net_def));
+}
+
 } // namespace caffe2
@@ -259,6 +259,12 @@ class OperatorBase : public Observable<OperatorBase> {
     return true;
   }
 
+  // Sets the intra-op pool that the operator splits its work with if it runs
+  // on a CPUContext. Operators start with the pool of their workspace, and
+  // nets may give their operators another one, see CreateNet.
+  virtual void SetIntraOpThreadPool(
+      const std::shared_ptr<IntraOpThreadPool>& /* unused */) {}
+
   const std::string& type() {
     CAFFE_ENFORCE(operator_def_.get() != nullptr);
     return operator_def_->type();
@@ -331,6 +337,9 @@ class Operator : public OperatorBase {
  public:
   explicit Operator(const OperatorDef& operator_def, Workspace* ws)
       : OperatorBase(operator_def, ws), context_(operator_def.device_option()) {
+    if (ws) {
+      SetContextIntraOpThreadPool(&context_, ws->GetIntraOpThreadPool());
+    }
     // In the constructor, we switch to the device so that the child class
     // constructors will run on that device.
     context_.SwitchToDevice(0);
@@ -344,6 +353,11 @@ class Operator : public OperatorBase {
     return OperatorBase::template Output<Tensor<Context>>(idx);
   }
 
+  void SetIntraOpThreadPool(
+      const std::shared_ptr<IntraOpThreadPool>& pool) override {
+    SetContextIntraOpThreadPool(&context_, pool);
+  }
+
   void WaitEvent(const Event& ev, int stream_id = -1) final {
     if (stream_id >= 0) {
       context_.SwitchToDevice(stream_id);
@@ -16,8 +16,11 @@
 
 #include "caffe2/core/predictor.h"
 
+#include <algorithm>
 #include <unordered_set>
 
+#include "caffe2/core/operator.h"
+
 namespace caffe2 {
 
 namespace {
@@ -111,7 +114,7 @@ bool Predictor::run(const TensorVector& inputs, TensorVector* outputs) {
     shareInputTensor(&ws_, run_net_.external_input(i), inputs[i]);
   }
 
-  if (!ws_.RunNet(run_net_.name())) {
+  if (!runNet()) {
     return false;
   }
 
@@ -133,7 +136,7 @@ bool Predictor::run_map(const TensorMap& inputs, TensorVector* outputs) {
     shareInputTensor(&ws_, input.first, input.second);
   }
 
-  if (!ws_.RunNet(run_net_.name())) {
+  if (!runNet()) {
     return false;
   }
 
@@ -143,4 +146,56 @@ bool Predictor::run_map(const TensorMap& inputs, TensorVector* outputs) {
   }
   return true;
 }
+bool Predictor::runNet() {
+  if (!ws_.RunNet(run_net_.name())) {
+    return false;
+  }
+  if (memoryPlanPending_) {
+    memoryPlanner_->PlanFromWorkspace();
+    memoryPlanPending_ = false;
+    memoryPlanned_ = true;
+  } else if (memoryPlanned_) {
+    memoryPlanner_->Verify();
+  }
+  return true;
+}
+
+bool Predictor::planMemory(
+    const CaffeMap<std::string, std::vector<TIndex>>& input_dims) {
+  memoryPlanner_ = caffe2::make_unique<StaticMemoryPlanner>(run_net_, &ws_);
+  if (!memoryPlanner_->CanPlan()) {
+    LOG(WARNING) << "Cannot plan memory of net " << run_net_.name()
+                 << ": its ops may not run sequentially.";
+    memoryPlanner_.reset();
+    return false;
+  }
+  if (input_dims.empty()) {
+    memoryPlanPending_ = true;
+    memoryPlanned_ = false;
+    return true;
+  }
+  CaffeMap<std::string, std::vector<TIndex>> blob_dims(input_dims);
+  for (const auto& name : ws_.Blobs()) {
+    const auto* blob = ws_.GetBlob(name);
+    if (blob_dims.count(name) || !blob->IsType<TensorCPU>()) {
+      continue;
+    }
+    const auto& dims = blob->Get<TensorCPU>().dims();
+    if (!dims.empty() &&
+        std::all_of(dims.begin(), dims.end(), [](TIndex d) { return d > 0; })) {
+      blob_dims[name] = dims;
+    }
+  }
+  std::vector<std::unique_ptr<NetDef>> nets;
+  nets.emplace_back(new NetDef(run_net_));
+  memoryPlanner_->PlanFromShapes(
+      InferBlobShapesAndTypesFromMap(blob_dims, nets));
+  memoryPlanPending_ = false;
+  memoryPlanned_ = true;
+  return true;
+}
+
+const StaticMemoryPlanStats* Predictor::memoryPlanStats() const {
+  return memoryPlanned_ ? &memoryPlanner_->stats() : nullptr;
+}
 } // namespace caffe2
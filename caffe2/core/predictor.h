@@ -18,6 +18,7 @@
 
 #include <unordered_set>
 #include "caffe2/core/net.h"
+#include "caffe2/core/static_memory_planner.h"
 #include "caffe2/core/tensor.h"
 #include "caffe2/proto/metanet.pb.h"
 #include "caffe2/proto/predictor_consts.pb.h"
@@ -57,6 +58,17 @@ class Predictor {
   // Similar to run, but consumes a map of name to tensor as input
   bool run_map(const TensorMap& inputs, TensorVector* outputs);
 
+  // Places the intermediate tensors of `run_net` into one preallocated
+  // buffer, see StaticMemoryPlanner. If `input_dims` is empty, the plan is
+  // built from the shapes of the next run; otherwise it is built right away
+  // from shapes inferred from the given input dimensions.
+  // Returns false if `run_net` does not run its ops sequentially.
+  bool planMemory(
+      const CaffeMap<std::string, std::vector<TIndex>>& input_dims = {});
+
+  // Statistics of the current memory plan, or nullptr if there is none yet.
+  const StaticMemoryPlanStats* memoryPlanStats() const;
+
   const NetDef& def() const {
     return run_net_;
   };
@@ -66,8 +78,13 @@ class Predictor {
   };
 
  private:
+  bool runNet();
+
   NetDef run_net_;
   Workspace ws_;
   std::unordered_set<std::string> inputNames_;
+  std::unique_ptr<StaticMemoryPlanner> memoryPlanner_;
+  bool memoryPlanPending_{false};
+  bool memoryPlanned_{false};
 };
 }
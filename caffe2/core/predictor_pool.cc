@@ -0,0 +1,182 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/core/predictor_pool.h"
+
+#include <thread>
+#include <unordered_set>
+
+#include "caffe2/core/blob_stats.h"
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+constexpr uint32_t PredictorPool::kNone;
+
+PredictorPool::PredictorPool(
+    const NetDef& init_net,
+    const NetDef& run_net,
+    size_t size)
+    : memoryBytes_(new std::atomic<size_t>[size]),
+      head_(kNone),
+      next_(new std::atomic<uint32_t>[size]) {
+  CAFFE_ENFORCE_GT(size, 0);
+  CAFFE_ENFORCE_LT(size, kNone);
+  CAFFE_ENFORCE(shared_.RunNetOnce(init_net));
+  std::unordered_set<std::string> outputs;
+  for (const auto& op : run_net.op()) {
+    outputs.insert(op.output().begin(), op.output().end());
+  }
+  for (uint32_t i = 0; i < size; ++i) {
+    workspaces_.emplace_back(new Workspace(&shared_));
+    auto* ws = workspaces_.back().get();
+    for (const auto& name : outputs) {
+      ws->CreateLocalBlob(name);
+    }
+    for (const auto& name : run_net.external_input()) {
+      if (outputs.count(name)) {
+        continue;
+      }
+      const auto* shared = shared_.GetBlob(name);
+      if (!shared) {
+        // Fed on each run, like the inputs Predictor creates itself.
+        ws->CreateLocalBlob(name)->GetMutable<TensorCPU>();
+        continue;
+      }
+      if (!shared->IsType<TensorCPU>()) {
+        // Only tensors can be fed, other objects stay shared.
+        continue;
+      }
+      const auto& param = shared->Get<TensorCPU>();
+      auto* tensor = ws->CreateLocalBlob(name)->GetMutable<TensorCPU>();
+      tensor->ResizeLike(param);
+      // A tensor that was only given a shape has no data to share yet.
+      if (param.size() == 0 || param.capacity_nbytes() > 0) {
+        tensor->ShareData(param);
+      }
+    }
+    instances_.emplace_back(new Predictor(NetDef(), run_net, ws));
+    localBlobs_.emplace_back();
+    for (auto* local : {ws, instances_.back()->ws()}) {
+      for (const auto& name : local->LocalBlobs()) {
+        localBlobs_.back().push_back(local->GetBlob(name));
+      }
+    }
+    memoryBytes_[i] = localMemoryBytes(i);
+    push(i);
+  }
+  VLOG(1) << "Created a pool of " << size << " predictors for "
+          << run_net.name() << " sharing " << sharedMemoryBytes()
+          << " bytes of parameters.";
+}
+
+PredictorPool::~PredictorPool() {
+  // Every Lease has to be returned before the pool goes away.
+  size_t free = 0;
+  for (uint32_t i = head_.load() & kNone; i != kNone; i = next_[i].load()) {
+    ++free;
+  }
+  if (free != instances_.size()) {
+    LOG(FATAL) << instances_.size() - free << " predictors are still checked "
+               << "out of a pool that is being destroyed.";
+  }
+}
+
+PredictorPool::Lease PredictorPool::tryCheckout() {
+  const uint32_t index = pop();
+  if (index == kNone) {
+    return Lease();
+  }
+  return Lease(this, index);
+}
+
+PredictorPool::Lease PredictorPool::checkout() {
+  while (true) {
+    auto lease = tryCheckout();
+    if (lease) {
+      return lease;
+    }
+    std::this_thread::yield();
+  }
+}
+
+void PredictorPool::checkin(uint32_t index) {
+  memoryBytes_[index].store(localMemoryBytes(index), std::memory_order_relaxed);
+  push(index);
+}
+
+uint32_t PredictorPool::pop() {
+  uint64_t head = head_.load(std::memory_order_acquire);
+  while (true) {
+    const uint32_t index = head & kNone;
+    if (index == kNone) {
+      return kNone;
+    }
+    const uint64_t next = next_[index].load(std::memory_order_relaxed);
+    const uint64_t version = (head >> 32) + 1;
+    if (head_.compare_exchange_weak(
+            head,
+            (version << 32) | next,
+            std::memory_order_acquire,
+            std::memory_order_acquire)) {
+      return index;
+    }
+  }
+}
+
+void PredictorPool::push(uint32_t index) {
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  while (true) {
+    next_[index].store(head & kNone, std::memory_order_relaxed);
+    const uint64_t version = (head >> 32) + 1;
+    if (head_.compare_exchange_weak(
+            head,
+            (version << 32) | index,
+            std::memory_order_release,
+            std::memory_order_relaxed)) {
+      return;
+    }
+  }
+}
+
+size_t PredictorPool::localMemoryBytes(uint32_t index) const {
+  size_t bytes = 0;
+  for (const auto* blob : localBlobs_[index]) {
+    if (blob->IsType<TensorCPU>() && blob->Get<TensorCPU>().shares_data()) {
+      continue;
+    }
+    bytes += BlobStat::sizeBytes(*blob);
+  }
+  return bytes;
+}
+
+size_t PredictorPool::sharedMemoryBytes() const {
+  size_t bytes = 0;
+  for (const auto& name : shared_.LocalBlobs()) {
+    bytes += BlobStat::sizeBytes(*shared_.GetBlob(name));
+  }
+  return bytes;
+}
+
+std::vector<size_t> PredictorPool::instanceMemoryBytes() const {
+  std::vector<size_t> bytes(instances_.size());
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = memoryBytes_[i].load(std::memory_order_relaxed);
+  }
+  return bytes;
+}
+
+} // namespace caffe2
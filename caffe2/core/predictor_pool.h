@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "caffe2/core/predictor.h"
+#include "caffe2/core/workspace.h"
+
+namespace caffe2 {
+
+/**
+ * A fixed set of Predictors that share their parameters.
+ *
+ * `init_net` runs once, into a workspace owned by the pool. Every instance
+ * is a Predictor whose workspace is a child of that one: parameters are
+ * looked up in the shared workspace, and only the inputs and activations of
+ * `run_net` are allocated per instance.
+ *
+ * Every external input and op output of `run_net` is a blob local to the
+ * instance, so that feeding inputs and running ops never writes to a shared
+ * blob. External inputs that `init_net` created as tensors start out sharing
+ * the data of the shared tensor. `run_net` must not write to the parameters
+ * in place.
+ *
+ * Threads check an instance out, run it, and return it when the Lease goes
+ * out of scope. Checkout and return go through a lock-free free list, so
+ * they never block each other.
+ */
+class PredictorPool {
+ public:
+  // Exclusive use of one instance, returned to the pool on destruction.
+  class Lease {
+   public:
+    Lease() {}
+    Lease(Lease&& other) noexcept : pool_(other.pool_), index_(other.index_) {
+      other.pool_ = nullptr;
+    }
+    Lease& operator=(Lease&& other) noexcept {
+      std::swap(pool_, other.pool_);
+      std::swap(index_, other.index_);
+      return *this;
+    }
+    ~Lease() {
+      if (pool_) {
+        pool_->checkin(index_);
+      }
+    }
+
+    explicit operator bool() const {
+      return pool_ != nullptr;
+    }
+    Predictor* get() const {
+      return pool_ ? pool_->instances_[index_].get() : nullptr;
+    }
+    Predictor* operator->() const {
+      return get();
+    }
+    uint32_t index() const {
+      return index_;
+    }
+
+   private:
+    friend class PredictorPool;
+    Lease(PredictorPool* pool, uint32_t index) : pool_(pool), index_(index) {}
+
+    PredictorPool* pool_ = nullptr;
+    uint32_t index_ = 0;
+
+    DISABLE_COPY_AND_ASSIGN(Lease);
+  };
+
+  PredictorPool(const NetDef& init_net, const NetDef& run_net, size_t size);
+  ~PredictorPool();
+
+  // Returns an empty Lease if all instances are checked out.
+  Lease tryCheckout();
+  // Waits, yielding the thread, until an instance is free.
+  Lease checkout();
+
+  size_t size() const {
+    return instances_.size();
+  }
+
+  const Workspace& sharedWorkspace() const {
+    return shared_;
+  }
+
+  // Bytes held by the blobs of the shared workspace, i.e. the parameters.
+  size_t sharedMemoryBytes() const;
+  // Bytes held by the blobs local to the workspace of each instance, as of
+  // the last time the instance was returned to the pool. Tensors sharing
+  // their data, i.e. parameters and fed inputs, are not counted.
+  std::vector<size_t> instanceMemoryBytes() const;
+
+ private:
+  static constexpr uint32_t kNone = ~uint32_t(0);
+
+  void checkin(uint32_t index);
+  uint32_t pop();
+  void push(uint32_t index);
+  size_t localMemoryBytes(uint32_t index) const;
+
+  Workspace shared_;
+  // Holds the blobs local to each instance, between shared_ and the
+  // workspace of the Predictor.
+  std::vector<std::unique_ptr<Workspace>> workspaces_;
+  std::vector<std::unique_ptr<Predictor>> instances_;
+  // Blobs local to each instance; they all exist once its net is created.
+  std::vector<std::vector<const Blob*>> localBlobs_;
+  std::unique_ptr<std::atomic<size_t>[]> memoryBytes_;
+
+  // Treiber stack of free instances. The head packs the index of the top
+  // instance into the low 32 bits and a version counter, which guards
+  // against ABA, into the high 32 bits.
+  std::atomic<uint64_t> head_;
+  std::unique_ptr<std::atomic<uint32_t>[]> next_;
+
+  DISABLE_COPY_AND_ASSIGN(PredictorPool);
+};
+
+} // namespace caffe2
@@ -0,0 +1,253 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <google/protobuf/text_format.h>
+#include <thread>
+#include "caffe2/core/predictor_pool.h"
+
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+const char* predictSpec = R"DOC(
+        name: "predict"
+        type: "simple"
+        external_input: "data"
+        external_input: "W"
+        external_input: "b"
+        external_output: "y"
+        op {
+          input: "data"
+          input: "W"
+          input: "b"
+          output: "y"
+          type: "FC"
+        }
+)DOC";
+
+const char* initSpec = R"DOC(
+        name: "init"
+        type: "simple"
+        op {
+          type: "ConstantFill"
+          output: "W"
+          arg {
+            name: "shape"
+            ints: 100
+            ints: 40
+          }
+          arg {
+            name: "value"
+            f: 2.0
+          }
+        }
+        op {
+          type: "ConstantFill"
+          output: "b"
+          arg {
+            name: "shape"
+            ints: 100
+          }
+          arg {
+            name: "value"
+            f: 1.0
+          }
+        }
+)DOC";
+
+// Also creates the input and the output of the run net, as init nets that
+// declare the shapes of the inputs do.
+const char* initWithInputSpec = R"DOC(
+        name: "init"
+        type: "simple"
+        op {
+          type: "ConstantFill"
+          output: "W"
+          arg {
+            name: "shape"
+            ints: 100
+            ints: 40
+          }
+          arg {
+            name: "value"
+            f: 2.0
+          }
+        }
+        op {
+          type: "ConstantFill"
+          output: "b"
+          arg {
+            name: "shape"
+            ints: 100
+          }
+          arg {
+            name: "value"
+            f: 1.0
+          }
+        }
+        op {
+          type: "ConstantFill"
+          output: "data"
+          arg {
+            name: "shape"
+            ints: 1
+            ints: 40
+          }
+        }
+        op {
+          type: "ConstantFill"
+          output: "y"
+          arg {
+            name: "shape"
+            ints: 1
+            ints: 100
+          }
+        }
+)DOC";
+
+NetDef parseNetDef(const std::string& value) {
+  NetDef def;
+  CAFFE_ENFORCE(
+      google::protobuf::TextFormat::ParseFromString(value, &def),
+      "Failed to parse NetDef with value: ",
+      value);
+  return def;
+}
+
+} // namespace
+
+TEST(PredictorPoolTest, SharesParameters) {
+  PredictorPool pool(parseNetDef(initSpec), parseNetDef(predictSpec), 2);
+  EXPECT_EQ(pool.size(), 2);
+  EXPECT_EQ(pool.sharedMemoryBytes(), (100 * 40 + 100) * sizeof(float));
+
+  TensorCPU input(std::vector<TIndex>{1, 40});
+  for (int i = 0; i < 40; ++i) {
+    input.mutable_data<float>()[i] = 1.0;
+  }
+  {
+    auto lease = pool.checkout();
+    ASSERT_TRUE(lease);
+    // The instance reads the parameters without copying them.
+    EXPECT_EQ(
+        lease->ws()->GetBlob("W")->Get<TensorCPU>().raw_data(),
+        pool.sharedWorkspace().GetBlob("W")->Get<TensorCPU>().raw_data());
+    Predictor::TensorVector outputs;
+    EXPECT_TRUE(lease->run({&input}, &outputs));
+    ASSERT_EQ(outputs.size(), 1);
+    EXPECT_EQ(outputs[0]->size(), 100);
+    EXPECT_FLOAT_EQ(outputs[0]->data<float>()[0], 81.0);
+  }
+  // Only the output of the instance that ran is allocated.
+  auto bytes = pool.instanceMemoryBytes();
+  ASSERT_EQ(bytes.size(), 2);
+  EXPECT_GE(bytes[0] + bytes[1], 100 * sizeof(float));
+  EXPECT_LT(bytes[0] + bytes[1], pool.sharedMemoryBytes());
+}
+
+TEST(PredictorPoolTest, CheckoutAndReturn) {
+  PredictorPool pool(parseNetDef(initSpec), parseNetDef(predictSpec), 2);
+  auto first = pool.tryCheckout();
+  auto second = pool.tryCheckout();
+  ASSERT_TRUE(first);
+  ASSERT_TRUE(second);
+  EXPECT_NE(first.index(), second.index());
+  EXPECT_FALSE(pool.tryCheckout());
+  {
+    auto returned = std::move(first);
+  }
+  EXPECT_FALSE(first);
+  auto third = pool.tryCheckout();
+  EXPECT_TRUE(third);
+  EXPECT_FALSE(pool.tryCheckout());
+}
+
+TEST(PredictorPoolTest, ConcurrentRuns) {
+  const int kNumThreads = 8;
+  const int kNumRuns = 100;
+  PredictorPool pool(parseNetDef(initSpec), parseNetDef(predictSpec), 3);
+  std::vector<std::thread> threads;
+  std::atomic<int> failures{0};
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&pool, &failures, t]() {
+      TensorCPU input(std::vector<TIndex>{1, 40});
+      for (int i = 0; i < 40; ++i) {
+        input.mutable_data<float>()[i] = t;
+      }
+      for (int run = 0; run < kNumRuns; ++run) {
+        auto lease = pool.checkout();
+        Predictor::TensorVector outputs;
+        if (!lease->run({&input}, &outputs) ||
+            outputs[0]->data<float>()[99] != 80.0f * t + 1) {
+          ++failures;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(failures, 0);
+  // All instances are back in the pool.
+  std::vector<PredictorPool::Lease> leases;
+  for (int i = 0; i < 3; ++i) {
+    leases.push_back(pool.tryCheckout());
+    EXPECT_TRUE(leases.back());
+  }
+  EXPECT_FALSE(pool.tryCheckout());
+}
+
+TEST(PredictorPoolTest, ConcurrentRunsWithInputCreatedByInitNet) {
+  const int kNumThreads = 8;
+  const int kNumRuns = 100;
+  PredictorPool pool(
+      parseNetDef(initWithInputSpec), parseNetDef(predictSpec), 3);
+  const auto& shared = pool.sharedWorkspace();
+  const auto* shared_data = shared.GetBlob("data")->Get<TensorCPU>().raw_data();
+  const auto* shared_y = shared.GetBlob("y")->Get<TensorCPU>().raw_data();
+  std::vector<std::thread> threads;
+  std::atomic<int> failures{0};
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&pool, &failures, t]() {
+      TensorCPU input(std::vector<TIndex>{1, 40});
+      for (int i = 0; i < 40; ++i) {
+        input.mutable_data<float>()[i] = t;
+      }
+      for (int run = 0; run < kNumRuns; ++run) {
+        auto lease = pool.checkout();
+        Predictor::TensorVector outputs;
+        if (!lease->run({&input}, &outputs) ||
+            outputs[0]->data<float>()[99] != 80.0f * t + 1) {
+          ++failures;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(failures, 0);
+  // Inputs were fed and outputs written in the workspaces of the instances.
+  EXPECT_EQ(shared.GetBlob("data")->Get<TensorCPU>().raw_data(), shared_data);
+  EXPECT_EQ(shared.GetBlob("y")->Get<TensorCPU>().raw_data(), shared_y);
+  for (int i = 0; i < 40; ++i) {
+    EXPECT_EQ(shared.GetBlob("data")->Get<TensorCPU>().data<float>()[i], 0);
+  }
+}
+
+} // namespace caffe2
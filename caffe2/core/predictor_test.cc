@@ -74,6 +74,71 @@ const char* initSpec = R"DOC(
 
 )DOC";
 
+const char* chainSpec = R"DOC(
+        name: "chain"
+        external_input: "data"
+        external_input: "W"
+        external_input: "b"
+        external_output: "y"
+        op {
+          input: "data"
+          input: "W"
+          input: "b"
+          output: "fc"
+          type: "FC"
+        }
+        op {
+          input: "fc"
+          output: "relu"
+          type: "Relu"
+        }
+        op {
+          input: "relu"
+          output: "scaled"
+          type: "Scale"
+          arg {
+            name: "scale"
+            f: 2.0
+          }
+        }
+        op {
+          input: "scaled"
+          output: "y"
+          type: "Relu"
+        }
+)DOC";
+
+const char* aliasSpec = R"DOC(
+        name: "alias"
+        external_input: "data"
+        external_input: "W"
+        external_input: "b"
+        external_output: "y"
+        op {
+          input: "data"
+          input: "W"
+          input: "b"
+          output: "fc"
+          type: "FC"
+        }
+        op {
+          input: "fc"
+          output: "view"
+          type: "Alias"
+        }
+        op {
+          input: "view"
+          output: "relu"
+          type: "Relu"
+        }
+        op {
+          input: "relu"
+          input: "view"
+          output: "y"
+          type: "Add"
+        }
+)DOC";
+
 const char* metaSpec = R"DOC(
   blobs {
     key: "INPUTS_BLOB_TYPE"
@@ -214,6 +279,74 @@ TEST_F(PredictorTest, SimpleBatchSizedMapInput) {
   EXPECT_NEAR(output.front()->data<float>()[4], 0.1209, 1E-4);
 }
 
+TEST(PredictorMemoryPlanTest, PlanFromFirstRun) {
+  DeviceOption op;
+  op.set_random_seed(1701);
+  CPUContext ctx(op);
+  Predictor reference(parseNetDef(initSpec), parseNetDef(chainSpec));
+  Predictor planned(parseNetDef(initSpec), parseNetDef(chainSpec));
+  EXPECT_TRUE(planned.planMemory());
+  EXPECT_EQ(planned.memoryPlanStats(), nullptr);
+  for (int iter = 0; iter < 3; ++iter) {
+    auto inputData = randomTensor({1, 4}, &ctx);
+    Predictor::TensorVector input{inputData->template GetMutable<TensorCPU>()};
+    Predictor::TensorVector expected, output;
+    reference.run(input, &expected);
+    planned.run(input, &output);
+    ASSERT_EQ(output.size(), 1);
+    ASSERT_EQ(output.front()->size(), 10);
+    for (int i = 0; i < 10; ++i) {
+      EXPECT_FLOAT_EQ(
+          output.front()->data<float>()[i], expected.front()->data<float>()[i]);
+    }
+  }
+  const auto* stats = planned.memoryPlanStats();
+  ASSERT_NE(stats, nullptr);
+  // "fc" and "scaled" do not overlap in time and share their slot.
+  EXPECT_EQ(stats->num_planned_blobs, 3);
+  EXPECT_EQ(stats->planned_bytes, 2 * stats->unplanned_bytes / 3);
+  EXPECT_EQ(stats->num_dropped_blobs, 0);
+}
+
+TEST(PredictorMemoryPlanTest, PlanFromDeclaredShapes) {
+  Predictor planned(parseNetDef(initSpec), parseNetDef(chainSpec));
+  EXPECT_TRUE(planned.planMemory({{"data", {1, 4}}}));
+  const auto* stats = planned.memoryPlanStats();
+  ASSERT_NE(stats, nullptr);
+  EXPECT_EQ(stats->num_planned_blobs, 3);
+  EXPECT_LT(stats->planned_bytes, stats->unplanned_bytes);
+}
+
+TEST(PredictorMemoryPlanTest, AliasedBlobsAreNotPlanned) {
+  DeviceOption op;
+  op.set_random_seed(1701);
+  CPUContext ctx(op);
+  Predictor reference(parseNetDef(initSpec), parseNetDef(aliasSpec));
+  Predictor planned(parseNetDef(initSpec), parseNetDef(aliasSpec));
+  EXPECT_TRUE(planned.planMemory({{"data", {1, 4}}}));
+  const auto* stats = planned.memoryPlanStats();
+  ASSERT_NE(stats, nullptr);
+  // Only "relu" is planned: "fc" and "view" share their data.
+  EXPECT_EQ(stats->num_planned_blobs, 1);
+  auto inputData = randomTensor({1, 4}, &ctx);
+  Predictor::TensorVector input{inputData->template GetMutable<TensorCPU>()};
+  Predictor::TensorVector expected, output;
+  reference.run(input, &expected);
+  planned.run(input, &output);
+  ASSERT_EQ(output.size(), 1);
+  ASSERT_EQ(output.front()->size(), 10);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_FLOAT_EQ(
+        output.front()->data<float>()[i], expected.front()->data<float>()[i]);
+  }
+}
+
+TEST(PredictorMemoryPlanTest, DagNetIsNotPlanned) {
+  Predictor predictor(parseNetDef(initSpec), parseNetDef(predictSpec));
+  EXPECT_FALSE(predictor.planMemory());
+  EXPECT_EQ(predictor.memoryPlanStats(), nullptr);
+}
+
 class PredictorMetaNetDefTest : public testing::Test {
  public:
   void SetUp() override {
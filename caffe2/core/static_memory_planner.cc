@@ -0,0 +1,270 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/core/static_memory_planner.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/core/types.h"
+
+namespace caffe2 {
+
+namespace {
+
+size_t AlignUp(size_t nbytes) {
+  return (nbytes + gCaffe2Alignment - 1) / gCaffe2Alignment *
+      gCaffe2Alignment;
+}
+
+bool HasNestedNets(const OperatorDef& op) {
+  for (const auto& arg : op.arg()) {
+    if (arg.has_n() || arg.nets_size() > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Ops whose output may share its data with an input. Shape inference cannot
+// tell, so both sides are kept out of the plan.
+bool MayAlias(const OperatorDef& op) {
+  static const std::unordered_set<std::string> kAliasingOps{
+      "Alias", "EnsureDense", "Flatten", "FlattenToVec", "Reshape"};
+  return kAliasingOps.count(op.type()) > 0;
+}
+
+const void* DataOrNull(const TensorCPU& tensor) {
+  return tensor.capacity_nbytes() > 0 ? tensor.raw_data() : nullptr;
+}
+
+} // namespace
+
+StaticMemoryPlanner::StaticMemoryPlanner(const NetDef& net, Workspace* ws)
+    : net_(net), ws_(ws) {
+  std::unordered_set<std::string> excluded(
+      net.external_input().begin(), net.external_input().end());
+  excluded.insert(net.external_output().begin(), net.external_output().end());
+  CaffeMap<std::string, std::pair<int, int>> lifetimes;
+  for (int i = 0; i < net.op_size(); ++i) {
+    const auto& op = net.op(i);
+    if (MayAlias(op)) {
+      excluded.insert(op.input().begin(), op.input().end());
+      excluded.insert(op.output().begin(), op.output().end());
+    }
+    for (const auto& input : op.input()) {
+      auto it = lifetimes.find(input);
+      if (it == lifetimes.end()) {
+        // Read before being written: the value comes from outside the run.
+        excluded.insert(input);
+      } else {
+        it->second.second = i;
+      }
+    }
+    for (const auto& output : op.output()) {
+      auto it = lifetimes.find(output);
+      if (it == lifetimes.end()) {
+        lifetimes[output] = {i, i};
+      } else {
+        it->second.second = i;
+      }
+    }
+  }
+  for (const auto& lifetime : lifetimes) {
+    if (!excluded.count(lifetime.first)) {
+      lifetimes_.insert(lifetime);
+    }
+  }
+}
+
+bool StaticMemoryPlanner::CanPlan() const {
+  // Lifetimes are derived from the op order, which only holds for nets that
+  // run their ops one after the other.
+  if (net_.has_type() && net_.type() != "simple") {
+    return false;
+  }
+  for (const auto& op : net_.op()) {
+    if (op.device_option().device_type() != CPU || HasNestedNets(op)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void StaticMemoryPlanner::PlanFromWorkspace() {
+  // Tensors sharing their data with another tensor after the reference run
+  // are aliases whose lifetime we cannot see, so neither side is planned.
+  std::vector<const void*> shared_ptrs;
+  for (const auto& name : ws_->Blobs()) {
+    const auto* blob = ws_->GetBlob(name);
+    if (blob->IsType<TensorCPU>()) {
+      const auto& tensor = blob->Get<TensorCPU>();
+      if (tensor.shares_data() && DataOrNull(tensor)) {
+        shared_ptrs.push_back(DataOrNull(tensor));
+      }
+    }
+  }
+
+  std::vector<Candidate> candidates;
+  for (const auto& lifetime : lifetimes_) {
+    const auto* blob = ws_->GetBlob(lifetime.first);
+    if (!blob || !blob->IsType<TensorCPU>()) {
+      continue;
+    }
+    const auto& tensor = blob->Get<TensorCPU>();
+    const char* data = static_cast<const char*>(DataOrNull(tensor));
+    if (!data || tensor.nbytes() == 0 || tensor.meta().ctor() ||
+        tensor.shares_data()) {
+      continue;
+    }
+    bool aliased = false;
+    for (const void* ptr : shared_ptrs) {
+      if (ptr >= data && ptr < data + tensor.capacity_nbytes()) {
+        aliased = true;
+        break;
+      }
+    }
+    if (aliased) {
+      continue;
+    }
+    candidates.push_back(
+        {lifetime.first,
+         lifetime.second.first,
+         lifetime.second.second,
+         AlignUp(tensor.nbytes()),
+         0,
+         tensor.meta(),
+         tensor.dims()});
+  }
+  Plan(&candidates);
+}
+
+void StaticMemoryPlanner::PlanFromShapes(const TensorShapes& shapes) {
+  std::vector<Candidate> candidates;
+  for (const auto& shape : shapes.shapes()) {
+    auto it = lifetimes_.find(shape.name());
+    if (it == lifetimes_.end() || shape.unknown_shape() ||
+        shape.unknown_dims_size() > 0) {
+      continue;
+    }
+    const auto& meta = DataTypeToTypeMeta(shape.data_type());
+    if (meta.itemsize() == 0 || meta.ctor()) {
+      continue;
+    }
+    std::vector<TIndex> dims(shape.dims().begin(), shape.dims().end());
+    size_t nbytes = meta.itemsize();
+    for (auto d : dims) {
+      nbytes *= std::max<TIndex>(d, 0);
+    }
+    if (nbytes == 0) {
+      continue;
+    }
+    candidates.push_back(
+        {it->first,
+         it->second.first,
+         it->second.second,
+         AlignUp(nbytes),
+         0,
+         meta,
+         dims});
+  }
+  Plan(&candidates);
+}
+
+void StaticMemoryPlanner::Plan(std::vector<Candidate>* candidates) {
+  // Place the largest tensors first, each at the lowest offset that does not
+  // collide with an already placed tensor of overlapping lifetime.
+  std::sort(
+      candidates->begin(),
+      candidates->end(),
+      [](const Candidate& a, const Candidate& b) {
+        return a.nbytes != b.nbytes ? a.nbytes > b.nbytes
+                                    : a.first_op < b.first_op;
+      });
+  size_t slab_bytes = 0;
+  size_t unplanned_bytes = 0;
+  std::vector<const Candidate*> placed;
+  for (auto& candidate : *candidates) {
+    std::vector<std::pair<size_t, size_t>> conflicts;
+    for (const auto* other : placed) {
+      if (other->first_op <= candidate.last_op &&
+          candidate.first_op <= other->last_op) {
+        conflicts.emplace_back(other->offset, other->offset + other->nbytes);
+      }
+    }
+    std::sort(conflicts.begin(), conflicts.end());
+    size_t offset = 0;
+    for (const auto& range : conflicts) {
+      if (range.first >= offset + candidate.nbytes) {
+        break;
+      }
+      offset = std::max(offset, range.second);
+    }
+    candidate.offset = offset;
+    placed.push_back(&candidate);
+    slab_bytes = std::max(slab_bytes, offset + candidate.nbytes);
+    unplanned_bytes += candidate.nbytes;
+  }
+
+  stats_ = StaticMemoryPlanStats();
+  planned_.clear();
+  if (candidates->empty()) {
+    slab_.reset();
+    return;
+  }
+  auto data_and_deleter = CPUContext::New(slab_bytes);
+  slab_ =
+      std::shared_ptr<void>(data_and_deleter.first, data_and_deleter.second);
+  auto slab = slab_;
+  for (const auto& candidate : *candidates) {
+    void* ptr = static_cast<char*>(slab_.get()) + candidate.offset;
+    auto* tensor = ws_->CreateBlob(candidate.name)->GetMutable<TensorCPU>();
+    tensor->Resize(candidate.dims);
+    // The deleter keeps the slab alive for as long as any tensor uses it.
+    tensor->ShareExternalPointer(
+        ptr, candidate.meta, candidate.nbytes, [slab](void*) {});
+    planned_.emplace_back(candidate.name, ptr);
+  }
+
+  stats_.num_planned_blobs = candidates->size();
+  stats_.unplanned_bytes = unplanned_bytes;
+  stats_.planned_bytes = slab_bytes;
+  LOG(INFO) << "Static memory plan for net " << net_.name() << ": "
+            << stats_.num_planned_blobs << " blobs, "
+            << stats_.unplanned_bytes << " bytes unplanned, "
+            << stats_.planned_bytes << " bytes planned, saving "
+            << stats_.unplanned_bytes - stats_.planned_bytes << " bytes.";
+}
+
+void StaticMemoryPlanner::Verify() {
+  auto it = planned_.begin();
+  while (it != planned_.end()) {
+    const auto* blob = ws_->GetBlob(it->first);
+    if (blob && blob->IsType<TensorCPU>() &&
+        DataOrNull(blob->Get<TensorCPU>()) == it->second) {
+      ++it;
+      continue;
+    }
+    VLOG(1) << "Blob " << it->first << " left its planned slot.";
+    it = planned_.erase(it);
+    ++stats_.num_dropped_blobs;
+  }
+}
+
+} // namespace caffe2
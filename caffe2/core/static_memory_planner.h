@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_CORE_STATIC_MEMORY_PLANNER_H_
+#define CAFFE2_CORE_STATIC_MEMORY_PLANNER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/typeid.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+
+struct StaticMemoryPlanStats {
+  // Number of intermediate tensors placed into the slab.
+  size_t num_planned_blobs{0};
+  // Bytes the planned tensors take when each one owns its buffer.
+  size_t unplanned_bytes{0};
+  // Size of the slab holding all planned tensors.
+  size_t planned_bytes{0};
+  // Number of planned tensors that later outgrew or left their slot.
+  size_t num_dropped_blobs{0};
+};
+
+/**
+ * Places the intermediate CPU tensors of a sequentially executed net into a
+ * single preallocated buffer.
+ *
+ * Each intermediate blob lives from the op that first writes it to the last
+ * op that reads or writes it. Blobs whose lifetimes do not overlap are given
+ * overlapping byte ranges of the slab, and each tensor is rebound to its slot
+ * with ShareExternalPointer(), so later runs reuse the slab instead of
+ * holding on to one buffer per blob.
+ *
+ * The following blobs are never planned: external inputs and outputs of the
+ * net, blobs read before being written (weights, state carried across runs),
+ * tensors of types that need a constructor, inputs and outputs of ops that
+ * may alias their output to an input (Alias, Reshape, Flatten, ...), and
+ * tensors that alias other tensors after the reference run.
+ *
+ * Planning is only an optimization. A planned tensor that needs more than its
+ * slot at a later run simply reallocates on its own; Verify() detects this
+ * and drops it from the plan.
+ */
+class StaticMemoryPlanner {
+ public:
+  StaticMemoryPlanner(const NetDef& net, Workspace* ws);
+
+  // Returns false if the net cannot be planned, e.g. because its ops may run
+  // concurrently.
+  bool CanPlan() const;
+
+  // Plans from the sizes the intermediate tensors have in the workspace,
+  // i.e. after the net has run once.
+  void PlanFromWorkspace();
+
+  // Plans from statically inferred shapes, before the net has run.
+  void PlanFromShapes(const TensorShapes& shapes);
+
+  // Checks that every planned tensor still uses its slot of the slab and
+  // drops the ones that do not.
+  void Verify();
+
+  const StaticMemoryPlanStats& stats() const {
+    return stats_;
+  }
+
+ private:
+  struct Candidate {
+    std::string name;
+    int first_op;
+    int last_op;
+    size_t nbytes;
+    size_t offset;
+    TypeMeta meta;
+    std::vector<TIndex> dims;
+  };
+
+  void Plan(std::vector<Candidate>* candidates);
+
+  const NetDef net_;
+  Workspace* ws_;
+  // Lifetime of every blob that may be planned, as [first op, last op].
+  CaffeMap<std::string, std::pair<int, int>> lifetimes_;
+  std::shared_ptr<void> slab_;
+  // Name and data pointer of each planned tensor.
+  std::vector<std::pair<std::string, void*>> planned_;
+  StaticMemoryPlanStats stats_;
+
+  DISABLE_COPY_AND_ASSIGN(StaticMemoryPlanner);
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_CORE_STATIC_MEMORY_PLANNER_H_
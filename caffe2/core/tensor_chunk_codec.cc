@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/core/tensor_chunk_codec.h"
+
+#include <cstring>
+#include <memory>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/utils/string_utils.h"
+
+namespace caffe2 {
+
+CAFFE_DEFINE_REGISTRY(TensorChunkCodecRegistry, TensorChunkCodec);
+
+namespace {
+
+// Groups the i-th bytes of all items together. Trailing bytes that do not
+// make up a whole item are kept as is.
+class ShuffleCodec : public TensorChunkCodec {
+ public:
+  void Encode(
+      const char* data,
+      size_t size,
+      size_t itemsize,
+      std::string* out) const override {
+    const size_t offset = out->size();
+    out->resize(offset + size);
+    char* dst = &(*out)[offset];
+    if (itemsize <= 1) {
+      memcpy(dst, data, size);
+      return;
+    }
+    const size_t n = size / itemsize;
+    for (size_t b = 0; b < itemsize; ++b) {
+      for (size_t i = 0; i < n; ++i) {
+        dst[b * n + i] = data[i * itemsize + b];
+      }
+    }
+    memcpy(dst + n * itemsize, data + n * itemsize, size - n * itemsize);
+  }
+
+  void Decode(
+      const char* data,
+      size_t size,
+      size_t itemsize,
+      char* out,
+      size_t out_size) const override {
+    CAFFE_ENFORCE_EQ(size, out_size, "Corrupted shuffled tensor chunk.");
+    if (itemsize <= 1) {
+      memcpy(out, data, size);
+      return;
+    }
+    const size_t n = size / itemsize;
+    for (size_t b = 0; b < itemsize; ++b) {
+      for (size_t i = 0; i < n; ++i) {
+        out[i * itemsize + b] = data[b * n + i];
+      }
+    }
+    memcpy(out + n * itemsize, data + n * itemsize, size - n * itemsize);
+  }
+
+  bool PreservesSize() const override {
+    return true;
+  }
+};
+
+REGISTER_TENSOR_CHUNK_CODEC(shuffle, ShuffleCodec);
+
+std::vector<std::unique_ptr<TensorChunkCodec>> CreateCodecs(
+    const std::string& codec) {
+  std::vector<std::unique_ptr<TensorChunkCodec>> codecs;
+  const auto stages = split('+', codec);
+  for (int i = 0; i < stages.size(); ++i) {
+    codecs.push_back(TensorChunkCodecRegistry()->Create(stages[i]));
+    CAFFE_ENFORCE(
+        codecs.back(),
+        "Unknown tensor chunk codec: ",
+        stages[i],
+        ". Is Caffe2 built with it?");
+    CAFFE_ENFORCE(
+        i + 1 == stages.size() || codecs.back()->PreservesSize(),
+        "Only the last stage of a tensor chunk codec may change the size of "
+        "the data: ",
+        codec);
+  }
+  return codecs;
+}
+
+} // namespace
+
+std::vector<std::string> ParseTensorChunkCodec(const std::string& codec) {
+  CreateCodecs(codec);
+  return split('+', codec);
+}
+
+bool EncodeTensorChunk(
+    const std::string& codec,
+    const char* data,
+    size_t size,
+    size_t itemsize,
+    std::string* out) {
+  const auto codecs = CreateCodecs(codec);
+  const size_t raw_size = size;
+  std::string buffer;
+  for (int i = 0; i < codecs.size(); ++i) {
+    // Stages alternate between out and buffer so that the last one writes
+    // into out.
+    std::string* dst = (codecs.size() - i) % 2 == 1 ? out : &buffer;
+    dst->clear();
+    codecs[i]->Encode(data, size, itemsize, dst);
+    data = dst->data();
+    size = dst->size();
+  }
+  if (out->size() >= raw_size) {
+    out->clear();
+    return false;
+  }
+  return true;
+}
+
+void DecodeTensorChunk(
+    const std::string& codec,
+    const char* data,
+    size_t size,
+    size_t itemsize,
+    char* out,
+    size_t out_size) {
+  const auto codecs = CreateCodecs(codec);
+  // All stages but the last preserve the size, so every intermediate result
+  // has out_size bytes. Stages alternate between two buffers, the first
+  // stage decodes into out.
+  std::vector<char> buffers[2];
+  for (int i = codecs.size() - 1; i >= 0; --i) {
+    char* dst = out;
+    if (i > 0) {
+      buffers[i % 2].resize(out_size);
+      dst = buffers[i % 2].data();
+    }
+    codecs[i]->Decode(data, size, itemsize, dst, out_size);
+    data = dst;
+    size = out_size;
+  }
+}
+
+} // namespace caffe2
@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_CORE_TENSOR_CHUNK_CODEC_H_
+#define CAFFE2_CORE_TENSOR_CHUNK_CODEC_H_
+
+#include <string>
+#include <vector>
+
+#include "caffe2/core/registry.h"
+
+namespace caffe2 {
+
+/**
+ * @brief TensorChunkCodec encodes the bytes of a raw tensor chunk.
+ *
+ * Codecs are looked up by name in TensorChunkCodecRegistry and can be chained
+ * into a pipeline written as their names joined by '+', e.g. "shuffle+zstd".
+ * Every stage of a pipeline but the last has to preserve the size of the
+ * data, so that all stages can be decoded knowing only the size of the chunk.
+ *
+ * The "shuffle" codec is always available; it groups the i-th bytes of all
+ * items together, which makes the exponents of floats compress much better.
+ * Compressors are registered by optional modules, e.g. "zstd" when Caffe2 is
+ * built with USE_ZSTD and "lz4" when built with USE_LZ4.
+ *
+ * Codecs have to be thread-safe: chunks are encoded and decoded in parallel.
+ */
+class TensorChunkCodec {
+ public:
+  virtual ~TensorChunkCodec() {}
+
+  // Appends the encoding of size bytes of data, made of items of itemsize
+  // bytes each, to out.
+  virtual void Encode(
+      const char* data,
+      size_t size,
+      size_t itemsize,
+      std::string* out) const = 0;
+
+  // Decodes size bytes of encoded data into exactly out_size bytes at out.
+  virtual void Decode(
+      const char* data,
+      size_t size,
+      size_t itemsize,
+      char* out,
+      size_t out_size) const = 0;
+
+  // Whether the encoding always has the same size as the data.
+  virtual bool PreservesSize() const {
+    return false;
+  }
+};
+
+CAFFE_DECLARE_REGISTRY(TensorChunkCodecRegistry, TensorChunkCodec);
+#define REGISTER_TENSOR_CHUNK_CODEC(name, ...) \
+  CAFFE_REGISTER_CLASS(TensorChunkCodecRegistry, name, __VA_ARGS__)
+
+// Checks that every stage of the codec pipeline is registered and that only
+// the last one may change the size of the data, and returns the stages.
+std::vector<std::string> ParseTensorChunkCodec(const std::string& codec);
+
+// Encodes size bytes of data with the codec pipeline into out. Returns false,
+// leaving out empty, if the encoding is not smaller than the data, in which
+// case the chunk is better stored as is.
+bool EncodeTensorChunk(
+    const std::string& codec,
+    const char* data,
+    size_t size,
+    size_t itemsize,
+    std::string* out);
+
+// Decodes data encoded by EncodeTensorChunk into exactly out_size bytes.
+void DecodeTensorChunk(
+    const std::string& codec,
+    const char* data,
+    size_t size,
+    size_t itemsize,
+    char* out,
+    size_t out_size);
+
+} // namespace caffe2
+
+#endif // CAFFE2_CORE_TENSOR_CHUNK_CODEC_H_
@@ -35,6 +35,7 @@
 #include "caffe2/core/registry.h"
 #include "caffe2/core/net.h"
 #include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/parallel_for.h"
 #include "caffe2/utils/signal_handler.h"
 #if CAFFE2_MOBILE
 #include "caffe2/utils/threadpool/ThreadPool.h"
@@ -300,6 +301,24 @@ class Workspace {
   ThreadPool* GetThreadPool();
 #endif
 
+  /*
+   * Sets the intra-op pool that CPU operators created in this workspace from
+   * now on split their work with, nullptr meaning the process-wide default.
+   * Workspaces created on top of this one inherit it, unless they are given
+   * their own. Nets may still give their operators a pool of their own, see
+   * CreateNet.
+   */
+  void SetIntraOpThreadPool(std::shared_ptr<IntraOpThreadPool> pool) {
+    intra_op_pool_ = std::move(pool);
+  }
+
+  std::shared_ptr<IntraOpThreadPool> GetIntraOpThreadPool() const {
+    if (!intra_op_pool_ && shared_) {
+      return shared_->GetIntraOpThreadPool();
+    }
+    return intra_op_pool_;
+  }
+
   // RunOperatorOnce and RunNetOnce runs an operator or net once. The difference
   // between RunNet and RunNetOnce lies in the fact that RunNet allows you to
   // have a persistent net object, while RunNetOnce creates a net and discards
@@ -318,6 +337,7 @@ class Workspace {
   const Workspace* shared_;
   std::unordered_map<string, std::pair<const Workspace*, string>>
       forwarded_blobs_;
+  std::shared_ptr<IntraOpThreadPool> intra_op_pool_;
 #if CAFFE2_MOBILE
   std::unique_ptr<ThreadPool> thread_pool_;
   std::mutex thread_pool_creation_mutex_;
@@ -14,6 +14,14 @@
  * limitations under the License.
  */
 
+// shmdb is not built on Apple platforms and Android, see
+// caffe2/db/CMakeLists.txt. Its tests only run on Linux.
+#if defined(__linux__) && !defined(__ANDROID__)
+#define CAFFE2_DB_TEST_SHMDB
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 #include <cstdio>
 #include <iomanip>
 #include <sstream>
@@ -22,9 +30,16 @@
 #include "caffe2/core/blob_serialization.h"
 #include "caffe2/core/db.h"
 #include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
 #include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
 #include <gtest/gtest.h>
 
+#ifdef CAFFE2_DB_TEST_SHMDB
+CAFFE2_DECLARE_int64(caffe2_shmdb_capacity);
+#endif
+
 namespace caffe2 {
 namespace db {
 
@@ -212,5 +227,246 @@ TEST(DBReaderShardedTest, Reader) {
   EXPECT_EQ(value, "05");
 }
 
+static void ExpectRead(
+    const DBReader& reader,
+    int cursor_id,
+    const string& expected) {
+  string key;
+  string value;
+  reader.Read(cursor_id, &key, &value);
+  EXPECT_EQ(key, expected);
+  EXPECT_EQ(value, expected);
+}
+
+TEST(DBReaderSplitCursorsTest, Strided) {
+  // mmapdb does not support Seek, so the cursors interleave.
+  std::string name = std::tmpnam(nullptr);
+  CreateAndFill("mmapdb", name);
+  DBReader reader("mmapdb", name);
+  reader.SplitCursors(3);
+  EXPECT_EQ(reader.NumCursors(), 3);
+  // Splitting again with the same count keeps the cursors.
+  reader.SplitCursors(3);
+  EXPECT_THROW(reader.SplitCursors(2), EnforceNotMet);
+
+  // Reading the cursors round robin gives the order of Read().
+  string key;
+  string value;
+  for (int i = 0; i < 9; ++i) {
+    std::stringstream ss;
+    ss << std::setw(2) << std::setfill('0') << i;
+    ExpectRead(reader, i % 3, ss.str());
+  }
+  // Cursor 0 holds 00, 03, 06 and 09, then wraps around.
+  ExpectRead(reader, 0, "09");
+  ExpectRead(reader, 0, "00");
+  ExpectRead(reader, 1, "01");
+  // The regular cursor is not affected.
+  reader.Read(&key, &value);
+  EXPECT_EQ(key, "00");
+}
+
+TEST(DBReaderSplitCursorsTest, StridedShards) {
+  std::string name = std::tmpnam(nullptr);
+  CreateAndFill("mmapdb", name);
+  // Shard 1 of 2 holds 01, 03, 05, 07, 09.
+  DBReader reader("mmapdb", name, 2, 1);
+  reader.SplitCursors(2);
+  ExpectRead(reader, 0, "01");
+  ExpectRead(reader, 1, "03");
+  ExpectRead(reader, 0, "05");
+  ExpectRead(reader, 1, "07");
+  ExpectRead(reader, 0, "09");
+  ExpectRead(reader, 0, "01");
+}
+
+TEST(DBReaderSplitCursorsTest, KeyRanges) {
+  std::string name = std::tmpnam(nullptr);
+  CreateAndFill("leveldb", name);
+  DBReader reader("leveldb", name);
+  reader.SplitCursors(3);
+  // Ranges are [00, 03), [03, 06) and [06, end).
+  ExpectRead(reader, 0, "00");
+  ExpectRead(reader, 1, "03");
+  ExpectRead(reader, 2, "06");
+  ExpectRead(reader, 0, "01");
+  ExpectRead(reader, 0, "02");
+  ExpectRead(reader, 0, "00");
+  ExpectRead(reader, 2, "07");
+  ExpectRead(reader, 2, "08");
+  ExpectRead(reader, 2, "09");
+  ExpectRead(reader, 2, "06");
+
+  // Concurrent reads through different cursors see every record once.
+  DBReader parallel_reader("leveldb", name);
+  parallel_reader.SplitCursors(2);
+  vector<std::thread> threads;
+  vector<vector<string>> keys(2);
+  for (int i = 0; i < 2; ++i) {
+    threads.emplace_back([&parallel_reader, &keys, i]() {
+      string key;
+      string value;
+      for (int j = 0; j < kMaxItems / 2; ++j) {
+        parallel_reader.Read(i, &key, &value);
+        keys[i].push_back(key);
+      }
+    });
+  }
+  std::set<string> keys_set;
+  for (int i = 0; i < 2; ++i) {
+    threads[i].join();
+    keys_set.insert(keys[i].begin(), keys[i].end());
+  }
+  EXPECT_EQ(keys_set.size(), kMaxItems);
+}
+
+TEST(MMapDBTest, ReadWrite) {
+  std::string name = std::tmpnam(nullptr);
+  CreateAndFill("mmapdb", name);
+  std::unique_ptr<DB> db(CreateDB("mmapdb", name, READ));
+  std::unique_ptr<Cursor> cursor(db->NewCursor());
+  const char* data = nullptr;
+  size_t size = 0;
+  std::shared_ptr<void> owner;
+  for (int i = 0; i < kMaxItems; ++i) {
+    std::stringstream ss;
+    ss << std::setw(2) << std::setfill('0') << i;
+    EXPECT_TRUE(cursor->Valid());
+    EXPECT_EQ(cursor->key(), ss.str());
+    EXPECT_EQ(cursor->value(), ss.str());
+    EXPECT_TRUE(cursor->MappedValue(&data, &size, &owner));
+    EXPECT_EQ(string(data, size), ss.str());
+    cursor->Next();
+  }
+  EXPECT_FALSE(cursor->Valid());
+  cursor->SeekToFirst();
+  EXPECT_EQ(cursor->key(), "00");
+  // The mapping outlives the db as long as the owner is held.
+  cursor.reset();
+  db.reset();
+  EXPECT_EQ(string(data, size), "09");
+}
+
+TEST(MMapDBTest, LoadAliasesMappedTensors) {
+  std::string name = std::tmpnam(nullptr);
+  bool raw_flag = FLAGS_caffe2_serialize_raw_tensors;
+  FLAGS_caffe2_serialize_raw_tensors = true;
+  {
+    std::unique_ptr<DB> db(CreateDB("mmapdb", name, NEW));
+    std::unique_ptr<Transaction> trans(db->NewTransaction());
+    auto acceptor = [&](const std::string& key, const std::string& value) {
+      trans->Put(key, value);
+    };
+    for (int i = 0; i < 3; ++i) {
+      Blob blob;
+      auto* tensor = blob.GetMutable<TensorCPU>();
+      tensor->Resize(i + 1, 7);
+      for (int j = 0; j < tensor->size(); ++j) {
+        tensor->mutable_data<float>()[j] = i * 100 + j;
+      }
+      blob.Serialize(MakeString("blob", i), acceptor, kNoChunking);
+    }
+    trans->Commit();
+  }
+  FLAGS_caffe2_serialize_raw_tensors = raw_flag;
+
+  Workspace ws;
+  OperatorDef op_def = CreateOperatorDef(
+      "Load",
+      "",
+      std::vector<string>{},
+      std::vector<string>{"blob0", "blob1", "blob2"},
+      std::vector<Argument>{MakeArgument<string>("db_type", "mmapdb"),
+                            MakeArgument<string>("db", name),
+                            MakeArgument<int>("absolute_path", 1)});
+  auto load_op = CreateOperator(op_def, &ws);
+  EXPECT_TRUE(load_op->Run());
+  load_op.reset();
+  for (int i = 0; i < 3; ++i) {
+    const auto& tensor = ws.GetBlob(MakeString("blob", i))->Get<TensorCPU>();
+    EXPECT_TRUE(tensor.shares_data());
+    EXPECT_EQ(
+        reinterpret_cast<uintptr_t>(tensor.raw_data()) % gCaffe2Alignment, 0);
+    EXPECT_EQ(tensor.dim(0), i + 1);
+    EXPECT_EQ(tensor.dim(1), 7);
+    for (int j = 0; j < tensor.size(); ++j) {
+      EXPECT_EQ(tensor.data<float>()[j], i * 100 + j);
+    }
+  }
+}
+
+#ifdef CAFFE2_DB_TEST_SHMDB
+static string ShmDBTestName(const string& test) {
+  return "/caffe2_shmdb_test_" + test + "_" + caffe2::to_string(getpid());
+}
+
+TEST(ShmDBTest, WriterAndReaderThreads) {
+  // A small ring, so that the writer blocks and records wrap around.
+  const auto capacity = FLAGS_caffe2_shmdb_capacity;
+  FLAGS_caffe2_shmdb_capacity = 1024;
+  const string name = ShmDBTestName("threads");
+  constexpr int kNumRecords = 1000;
+  std::unique_ptr<DB> in_db(CreateDB("shmdb", name, READ));
+  ASSERT_TRUE(in_db != nullptr);
+  std::thread writer([&name]() {
+    std::unique_ptr<DB> out_db(CreateDB("shmdb", name, NEW));
+    auto transaction = out_db->NewTransaction();
+    for (int i = 0; i < kNumRecords; ++i) {
+      transaction->Put(caffe2::to_string(i), string(i % 300, 'a' + i % 26));
+    }
+    transaction->Commit();
+  });
+  auto cursor = in_db->NewCursor();
+  for (int i = 0; i < kNumRecords; ++i) {
+    ASSERT_TRUE(cursor->Valid());
+    EXPECT_EQ(cursor->key(), caffe2::to_string(i));
+    EXPECT_EQ(cursor->value(), string(i % 300, 'a' + i % 26));
+    if (i + 1 < kNumRecords) {
+      cursor->Next();
+    }
+  }
+  writer.join();
+  FLAGS_caffe2_shmdb_capacity = capacity;
+}
+
+TEST(ShmDBTest, RejectsRecordsLargerThanHalfTheRing) {
+  const auto capacity = FLAGS_caffe2_shmdb_capacity;
+  FLAGS_caffe2_shmdb_capacity = 1024;
+  std::unique_ptr<DB> db(CreateDB("shmdb", ShmDBTestName("large"), NEW));
+  auto transaction = db->NewTransaction();
+  EXPECT_THROW(transaction->Put("key", string(1024, 'x')), EnforceNotMet);
+  FLAGS_caffe2_shmdb_capacity = capacity;
+}
+
+TEST(ShmDBTest, FeedsAnotherProcess) {
+  const string name = ShmDBTestName("process");
+  // Attach before the child does, so that the ring outlives the child.
+  std::unique_ptr<DB> in_db(CreateDB("shmdb", name, READ));
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    {
+      std::unique_ptr<DB> out_db(CreateDB("shmdb", name, NEW));
+      auto transaction = out_db->NewTransaction();
+      for (int i = 0; i < kMaxItems; ++i) {
+        transaction->Put(caffe2::to_string(i), caffe2::to_string(i * i));
+      }
+    }
+    _exit(0);
+  }
+  auto cursor = in_db->NewCursor();
+  for (int i = 0; i < kMaxItems; ++i) {
+    EXPECT_EQ(cursor->key(), caffe2::to_string(i));
+    EXPECT_EQ(cursor->value(), caffe2::to_string(i * i));
+    if (i + 1 < kMaxItems) {
+      cursor->Next();
+    }
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+#endif // CAFFE2_DB_TEST_SHMDB
+
 }  // namespace db
 }  // namespace caffe2
@@ -0,0 +1,296 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+#include <limits>
+#include <mutex>
+
+#include "caffe2/core/blob_serialization.h"
+#include "caffe2/core/db.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/utils/mapped_file.h"
+
+namespace caffe2 {
+namespace db {
+
+// MMapDB stores key-value pairs in a single file laid out so that it can be
+// memory-mapped for reading. Every value starts at an offset chosen such that
+// the payload of a raw tensor chunk (see RawTensorChunkHeader) is aligned to
+// kMMapDBAlignment. This lets the Load operator create CPU tensors that alias
+// the mapping directly instead of copying them to the heap, and lets several
+// processes loading the same file share its pages through the page cache.
+//
+// The file starts with a header:
+//   char[8] magic, uint32 version, uint32 alignment
+// followed by entries:
+//   uint32 key length, uint32 reserved, uint64 value length,
+//   uint64 absolute value offset, key bytes, zero padding, value bytes.
+// The next entry starts right after the value bytes.
+//
+// The file is mapped copy-on-write: tensors that alias it can be modified in
+// place, in which case only the modified pages become private to the process.
+// Seeking is not supported.
+
+namespace {
+constexpr char kMMapDBMagic[8] = {'C', '2', 'M', 'M', 'A', 'P', 'D', 'B'};
+constexpr uint32_t kMMapDBVersion = 1;
+constexpr uint64_t kMMapDBAlignment = 64;
+constexpr size_t kMMapDBHeaderSize =
+    sizeof(kMMapDBMagic) + 2 * sizeof(uint32_t);
+constexpr size_t kMMapDBEntryHeaderSize =
+    2 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+
+static_assert(
+    kMMapDBAlignment % gCaffe2Alignment == 0,
+    "MMapDB alignment has to be a multiple of the Caffe2 alignment.");
+
+template <typename T>
+T ReadAt(const char* data, size_t offset) {
+  T value;
+  memcpy(&value, data + offset, sizeof(T));
+  return value;
+}
+
+template <typename T>
+void Write(FILE* file, T value) {
+  CAFFE_ENFORCE_EQ(fwrite(&value, sizeof(T), 1, file), 1);
+}
+
+} // namespace
+
+class MMapDBCursor : public Cursor {
+ public:
+  explicit MMapDBCursor(std::shared_ptr<MappedFile> file)
+      : file_(std::move(file)) {
+    SeekToFirst();
+  }
+  ~MMapDBCursor() {}
+
+  void Seek(const string& /*key*/) override {
+    LOG(FATAL) << "MMapDB does not support seeking to a specific key.";
+  }
+
+  void SeekToFirst() override {
+    ReadEntry(kMMapDBHeaderSize);
+  }
+
+  void Next() override {
+    CAFFE_ENFORCE(valid_, "Cursor is at invalid location!");
+    ReadEntry(value_offset_ + value_len_);
+  }
+
+  string key() override {
+    CAFFE_ENFORCE(valid_, "Cursor is at invalid location!");
+    return string(file_->data() + key_offset_, key_len_);
+  }
+
+  string value() override {
+    CAFFE_ENFORCE(valid_, "Cursor is at invalid location!");
+    return string(file_->data() + value_offset_, value_len_);
+  }
+
+  bool MappedValue(
+      const char** data,
+      size_t* size,
+      std::shared_ptr<void>* owner) override {
+    CAFFE_ENFORCE(valid_, "Cursor is at invalid location!");
+    *data = file_->data() + value_offset_;
+    *size = value_len_;
+    *owner = file_;
+    return true;
+  }
+
+  bool Valid() override {
+    return valid_;
+  }
+
+ private:
+  void ReadEntry(uint64_t offset) {
+    const char* data = file_->data();
+    const uint64_t size = file_->size();
+    if (offset >= size) {
+      VLOG(1) << "EOF reached, setting valid to false";
+      valid_ = false;
+      return;
+    }
+    CAFFE_ENFORCE_LE(
+        offset + kMMapDBEntryHeaderSize, size, "Truncated MMapDB entry.");
+    key_len_ = ReadAt<uint32_t>(data, offset);
+    value_len_ = ReadAt<uint64_t>(data, offset + 2 * sizeof(uint32_t));
+    value_offset_ = ReadAt<uint64_t>(
+        data, offset + 2 * sizeof(uint32_t) + sizeof(uint64_t));
+    key_offset_ = offset + kMMapDBEntryHeaderSize;
+    CAFFE_ENFORCE_GT(key_len_, 0);
+    CAFFE_ENFORCE(
+        key_offset_ + key_len_ <= value_offset_ &&
+            value_offset_ <= size && value_len_ <= size - value_offset_,
+        "Corrupted MMapDB entry at offset ",
+        offset);
+    valid_ = true;
+  }
+
+  std::shared_ptr<MappedFile> file_;
+  bool valid_;
+  uint64_t key_offset_;
+  uint32_t key_len_;
+  uint64_t value_offset_;
+  uint64_t value_len_;
+};
+
+class MMapDBTransaction : public Transaction {
+ public:
+  MMapDBTransaction(FILE* f, uint64_t* offset, std::mutex* mutex)
+      : file_(f), offset_(offset), lock_(*mutex) {}
+  ~MMapDBTransaction() {
+    Commit();
+  }
+
+  void Put(const string& key, const string& value) override {
+    CAFFE_ENFORCE(file_, "Transaction has already been committed.");
+    CAFFE_ENFORCE_GT(key.size(), 0);
+    CAFFE_ENFORCE_LE(key.size(), std::numeric_limits<uint32_t>::max());
+    // Align the payload of raw tensor chunks, and the value itself otherwise.
+    uint64_t payload_offset = 0;
+    if (IsRawTensorChunk(value)) {
+      RawTensorChunkHeader header;
+      ParseRawTensorChunkHeader(value, &header);
+      payload_offset = header.data_offset;
+    }
+    const uint64_t key_end = *offset_ + kMMapDBEntryHeaderSize + key.size();
+    const uint64_t payload_begin = (key_end + payload_offset +
+                                    kMMapDBAlignment - 1) /
+        kMMapDBAlignment * kMMapDBAlignment;
+    const uint64_t value_offset = payload_begin - payload_offset;
+    static const char kZeros[kMMapDBAlignment] = {0};
+
+    Write<uint32_t>(file_, key.size());
+    Write<uint32_t>(file_, 0);
+    Write<uint64_t>(file_, value.size());
+    Write<uint64_t>(file_, value_offset);
+    CAFFE_ENFORCE_EQ(
+        fwrite(key.data(), sizeof(char), key.size(), file_), key.size());
+    const size_t padding = value_offset - key_end;
+    CAFFE_ENFORCE_EQ(fwrite(kZeros, sizeof(char), padding, file_), padding);
+    CAFFE_ENFORCE_EQ(
+        fwrite(value.data(), sizeof(char), value.size(), file_), value.size());
+    *offset_ = value_offset + value.size();
+  }
+
+  void Commit() override {
+    if (file_ != nullptr) {
+      CAFFE_ENFORCE_EQ(fflush(file_), 0);
+      file_ = nullptr;
+    }
+  }
+
+ private:
+  FILE* file_;
+  uint64_t* offset_;
+  std::lock_guard<std::mutex> lock_;
+
+  DISABLE_COPY_AND_ASSIGN(MMapDBTransaction);
+};
+
+class MMapDB : public DB {
+ public:
+  MMapDB(const string& source, Mode mode)
+      : DB(source, mode), file_(nullptr), offset_(0) {
+    switch (mode) {
+      case NEW:
+        file_ = fopen(source.c_str(), "wb");
+        break;
+      case WRITE:
+        file_ = fopen(source.c_str(), "ab");
+        break;
+      case READ:
+        // Load aliases tensors to the mapping, and they may be updated in
+        // place afterwards, e.g. by an optimizer.
+        mapped_file_ =
+            std::make_shared<MappedFile>(source, true /* copy_on_write */);
+        CheckHeader(source);
+        VLOG(1) << "Opened MMapDB " << source;
+        return;
+    }
+    CAFFE_ENFORCE(file_, "Cannot open file: " + source);
+    CAFFE_ENFORCE_EQ(fseek(file_, 0, SEEK_END), 0);
+    offset_ = ftell(file_);
+    if (offset_ == 0) {
+      CAFFE_ENFORCE_EQ(
+          fwrite(kMMapDBMagic, sizeof(char), sizeof(kMMapDBMagic), file_),
+          sizeof(kMMapDBMagic));
+      Write<uint32_t>(file_, kMMapDBVersion);
+      Write<uint32_t>(file_, kMMapDBAlignment);
+      offset_ = kMMapDBHeaderSize;
+    }
+    VLOG(1) << "Opened MMapDB " << source;
+  }
+  ~MMapDB() {
+    Close();
+  }
+
+  void Close() override {
+    if (file_) {
+      fclose(file_);
+    }
+    file_ = nullptr;
+    mapped_file_.reset();
+  }
+
+  unique_ptr<Cursor> NewCursor() override {
+    CAFFE_ENFORCE_EQ(this->mode_, READ);
+    CAFFE_ENFORCE(mapped_file_, "MMapDB has been closed.");
+    return make_unique<MMapDBCursor>(mapped_file_);
+  }
+
+  unique_ptr<Transaction> NewTransaction() override {
+    CAFFE_ENFORCE(this->mode_ == NEW || this->mode_ == WRITE);
+    CAFFE_ENFORCE(file_, "MMapDB has been closed.");
+    return make_unique<MMapDBTransaction>(file_, &offset_, &file_access_mutex_);
+  }
+
+ private:
+  void CheckHeader(const string& source) {
+    const char* data = mapped_file_->data();
+    CAFFE_ENFORCE(
+        mapped_file_->size() >= kMMapDBHeaderSize &&
+            memcmp(data, kMMapDBMagic, sizeof(kMMapDBMagic)) == 0,
+        "Not an MMapDB file: ",
+        source);
+    CAFFE_ENFORCE_EQ(
+        ReadAt<uint32_t>(data, sizeof(kMMapDBMagic)),
+        kMMapDBVersion,
+        "Unsupported MMapDB version in ",
+        source);
+    CAFFE_ENFORCE_EQ(
+        ReadAt<uint32_t>(data, sizeof(kMMapDBMagic) + sizeof(uint32_t)),
+        kMMapDBAlignment,
+        "Unsupported MMapDB alignment in ",
+        source);
+  }
+
+  FILE* file_;
+  uint64_t offset_;
+  std::shared_ptr<MappedFile> mapped_file_;
+  // access mutex makes sure we don't have multiple transactions writing to
+  // the same file at the same time.
+  std::mutex file_access_mutex_;
+};
+
+REGISTER_CAFFE2_DB(MMapDB, MMapDB);
+REGISTER_CAFFE2_DB(mmapdb, MMapDB);
+
+} // namespace db
+} // namespace caffe2
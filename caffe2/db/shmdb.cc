@@ -0,0 +1,394 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <thread>
+
+#include "caffe2/core/db.h"
+#include "caffe2/core/flags.h"
+#include "caffe2/core/logging.h"
+
+CAFFE2_DEFINE_int64(
+    caffe2_shmdb_capacity,
+    64 << 20,
+    "Size in bytes of the ring buffer of a shmdb, used by the process that "
+    "creates it.");
+
+namespace caffe2 {
+namespace db {
+
+// ShmDB passes records between processes on the same host through a ring
+// buffer in POSIX shared memory, as a local replacement for zmqdb that needs
+// no sockets and copies every record only twice: into the ring by the writer
+// and out of it by the reader.
+//
+// The source is the name of the shared memory object, e.g. "/caffe2_feed".
+// Whichever process opens it first creates it with --caffe2_shmdb_capacity
+// bytes of ring buffer, and the last one to close it removes it. Writers
+// (NEW or WRITE mode) block while the ring is full and readers block while it
+// is empty, so, like zmqdb, a cursor is always valid and never reaches the
+// end. Any number of processes and threads may read and write concurrently:
+// each record goes to exactly one reader.
+//
+// The ring is guarded by a process-shared robust mutex, so a process that
+// dies while holding it does not block the others. Records are only made
+// visible once completely written, so the ring stays consistent in that case.
+//
+// Each record is stored as
+//   uint32 key size, uint32 value size, key bytes, value bytes
+// padded to kShmRecordAlignment. A record that does not fit before the end
+// of the buffer is preceded by a wrap marker in place of its key size and
+// written at the start of the buffer instead.
+
+namespace {
+constexpr uint32_t kShmDBVersion = 1;
+constexpr uint64_t kShmRecordAlignment = 8;
+constexpr uint32_t kShmWrapMarker = 0xffffffff;
+constexpr size_t kShmRecordHeaderSize = 2 * sizeof(uint32_t);
+
+struct ShmRingHeader {
+  // Set last by the creator once everything else is initialized.
+  std::atomic<uint32_t> initialized;
+  uint32_t version;
+  uint64_t capacity;
+  // Number of processes that have the ring open, INT_MIN once the last one
+  // started removing it.
+  std::atomic<int> numAttached;
+  pthread_mutex_t mutex;
+  pthread_cond_t notEmpty;
+  pthread_cond_t notFull;
+  // Positions in bytes since the creation of the ring; the data of a
+  // position lives at offset position % capacity.
+  uint64_t head;
+  uint64_t tail;
+};
+
+constexpr uint64_t kShmDataOffset =
+    (sizeof(ShmRingHeader) + kShmRecordAlignment - 1) / kShmRecordAlignment *
+    kShmRecordAlignment;
+
+uint64_t RecordSize(size_t keySize, size_t valueSize) {
+  return (kShmRecordHeaderSize + keySize + valueSize + kShmRecordAlignment -
+          1) /
+      kShmRecordAlignment * kShmRecordAlignment;
+}
+
+void HandleOwnerDead(int rv, pthread_mutex_t* mutex) {
+  if (rv == EOWNERDEAD) {
+    // Records are published after they are complete, so the ring is
+    // consistent even if its previous owner died in the middle of a copy.
+    LOG(WARNING) << "A process died while holding the shmdb lock.";
+    pthread_mutex_consistent(mutex);
+    return;
+  }
+  CAFFE_ENFORCE_EQ(rv, 0, "shmdb lock failed: ", strerror(rv));
+}
+
+class ShmRingLock {
+ public:
+  explicit ShmRingLock(ShmRingHeader* header) : header_(header) {
+    HandleOwnerDead(pthread_mutex_lock(&header_->mutex), &header_->mutex);
+  }
+  ~ShmRingLock() {
+    pthread_mutex_unlock(&header_->mutex);
+  }
+
+  void Wait(pthread_cond_t* cond) {
+    HandleOwnerDead(pthread_cond_wait(cond, &header_->mutex), &header_->mutex);
+  }
+
+ private:
+  ShmRingHeader* header_;
+
+  DISABLE_COPY_AND_ASSIGN(ShmRingLock);
+};
+
+// A shared memory ring, mapped into this process.
+class ShmRing {
+ public:
+  explicit ShmRing(const string& source) : name_(source) {
+    if (name_.empty() || name_[0] != '/') {
+      name_ = "/" + name_;
+    }
+    while (!Attach()) {
+      // The ring was being removed by its last user, open a new one.
+    }
+  }
+
+  ~ShmRing() {
+    int oldCount = header_->numAttached.fetch_sub(1);
+    bool doUnlink = false;
+    if (oldCount == 1) {
+      // Lock out processes that are attaching right now, see Attach().
+      oldCount = 0;
+      doUnlink = header_->numAttached.compare_exchange_strong(oldCount, INT_MIN);
+    }
+    munmap(header_, size_);
+    if (doUnlink) {
+      shm_unlink(name_.c_str());
+    }
+  }
+
+  void Put(const string& key, const string& value) {
+    const uint64_t capacity = header_->capacity;
+    const uint64_t size = RecordSize(key.size(), value.size());
+    CAFFE_ENFORCE_LE(
+        size,
+        capacity / 2,
+        "Record of ",
+        size,
+        " bytes is too large for a shmdb of ",
+        capacity,
+        " bytes, increase --caffe2_shmdb_capacity.");
+    ShmRingLock lock(header_);
+    uint64_t needed = size;
+    while (true) {
+      const uint64_t remaining = capacity - header_->tail % capacity;
+      needed = remaining < size ? remaining + size : size;
+      if (capacity - (header_->tail - header_->head) >= needed) {
+        break;
+      }
+      lock.Wait(&header_->notFull);
+    }
+    if (needed > size) {
+      Store<uint32_t>(header_->tail, kShmWrapMarker);
+      header_->tail += needed - size;
+    }
+    const uint64_t offset = header_->tail % capacity;
+    Store<uint32_t>(offset, key.size());
+    Store<uint32_t>(offset + sizeof(uint32_t), value.size());
+    char* dst = data_ + offset + kShmRecordHeaderSize;
+    memcpy(dst, key.data(), key.size());
+    memcpy(dst + key.size(), value.data(), value.size());
+    header_->tail += size;
+    pthread_cond_signal(&header_->notEmpty);
+  }
+
+  void Get(string* key, string* value) {
+    const uint64_t capacity = header_->capacity;
+    ShmRingLock lock(header_);
+    uint32_t keySize;
+    while (true) {
+      if (header_->head == header_->tail) {
+        lock.Wait(&header_->notEmpty);
+        continue;
+      }
+      keySize = Load<uint32_t>(header_->head);
+      if (keySize != kShmWrapMarker) {
+        break;
+      }
+      header_->head += capacity - header_->head % capacity;
+    }
+    const uint64_t offset = header_->head % capacity;
+    const uint32_t valueSize = Load<uint32_t>(offset + sizeof(uint32_t));
+    const char* src = data_ + offset + kShmRecordHeaderSize;
+    key->assign(src, keySize);
+    value->assign(src + keySize, valueSize);
+    header_->head += RecordSize(keySize, valueSize);
+    pthread_cond_broadcast(&header_->notFull);
+  }
+
+ private:
+  // Opens or creates the ring and maps it. Returns false if the ring was
+  // being removed, in which case the caller should try again.
+  bool Attach() {
+    int fd = shm_open(name_.c_str(), O_RDWR, 0);
+    bool creator = false;
+    if (fd == -1) {
+      CAFFE_ENFORCE_EQ(errno, ENOENT, "shm_open failed: ", strerror(errno));
+      fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+      if (fd == -1 && errno == EEXIST) {
+        // Another process created it first.
+        return false;
+      }
+      CAFFE_ENFORCE(fd != -1, "shm_open failed: ", strerror(errno));
+      creator = true;
+      const int64_t capacity = FLAGS_caffe2_shmdb_capacity /
+          kShmRecordAlignment * kShmRecordAlignment;
+      CAFFE_ENFORCE_GT(capacity, 0, "Invalid --caffe2_shmdb_capacity.");
+      if (ftruncate(fd, kShmDataOffset + capacity) != 0) {
+        close(fd);
+        CAFFE_THROW("ftruncate failed: ", strerror(errno));
+      }
+    }
+    // The creator may not have resized the object yet.
+    struct stat st;
+    while (true) {
+      if (fstat(fd, &st) != 0) {
+        close(fd);
+        CAFFE_THROW("fstat failed: ", strerror(errno));
+      }
+      if (st.st_size > kShmDataOffset) {
+        break;
+      }
+      std::this_thread::yield();
+    }
+    size_ = st.st_size;
+    void* addr =
+        mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    CAFFE_ENFORCE(addr != MAP_FAILED, "mmap failed: ", strerror(errno));
+    header_ = static_cast<ShmRingHeader*>(addr);
+    data_ = static_cast<char*>(addr) + kShmDataOffset;
+
+    if (creator) {
+      Initialize();
+      return true;
+    }
+    while (header_->initialized.load(std::memory_order_acquire) == 0) {
+      std::this_thread::yield();
+    }
+    if (header_->numAttached.fetch_add(1) < 0) {
+      header_->numAttached.fetch_sub(1);
+      munmap(header_, size_);
+      return false;
+    }
+    CAFFE_ENFORCE_EQ(
+        header_->version, kShmDBVersion, "Unsupported shmdb version.");
+    CAFFE_ENFORCE_EQ(
+        header_->capacity + kShmDataOffset, size_, "Corrupted shmdb.");
+    return true;
+  }
+
+  void Initialize() {
+    header_->version = kShmDBVersion;
+    header_->capacity = size_ - kShmDataOffset;
+    header_->head = 0;
+    header_->tail = 0;
+    header_->numAttached = 1;
+    pthread_mutexattr_t mutexAttr;
+    pthread_mutexattr_init(&mutexAttr);
+    pthread_mutexattr_setpshared(&mutexAttr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&mutexAttr, PTHREAD_MUTEX_ROBUST);
+    CAFFE_ENFORCE_EQ(pthread_mutex_init(&header_->mutex, &mutexAttr), 0);
+    pthread_mutexattr_destroy(&mutexAttr);
+    pthread_condattr_t condAttr;
+    pthread_condattr_init(&condAttr);
+    pthread_condattr_setpshared(&condAttr, PTHREAD_PROCESS_SHARED);
+    CAFFE_ENFORCE_EQ(pthread_cond_init(&header_->notEmpty, &condAttr), 0);
+    CAFFE_ENFORCE_EQ(pthread_cond_init(&header_->notFull, &condAttr), 0);
+    pthread_condattr_destroy(&condAttr);
+    header_->initialized.store(1, std::memory_order_release);
+  }
+
+  template <typename T>
+  void Store(uint64_t position, T value) {
+    memcpy(data_ + position % header_->capacity, &value, sizeof(T));
+  }
+
+  template <typename T>
+  T Load(uint64_t position) const {
+    T value;
+    memcpy(&value, data_ + position % header_->capacity, sizeof(T));
+    return value;
+  }
+
+  string name_;
+  ShmRingHeader* header_;
+  char* data_;
+  size_t size_;
+
+  DISABLE_COPY_AND_ASSIGN(ShmRing);
+};
+} // namespace
+
+class ShmDBCursor : public Cursor {
+ public:
+  explicit ShmDBCursor(std::shared_ptr<ShmRing> ring) : ring_(ring) {
+    // Obtain the first record.
+    Next();
+  }
+
+  void Seek(const string& /*key*/) override { /* do nothing */ }
+  void SeekToFirst() override { /* do nothing */ }
+
+  void Next() override {
+    ring_->Get(&key_, &value_);
+  }
+
+  string key() override {
+    return key_;
+  }
+  string value() override {
+    return value_;
+  }
+  bool Valid() override {
+    return true;
+  }
+
+ private:
+  std::shared_ptr<ShmRing> ring_;
+  string key_;
+  string value_;
+};
+
+class ShmDBTransaction : public Transaction {
+ public:
+  explicit ShmDBTransaction(std::shared_ptr<ShmRing> ring) : ring_(ring) {}
+
+  void Put(const string& key, const string& value) override {
+    ring_->Put(key, value);
+  }
+  // Records are visible to readers as soon as they are put.
+  void Commit() override {}
+
+ private:
+  std::shared_ptr<ShmRing> ring_;
+
+  DISABLE_COPY_AND_ASSIGN(ShmDBTransaction);
+};
+
+class ShmDB : public DB {
+ public:
+  ShmDB(const string& source, Mode mode)
+      : DB(source, mode), ring_(std::make_shared<ShmRing>(source)) {
+    VLOG(1) << "Opened ShmDB " << source;
+  }
+
+  void Close() override {
+    ring_.reset();
+  }
+
+  unique_ptr<Cursor> NewCursor() override {
+    CAFFE_ENFORCE_EQ(this->mode_, READ);
+    CAFFE_ENFORCE(ring_, "ShmDB has been closed.");
+    return make_unique<ShmDBCursor>(ring_);
+  }
+
+  unique_ptr<Transaction> NewTransaction() override {
+    CAFFE_ENFORCE(this->mode_ == NEW || this->mode_ == WRITE);
+    CAFFE_ENFORCE(ring_, "ShmDB has been closed.");
+    return make_unique<ShmDBTransaction>(ring_);
+  }
+
+ private:
+  std::shared_ptr<ShmRing> ring_;
+};
+
+REGISTER_CAFFE2_DB(ShmDB, ShmDB);
+REGISTER_CAFFE2_DB(shmdb, ShmDB);
+
+} // namespace db
+} // namespace caffe2
@@ -113,6 +113,9 @@ The dimension of the output image will always be cropxcrop
          "outputs)")
     .Arg("random_scale", "[min, max] shortest-side desired for image resize. "
          "Defaults to [-1, -1] or no random resize desired.")
+    .Arg("prefetch_shared_pool", "If 1, prefetch batches on the thread pool "
+         "shared by input operators (see --caffe2_prefetch_pool_size) instead "
+         "of a thread of this operator. Defaults to 0")
     .Input(0, "reader", "The input reader (a db::DBReader)")
     .Output(0, "data", "Tensor containing the images")
     .Output(1, "label", "Tensor containing the labels")
@@ -22,6 +22,7 @@
 
 #include <iostream>
 #include <algorithm>
+#include <functional>
 
 #include "caffe/proto/caffe.pb.h"
 #include "caffe2/core/db.h"
@@ -87,9 +88,19 @@ class ImageInputOp final
     BoundingBox bounding_params;
   };
 
+  // Buffers reused by a decode thread from one image to the next, so that
+  // images of the same size do not allocate once the first one is decoded.
+  struct DecodeScratch {
+    caffe::Datum datum;
+    TensorProtos protos;
+    cv::Mat decoded;
+    cv::Mat converted;
+    cv::Mat scaled;
+  };
+
   bool GetImageAndLabelAndInfoFromDBValue(
       const string& value, cv::Mat* img, PerImageArg& info, int item_id,
-      std::mt19937* randgen);
+      std::mt19937* randgen, DecodeScratch* scratch);
   void DecodeAndTransform(
       const std::string& value, float *image_data, int item_id,
       const int channels, std::size_t thread_index);
@@ -155,6 +166,10 @@ class ImageInputOp final
 
   // Working variables
   std::vector<std::mt19937> randgen_per_thread_;
+  std::vector<DecodeScratch> scratch_per_thread_;
+  // Values of the batch being decoded, kept alive until the decode threads
+  // are done so that they are not copied into each task.
+  std::vector<std::string> batch_values_;
 };
 
 template <class Context>
@@ -377,6 +392,8 @@ ImageInputOp<Context>::ImageInputOp(
   for (int i = 0; i < num_decode_threads_; ++i) {
     randgen_per_thread_.emplace_back(meta_randgen());
   }
+  scratch_per_thread_.resize(num_decode_threads_);
+  batch_values_.resize(batch_size_);
   prefetched_image_.Resize(
       TIndex(batch_size_),
       TIndex(crop_),
@@ -399,9 +416,9 @@ template <class Context>
 bool RandomSizedCropping(
   cv::Mat* img,
   const int crop,
-  std::mt19937* randgen
+  std::mt19937* randgen,
+  cv::Mat* scaled_img
 ) {
-  cv::Mat scaled_img;
   bool inception_scale_jitter = false;
   int im_height = img->rows, im_width = img->cols;
   int area = im_height * im_width;
@@ -423,12 +440,12 @@ bool RandomSizedCropping(
       cropping = (*img)(ROI);
       cv::resize(
           cropping,
-          scaled_img,
+          *scaled_img,
           cv::Size(crop, crop),
           0,
           0,
           cv::INTER_AREA);
-      *img = scaled_img;
+      *img = *scaled_img;
       inception_scale_jitter = true;
       break;
     }
@@ -442,31 +459,38 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
     cv::Mat* img,
     PerImageArg& info,
     int item_id,
-    std::mt19937* randgen) {
+    std::mt19937* randgen,
+    DecodeScratch* scratch) {
   //
   // recommend using --caffe2_use_fatal_for_enforce=1 when using ImageInputOp
   // as this function runs on a worker thread and the exceptions from
   // CAFFE_ENFORCE are silently dropped by the thread worker functions
   //
-  cv::Mat src;
+  // Decoded in place over the previous image, so that images of the same
+  // size and type reuse its buffer.
+  cv::Mat& src = scratch->decoded;
 
   // Use the default information for images
   info = default_arg_;
   if (use_caffe_datum_) {
     // The input is a caffe datum format.
-    caffe::Datum datum;
+    caffe::Datum& datum = scratch->datum;
     CAFFE_ENFORCE(datum.ParseFromString(value));
 
     prefetched_label_.mutable_data<int>()[item_id] = datum.label();
     if (datum.encoded()) {
       // encoded image in datum.
-      src = cv::imdecode(
+      // When the buffer cannot be decoded, imdecode returns an empty Mat but
+      // may leave the previous image in src, so check what it returns.
+      const cv::Mat decoded = cv::imdecode(
           cv::Mat(
               1,
               datum.data().size(),
               CV_8UC1,
               const_cast<char*>(datum.data().data())),
-          color_ ? CV_LOAD_IMAGE_COLOR : CV_LOAD_IMAGE_GRAYSCALE);
+          color_ ? CV_LOAD_IMAGE_COLOR : CV_LOAD_IMAGE_GRAYSCALE,
+          &src);
+      CAFFE_ENFORCE(!decoded.empty(), "Failed to decode image.");
     } else {
       // Raw image in datum.
       CAFFE_ENFORCE(datum.channels() == 3 || datum.channels() == 1);
@@ -495,16 +519,12 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
     }
   } else {
     // The input is a caffe2 format.
-    TensorProtos protos;
+    TensorProtos& protos = scratch->protos;
     CAFFE_ENFORCE(protos.ParseFromString(value));
     const TensorProto& image_proto = protos.protos(0);
     const TensorProto& label_proto = protos.protos(1);
-    vector<TensorProto> additional_output_protos;
     int start = additional_inputs_offset_;
     int end = start + additional_inputs_count_;
-    for (int i = start; i < end; ++i) {
-      additional_output_protos.push_back(protos.protos(i));
-    }
 
     if (protos.protos_size() == end + 1) {
       // We have bounding box information
@@ -524,13 +544,15 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
       const string& encoded_image_str = image_proto.string_data(0);
       int encoded_size = encoded_image_str.size();
       // We use a cv::Mat to wrap the encoded str so we do not need a copy.
-      src = cv::imdecode(
+      const cv::Mat decoded = cv::imdecode(
           cv::Mat(
               1,
               &encoded_size,
               CV_8UC1,
               const_cast<char*>(encoded_image_str.data())),
-          color_ ? CV_LOAD_IMAGE_COLOR : CV_LOAD_IMAGE_GRAYSCALE);
+          color_ ? CV_LOAD_IMAGE_COLOR : CV_LOAD_IMAGE_GRAYSCALE,
+          &src);
+      CAFFE_ENFORCE(!decoded.empty(), "Failed to decode image.");
     } else if (image_proto.data_type() == TensorProto::BYTE) {
       // raw image content.
       int src_c = (image_proto.dims_size() == 3) ? image_proto.dims(2) : 1;
@@ -613,8 +635,8 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
       LOG(FATAL) << "Unsupported label data type.";
     }
 
-    for (int i = 0; i < additional_output_protos.size(); ++i) {
-      auto additional_output_proto = additional_output_protos[i];
+    for (int i = 0; i < additional_inputs_count_; ++i) {
+      const TensorProto& additional_output_proto = protos.protos(start + i);
 
       if (additional_output_proto.data_type() == TensorProto::FLOAT) {
         float* additional_output =
@@ -654,7 +676,9 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
   if (out_c == src.channels()) {
     *img = src;
   } else {
-    cv::cvtColor(src, *img, (out_c == 1) ? CV_BGR2GRAY : CV_GRAY2BGR);
+    cv::cvtColor(
+        src, scratch->converted, (out_c == 1) ? CV_BGR2GRAY : CV_GRAY2BGR);
+    *img = scratch->converted;
   }
 
   // Note(Yangqing): I believe that the mat should be created continuous.
@@ -688,12 +712,13 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
     // LOG(INFO) << "No bounding\n";
   }
 
-  cv::Mat scaled_img;
+  cv::Mat& scaled_img = scratch->scaled;
   bool inception_scale_jitter = false;
   if (scale_jitter_type_ == INCEPTION_STYLE) {
     if (!is_test_) {
       // Inception-stype scale jittering is only used for training
-      inception_scale_jitter = RandomSizedCropping<Context>(img, crop_, randgen);
+      inception_scale_jitter =
+          RandomSizedCropping<Context>(img, crop_, randgen, &scaled_img);
       // if a random crop is still not found, do simple random cropping later
     }
   }
@@ -904,6 +929,51 @@ void ColorNormalization(
   }
 }
 
+// Copies the crop x crop window at (height_offset, width_offset) to image_data
+// in HWC order, mirrored horizontally if requested. With mean and std (the
+// inverse std, as in ColorNormalization) every pixel is also normalized on
+// the way, so that the output is written in a single pass.
+template <class Context>
+void CropAndNormalize(
+    const cv::Mat& scaled_img,
+    const int channels,
+    float* image_data,
+    const int crop,
+    const int height_offset,
+    const int width_offset,
+    const bool mirror_image,
+    const float* mean,
+    const float* std) {
+  const float kZero[3] = {0.f, 0.f, 0.f};
+  const float kOne[3] = {1.f, 1.f, 1.f};
+  if (!mean) {
+    mean = kZero;
+    std = kOne;
+  }
+  // Walk each row right to left when mirroring.
+  const int first_col = mirror_image ? width_offset + crop - 1 : width_offset;
+  const int step = mirror_image ? -channels : channels;
+  float* image_data_ptr = image_data;
+  for (int h = height_offset; h < height_offset + crop; ++h) {
+    const uint8_t* cv_data = scaled_img.ptr(h) + first_col * channels;
+    if (channels == 3) {
+      for (int w = 0; w < crop; ++w, cv_data += step) {
+        image_data_ptr[0] = (static_cast<float>(cv_data[0]) - mean[0]) * std[0];
+        image_data_ptr[1] = (static_cast<float>(cv_data[1]) - mean[1]) * std[1];
+        image_data_ptr[2] = (static_cast<float>(cv_data[2]) - mean[2]) * std[2];
+        image_data_ptr += 3;
+      }
+    } else {
+      for (int w = 0; w < crop; ++w, cv_data += step) {
+        for (int c = 0; c < channels; ++c) {
+          *(image_data_ptr++) =
+              (static_cast<float>(cv_data[c]) - mean[c]) * std[c];
+        }
+      }
+    }
+  }
+}
+
 // Factored out image transformation
 template <class Context>
 void TransformImage(
@@ -942,41 +1012,38 @@ void TransformImage(
       std::uniform_int_distribution<>(0, scaled_img.rows - crop)(*randgen);
   }
 
-  float* image_data_ptr = image_data;
-  if (!is_test && mirror && (*mirror_this_image)(*randgen)) {
-    // Copy mirrored image.
-    for (int h = height_offset; h < height_offset + crop; ++h) {
-      for (int w = width_offset + crop - 1; w >= width_offset; --w) {
-        const uint8_t* cv_data = scaled_img.ptr(h) + w * channels;
-        for (int c = 0; c < channels; ++c) {
-          *(image_data_ptr++) = static_cast<float>(cv_data[c]);
-        }
-      }
-    }
-  } else {
-    // Copy normally.
-    for (int h = height_offset; h < height_offset + crop; ++h) {
-      for (int w = width_offset; w < width_offset + crop; ++w) {
-        const uint8_t* cv_data = scaled_img.ptr(h) + w * channels;
-        for (int c = 0; c < channels; ++c) {
-          *(image_data_ptr++) = static_cast<float>(cv_data[c]);
-        }
-      }
-    }
-  }
-
-  if (color_jitter && channels == 3 && !is_test) {
+  const bool mirror_image =
+      !is_test && mirror && (*mirror_this_image)(*randgen);
+  const bool jitter = color_jitter && channels == 3 && !is_test;
+  const bool lighting = color_lighting && channels == 3 && !is_test;
+  // Color jitter and lighting work on unnormalized pixels, so normalization
+  // can only be fused into the copy when neither of them is applied.
+  const bool fuse_normalization = !jitter && !lighting;
+  CropAndNormalize<Context>(
+      scaled_img,
+      channels,
+      image_data,
+      crop,
+      height_offset,
+      width_offset,
+      mirror_image,
+      fuse_normalization ? mean.data() : nullptr,
+      fuse_normalization ? std.data() : nullptr);
+
+  if (jitter) {
     ColorJitter<Context>(image_data, crop, saturation, brightness, contrast,
       randgen);
   }
-  if (color_lighting && channels == 3 && !is_test) {
+  if (lighting) {
     ColorLighting<Context>(image_data, crop, color_lighting_std,
       color_lighting_eigvecs, color_lighting_eigvals, randgen);
   }
 
-  // Color normalization
-  // Mean subtraction and scaling.
-  ColorNormalization<Context>(image_data, crop, channels, mean, std);
+  if (!fuse_normalization) {
+    // Color normalization
+    // Mean subtraction and scaling.
+    ColorNormalization<Context>(image_data, crop, channels, mean, std);
+  }
 }
 
 // Only crop / transose the image
@@ -1043,7 +1110,7 @@ void ImageInputOp<Context>::DecodeAndTransform(
   // Decode the image
   PerImageArg info;
   CHECK(GetImageAndLabelAndInfoFromDBValue(value, &img, info, item_id,
-    randgen));
+    randgen, &scratch_per_thread_[thread_index]));
 
   // Factor out the image transformation
   TransformImage<Context>(img, channels, image_data,
@@ -1067,7 +1134,7 @@ void ImageInputOp<Context>::DecodeAndTransposeOnly(
   // Decode the image
   PerImageArg info;
   CHECK(GetImageAndLabelAndInfoFromDBValue(value, &img, info, item_id,
-    randgen));
+    randgen, &scratch_per_thread_[thread_index]));
 
   // Factor out the image transformation
   CropTransposeImage<Context>(img, channels, image_data, crop_, mirror_,
@@ -1095,11 +1162,11 @@ bool ImageInputOp<Context>::Prefetch() {
   prefetched_label_.mutable_data<int>();
   // Prefetching handled with a thread pool of "decode_threads" threads.
 
+  std::string key;
   for (int item_id = 0; item_id < batch_size_; ++item_id) {
-    std::string key, value;
-    cv::Mat img;
-
-    // read data
+    // read data. The decode tasks refer to the value in batch_values_, whose
+    // storage is reused from batch to batch.
+    std::string& value = batch_values_[item_id];
     reader_->Read(&key, &value);
 
     // determine label type based on first item
@@ -1146,7 +1213,7 @@ bool ImageInputOp<Context>::Prefetch() {
       thread_pool_->runTaskWithID(std::bind(
           &ImageInputOp<Context>::DecodeAndTransposeOnly,
           this,
-          std::string(value),
+          std::cref(value),
           image_data,
           item_id,
           channels,
@@ -1157,7 +1224,7 @@ bool ImageInputOp<Context>::Prefetch() {
       thread_pool_->runTaskWithID(std::bind(
           &ImageInputOp<Context>::DecodeAndTransform,
           this,
-          std::string(value),
+          std::cref(value),
           image_data,
           item_id,
           channels,
@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "caffe2/core/context.h"
+#include "caffe2/image/image_input_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+cv::Mat RandomImage(int height, int width, int channels, std::mt19937* gen) {
+  cv::Mat img(height, width, channels == 3 ? CV_8UC3 : CV_8UC1);
+  std::uniform_int_distribution<int> dist(0, 255);
+  for (int h = 0; h < height; ++h) {
+    uint8_t* row = img.ptr(h);
+    for (int i = 0; i < width * channels; ++i) {
+      row[i] = dist(*gen);
+    }
+  }
+  return img;
+}
+
+// Crops, mirrors and normalizes one pixel at a time.
+std::vector<float> ReferenceCrop(
+    const cv::Mat& img,
+    int channels,
+    int crop,
+    int height_offset,
+    int width_offset,
+    bool mirror,
+    const std::vector<float>& mean,
+    const std::vector<float>& std) {
+  std::vector<float> out;
+  for (int h = height_offset; h < height_offset + crop; ++h) {
+    for (int i = 0; i < crop; ++i) {
+      const int w = mirror ? width_offset + crop - 1 - i : width_offset + i;
+      for (int c = 0; c < channels; ++c) {
+        const float pixel = img.ptr(h)[w * channels + c];
+        out.push_back((pixel - mean[c]) * std[c]);
+      }
+    }
+  }
+  return out;
+}
+
+} // namespace
+
+TEST(ImageInputOpTest, CropAndNormalize) {
+  std::mt19937 gen(1701);
+  const std::vector<float> mean{104.f, 117.f, 123.f};
+  const std::vector<float> std{1.f / 58.f, 1.f / 57.f, 1.f / 59.f};
+  const std::vector<float> identity_mean(3, 0.f);
+  const std::vector<float> identity_std(3, 1.f);
+  const int crop = 5;
+  for (const int channels : {1, 3}) {
+    const auto img = RandomImage(9, 11, channels, &gen);
+    for (const bool mirror : {false, true}) {
+      std::vector<float> out(crop * crop * channels);
+      CropAndNormalize<CPUContext>(
+          img, channels, out.data(), crop, 3, 2, mirror, mean.data(),
+          std.data());
+      const auto expected =
+          ReferenceCrop(img, channels, crop, 3, 2, mirror, mean, std);
+      for (int i = 0; i < out.size(); ++i) {
+        EXPECT_FLOAT_EQ(expected[i], out[i]) << i;
+      }
+
+      // Without mean and std the pixels are only copied.
+      CropAndNormalize<CPUContext>(
+          img, channels, out.data(), crop, 3, 2, mirror, nullptr, nullptr);
+      const auto copied = ReferenceCrop(
+          img, channels, crop, 3, 2, mirror, identity_mean, identity_std);
+      for (int i = 0; i < out.size(); ++i) {
+        EXPECT_EQ(copied[i], out[i]) << i;
+      }
+    }
+  }
+}
+
+TEST(ImageInputOpTest, TransformImageWithoutJitter) {
+  std::mt19937 gen(1701);
+  const std::vector<float> mean{104.f, 117.f, 123.f};
+  const std::vector<float> std{1.f / 58.f, 1.f / 57.f, 1.f / 59.f};
+  const int crop = 4;
+  const auto img = RandomImage(8, 10, 3, &gen);
+  std::bernoulli_distribution mirror_this_image(0.5f);
+  std::vector<float> out(crop * crop * 3);
+  // In test mode the crop is centered, never mirrored and never jittered, so
+  // normalization is fused into the copy.
+  TransformImage<CPUContext>(
+      img, 3, out.data(), true, 0.4f, 0.4f, 0.4f, true, 0.1f, {}, {}, crop,
+      true, mean, std, &gen, &mirror_this_image, true /* is_test */);
+  const auto expected = ReferenceCrop(img, 3, crop, 2, 3, false, mean, std);
+  for (int i = 0; i < out.size(); ++i) {
+    EXPECT_FLOAT_EQ(expected[i], out[i]) << i;
+  }
+}
+
+} // namespace caffe2
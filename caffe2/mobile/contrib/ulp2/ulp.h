@@ -32,7 +32,8 @@ struct ConvArgs {
   int pad_r{0};
 };
 
-using ParallelFor = std::function<void(size_t, std::function<void(size_t)>)>;
+using QConvParallelFor =
+    std::function<void(size_t, std::function<void(size_t)>)>;
 
 struct QConvState {
   std::vector<std::unique_ptr<TensorCPU>> XQs;
@@ -48,7 +49,7 @@ struct QConvState {
 
   std::unique_ptr<TensorCPU> bias;
 
-  ParallelFor parallelFor{nullptr};
+  QConvParallelFor parallelFor{nullptr};
 };
 
 void uniformQuantize2b1b(const TensorCPU& X,
@@ -0,0 +1,380 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/core/types.h"
+#include "caffe2/operators/dataset_ops.h"
+#include "caffe2/utils/mapped_file.h"
+
+namespace caffe2 {
+namespace dataset_ops {
+
+// A columnar dataset stores the fields of a dataset, i.e. the tensors walked
+// by a TreeCursor, in a single file that can be memory-mapped for reading.
+// Each field is stored contiguously, starting at a multiple of
+// kColumnarAlignment, so that OpenColumnarDataset can output CPU tensors that
+// alias the mapping. ReadNextBatch and ReadRandomBatch then only fault in the
+// pages of the rows they read, and datasets larger than RAM can be used
+// without loading them into the workspace first.
+//
+// The file starts with a header:
+//   char[8] magic, uint32 version, uint32 number of columns
+// followed by one directory entry per column:
+//   uint32 name length, int32 data type (TensorProto::DataType),
+//   uint32 number of dims, uint32 reserved,
+//   uint64 absolute data offset, uint64 data length in bytes,
+//   int64 dims[number of dims], name bytes.
+// The column data follows the directory.
+//
+// Optionally the file also stores the matrix of offsets computed by
+// ComputeOffset as an int64 column named kColumnarOffsetsName, so that
+// ReadRandomBatch does not need to walk the lengths of the whole dataset
+// before reading the first batch.
+
+namespace {
+constexpr char kColumnarMagic[8] = {'C', '2', 'C', 'O', 'L', 'D', 'S', '1'};
+constexpr uint32_t kColumnarVersion = 1;
+constexpr uint64_t kColumnarAlignment = 64;
+constexpr size_t kColumnarHeaderSize =
+    sizeof(kColumnarMagic) + 2 * sizeof(uint32_t);
+constexpr size_t kColumnarEntryHeaderSize =
+    4 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+const char kColumnarOffsetsName[] = "__record_offsets__";
+
+static_assert(
+    kColumnarAlignment % gCaffe2Alignment == 0,
+    "Columnar dataset alignment has to be a multiple of the Caffe2 alignment.");
+
+template <typename T>
+T ReadAt(const char* data, size_t offset) {
+  T value;
+  memcpy(&value, data + offset, sizeof(T));
+  return value;
+}
+
+template <typename T>
+void Write(FILE* file, T value) {
+  CAFFE_ENFORCE_EQ(fwrite(&value, sizeof(T), 1, file), 1);
+}
+
+uint64_t AlignUp(uint64_t offset) {
+  return (offset + kColumnarAlignment - 1) / kColumnarAlignment *
+      kColumnarAlignment;
+}
+
+struct ColumnEntry {
+  std::string name;
+  TensorProto::DataType dataType;
+  std::vector<TIndex> dims;
+  uint64_t dataOffset;
+  uint64_t dataBytes;
+};
+
+void WriteColumnarFile(
+    const std::string& path,
+    const std::vector<std::string>& names,
+    const std::vector<const TensorCPU*>& columns) {
+  std::vector<ColumnEntry> entries(columns.size());
+  uint64_t offset = kColumnarHeaderSize;
+  for (int i = 0; i < columns.size(); ++i) {
+    const auto& column = *columns[i];
+    auto& entry = entries[i];
+    CAFFE_ENFORCE(
+        column.meta().copy() == nullptr,
+        "Columnar datasets only support fields of fundamental types, ",
+        names[i],
+        " has type ",
+        column.meta().name());
+    entry.name = names[i];
+    entry.dataType = TypeMetaToDataType(column.meta());
+    CAFFE_ENFORCE_NE(
+        entry.dataType,
+        TensorProto_DataType_UNDEFINED,
+        "Unsupported type for field ",
+        names[i]);
+    entry.dims = column.dims();
+    entry.dataBytes = column.nbytes();
+    offset += kColumnarEntryHeaderSize + entry.dims.size() * sizeof(int64_t) +
+        entry.name.size();
+  }
+  for (auto& entry : entries) {
+    entry.dataOffset = AlignUp(offset);
+    offset = entry.dataOffset + entry.dataBytes;
+  }
+
+  std::unique_ptr<FILE, int (*)(FILE*)> file(
+      fopen(path.c_str(), "wb"), &fclose);
+  CAFFE_ENFORCE(file, "Cannot open file: ", path);
+  CAFFE_ENFORCE_EQ(
+      fwrite(kColumnarMagic, sizeof(char), sizeof(kColumnarMagic), file.get()),
+      sizeof(kColumnarMagic));
+  Write<uint32_t>(file.get(), kColumnarVersion);
+  Write<uint32_t>(file.get(), entries.size());
+  for (const auto& entry : entries) {
+    Write<uint32_t>(file.get(), entry.name.size());
+    Write<int32_t>(file.get(), entry.dataType);
+    Write<uint32_t>(file.get(), entry.dims.size());
+    Write<uint32_t>(file.get(), 0);
+    Write<uint64_t>(file.get(), entry.dataOffset);
+    Write<uint64_t>(file.get(), entry.dataBytes);
+    for (const auto d : entry.dims) {
+      Write<int64_t>(file.get(), d);
+    }
+    CAFFE_ENFORCE_EQ(
+        fwrite(entry.name.data(), sizeof(char), entry.name.size(), file.get()),
+        entry.name.size());
+  }
+  static const char kZeros[kColumnarAlignment] = {0};
+  uint64_t written = ftell(file.get());
+  for (int i = 0; i < entries.size(); ++i) {
+    const size_t padding = entries[i].dataOffset - written;
+    CAFFE_ENFORCE_EQ(
+        fwrite(kZeros, sizeof(char), padding, file.get()), padding);
+    CAFFE_ENFORCE_EQ(
+        fwrite(columns[i]->raw_data(), 1, entries[i].dataBytes, file.get()),
+        entries[i].dataBytes);
+    written = entries[i].dataOffset + entries[i].dataBytes;
+  }
+  CAFFE_ENFORCE_EQ(fclose(file.release()), 0, "Cannot write file: ", path);
+}
+
+std::vector<ColumnEntry> ReadColumnarDirectory(
+    const MappedFile& file,
+    const std::string& path) {
+  const char* data = file.data();
+  const size_t size = file.size();
+  CAFFE_ENFORCE(
+      size >= kColumnarHeaderSize &&
+          memcmp(data, kColumnarMagic, sizeof(kColumnarMagic)) == 0,
+      "Not a columnar dataset file: ",
+      path);
+  CAFFE_ENFORCE_EQ(
+      ReadAt<uint32_t>(data, sizeof(kColumnarMagic)),
+      kColumnarVersion,
+      "Unsupported columnar dataset version in ",
+      path);
+  const uint32_t numColumns =
+      ReadAt<uint32_t>(data, sizeof(kColumnarMagic) + sizeof(uint32_t));
+  std::vector<ColumnEntry> entries(numColumns);
+  size_t offset = kColumnarHeaderSize;
+  for (auto& entry : entries) {
+    CAFFE_ENFORCE_LE(
+        offset + kColumnarEntryHeaderSize, size, "Truncated file: ", path);
+    const uint32_t nameLength = ReadAt<uint32_t>(data, offset);
+    entry.dataType = static_cast<TensorProto::DataType>(
+        ReadAt<int32_t>(data, offset + sizeof(uint32_t)));
+    const uint32_t ndim = ReadAt<uint32_t>(data, offset + 2 * sizeof(uint32_t));
+    entry.dataOffset = ReadAt<uint64_t>(data, offset + 4 * sizeof(uint32_t));
+    entry.dataBytes = ReadAt<uint64_t>(
+        data, offset + 4 * sizeof(uint32_t) + sizeof(uint64_t));
+    offset += kColumnarEntryHeaderSize;
+    CAFFE_ENFORCE_LE(
+        offset + ndim * sizeof(int64_t) + nameLength,
+        size,
+        "Truncated file: ",
+        path);
+    for (int d = 0; d < ndim; ++d) {
+      entry.dims.push_back(ReadAt<int64_t>(data, offset));
+      offset += sizeof(int64_t);
+    }
+    entry.name.assign(data + offset, nameLength);
+    offset += nameLength;
+    CAFFE_ENFORCE(
+        entry.dataOffset % kColumnarAlignment == 0 &&
+            entry.dataOffset + entry.dataBytes <= size,
+        "Corrupted column ",
+        entry.name,
+        " in ",
+        path);
+  }
+  return entries;
+}
+} // namespace
+
+class WriteColumnarDatasetOp : public Operator<CPUContext> {
+ public:
+  WriteColumnarDatasetOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator(operator_def, ws),
+        path_(GetSingleArgument<std::string>("path", "")),
+        writeOffsets_(GetSingleArgument<bool>("write_offsets", true)) {
+    CAFFE_ENFORCE(!path_.empty(), "Must specify the path argument.");
+  }
+
+  bool RunOnDevice() override {
+    auto& cursor = OperatorBase::Input<std::unique_ptr<TreeCursor>>(0);
+    CAFFE_ENFORCE_EQ(InputSize(), cursor->it.fields().size() + 1);
+    std::vector<std::string> names;
+    std::vector<const TensorCPU*> columns;
+    for (int i = 1; i < InputSize(); ++i) {
+      names.push_back(cursor->it.fields()[i - 1].name);
+      columns.push_back(&Input(i));
+      CAFFE_ENFORCE_NE(
+          names.back(),
+          kColumnarOffsetsName,
+          "Field name is reserved: ",
+          names.back());
+      CAFFE_ENFORCE_GE(
+          columns.back()->ndim(), 1, "Field ", names.back(), " is a scalar.");
+    }
+    TensorCPU offsets;
+    if (writeOffsets_) {
+      // Computed from the first record, without moving the cursor.
+      std::vector<TOffset> start;
+      ComputeRecordOffsets(cursor->it, columns, &start, &offsets);
+      names.push_back(kColumnarOffsetsName);
+      columns.push_back(&offsets);
+    }
+    WriteColumnarFile(path_, names, columns);
+    return true;
+  }
+
+ private:
+  std::string path_;
+  bool writeOffsets_;
+};
+
+class OpenColumnarDatasetOp : public Operator<CPUContext> {
+ public:
+  OpenColumnarDatasetOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator(operator_def, ws),
+        path_(GetSingleArgument<std::string>("path", "")),
+        fields_(GetRepeatedArgument<std::string>("fields")),
+        randomAccess_(GetSingleArgument<bool>("random_access", false)) {
+    CAFFE_ENFORCE(!path_.empty(), "Must specify the path argument.");
+  }
+
+  bool RunOnDevice() override {
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(path_);
+    if (randomAccess_) {
+      file->AdviseRandomAccess();
+    }
+    auto entries = ReadColumnarDirectory(*file, path_);
+    const ColumnEntry* offsets = nullptr;
+    if (!entries.empty() && entries.back().name == kColumnarOffsetsName) {
+      offsets = &entries.back();
+    }
+    const int numFields = entries.size() - (offsets ? 1 : 0);
+    CAFFE_ENFORCE(
+        OutputSize() == numFields ||
+            (offsets && OutputSize() == numFields + 1),
+        "Expected ",
+        numFields,
+        " outputs for the fields of ",
+        path_,
+        offsets ? " plus optionally one for the offsets" : "",
+        ", got ",
+        OutputSize());
+    if (!fields_.empty()) {
+      CAFFE_ENFORCE_EQ(fields_.size(), numFields);
+      for (int i = 0; i < numFields; ++i) {
+        CAFFE_ENFORCE_EQ(
+            fields_[i],
+            entries[i].name,
+            "Field ",
+            i,
+            " of ",
+            path_,
+            " does not match.");
+      }
+    }
+    for (int i = 0; i < OutputSize(); ++i) {
+      const auto& entry = i < numFields ? entries[i] : *offsets;
+      const TypeMeta meta = DataTypeToTypeMeta(entry.dataType);
+      auto* output = Output(i);
+      output->Resize(entry.dims);
+      CAFFE_ENFORCE_EQ(
+          output->size() * meta.itemsize(),
+          entry.dataBytes,
+          "Corrupted column ",
+          entry.name,
+          " in ",
+          path_);
+      // The tensors keep the mapping alive until the last of them is gone.
+      // They are read-only: writing to them faults.
+      output->ShareExternalPointer(
+          const_cast<char*>(file->data()) + entry.dataOffset,
+          meta,
+          entry.dataBytes,
+          [file](void*) {});
+    }
+    return true;
+  }
+
+ private:
+  std::string path_;
+  std::vector<std::string> fields_;
+  bool randomAccess_;
+};
+
+REGISTER_CPU_OPERATOR(WriteColumnarDataset, WriteColumnarDatasetOp);
+REGISTER_CPU_OPERATOR(OpenColumnarDataset, OpenColumnarDatasetOp);
+
+OPERATOR_SCHEMA(WriteColumnarDataset)
+    .NumInputs(2, INT_MAX)
+    .NumOutputs(0)
+    .SetDoc(R"DOC(
+Writes the fields of a dataset to a single file in a columnar format that
+OpenColumnarDataset can memory-map. Each field is stored contiguously with its
+shape and type, and the file records the field names of the cursor so that
+they can be checked when the dataset is opened. Only fields of fundamental
+types are supported.
+
+Unless write_offsets is false, the matrix of record offsets that ComputeOffset
+would output for these fields is computed once and stored in the file too.
+)DOC")
+    .Arg("path", "Path of the file to write.")
+    .Arg(
+        "write_offsets",
+        "Whether to store the record offsets used by ReadRandomBatch "
+        "(default true).")
+    .Input(0, "cursor", "A Cursor created by CreateTreeCursor for the fields.")
+    .Input(1, "dataset_field_0", "First dataset field");
+
+OPERATOR_SCHEMA(OpenColumnarDataset)
+    .NumInputs(0)
+    .NumOutputs(1, INT_MAX)
+    .SetDoc(R"DOC(
+Opens a dataset written by WriteColumnarDataset. The file is memory-mapped and
+each output is a CPU tensor that aliases the data of a field in the mapping,
+so nothing is read from disk until the tensors are accessed, e.g. by
+ReadNextBatch or ReadRandomBatch. The mapping is read-only, so the outputs
+must not be modified in place; copy them first if needed.
+
+If the file stores record offsets, an additional last output can be requested
+to get them; it can be passed to ReadRandomBatch in place of the output of
+ComputeOffset.
+)DOC")
+    .Arg("path", "Path of the file to open.")
+    .Arg(
+        "fields",
+        "Optional list of field names, checked against the names stored in "
+        "the file.")
+    .Arg(
+        "random_access",
+        "Hint that the dataset will be read at random rows, which disables "
+        "read-ahead on the mapping (default false).")
+    .Output(0, "dataset_field_0", "First dataset field");
+
+NO_GRADIENT(WriteColumnarDataset);
+NO_GRADIENT(OpenColumnarDataset);
+
+} // namespace dataset_ops
+} // namespace caffe2
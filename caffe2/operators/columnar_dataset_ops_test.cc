@@ -0,0 +1,161 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/proto_utils.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+namespace {
+
+template <typename T>
+void FillTensor(Workspace* ws, const string& name, const vector<T>& values) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(values.size());
+  std::copy(values.begin(), values.end(), tensor->mutable_data<T>());
+}
+
+template <typename T>
+vector<T> GetTensor(Workspace* ws, const string& name) {
+  const auto& tensor = ws->GetBlob(name)->Get<TensorCPU>();
+  return vector<T>(tensor.data<T>(), tensor.data<T>() + tensor.size());
+}
+
+void RunOp(Workspace* ws, const OperatorDef& def) {
+  auto op = CreateOperator(def, ws);
+  ASSERT_TRUE(op->Run());
+}
+
+// Writes a dataset of three records with 2, 0 and 3 float values each.
+class ColumnarDatasetTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = std::tmpnam(nullptr);
+    Argument fields = MakeArgument<vector<string>>(
+        "fields", vector<string>{"a:lengths", "a:values"});
+    RunOp(
+        &ws_,
+        CreateOperatorDef("CreateTreeCursor", "", {}, {"cursor"}, {fields}));
+    FillTensor<int>(&ws_, "lengths", {2, 0, 3});
+    FillTensor<float>(&ws_, "values", {1, 2, 3, 4, 5});
+    RunOp(
+        &ws_,
+        CreateOperatorDef(
+            "WriteColumnarDataset",
+            "",
+            {"cursor", "lengths", "values"},
+            {},
+            {MakeArgument<string>("path", path_)}));
+  }
+
+  void TearDown() override {
+    std::remove(path_.c_str());
+  }
+
+  OperatorDef OpenDef(const vector<string>& outputs) {
+    return CreateOperatorDef(
+        "OpenColumnarDataset",
+        "",
+        {},
+        outputs,
+        {MakeArgument<string>("path", path_)});
+  }
+
+  Workspace ws_;
+  string path_;
+};
+
+TEST_F(ColumnarDatasetTest, OpenReturnsFieldsAndOffsets) {
+  RunOp(&ws_, OpenDef({"mapped_lengths", "mapped_values", "mapped_offsets"}));
+  EXPECT_EQ(GetTensor<int>(&ws_, "mapped_lengths"), (vector<int>{2, 0, 3}));
+  EXPECT_EQ(
+      GetTensor<float>(&ws_, "mapped_values"),
+      (vector<float>{1, 2, 3, 4, 5}));
+
+  RunOp(
+      &ws_,
+      CreateOperatorDef(
+          "ComputeOffset",
+          "",
+          {"cursor", "lengths", "values"},
+          {"offsets"}));
+  const auto& offsets = ws_.GetBlob("offsets")->Get<TensorCPU>();
+  const auto& mapped = ws_.GetBlob("mapped_offsets")->Get<TensorCPU>();
+  EXPECT_EQ(mapped.dims(), offsets.dims());
+  EXPECT_EQ(
+      GetTensor<int64_t>(&ws_, "mapped_offsets"),
+      GetTensor<int64_t>(&ws_, "offsets"));
+}
+
+TEST_F(ColumnarDatasetTest, OutputsOutliveOperator) {
+  RunOp(&ws_, OpenDef({"mapped_lengths", "mapped_values"}));
+  // The operator and its mapping handle are gone, the tensors still work.
+  std::remove(path_.c_str());
+  EXPECT_EQ(
+      GetTensor<float>(&ws_, "mapped_values"),
+      (vector<float>{1, 2, 3, 4, 5}));
+}
+
+TEST_F(ColumnarDatasetTest, ReadRandomBatchFromMappedDataset) {
+  RunOp(&ws_, OpenDef({"mapped_lengths", "mapped_values", "mapped_offsets"}));
+  FillTensor<int64_t>(&ws_, "idx", {2, 0, 1});
+  RunOp(
+      &ws_,
+      CreateOperatorDef(
+          "ReadRandomBatch",
+          "",
+          {"cursor",
+           "idx",
+           "mapped_offsets",
+           "mapped_lengths",
+           "mapped_values"},
+          {"batch_lengths", "batch_values"},
+          {MakeArgument<int>("batch_size", 2)}));
+  EXPECT_EQ(GetTensor<int>(&ws_, "batch_lengths"), (vector<int>{3, 2}));
+  EXPECT_EQ(
+      GetTensor<float>(&ws_, "batch_values"),
+      (vector<float>{3, 4, 5, 1, 2}));
+}
+
+TEST_F(ColumnarDatasetTest, ChecksFieldNamesAndOutputs) {
+  auto def = OpenDef({"mapped_lengths", "mapped_values"});
+  def.add_arg()->CopyFrom(MakeArgument<vector<string>>(
+      "fields", vector<string>{"a:lengths", "b:values"}));
+  EXPECT_THROW(RunOp(&ws_, def), EnforceNotMet);
+  EXPECT_THROW(RunOp(&ws_, OpenDef({"mapped_lengths"})), EnforceNotMet);
+}
+
+TEST_F(ColumnarDatasetTest, WithoutOffsets) {
+  RunOp(
+      &ws_,
+      CreateOperatorDef(
+          "WriteColumnarDataset",
+          "",
+          {"cursor", "lengths", "values"},
+          {},
+          {MakeArgument<string>("path", path_),
+           MakeArgument<bool>("write_offsets", false)}));
+  EXPECT_THROW(
+      RunOp(&ws_, OpenDef({"mapped_lengths", "mapped_values", "offsets"})),
+      EnforceNotMet);
+  RunOp(&ws_, OpenDef({"mapped_lengths", "mapped_values"}));
+  EXPECT_EQ(GetTensor<int>(&ws_, "mapped_lengths"), (vector<int>{2, 0, 3}));
+}
+
+} // namespace
+} // namespace caffe2
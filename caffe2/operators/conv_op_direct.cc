@@ -0,0 +1,340 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/operators/conv_pool_op_base.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+namespace {
+
+// Number of output channels and of output columns accumulated together.
+constexpr int kBlockM = 8;
+constexpr int kTileW = 4;
+
+struct DirectConvShape {
+  int C, H, W;
+  int KH, KW;
+  int SH, SW;
+  int DH, DW;
+  int PT, PL;
+  int OH, OW;
+};
+
+// Computes kTileW consecutive output columns of row oh for a block of
+// kBlockM output channels, keeping the sums in registers. All taps of these
+// columns must be inside the image horizontally. w is a block of filters
+// packed as [C][KH][KW][kBlockM].
+template <bool kUnitStride>
+void DirectConvTile(
+    const DirectConvShape& s,
+    const float* X,
+    const float* w,
+    const float* bias,
+    int oh,
+    int ow,
+    int mb,
+    float* const* y) {
+  float acc[kBlockM][kTileW];
+  for (int mi = 0; mi < kBlockM; ++mi) {
+    for (int j = 0; j < kTileW; ++j) {
+      acc[mi][j] = bias[mi];
+    }
+  }
+  const int ih0 = oh * s.SH - s.PT;
+  const int iw0 = ow * s.SW - s.PL;
+  for (int c = 0; c < s.C; ++c) {
+    for (int kh = 0; kh < s.KH; ++kh) {
+      const int ih = ih0 + kh * s.DH;
+      if (ih < 0 || ih >= s.H) {
+        continue;
+      }
+      const float* x_row = X + (c * s.H + ih) * s.W + iw0;
+      const float* w_row = w + (c * s.KH + kh) * s.KW * kBlockM;
+      for (int kw = 0; kw < s.KW; ++kw) {
+        const float* x = x_row + kw * s.DW;
+        const float* wk = w_row + kw * kBlockM;
+        float xv[kTileW];
+        for (int j = 0; j < kTileW; ++j) {
+          xv[j] = x[kUnitStride ? j : j * s.SW];
+        }
+        for (int mi = 0; mi < kBlockM; ++mi) {
+          for (int j = 0; j < kTileW; ++j) {
+            acc[mi][j] += wk[mi] * xv[j];
+          }
+        }
+      }
+    }
+  }
+  for (int mi = 0; mi < mb; ++mi) {
+    std::copy(acc[mi], acc[mi] + kTileW, y[mi] + ow);
+  }
+}
+
+// Computes a single output column, checking every tap against the image
+// borders.
+void DirectConvColumn(
+    const DirectConvShape& s,
+    const float* X,
+    const float* w,
+    const float* bias,
+    int oh,
+    int ow,
+    int mb,
+    float* const* y) {
+  float acc[kBlockM];
+  std::copy(bias, bias + kBlockM, acc);
+  const int ih0 = oh * s.SH - s.PT;
+  const int iw0 = ow * s.SW - s.PL;
+  for (int c = 0; c < s.C; ++c) {
+    for (int kh = 0; kh < s.KH; ++kh) {
+      const int ih = ih0 + kh * s.DH;
+      if (ih < 0 || ih >= s.H) {
+        continue;
+      }
+      const float* x_row = X + (c * s.H + ih) * s.W;
+      const float* w_row = w + (c * s.KH + kh) * s.KW * kBlockM;
+      for (int kw = 0; kw < s.KW; ++kw) {
+        const int iw = iw0 + kw * s.DW;
+        if (iw < 0 || iw >= s.W) {
+          continue;
+        }
+        for (int mi = 0; mi < kBlockM; ++mi) {
+          acc[mi] += w_row[kw * kBlockM + mi] * x_row[iw];
+        }
+      }
+    }
+  }
+  for (int mi = 0; mi < mb; ++mi) {
+    y[mi][ow] = acc[mi];
+  }
+}
+
+} // namespace
+
+// Direct 2D convolution in NCHW order that accumulates straight into the
+// output instead of materializing an im2col buffer, meant for the small
+// kernels where the im2col copy costs as much as the multiplication.
+//
+// Filters are packed in blocks of kBlockM output channels. Each output row
+// is computed for all blocks in turn, so the input rows feeding it stay in
+// cache, and kTileW output columns of a block are accumulated in registers.
+// Columns whose taps fall in the padding are computed one at a time. 1x1
+// convolutions with unit strides and no padding are computed as one GEMM per
+// image and group. Filters and bias are packed on every run, or only once
+// with convolution_transform_strategy PRECOMPUTE.
+class DirectConvOp final : public ConvPoolOpBase<CPUContext> {
+ public:
+  USE_CONV_POOL_BASE_FUNCTIONS(CPUContext);
+  DirectConvOp(const OperatorDef& operator_def, Workspace* ws)
+      : ConvPoolOpBase<CPUContext>(operator_def, ws),
+        precompute_(
+            OperatorBase::GetSingleArgument<string>(
+                "convolution_transform_strategy", "COMPUTE") == "PRECOMPUTE") {
+    OPERATOR_NEEDS_FEATURE(
+        order_ == StorageOrder::NCHW, "DIRECT only supports NCHW order.");
+    OPERATOR_NEEDS_FEATURE(
+        kernel_.size() == 2, "DIRECT only supports 2D convolution.");
+  }
+  ~DirectConvOp() {}
+
+  bool RunOnDeviceWithOrderNCHW() override;
+
+ private:
+  void RunImage(
+      const DirectConvShape& s,
+      const float* X,
+      const float* packed_filter,
+      const float* packed_bias,
+      int M,
+      float* Y);
+
+  // With the PRECOMPUTE strategy the filters and bias are packed on the
+  // first run only, for weights that do not change, as in NNPACK.
+  const bool precompute_;
+  bool filter_packed_{false};
+  Tensor<CPUContext> packed_filter_;
+  Tensor<CPUContext> packed_bias_;
+
+  INPUT_TAGS(INPUT, FILTER, BIAS);
+};
+
+bool DirectConvOp::RunOnDeviceWithOrderNCHW() {
+  const auto& X = Input(INPUT);
+  const auto& filter = Input(FILTER);
+  auto* Y = Output(0);
+  CAFFE_ENFORCE_EQ(X.ndim(), 4);
+  CAFFE_ENFORCE_EQ(filter.ndim(), 4);
+  const int N = X.dim32(0), C = X.dim32(1), H = X.dim32(2), W = X.dim32(3);
+  const int M = filter.dim32(0);
+  CAFFE_ENFORCE(
+      C == filter.dim32(1) * group_,
+      "Convolution op: input channels does not match: # of input channels ",
+      C,
+      " is not equal to kernel channels * group:",
+      filter.dim32(1),
+      "*",
+      group_);
+  CAFFE_ENFORCE(
+      M % group_ == 0,
+      "The number of output channels is not divisible by group.");
+  CAFFE_ENFORCE_EQ(filter.dim32(2), kernel_h());
+  CAFFE_ENFORCE_EQ(filter.dim32(3), kernel_w());
+  ConvPoolOpBase<CPUContext>::SetOutputSize(X, Y, M);
+
+  const float* bias = nullptr;
+  if (InputSize() == 3) {
+    const auto& B = Input(BIAS);
+    CAFFE_ENFORCE_EQ(B.ndim(), 1);
+    CAFFE_ENFORCE_EQ(B.dim32(0), M);
+    bias = B.data<float>();
+  }
+
+  const int Cg = C / group_;
+  const int Mg = M / group_;
+  const DirectConvShape s{Cg,
+                          H,
+                          W,
+                          kernel_h(),
+                          kernel_w(),
+                          stride_h(),
+                          stride_w(),
+                          dilation_h(),
+                          dilation_w(),
+                          pad_t(),
+                          pad_l(),
+                          Y->dim32(2),
+                          Y->dim32(3)};
+  const int K = s.KH * s.KW;
+  const bool is1x1 = K == 1 && s.SH == 1 && s.SW == 1 && s.PT == 0 &&
+      s.PL == 0 && pad_b() == 0 && pad_r() == 0;
+  const float* Xdata = X.data<float>();
+  const float* filter_data = filter.data<float>();
+  float* Ydata = Y->mutable_data<float>();
+
+  if (is1x1) {
+    for (int n = 0; n < N; ++n) {
+      for (int g = 0; g < group_; ++g) {
+        float* Yg = Ydata + (n * M + g * Mg) * H * W;
+        math::Gemm<float, CPUContext>(
+            CblasNoTrans,
+            CblasNoTrans,
+            Mg,
+            H * W,
+            Cg,
+            1,
+            filter_data + g * Mg * Cg,
+            Xdata + (n * C + g * Cg) * H * W,
+            0,
+            Yg,
+            &context_);
+        if (bias) {
+          EigenArrayMap<float>(Yg, H * W, Mg).rowwise() +=
+              ConstEigenVectorArrayMap<float>(bias + g * Mg, Mg).transpose();
+        }
+      }
+    }
+    return true;
+  }
+
+  // Pack the filters of each group as [block][Cg][KH][KW][kBlockM] and the
+  // bias as [block][kBlockM], padding the last block of a group with zeros.
+  const int blocks = (Mg + kBlockM - 1) / kBlockM;
+  const vector<TIndex> packed_dims{group_, blocks, Cg * K * kBlockM};
+  if (!precompute_ || !filter_packed_ || packed_filter_.dims() != packed_dims) {
+    packed_filter_.Resize(packed_dims);
+    packed_bias_.Resize(group_, blocks, kBlockM);
+    float* packed_filter = packed_filter_.mutable_data<float>();
+    float* packed_bias = packed_bias_.mutable_data<float>();
+    std::fill(packed_filter, packed_filter + packed_filter_.size(), 0.0f);
+    std::fill(packed_bias, packed_bias + packed_bias_.size(), 0.0f);
+    for (int m = 0; m < M; ++m) {
+      const int g = m / Mg;
+      const int block = g * blocks + m % Mg / kBlockM;
+      const int mi = m % Mg % kBlockM;
+      float* dst = packed_filter + block * Cg * K * kBlockM + mi;
+      const float* src = filter_data + m * Cg * K;
+      for (int ck = 0; ck < Cg * K; ++ck) {
+        dst[ck * kBlockM] = src[ck];
+      }
+      packed_bias[block * kBlockM + mi] = bias ? bias[m] : 0.0f;
+    }
+    filter_packed_ = true;
+  }
+  const float* packed_filter = packed_filter_.data<float>();
+  const float* packed_bias = packed_bias_.data<float>();
+
+  for (int n = 0; n < N; ++n) {
+    for (int g = 0; g < group_; ++g) {
+      RunImage(
+          s,
+          Xdata + (n * C + g * Cg) * H * W,
+          packed_filter + g * blocks * Cg * K * kBlockM,
+          packed_bias + g * blocks * kBlockM,
+          Mg,
+          Ydata + (n * M + g * Mg) * s.OH * s.OW);
+    }
+  }
+  return true;
+}
+
+void DirectConvOp::RunImage(
+    const DirectConvShape& s,
+    const float* X,
+    const float* packed_filter,
+    const float* packed_bias,
+    int M,
+    float* Y) {
+  const int block_size = s.C * s.KH * s.KW * kBlockM;
+  // Output columns [ow_begin, ow_end) have all their taps inside the image.
+  const int ow_begin = std::min(s.OW, (s.PL + s.SW - 1) / s.SW);
+  const int last_tap = (s.KW - 1) * s.DW - s.PL;
+  const int ow_end = s.W - 1 - last_tap < 0
+      ? ow_begin
+      : std::max(ow_begin, std::min(s.OW, (s.W - 1 - last_tap) / s.SW + 1));
+  const auto tile = s.SW == 1 ? DirectConvTile<true> : DirectConvTile<false>;
+
+  for (int oh = 0; oh < s.OH; ++oh) {
+    for (int m0 = 0; m0 < M; m0 += kBlockM) {
+      const int mb = std::min(kBlockM, M - m0);
+      const float* w = packed_filter + m0 / kBlockM * block_size;
+      const float* bias = packed_bias + m0;
+      float* y[kBlockM];
+      for (int mi = 0; mi < mb; ++mi) {
+        y[mi] = Y + ((m0 + mi) * s.OH + oh) * s.OW;
+      }
+      int ow = 0;
+      for (; ow < ow_begin; ++ow) {
+        DirectConvColumn(s, X, w, bias, oh, ow, mb, y);
+      }
+      for (; ow + kTileW <= ow_end; ow += kTileW) {
+        tile(s, X, w, bias, oh, ow, mb, y);
+      }
+      for (; ow < s.OW; ++ow) {
+        DirectConvColumn(s, X, w, bias, oh, ow, mb, y);
+      }
+    }
+  }
+}
+
+REGISTER_CPU_OPERATOR_WITH_ENGINE(Conv, DIRECT, DirectConvOp);
+REGISTER_CPU_OPERATOR_WITH_ENGINE(Conv2D, DIRECT, DirectConvOp);
+
+} // namespace caffe2
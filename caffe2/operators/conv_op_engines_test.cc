@@ -0,0 +1,179 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/utils/proto_utils.h"
+
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+struct ConvShape {
+  int N, C, H, W, M;
+  int kernel, stride, pad, dilation, group;
+};
+
+void AddUniformInput(
+    const vector<TIndex>& shape,
+    const string& name,
+    Workspace* ws) {
+  DeviceOption option;
+  CPUContext context(option);
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(shape);
+  math::RandUniform<float, CPUContext>(
+      tensor->size(), -1, 1, tensor->mutable_data<float>(), &context);
+}
+
+OperatorDef ConvDef(
+    const ConvShape& shape,
+    const string& engine,
+    const string& output,
+    bool use_bias) {
+  OperatorDef def = CreateOperatorDef(
+      "Conv",
+      "",
+      use_bias ? std::vector<string>{"X", "w", "b"}
+               : std::vector<string>{"X", "w"},
+      std::vector<string>{output},
+      std::vector<Argument>{MakeArgument<int>("kernel", shape.kernel),
+                            MakeArgument<int>("stride", shape.stride),
+                            MakeArgument<int>("pad", shape.pad),
+                            MakeArgument<int>("dilation", shape.dilation),
+                            MakeArgument<int>("group", shape.group)});
+  def.set_engine(engine);
+  return def;
+}
+
+// Runs the convolution with the default engine and with the given engine,
+// and checks that the given engine was used and computed the same output.
+void CompareWithDefault(
+    const ConvShape& shape,
+    const string& engine,
+    float tolerance,
+    const std::vector<Argument>& engine_args = {}) {
+  for (bool use_bias : {false, true}) {
+    Workspace ws;
+    AddUniformInput({shape.N, shape.C, shape.H, shape.W}, "X", &ws);
+    AddUniformInput(
+        {shape.M, shape.C / shape.group, shape.kernel, shape.kernel}, "w", &ws);
+    AddUniformInput({shape.M}, "b", &ws);
+
+    auto expected_op =
+        CreateOperator(ConvDef(shape, "", "Y_expected", use_bias), &ws);
+    ASSERT_TRUE(expected_op->Run());
+    auto def = ConvDef(shape, engine, "Y", use_bias);
+    for (const auto& arg : engine_args) {
+      *def.add_arg() = arg;
+    }
+    auto op = CreateOperator(def, &ws);
+    EXPECT_EQ(op->engine(), engine);
+    // Run twice, so that precomputed filter transforms get reused.
+    ASSERT_TRUE(op->Run());
+    ASSERT_TRUE(op->Run());
+
+    const auto& expected = ws.GetBlob("Y_expected")->Get<TensorCPU>();
+    const auto& actual = ws.GetBlob("Y")->Get<TensorCPU>();
+    ASSERT_EQ(expected.dims(), actual.dims());
+    for (int i = 0; i < expected.size(); ++i) {
+      ASSERT_NEAR(expected.data<float>()[i], actual.data<float>()[i], tolerance)
+          << engine << " differs at " << i;
+    }
+  }
+}
+
+} // namespace
+
+TEST(ConvOpEnginesTest, Direct) {
+  for (const auto& shape : std::vector<ConvShape>{
+           {2, 3, 9, 11, 5, 3, 1, 1, 1, 1},
+           {1, 4, 8, 8, 17, 3, 2, 0, 1, 1},
+           {1, 6, 10, 7, 4, 5, 1, 2, 1, 2},
+           {1, 3, 12, 12, 2, 3, 3, 3, 2, 1},
+           {2, 8, 6, 6, 12, 1, 1, 0, 1, 2},
+           {1, 8, 6, 6, 4, 1, 2, 1, 1, 1}}) {
+    CompareWithDefault(shape, "DIRECT", 1e-4);
+    CompareWithDefault(
+        shape,
+        "DIRECT",
+        1e-4,
+        {MakeArgument<string>("convolution_transform_strategy", "PRECOMPUTE")});
+  }
+}
+
+TEST(ConvOpEnginesTest, Winograd) {
+  for (const auto& shape : std::vector<ConvShape>{
+           {2, 3, 9, 11, 5, 3, 1, 1, 1, 1},
+           {1, 16, 14, 14, 8, 3, 1, 1, 1, 1},
+           {1, 4, 5, 3, 4, 3, 1, 0, 1, 1},
+           {1, 6, 20, 17, 6, 3, 1, 2, 1, 3},
+           {1, 8, 30, 30, 4, 3, 1, 1, 1, 1}}) {
+    CompareWithDefault(shape, "WINOGRAD", 1e-4);
+    CompareWithDefault(
+        shape, "WINOGRAD", 1e-3, {MakeArgument<int>("winograd_tile", 4)});
+    CompareWithDefault(
+        shape,
+        "WINOGRAD",
+        1e-4,
+        {MakeArgument<string>("convolution_transform_strategy", "PRECOMPUTE")});
+  }
+}
+
+TEST(ConvOpEnginesTest, UnsupportedShapesFallBackToDefault) {
+  Workspace ws;
+  AddUniformInput({1, 2, 8, 8}, "X", &ws);
+  AddUniformInput({3, 2, 5, 5}, "w", &ws);
+  auto op = CreateOperator(
+      ConvDef({1, 2, 8, 8, 3, 5, 1, 0, 1, 1}, "WINOGRAD", "Y", false), &ws);
+  EXPECT_EQ(op->engine(), "");
+  EXPECT_TRUE(op->Run());
+}
+
+TEST(ConvOpEnginesTest, OneByOneGemm) {
+  // The default engine computes 1x1 convolutions without an im2col buffer,
+  // compare against the im2col path with a padded border that is cropped.
+  for (int group : {1, 2}) {
+    Workspace ws;
+    AddUniformInput({2, 4, 5, 6}, "X", &ws);
+    AddUniformInput({6, 4 / group, 1, 1}, "w", &ws);
+    AddUniformInput({6}, "b", &ws);
+    ConvShape shape{2, 4, 5, 6, 6, 1, 1, 0, 1, group};
+    ASSERT_TRUE(ws.RunOperatorOnce(ConvDef(shape, "", "Y", true)));
+    shape.pad = 1;
+    ASSERT_TRUE(ws.RunOperatorOnce(ConvDef(shape, "", "Y_padded", true)));
+    const auto& Y = ws.GetBlob("Y")->Get<TensorCPU>();
+    const auto& Y_padded = ws.GetBlob("Y_padded")->Get<TensorCPU>();
+    for (int nm = 0; nm < 12; ++nm) {
+      for (int h = 0; h < 5; ++h) {
+        for (int w = 0; w < 6; ++w) {
+          EXPECT_NEAR(
+              Y.data<float>()[(nm * 5 + h) * 6 + w],
+              Y_padded.data<float>()[(nm * 7 + h + 1) * 8 + w + 1],
+              1e-5);
+        }
+      }
+    }
+  }
+}
+
+} // namespace caffe2
@@ -18,6 +18,8 @@
 #ifndef CAFFE2_OPERATORS_CONV_OP_IMPL_H_
 #define CAFFE2_OPERATORS_CONV_OP_IMPL_H_
 
+#include <algorithm>
+
 #include "caffe2/core/context.h"
 #include "caffe2/core/flags.h"
 #include "caffe2/core/logging.h"
@@ -118,13 +120,26 @@ bool ConvOp<T, Context>::RunOnDeviceWithOrderNCHW() {
   }
   T* Ydata = Y->template mutable_data<T>();
 
+  // A 1x1 convolution with unit strides and no padding is a plain GEMM: the
+  // input image already is its col buffer.
+  const bool is_1x1 = kernel_dims_size == 1 &&
+      std::all_of(
+          stride_.begin(), stride_.end(), [](int s) { return s == 1; }) &&
+      std::all_of(pads_.begin(), pads_.end(), [](int p) { return p == 0; });
+
   auto f = [&](Tensor<Context>* col_buffer) {
-    col_buffer->Resize(buffer_shape);
-    T* col_buffer_data = col_buffer->template mutable_data<T>();
+    T* col_buffer_data = nullptr;
+    if (!is_1x1) {
+      col_buffer->Resize(buffer_shape);
+      col_buffer_data = col_buffer->template mutable_data<T>();
+    }
     // Im2col, followed by gemm.
     for (int image_id = 0; image_id < N; ++image_id) {
       for (int group_id = 0; group_id < group_; ++group_id) {
-        if (kernel_.size() == 2) {
+        const T* col_data = col_buffer_data;
+        if (is_1x1) {
+          col_data = Xdata + group_id * input_offset;
+        } else if (kernel_.size() == 2) {
           math::Im2col<T, Context, StorageOrder::NCHW>(
               Xdata + group_id * input_offset,
               C / group_,
@@ -166,7 +181,7 @@ bool ConvOp<T, Context>::RunOnDeviceWithOrderNCHW() {
             kernel_dim,
             1,
             filter.template data<T>() + group_id * filter_offset,
-            col_buffer_data,
+            col_data,
             0,
             Ydata + group_id * output_offset,
             &context_);
@@ -193,7 +208,7 @@ bool ConvOp<T, Context>::RunOnDeviceWithOrderNCHW() {
     }
   };
 
-  if (FLAGS_caffe2_force_shared_col_buffer || shared_buffer_) {
+  if (!is_1x1 && (FLAGS_caffe2_force_shared_col_buffer || shared_buffer_)) {
     runWithSharedBuffer<Context>(ws_, f);
   } else {
     f(&col_buffer_);
@@ -0,0 +1,315 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/operators/conv_pool_op_base.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+namespace {
+
+// Transform matrices of Winograd F(m x m, 3 x 3), see Lavin and Gray, "Fast
+// Algorithms for Convolutional Neural Networks". Each output tile of m x m
+// is computed from an input tile of (m + 2) x (m + 2).
+template <int m>
+struct WinogradTransforms;
+
+template <>
+struct WinogradTransforms<2> {
+  static constexpr int kAlpha = 4;
+  static constexpr float BT[4][4] = {{1, 0, -1, 0},
+                                     {0, 1, 1, 0},
+                                     {0, -1, 1, 0},
+                                     {0, 1, 0, -1}};
+  static constexpr float G[4][3] = {{1, 0, 0},
+                                    {0.5f, 0.5f, 0.5f},
+                                    {0.5f, -0.5f, 0.5f},
+                                    {0, 0, 1}};
+  static constexpr float AT[2][4] = {{1, 1, 1, 0}, {0, 1, -1, -1}};
+};
+
+constexpr float WinogradTransforms<2>::BT[4][4];
+constexpr float WinogradTransforms<2>::G[4][3];
+constexpr float WinogradTransforms<2>::AT[2][4];
+
+template <>
+struct WinogradTransforms<4> {
+  static constexpr int kAlpha = 6;
+  static constexpr float BT[6][6] = {{4, 0, -5, 0, 1, 0},
+                                     {0, -4, -4, 1, 1, 0},
+                                     {0, 4, -4, -1, 1, 0},
+                                     {0, -2, -1, 2, 1, 0},
+                                     {0, 2, -1, -2, 1, 0},
+                                     {0, 4, 0, -5, 0, 1}};
+  static constexpr float G[6][3] = {{1.0f / 4, 0, 0},
+                                    {-1.0f / 6, -1.0f / 6, -1.0f / 6},
+                                    {-1.0f / 6, 1.0f / 6, -1.0f / 6},
+                                    {1.0f / 24, 1.0f / 12, 1.0f / 6},
+                                    {1.0f / 24, -1.0f / 12, 1.0f / 6},
+                                    {0, 0, 1}};
+  static constexpr float AT[4][6] = {{1, 1, 1, 1, 1, 0},
+                                     {0, 1, -1, 2, -2, 0},
+                                     {0, 1, 1, 4, 4, 0},
+                                     {0, 1, -1, 8, -8, 1}};
+};
+
+constexpr float WinogradTransforms<4>::BT[6][6];
+constexpr float WinogradTransforms<4>::G[6][3];
+constexpr float WinogradTransforms<4>::AT[4][6];
+
+// out (R x S) = L (R x K) * in (K x K) * L^T (K x S), with R == S and the
+// same matrix on both sides, which is the shape of every Winograd transform.
+template <int R, int K>
+inline void SandwichTransform(
+    const float (&L)[R][K],
+    const float* in,
+    float* out) {
+  float tmp[R][K];
+  for (int i = 0; i < R; ++i) {
+    for (int j = 0; j < K; ++j) {
+      float sum = 0;
+      for (int k = 0; k < K; ++k) {
+        sum += L[i][k] * in[k * K + j];
+      }
+      tmp[i][j] = sum;
+    }
+  }
+  for (int i = 0; i < R; ++i) {
+    for (int j = 0; j < R; ++j) {
+      float sum = 0;
+      for (int k = 0; k < K; ++k) {
+        sum += tmp[i][k] * L[j][k];
+      }
+      out[i * R + j] = sum;
+    }
+  }
+}
+
+} // namespace
+
+// Winograd convolution for 3x3 kernels with unit stride and dilation in NCHW
+// order. The "winograd_tile" argument selects F(2x2, 3x3) (the default) or
+// F(4x4, 3x3), which does fewer multiplications but is less accurate.
+//
+// Filters are transformed into an (alpha * alpha) x M x C buffer on every
+// run, or only once with convolution_transform_strategy PRECOMPUTE. Output
+// tiles are processed in blocks of kTileBlock: the input tiles of a block are
+// transformed into an (alpha * alpha) x C x tiles buffer, multiplied by the
+// filters with one GEMM per transform position, and transformed back into
+// the output. The buffers only depend on the number of channels, never on
+// the image size.
+class WinogradConvOp final : public ConvPoolOpBase<CPUContext> {
+ public:
+  USE_CONV_POOL_BASE_FUNCTIONS(CPUContext);
+  WinogradConvOp(const OperatorDef& operator_def, Workspace* ws)
+      : ConvPoolOpBase<CPUContext>(operator_def, ws),
+        tile_(OperatorBase::GetSingleArgument<int>("winograd_tile", 2)),
+        precompute_(
+            OperatorBase::GetSingleArgument<string>(
+                "convolution_transform_strategy", "COMPUTE") == "PRECOMPUTE") {
+    OPERATOR_NEEDS_FEATURE(
+        order_ == StorageOrder::NCHW, "WINOGRAD only supports NCHW order.");
+    OPERATOR_NEEDS_FEATURE(
+        kernel_.size() == 2 && kernel_h() == 3 && kernel_w() == 3,
+        "WINOGRAD only supports 3x3 kernels.");
+    OPERATOR_NEEDS_FEATURE(
+        stride_h() == 1 && stride_w() == 1,
+        "WINOGRAD only supports unit strides.");
+    OPERATOR_NEEDS_FEATURE(
+        dilation_h() == 1 && dilation_w() == 1,
+        "WINOGRAD does not support dilation.");
+    CAFFE_ENFORCE(
+        tile_ == 2 || tile_ == 4, "winograd_tile must be 2 or 4, got ", tile_);
+  }
+  ~WinogradConvOp() {}
+
+  bool RunOnDeviceWithOrderNCHW() override {
+    return tile_ == 2 ? RunWithTile<2>() : RunWithTile<4>();
+  }
+
+ private:
+  static constexpr int kTileBlock = 64;
+
+  template <int m>
+  bool RunWithTile();
+
+  const int tile_;
+  // With the PRECOMPUTE strategy the filters are transformed on the first
+  // run only, for filters that do not change, as in NNPACK.
+  const bool precompute_;
+  bool filter_transformed_{false};
+  Tensor<CPUContext> transformed_filter_;
+  Tensor<CPUContext> transformed_input_;
+  Tensor<CPUContext> transformed_output_;
+
+  INPUT_TAGS(INPUT, FILTER, BIAS);
+};
+
+constexpr int WinogradConvOp::kTileBlock;
+
+template <int m>
+bool WinogradConvOp::RunWithTile() {
+  using Transforms = WinogradTransforms<m>;
+  constexpr int alpha = Transforms::kAlpha;
+  constexpr int alpha2 = alpha * alpha;
+
+  const auto& X = Input(INPUT);
+  const auto& filter = Input(FILTER);
+  auto* Y = Output(0);
+  CAFFE_ENFORCE_EQ(X.ndim(), 4);
+  CAFFE_ENFORCE_EQ(filter.ndim(), 4);
+  const int N = X.dim32(0), C = X.dim32(1), H = X.dim32(2), W = X.dim32(3);
+  const int M = filter.dim32(0);
+  CAFFE_ENFORCE(
+      C == filter.dim32(1) * group_,
+      "Convolution op: input channels does not match: # of input channels ",
+      C,
+      " is not equal to kernel channels * group:",
+      filter.dim32(1),
+      "*",
+      group_);
+  CAFFE_ENFORCE(
+      M % group_ == 0,
+      "The number of output channels is not divisible by group.");
+  CAFFE_ENFORCE_EQ(filter.dim32(2), 3);
+  CAFFE_ENFORCE_EQ(filter.dim32(3), 3);
+  ConvPoolOpBase<CPUContext>::SetOutputSize(X, Y, M);
+  const int OH = Y->dim32(2), OW = Y->dim32(3);
+  const int PT = pad_t(), PL = pad_l();
+
+  const float* bias = nullptr;
+  if (InputSize() == 3) {
+    const auto& B = Input(BIAS);
+    CAFFE_ENFORCE_EQ(B.ndim(), 1);
+    CAFFE_ENFORCE_EQ(B.dim32(0), M);
+    bias = B.data<float>();
+  }
+
+  const int Cg = C / group_;
+  const int Mg = M / group_;
+  const int tiles_h = (OH + m - 1) / m;
+  const int tiles_w = (OW + m - 1) / m;
+  const int num_tiles = tiles_h * tiles_w;
+
+  // U[xi][g][mo][c] = (G g G^T)[xi] for filter g of output channel mo and
+  // input channel c, so that each group and position is a row-major Mg x Cg
+  // matrix.
+  if (!precompute_ || !filter_transformed_ ||
+      transformed_filter_.dims() != vector<TIndex>{alpha2, M, Cg}) {
+    transformed_filter_.Resize(alpha2, M, Cg);
+    float* U = transformed_filter_.mutable_data<float>();
+    const float* filter_data = filter.data<float>();
+    for (int mo = 0; mo < M; ++mo) {
+      for (int c = 0; c < Cg; ++c) {
+        float u[alpha2];
+        SandwichTransform(Transforms::G, filter_data + (mo * Cg + c) * 9, u);
+        for (int xi = 0; xi < alpha2; ++xi) {
+          U[(xi * M + mo) * Cg + c] = u[xi];
+        }
+      }
+    }
+    filter_transformed_ = true;
+  }
+  const float* U = transformed_filter_.data<float>();
+
+  transformed_input_.Resize(alpha2, Cg, kTileBlock);
+  transformed_output_.Resize(alpha2, Mg, kTileBlock);
+  float* V = transformed_input_.mutable_data<float>();
+  float* Mbuf = transformed_output_.mutable_data<float>();
+  const float* Xdata = X.data<float>();
+  float* Ydata = Y->mutable_data<float>();
+
+  for (int n = 0; n < N; ++n) {
+    for (int g = 0; g < group_; ++g) {
+      const float* Xg = Xdata + (n * C + g * Cg) * H * W;
+      float* Yg = Ydata + (n * M + g * Mg) * OH * OW;
+      for (int t0 = 0; t0 < num_tiles; t0 += kTileBlock) {
+        const int tb = std::min(kTileBlock, num_tiles - t0);
+        // Input transform: V[xi][c][t] = (B^T d B)[xi].
+        for (int c = 0; c < Cg; ++c) {
+          const float* x = Xg + c * H * W;
+          for (int t = 0; t < tb; ++t) {
+            const int ih0 = (t0 + t) / tiles_w * m - PT;
+            const int iw0 = (t0 + t) % tiles_w * m - PL;
+            float d[alpha2];
+            for (int i = 0; i < alpha; ++i) {
+              const int ih = ih0 + i;
+              for (int j = 0; j < alpha; ++j) {
+                const int iw = iw0 + j;
+                d[i * alpha + j] = ih >= 0 && ih < H && iw >= 0 && iw < W
+                    ? x[ih * W + iw]
+                    : 0.0f;
+              }
+            }
+            float v[alpha2];
+            SandwichTransform(Transforms::BT, d, v);
+            for (int xi = 0; xi < alpha2; ++xi) {
+              V[(xi * Cg + c) * tb + t] = v[xi];
+            }
+          }
+        }
+        // Elementwise products, summed over channels as one GEMM per
+        // position: M[xi] (Mg x tb) = U[xi] (Mg x Cg) * V[xi] (Cg x tb).
+        for (int xi = 0; xi < alpha2; ++xi) {
+          math::Gemm<float, CPUContext>(
+              CblasNoTrans,
+              CblasNoTrans,
+              Mg,
+              tb,
+              Cg,
+              1,
+              U + (xi * M + g * Mg) * Cg,
+              V + xi * Cg * tb,
+              0,
+              Mbuf + xi * Mg * tb,
+              &context_);
+        }
+        // Output transform: Y tile = A^T M A, cropped at the image border.
+        for (int mo = 0; mo < Mg; ++mo) {
+          const float b = bias ? bias[g * Mg + mo] : 0.0f;
+          float* y = Yg + mo * OH * OW;
+          for (int t = 0; t < tb; ++t) {
+            float mt[alpha2];
+            for (int xi = 0; xi < alpha2; ++xi) {
+              mt[xi] = Mbuf[(xi * Mg + mo) * tb + t];
+            }
+            float out[m * m];
+            SandwichTransform(Transforms::AT, mt, out);
+            const int oh0 = (t0 + t) / tiles_w * m;
+            const int ow0 = (t0 + t) % tiles_w * m;
+            const int rows = std::min(m, OH - oh0);
+            const int cols = std::min(m, OW - ow0);
+            for (int i = 0; i < rows; ++i) {
+              for (int j = 0; j < cols; ++j) {
+                y[(oh0 + i) * OW + ow0 + j] = out[i * m + j] + b;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+REGISTER_CPU_OPERATOR_WITH_ENGINE(Conv, WINOGRAD, WinogradConvOp);
+REGISTER_CPU_OPERATOR_WITH_ENGINE(Conv2D, WINOGRAD, WinogradConvOp);
+
+} // namespace caffe2
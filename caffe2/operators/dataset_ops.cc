@@ -205,6 +205,41 @@ void TreeWalker::gatherSizeLimits() {
   }
 }
 
+void ComputeRecordOffsets(
+    TreeIterator& it,
+    const std::vector<const TensorCPU*>& fields,
+    std::vector<TOffset>* offsets,
+    TensorCPU* out) {
+  CAFFE_ENFORCE_EQ(fields.size(), it.fields().size());
+  std::vector<const TLength*> lengths(it.numLengthFields());
+  std::vector<TOffset> limits(
+      it.numOffsetFields(), std::numeric_limits<TOffset>::max());
+  std::vector<TOffset> sizes(it.numOffsetFields());
+  static const TLength lenZero = 0;
+  // gather length data
+  for (int i = 0; i < lengths.size(); ++i) {
+    const auto& lengthTensor = *fields[it.lengthField(i).id];
+    lengths[i] =
+        lengthTensor.size() > 0 ? lengthTensor.data<TLength>() : &lenZero;
+  }
+  // gather size limits
+  for (int i = 0; i < fields.size(); ++i) {
+    const int lengthFieldIdx = it.fields()[i].lengthFieldId + 1;
+    limits[lengthFieldIdx] =
+        std::min(limits[lengthFieldIdx], (TOffset)fields[i]->dim(0));
+  }
+  if (offsets->empty()) {
+    offsets->assign(sizes.size(), 0);
+  }
+  out->Resize(limits[0] + 1, sizes.size());
+  auto* outData = out->mutable_data<TOffset>();
+  for (TOffset k = 0; k <= limits[0]; ++k) {
+    std::copy(offsets->begin(), offsets->end(), outData);
+    outData += sizes.size();
+    it.advance(lengths, *offsets, sizes, limits, 1);
+  }
+}
+
 namespace {
 
 class CreateTreeCursorOp : public Operator<CPUContext> {
@@ -534,43 +569,13 @@ class ComputeOffsetOp : public Operator<CPUContext> {
   bool RunOnDevice() override {
     auto& cursor = OperatorBase::Input<std::unique_ptr<TreeCursor>>(0);
     CAFFE_ENFORCE(InputSize() == cursor->it.fields().size() + 1);
-    auto* out = Output(0);
-    std::vector<const TLength*> lengths;
-    std::vector<TOffset> limits;
-    std::vector<TOffset> sizes;
-    std::vector<TOffset> offsets;
-    TLength lenZero = 0;
-    sizes.resize(cursor->it.numOffsetFields());
-    // gather length data
-    lengths.resize(cursor->it.numLengthFields());
-    for (int i = 0; i < lengths.size(); ++i) {
-      auto& a = Input(cursor->it.lengthField(i).id + 1);
-      if (a.size() > 0) {
-        lengths[i] = a.data<int>();
-      } else {
-        lengths[i] = &lenZero;
-      }
-    }
-    // gather size limits
-    limits.assign(sizes.size(), std::numeric_limits<TOffset>::max());
-    for (int i = 0; i < cursor->it.fields().size(); ++i) {
-      int lengthFieldIdx = cursor->it.fields()[i].lengthFieldId + 1;
-      limits[lengthFieldIdx] =
-          std::min(limits[lengthFieldIdx], (TOffset)Input(i + 1).dims()[0]);
-    }
-    out->Resize(limits.at(0) + 1, sizes.size());
-    auto* out_data = out->mutable_data<int64_t>();
-    for (int k = 0; k <= limits.at(0); k++) {
-      // advance cursor
-      if (cursor->offsets.empty()) {
-        cursor->offsets.assign(sizes.size(), 0);
-      }
-      // write output
-      std::copy(cursor->offsets.begin(), cursor->offsets.end(), out_data);
-      out_data += sizes.size();
-      cursor->it.advance(lengths, cursor->offsets, sizes, limits, 1);
+    std::vector<const TensorCPU*> fields;
+    for (int i = 1; i < InputSize(); ++i) {
+      fields.push_back(&Input(i));
     }
-    cursor->offsets.assign(sizes.size(), 0); // reSet after getting meta info
+    ComputeRecordOffsets(cursor->it, fields, &cursor->offsets, Output(0));
+    // reSet after getting meta info
+    cursor->offsets.assign(cursor->it.numOffsetFields(), 0);
     return true;
   }
 };
@@ -205,6 +205,18 @@ class TreeWalker {
   std::vector<TOffset> prevOffsets_;
 };
 
+/**
+ * Computes the offsets matrix output by ComputeOffset for the given fields:
+ * row k holds the offset of the k-th record in every offset field, and the
+ * last row the total sizes. Starts from *offsets, or from the first record if
+ * it is empty, and leaves *offsets past the last record.
+ */
+void ComputeRecordOffsets(
+    TreeIterator& it,
+    const std::vector<const TensorCPU*>& fields,
+    std::vector<TOffset>* offsets,
+    TensorCPU* out);
+
 using SharedTensorVectorPtr = std::shared_ptr<std::vector<TensorCPU>>;
 
 template <class Context>
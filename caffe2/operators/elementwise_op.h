@@ -23,6 +23,7 @@
 #include "caffe2/core/operator.h"
 #include "caffe2/core/tensor.h"
 #include "caffe2/utils/math.h"
+#include "caffe2/utils/parallel_for.h"
 
 #include <tuple>
 
@@ -393,19 +394,27 @@ bool DivGradientOp<Context>::RunOnDevice() {
 }
 
 // For arithmetic operators, Eigen provides a good way to vectorize even
-// when broadcasting.
+// when broadcasting. Large inputs are split between the threads of the
+// intra-op pool, by rows of b's size when broadcasting.
+constexpr size_t kMinBroadcastRunSize = 16;
+
 #define EIGEN_FUNCTOR(name, eigen_op, input_type, output_type)               \
   struct Eigen##name##Functor {                                              \
     template <int b_is_scalar, typename T, typename R>                       \
-    inline void Run(size_t n, const T* a, const T* b, R* out, CPUContext*) { \
-      if (b_is_scalar) {                                                     \
-        EigenVectorArrayMap<R>(out, n) =                                     \
-            eigen_op((ConstEigenVectorArrayMap<T>(a, n)), (b[0]));           \
-      } else {                                                               \
-        EigenVectorArrayMap<R>(out, n) = eigen_op(                           \
-            (ConstEigenVectorArrayMap<T>(a, n)),                             \
-            (ConstEigenVectorArrayMap<T>(b, n)));                            \
-      }                                                                      \
+    inline void                                                              \
+    Run(size_t n, const T* a, const T* b, R* out, CPUContext* context) {     \
+      context->ParallelFor(                                                  \
+          n, kMemoryBoundGrainSize, [=](size_t begin, size_t end) {          \
+            if (b_is_scalar) {                                               \
+              EigenVectorArrayMap<R>(out + begin, end - begin) = eigen_op(   \
+                  (ConstEigenVectorArrayMap<T>(a + begin, end - begin)),     \
+                  (b[0]));                                                   \
+            } else {                                                         \
+              EigenVectorArrayMap<R>(out + begin, end - begin) = eigen_op(   \
+                  (ConstEigenVectorArrayMap<T>(a + begin, end - begin)),     \
+                  (ConstEigenVectorArrayMap<T>(b + begin, end - begin)));    \
+            }                                                                \
+          });                                                                \
     }                                                                        \
     template <typename T, typename R>                                        \
     void RunWithBroadcast(                                                   \
@@ -414,11 +423,17 @@ bool DivGradientOp<Context>::RunOnDevice() {
         R* out,                                                              \
         size_t pre,                                                          \
         size_t n,                                                            \
-        CPUContext*) {                                                       \
-      EigenArrayMap<R>(out, n, pre) = eigen_op(                              \
-          (ConstEigenArrayMap<T>(a, n, pre).colwise()),                      \
-          (ConstEigenVectorArrayMap<T>(b, n)));                              \
+        CPUContext* context) {                                               \
+      context->ParallelFor(                                                  \
+          pre, MemoryBoundRowGrainSize(n), [=](size_t begin, size_t end) {   \
+            EigenArrayMap<R>(out + begin * n, n, end - begin) = eigen_op(    \
+                (ConstEigenArrayMap<T>(a + begin * n, n, end - begin)        \
+                     .colwise()),                                            \
+                (ConstEigenVectorArrayMap<T>(b, n)));                        \
+          });                                                                \
     }                                                                        \
+    /* Splits the pre * n runs of post items that share a value of b, or */  \
+    /* the pre blocks when the runs are too short to vectorize. */           \
     template <typename T, typename R>                                        \
     void RunWithBroadcast2(                                                  \
         const T* a,                                                          \
@@ -427,12 +442,32 @@ bool DivGradientOp<Context>::RunOnDevice() {
         size_t pre,                                                          \
         size_t n,                                                            \
         size_t post,                                                         \
-        CPUContext*) {                                                       \
-      for (int i = 0; i < pre; ++i) {                                        \
-        EigenArrayMap<R>(out + i * n * post, post, n) = eigen_op(            \
-            (ConstEigenArrayMap<T>(a + i * n * post, post, n).rowwise()),    \
-            (Eigen::Map<const Eigen::Array<T, 1, Eigen::Dynamic>>(b, n)));   \
+        CPUContext* context) {                                               \
+      if (post < kMinBroadcastRunSize) {                                     \
+        context->ParallelFor(                                                \
+            pre,                                                             \
+            MemoryBoundRowGrainSize(n * post),                               \
+            [=](size_t begin, size_t end) {                                  \
+              for (size_t i = begin; i < end; ++i) {                         \
+                EigenArrayMap<R>(out + i * n * post, post, n) = eigen_op(    \
+                    (ConstEigenArrayMap<T>(a + i * n * post, post, n)        \
+                         .rowwise()),                                        \
+                    (Eigen::Map<const Eigen::Array<T, 1, Eigen::Dynamic>>(   \
+                        b, n)));                                             \
+              }                                                              \
+            });                                                              \
+        return;                                                              \
       }                                                                      \
+      context->ParallelFor(                                                  \
+          pre * n,                                                           \
+          MemoryBoundRowGrainSize(post),                                     \
+          [=](size_t begin, size_t end) {                                    \
+            for (size_t run = begin; run < end; ++run) {                     \
+              EigenVectorArrayMap<R>(out + run * post, post) = eigen_op(     \
+                  (ConstEigenVectorArrayMap<T>(a + run * post, post)),       \
+                  (b[run % n]));                                             \
+            }                                                                \
+          });                                                                \
     }                                                                        \
   };                                                                         \
   REGISTER_CPU_OPERATOR(                                                     \
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/operators/embedding_lookup_prefetch_tuner.h"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+
+#include "caffe2/utils/string_utils.h"
+
+CAFFE2_DEFINE_bool(
+    caffe2_embedding_lookup_autotune_prefetch,
+    true,
+    "If true, sparse lengths reducers without a prefetch_distance argument "
+    "autotune the prefetch distance of their embedding lookups once per table "
+    "shape.");
+
+namespace caffe2 {
+
+constexpr int EmbeddingLookupPrefetchTuner::kTrialsPerCandidate;
+constexpr TIndex EmbeddingLookupPrefetchTuner::kMinIndicesToTime;
+
+EmbeddingLookupPrefetchTuner::EmbeddingLookupPrefetchTuner(
+    const string& name,
+    std::vector<int> candidates)
+    : name_(name),
+      candidates_(std::move(candidates)),
+      best_nanos_per_index_(
+          candidates_.size(),
+          std::numeric_limits<double>::infinity()),
+      trials_(candidates_.size(), 0),
+      distance_stat_(StatRegistry::get().add(
+          "embedding_lookup_prefetch/" + name_ + "/distance")) {
+  CAFFE_ENFORCE(!candidates_.empty());
+  for (int candidate : candidates_) {
+    CAFFE_ENFORCE_GE(candidate, 0);
+  }
+  distance_stat_->reset(-1);
+}
+
+EmbeddingLookupPrefetchTuner* EmbeddingLookupPrefetchTuner::Get(
+    const string& kernel,
+    TIndex block_size,
+    TIndex data_size) {
+  static std::mutex mutex;
+  static std::unordered_map<
+      string,
+      std::unique_ptr<EmbeddingLookupPrefetchTuner>>
+      tuners;
+  const string name = MakeString(kernel, "/", block_size, "x", data_size);
+  std::lock_guard<std::mutex> guard(mutex);
+  auto& tuner = tuners[name];
+  if (!tuner) {
+    tuner.reset(new EmbeddingLookupPrefetchTuner(name));
+  }
+  return tuner.get();
+}
+
+std::vector<int> EmbeddingLookupPrefetchTuner::DefaultCandidates() {
+  return {0, 2, 4, 8, 16, 32, 64};
+}
+
+int EmbeddingLookupPrefetchTuner::Next() {
+  if (tuned()) {
+    return best_;
+  }
+  std::lock_guard<std::mutex> guard(mutex_);
+  return candidates_[next_trial_++ % candidates_.size()];
+}
+
+void EmbeddingLookupPrefetchTuner::Report(
+    int prefetch_distance,
+    TIndex index_size,
+    int64_t nanos) {
+  if (tuned() || index_size < kMinIndicesToTime) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (tuned()) {
+    return;
+  }
+  size_t done = 0;
+  for (size_t i = 0; i < candidates_.size(); ++i) {
+    if (candidates_[i] == prefetch_distance) {
+      // The minimum filters out calls slowed down by unrelated work.
+      best_nanos_per_index_[i] = std::min(
+          best_nanos_per_index_[i], static_cast<double>(nanos) / index_size);
+      ++trials_[i];
+    }
+    done += trials_[i] >= kTrialsPerCandidate;
+  }
+  if (done < candidates_.size()) {
+    return;
+  }
+  size_t best = 0;
+  for (size_t i = 1; i < candidates_.size(); ++i) {
+    if (best_nanos_per_index_[i] < best_nanos_per_index_[best]) {
+      best = i;
+    }
+  }
+  VLOG(1) << "Tuned embedding lookup prefetch distance for " << name_ << ": "
+          << candidates_[best] << " (" << best_nanos_per_index_[best]
+          << " ns per index)";
+  distance_stat_->reset(candidates_[best]);
+  best_ = candidates_[best];
+}
+
+} // namespace caffe2
@@ -0,0 +1,165 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_OPERATORS_EMBEDDING_LOOKUP_PREFETCH_TUNER_H_
+#define CAFFE2_OPERATORS_EMBEDDING_LOOKUP_PREFETCH_TUNER_H_
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/flags.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/stats.h"
+#include "caffe2/perfkernels/embedding_lookup.h"
+
+CAFFE2_DECLARE_bool(caffe2_embedding_lookup_autotune_prefetch);
+
+namespace caffe2 {
+
+/**
+ * Picks the prefetch distance of the EmbeddingLookup kernels for one table
+ * shape by timing the first calls made on it.
+ *
+ * Every candidate distance is used for kTrialsPerCandidate calls, round
+ * robin, and the one with the lowest time per looked-up index is kept for all
+ * later calls. Tuning happens on the real calls, so it costs no extra work
+ * beyond running some of them with a worse distance. Calls with fewer than
+ * kMinIndicesToTime indices are too noisy to time; they are not used for
+ * tuning and are ignored by Report().
+ *
+ * Tuners are shared by every operator looking up a table of the same shape,
+ * and the chosen distance is exported to the StatRegistry as
+ * "embedding_lookup_prefetch/<kernel>/<block_size>x<data_size>/distance".
+ */
+class EmbeddingLookupPrefetchTuner {
+ public:
+  static constexpr int kTrialsPerCandidate = 3;
+  static constexpr TIndex kMinIndicesToTime = 256;
+
+  EmbeddingLookupPrefetchTuner(
+      const string& name,
+      std::vector<int> candidates = DefaultCandidates());
+
+  // Returns the tuner shared by all lookups of the given kernel on a table
+  // of data_size rows of block_size elements.
+  static EmbeddingLookupPrefetchTuner*
+  Get(const string& kernel, TIndex block_size, TIndex data_size);
+
+  static std::vector<int> DefaultCandidates();
+
+  bool tuned() const {
+    return best_ >= 0;
+  }
+
+  // The chosen prefetch distance, or -1 while still tuning.
+  int best() const {
+    return best_;
+  }
+
+  // Returns the distance to use for the next call. Callers that time the
+  // call should report it back through Report().
+  int Next();
+
+  void Report(int prefetch_distance, TIndex index_size, int64_t nanos);
+
+  const string& name() const {
+    return name_;
+  }
+
+ private:
+  const string name_;
+  const std::vector<int> candidates_;
+  std::mutex mutex_;
+  int next_trial_ = 0;
+  std::vector<double> best_nanos_per_index_;
+  std::vector<int> trials_;
+  std::atomic<int> best_{-1};
+  StatValue* distance_stat_;
+
+  DISABLE_COPY_AND_ASSIGN(EmbeddingLookupPrefetchTuner);
+};
+
+/**
+ * Per-operator front end of EmbeddingLookupPrefetchTuner.
+ *
+ * Reads the "prefetch_distance" argument of the operator: a non-negative
+ * value pins the distance, and the default of -1 autotunes it unless
+ * --caffe2_embedding_lookup_autotune_prefetch is false, in which case
+ * kEmbeddingLookupDefaultPrefetchDistance is used.
+ */
+class EmbeddingLookupPrefetchDistance {
+ public:
+  explicit EmbeddingLookupPrefetchDistance(const OperatorBase& op)
+      : prefetch_distance_(
+            op.GetSingleArgument<int>("prefetch_distance", -1)) {}
+
+  // Calls lookup(prefetch_distance) with the distance to use for this call.
+  // `kernel` names the kind of table, e.g. its data type, and has to outlive
+  // the operator.
+  template <typename Lookup>
+  void Run(
+      const char* kernel,
+      TIndex block_size,
+      TIndex data_size,
+      TIndex index_size,
+      Lookup lookup) {
+    if (prefetch_distance_ >= 0) {
+      lookup(prefetch_distance_);
+      return;
+    }
+    if (!FLAGS_caffe2_embedding_lookup_autotune_prefetch) {
+      lookup(kEmbeddingLookupDefaultPrefetchDistance);
+      return;
+    }
+    if (!tuner_ || kernel != kernel_ || block_size != block_size_ ||
+        data_size != data_size_) {
+      tuner_ = EmbeddingLookupPrefetchTuner::Get(kernel, block_size, data_size);
+      kernel_ = kernel;
+      block_size_ = block_size;
+      data_size_ = data_size;
+    }
+    if (tuner_->tuned()) {
+      lookup(tuner_->best());
+      return;
+    }
+    if (index_size < EmbeddingLookupPrefetchTuner::kMinIndicesToTime) {
+      lookup(kEmbeddingLookupDefaultPrefetchDistance);
+      return;
+    }
+    const int prefetch_distance = tuner_->Next();
+    const auto start = std::chrono::steady_clock::now();
+    lookup(prefetch_distance);
+    const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+    tuner_->Report(prefetch_distance, index_size, nanos);
+  }
+
+ private:
+  const int prefetch_distance_;
+  EmbeddingLookupPrefetchTuner* tuner_ = nullptr;
+  const char* kernel_ = nullptr;
+  TIndex block_size_ = 0;
+  TIndex data_size_ = 0;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_OPERATORS_EMBEDDING_LOOKUP_PREFETCH_TUNER_H_
@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/stats.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/operators/embedding_lookup_prefetch_tuner.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+TEST(EmbeddingLookupPrefetchTunerTest, PicksFastestCandidate) {
+  EmbeddingLookupPrefetchTuner tuner("test/picks_fastest", {1, 2, 3});
+  const TIndex index_size = EmbeddingLookupPrefetchTuner::kMinIndicesToTime;
+  for (int i = 0;
+       i < 3 * EmbeddingLookupPrefetchTuner::kTrialsPerCandidate;
+       ++i) {
+    EXPECT_FALSE(tuner.tuned());
+    const int prefetch_distance = tuner.Next();
+    EXPECT_EQ(prefetch_distance, 1 + i % 3);
+    tuner.Report(
+        prefetch_distance, index_size, prefetch_distance == 2 ? 100 : 200);
+  }
+  EXPECT_TRUE(tuner.tuned());
+  EXPECT_EQ(tuner.best(), 2);
+  EXPECT_EQ(tuner.Next(), 2);
+  auto stats = toMap(StatRegistry::get().publish());
+  EXPECT_EQ(stats["embedding_lookup_prefetch/test/picks_fastest/distance"], 2);
+}
+
+TEST(EmbeddingLookupPrefetchTunerTest, IgnoresSmallCalls) {
+  EmbeddingLookupPrefetchTuner tuner("test/small_calls", {1, 2});
+  for (int i = 0; i < 10; ++i) {
+    tuner.Report(tuner.Next(), 1, 100);
+  }
+  EXPECT_FALSE(tuner.tuned());
+  EXPECT_EQ(tuner.best(), -1);
+}
+
+TEST(EmbeddingLookupPrefetchTunerTest, SparseLengthsSumAutotunes) {
+  const int kBlockSize = 4;
+  const int kNumRows = 100;
+  const int kNumIndices = EmbeddingLookupPrefetchTuner::kMinIndicesToTime;
+  Workspace ws;
+  auto* data = ws.CreateBlob("data")->GetMutable<TensorCPU>();
+  data->Resize(kNumRows, kBlockSize);
+  for (int i = 0; i < data->size(); ++i) {
+    data->mutable_data<float>()[i] = i / kBlockSize;
+  }
+  auto* indices = ws.CreateBlob("indices")->GetMutable<TensorCPU>();
+  indices->Resize(kNumIndices);
+  for (int i = 0; i < kNumIndices; ++i) {
+    indices->mutable_data<int32_t>()[i] = i % kNumRows;
+  }
+  auto* lengths = ws.CreateBlob("lengths")->GetMutable<TensorCPU>();
+  lengths->Resize(1);
+  lengths->mutable_data<int>()[0] = kNumIndices;
+
+  auto tuned = CreateOperator(
+      CreateOperatorDef(
+          "SparseLengthsSum", "", {"data", "indices", "lengths"}, {"tuned"}),
+      &ws);
+  auto pinned = CreateOperator(
+      CreateOperatorDef(
+          "SparseLengthsSum",
+          "",
+          {"data", "indices", "lengths"},
+          {"pinned"},
+          {MakeArgument<int>("prefetch_distance", 8)}),
+      &ws);
+  const int num_candidates =
+      EmbeddingLookupPrefetchTuner::DefaultCandidates().size();
+  for (int i = 0;
+       i < num_candidates * EmbeddingLookupPrefetchTuner::kTrialsPerCandidate;
+       ++i) {
+    EXPECT_TRUE(tuned->Run());
+  }
+  EXPECT_TRUE(pinned->Run());
+
+  auto* tuner = EmbeddingLookupPrefetchTuner::Get(
+      TypeMeta::Name<float>(), kBlockSize, kNumRows);
+  EXPECT_TRUE(tuner->tuned());
+  auto stats = toMap(StatRegistry::get().publish());
+  EXPECT_EQ(
+      stats["embedding_lookup_prefetch/" + tuner->name() + "/distance"],
+      tuner->best());
+
+  const auto& tuned_output = ws.GetBlob("tuned")->Get<TensorCPU>();
+  const auto& pinned_output = ws.GetBlob("pinned")->Get<TensorCPU>();
+  ASSERT_EQ(tuned_output.size(), kBlockSize);
+  for (int i = 0; i < kBlockSize; ++i) {
+    EXPECT_EQ(tuned_output.data<float>()[i], pinned_output.data<float>()[i]);
+  }
+}
+
+} // namespace caffe2
@@ -0,0 +1,141 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/utils/packed_gemm.h"
+
+namespace caffe2 {
+
+// FC for inference that packs the weights once into the panel layout of
+// PackedGemmMatrix instead of letting the GEMM repack the same constant W on
+// every run. This is a portable counterpart of the MKL based PACKED engine.
+// The microkernel is tuned for the few rows of online inference; batches of
+// more than max_packed_batch_size rows (16 by default), where BLAS catches
+// up, go to math::Gemm on the unpacked weights instead.
+//
+// The weights are packed once and assumed to be constant afterwards, as they
+// are in inference nets: the op remembers the tensor, its data pointer and
+// dims at packing time and only packs again when one of them differs, e.g.
+// after W was fed with a tensor of its own or reshaped. Values written in
+// place into W, directly or through a tensor sharing its data, are not seen,
+// so do not use this engine for weights that are updated while it runs.
+template <bool TransposeWeight>
+class PrepackedFullyConnectedOp final : public Operator<CPUContext> {
+ public:
+  USE_OPERATOR_FUNCTIONS(CPUContext);
+  PrepackedFullyConnectedOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws),
+        axis_(OperatorBase::GetSingleArgument<int32_t>("axis", 1)),
+        axis_w_(OperatorBase::GetSingleArgument<int32_t>("axis_w", 1)),
+        max_packed_batch_size_(OperatorBase::GetSingleArgument<int32_t>(
+            "max_packed_batch_size",
+            16)) {
+    OPERATOR_NEEDS_FEATURE(
+        !OperatorBase::GetSingleArgument<bool>("float16_compute", false),
+        "The PREPACKED engine does not support float16_compute.");
+  }
+
+  bool RunOnDevice() override {
+    const auto& X = Input(0);
+    const auto& W = Input(1);
+    const auto& b = Input(2);
+    auto* Y = Output(0);
+    CAFFE_ENFORCE(b.ndim() == 1, b.ndim());
+    const auto canonical_axis = X.canonical_axis_index(axis_);
+    const auto M = X.size_to_dim(canonical_axis);
+    const auto K = X.size_from_dim(canonical_axis);
+    const auto canonical_axis_w = W.canonical_axis_index(axis_w_);
+    const int N = TransposeWeight ? W.size_to_dim(canonical_axis_w)
+                                  : W.size_from_dim(canonical_axis_w);
+    CAFFE_ENFORCE(
+        M == X.size() / K && K == W.size() / N && N == b.size(),
+        "Dimension mismatch: X: ",
+        X.dims(),
+        ", W: ",
+        W.dims(),
+        ", b: ",
+        b.dims(),
+        ", axis: ",
+        axis_);
+
+    Y_shape_cache_ = X.dims();
+    DCHECK_LE(canonical_axis + 1, Y_shape_cache_.size());
+    Y_shape_cache_.resize(canonical_axis + 1);
+    Y_shape_cache_[canonical_axis] = N;
+    Y->Resize(Y_shape_cache_);
+    if (X.size() == 0) {
+      Y->template mutable_data<float>();
+      return true;
+    }
+
+    if (M > max_packed_batch_size_) {
+      math::Gemm<float, CPUContext>(
+          CblasNoTrans,
+          TransposeWeight ? CblasTrans : CblasNoTrans,
+          M,
+          N,
+          K,
+          1,
+          X.template data<float>(),
+          W.template data<float>(),
+          0,
+          Y->template mutable_data<float>(),
+          &context_);
+      EigenMatrixMap<float>(Y->template mutable_data<float>(), N, M)
+          .colwise() += ConstEigenVectorMap<float>(b.template data<float>(), N);
+      return true;
+    }
+
+    if (&W != packed_tensor_ || W.raw_data() != packed_data_ ||
+        W.dims() != packed_dims_ || packed_.empty()) {
+      packed_.Pack(N, K, W.template data<float>(), TransposeWeight);
+      packed_tensor_ = &W;
+      packed_data_ = W.raw_data();
+      packed_dims_ = W.dims();
+    }
+    PackedGemm(
+        M,
+        X.template data<float>(),
+        packed_,
+        b.template data<float>(),
+        Y->template mutable_data<float>());
+    return true;
+  }
+
+ private:
+  size_t axis_{1};
+  size_t axis_w_{1};
+  int max_packed_batch_size_;
+  vector<TIndex> Y_shape_cache_;
+
+  PackedGemmMatrix packed_;
+  const TensorCPU* packed_tensor_{nullptr};
+  const void* packed_data_{nullptr};
+  vector<TIndex> packed_dims_;
+};
+
+REGISTER_CPU_OPERATOR_WITH_ENGINE(
+    FC,
+    PREPACKED,
+    PrepackedFullyConnectedOp<true>);
+REGISTER_CPU_OPERATOR_WITH_ENGINE(
+    FCTransposed,
+    PREPACKED,
+    PrepackedFullyConnectedOp<false>);
+
+} // namespace caffe2
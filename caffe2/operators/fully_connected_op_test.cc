@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <iostream>
 
 #include "caffe2/operators/fully_connected_op.h"
@@ -85,4 +86,91 @@ TEST(FullyConnectedTest, FCTransposedTest) {
   }
 }
 
+static void AddRandomInput(
+    const vector<TIndex>& shape,
+    const string& name,
+    Workspace* ws) {
+  DeviceOption option;
+  CPUContext context(option);
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(shape);
+  math::RandUniform<float, CPUContext>(
+      tensor->size(), -1, 1, tensor->mutable_data<float>(), &context);
+}
+
+static void ExpectSameOutputs(
+    const string& type,
+    const string& engine,
+    Workspace* ws) {
+  OperatorDef def;
+  def.set_type(type);
+  def.add_input("X");
+  def.add_input("W");
+  def.add_input("B");
+  def.add_output("Y");
+  unique_ptr<OperatorBase> op(CreateOperator(def, ws));
+  ASSERT_TRUE(op->Run());
+  def.set_engine(engine);
+  def.set_output(0, "Y_" + engine);
+  unique_ptr<OperatorBase> engine_op(CreateOperator(def, ws));
+  EXPECT_EQ(engine, engine_op->engine());
+  ASSERT_TRUE(engine_op->Run());
+  const auto& Y = ws->GetBlob("Y")->Get<TensorCPU>();
+  const auto& Y_engine = ws->GetBlob("Y_" + engine)->Get<TensorCPU>();
+  ASSERT_EQ(Y.dims(), Y_engine.dims());
+  for (int i = 0; i < Y.size(); ++i) {
+    EXPECT_NEAR(Y.data<float>()[i], Y_engine.data<float>()[i], 1e-3);
+  }
+}
+
+TEST(FullyConnectedTest, PrepackedEngine) {
+  // Covers partial panels of N, several K blocks, every row remainder and
+  // a batch large enough to go to math::Gemm.
+  for (const auto M : {1, 3, 4, 9, 20}) {
+    for (const auto N : {1, 8, 21}) {
+      for (const auto K : {1, 100, 600}) {
+        Workspace ws;
+        AddRandomInput(vector<TIndex>{M, K}, "X", &ws);
+        AddRandomInput(vector<TIndex>{N}, "B", &ws);
+        AddRandomInput(vector<TIndex>{N, K}, "W", &ws);
+        ExpectSameOutputs("FC", "PREPACKED", &ws);
+        AddRandomInput(vector<TIndex>{K, N}, "W", &ws);
+        ExpectSameOutputs("FCTransposed", "PREPACKED", &ws);
+      }
+    }
+  }
+}
+
+TEST(FullyConnectedTest, PrepackedEngineRepacksChangedWeights) {
+  Workspace ws;
+  AddConstInput(vector<TIndex>{2, 10}, 1., "X", &ws);
+  AddConstInput(vector<TIndex>{6, 10}, 1., "W", &ws);
+  AddConstInput(vector<TIndex>{6}, 0.1, "B", &ws);
+  OperatorDef def;
+  def.set_type("FC");
+  def.set_engine("PREPACKED");
+  def.add_input("X");
+  def.add_input("W");
+  def.add_input("B");
+  def.add_output("Y");
+  unique_ptr<OperatorBase> op(CreateOperator(def, &ws));
+  ASSERT_TRUE(op->Run());
+  const auto& Y = ws.GetBlob("Y")->Get<TensorCPU>();
+  EXPECT_FLOAT_EQ(10.1f, Y.data<float>()[0]);
+
+  // Feeding W with a tensor of its own must invalidate the packed weights...
+  auto* W = new TensorCPU(vector<TIndex>{6, 10});
+  std::fill(W->mutable_data<float>(), W->mutable_data<float>() + 60, 2.f);
+  ws.GetBlob("W")->Reset(W);
+  ASSERT_TRUE(op->Run());
+  EXPECT_FLOAT_EQ(20.1f, Y.data<float>()[0]);
+
+  // ...and so must reshaping it.
+  AddConstInput(vector<TIndex>{3, 10}, 3., "W", &ws);
+  AddConstInput(vector<TIndex>{3}, 0.1, "B", &ws);
+  ASSERT_TRUE(op->Run());
+  ASSERT_EQ(2 * 3, Y.size());
+  EXPECT_FLOAT_EQ(30.1f, Y.data<float>()[5]);
+}
+
 }  // namespace caffe2
@@ -0,0 +1,257 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/operators/elementwise_op.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/utils/parallel_for.h"
+
+namespace caffe2 {
+
+namespace {
+
+enum class FusedStepKind { ADD, SUB, MUL, DIV, RELU };
+
+FusedStepKind ParseFusedStepKind(const std::string& op) {
+  if (op == "Add") {
+    return FusedStepKind::ADD;
+  } else if (op == "Sub") {
+    return FusedStepKind::SUB;
+  } else if (op == "Mul") {
+    return FusedStepKind::MUL;
+  } else if (op == "Div") {
+    return FusedStepKind::DIV;
+  } else if (op == "Relu") {
+    return FusedStepKind::RELU;
+  }
+  CAFFE_THROW("Unsupported op in FusedElementwise: ", op);
+}
+
+// Items of X that are carried through all steps at once. Two blocks of this
+// size stay in L1 for every supported type.
+constexpr std::size_t kFusedBlockSize = 1024;
+
+// The second operand of a binary step, in the layout of the legacy broadcast
+// of the elementwise ops: item i of the running value is combined with
+// data[(i / post) % n].
+template <typename T>
+struct FusedOperand {
+  const T* data = nullptr;
+  bool full = true;
+  std::size_t n = 1;
+  std::size_t post = 1;
+
+  // Returns the len items of the operand that line up with [start,
+  // start + len) of the running value, expanded into scratch if needed.
+  const T* Block(std::size_t start, std::size_t len, T* scratch) const {
+    if (full) {
+      return data + start;
+    }
+    const std::size_t end = start + len;
+    for (std::size_t i = start; i < end;) {
+      const std::size_t run_end = std::min(end, (i / post + 1) * post);
+      std::fill(
+          scratch + (i - start),
+          scratch + (run_end - start),
+          data[(i / post) % n]);
+      i = run_end;
+    }
+    return scratch;
+  }
+};
+
+} // namespace
+
+// Runs a chain of elementwise operators as one loop over blocks of the
+// input, as produced by the FuseElementwise transform. The intermediate
+// results of the chain stay in a block sized buffer instead of being
+// written to and read back from full sized blobs.
+class FusedElementwiseOp final : public Operator<CPUContext> {
+ public:
+  FusedElementwiseOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws) {
+    const auto ops = GetRepeatedArgument<string>("ops");
+    CAFFE_ENFORCE(!ops.empty(), "FusedElementwise needs at least one op.");
+    const auto broadcast = GetRepeatedArgument<int>(
+        "broadcast", std::vector<int>(ops.size(), 0));
+    const auto axis =
+        GetRepeatedArgument<int>("axis", std::vector<int>(ops.size(), -1));
+    const auto reverse =
+        GetRepeatedArgument<int>("reverse", std::vector<int>(ops.size(), 0));
+    CAFFE_ENFORCE_EQ(broadcast.size(), ops.size());
+    CAFFE_ENFORCE_EQ(axis.size(), ops.size());
+    CAFFE_ENFORCE_EQ(reverse.size(), ops.size());
+
+    int next_input = 1;
+    for (int i = 0; i < ops.size(); ++i) {
+      Step step;
+      step.kind = ParseFusedStepKind(ops[i]);
+      step.broadcast = broadcast[i];
+      step.axis = axis[i];
+      step.reverse = reverse[i];
+      if (step.kind != FusedStepKind::RELU) {
+        step.input = next_input++;
+      }
+      CAFFE_ENFORCE(
+          !(step.broadcast && step.reverse),
+          "Only the second operand of ",
+          ops[i],
+          " can be broadcast.");
+      steps_.push_back(step);
+    }
+    CAFFE_ENFORCE_EQ(
+        next_input,
+        InputSize(),
+        "FusedElementwise takes X and one input per binary op.");
+  }
+
+  bool RunOnDevice() override {
+    return DispatchHelper<NumericTypes>::call(this, Input(0));
+  }
+
+  template <typename T>
+  bool DoRunWithType() {
+    const auto& X = Input(0);
+    // Y may share its blob with X, so the operands are looked at first.
+    std::vector<FusedOperand<T>> operands(steps_.size());
+    for (int i = 0; i < steps_.size(); ++i) {
+      const Step& step = steps_[i];
+      if (step.kind == FusedStepKind::RELU) {
+        continue;
+      }
+      const auto& B = Input(step.input);
+      auto& operand = operands[i];
+      operand.data = B.template data<T>();
+      if (!step.broadcast) {
+        CAFFE_ENFORCE_EQ(
+            X.dims(),
+            B.dims(),
+            "Dimension mismatch - did you forget to set broadcast=1?");
+      } else if (B.size() == 1) {
+        operand.full = false;
+      } else {
+        size_t pre;
+        std::tie(pre, operand.n, operand.post) =
+            calculate_broadcast_sizes(X, B, step.axis);
+        operand.full = false;
+      }
+    }
+
+    auto* Y = Output(0);
+    Y->ResizeLike(X);
+    const T* Xdata = X.template data<T>();
+    T* Ydata = Y->template mutable_data<T>();
+    context_.ParallelFor(
+        X.size(),
+        kMemoryBoundGrainSize,
+        [this, &operands, Xdata, Ydata](std::size_t begin, std::size_t end) {
+          T acc_data[kFusedBlockSize];
+          T scratch[kFusedBlockSize];
+          for (std::size_t start = begin; start < end;
+               start += kFusedBlockSize) {
+            const std::size_t len = std::min(kFusedBlockSize, end - start);
+            EigenVectorArrayMap<T> acc(acc_data, len);
+            acc = ConstEigenVectorArrayMap<T>(Xdata + start, len);
+            for (int i = 0; i < steps_.size(); ++i) {
+              const T* b = steps_[i].kind == FusedStepKind::RELU
+                  ? nullptr
+                  : operands[i].Block(start, len, scratch);
+              RunStep(steps_[i], b, len, acc_data);
+            }
+            EigenVectorArrayMap<T>(Ydata + start, len) = acc;
+          }
+        });
+    return true;
+  }
+
+ private:
+  struct Step {
+    FusedStepKind kind;
+    bool broadcast;
+    int axis;
+    // Whether the running value is the second operand of the op.
+    bool reverse;
+    int input = -1;
+  };
+
+  template <typename T>
+  static void
+  RunStep(const Step& step, const T* b, std::size_t len, T* acc_data) {
+    EigenVectorArrayMap<T> acc(acc_data, len);
+    if (step.kind == FusedStepKind::RELU) {
+      acc = acc.cwiseMax(T(0));
+      return;
+    }
+    ConstEigenVectorArrayMap<T> b_arr(b, len);
+    switch (step.kind) {
+      case FusedStepKind::ADD:
+        acc += b_arr;
+        break;
+      case FusedStepKind::SUB:
+        if (step.reverse) {
+          acc = b_arr - acc;
+        } else {
+          acc -= b_arr;
+        }
+        break;
+      case FusedStepKind::MUL:
+        acc *= b_arr;
+        break;
+      case FusedStepKind::DIV:
+        if (step.reverse) {
+          acc = b_arr / acc;
+        } else {
+          acc /= b_arr;
+        }
+        break;
+      default:
+        CAFFE_THROW("Unexpected step.");
+    }
+  }
+
+  std::vector<Step> steps_;
+};
+
+REGISTER_CPU_OPERATOR(FusedElementwise, FusedElementwiseOp);
+
+OPERATOR_SCHEMA(FusedElementwise)
+    .NumInputs(1, INT_MAX)
+    .NumOutputs(1)
+    .AllowInplace({{0, 0}})
+    .IdenticalTypeAndShapeOfInput(0)
+    .SetDoc(R"DOC(
+Runs a chain of Add, Sub, Mul, Div and Relu operators in one pass over X, as
+produced by the FuseElementwise transform. The first op reads X, every next op
+reads the result of the previous one. Binary ops take their other operand from
+the next input, in order, and follow the broadcast rules of the corresponding
+elementwise operator.
+)DOC")
+    .Arg("ops", "List of op types, applied in order.")
+    .Arg("broadcast", "Per op, whether its other operand is broadcast.")
+    .Arg("axis", "Per op, the broadcast axis, -1 for the default.")
+    .Arg(
+        "reverse",
+        "Per op, 1 if the running value is the second operand of a "
+        "non-broadcast Sub or Div.")
+    .Input(0, "X", "Input of the first op.")
+    .Output(0, "Y", "Output of the last op, with the shape of X.");
+
+SHOULD_NOT_DO_GRADIENT(FusedElementwise);
+
+} // namespace caffe2
@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+namespace {
+
+// Strips the "Relu" suffix of a fused type, e.g. ConvRelu -> Conv.
+std::string InnerOpType(const std::string& fused_type) {
+  const std::string suffix = "Relu";
+  CAFFE_ENFORCE(
+      fused_type.size() > suffix.size() &&
+          fused_type.compare(
+              fused_type.size() - suffix.size(), suffix.size(), suffix) == 0,
+      "Not a fused Relu operator type: ",
+      fused_type);
+  return fused_type.substr(0, fused_type.size() - suffix.size());
+}
+
+OperatorDef InnerOpDef(const OperatorDef& def) {
+  OperatorDef inner_def = def;
+  inner_def.set_type(InnerOpType(def.type()));
+  return inner_def;
+}
+
+} // namespace
+
+// Runs an operator and applies Relu to its output in place, right after the
+// operator has written it. The operator is created through the registry with
+// the same inputs, arguments and engine, so ConvRelu with engine WINOGRAD
+// runs the WINOGRAD Conv. It shares the workspace of the fused operator and
+// thus writes straight into the fused output. The Relu is a second pass over
+// that output: the fusion saves the separate Relu operator and its
+// intermediate blob, not the memory traffic of the pass.
+class FusedReluOp final : public Operator<CPUContext> {
+ public:
+  FusedReluOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws),
+        op_(CreateOperator(InnerOpDef(operator_def), ws)) {
+    CAFFE_ENFORCE_EQ(OutputSize(), 1);
+  }
+
+  void SetIntraOpThreadPool(
+      const std::shared_ptr<IntraOpThreadPool>& pool) override {
+    Operator<CPUContext>::SetIntraOpThreadPool(pool);
+    op_->SetIntraOpThreadPool(pool);
+  }
+
+  bool RunOnDevice() override {
+    if (!op_->Run()) {
+      return false;
+    }
+    auto* Y = Output(0);
+    CAFFE_ENFORCE(
+        Y->IsType<float>(), "Fused Relu only supports float outputs.");
+    float* Ydata = Y->mutable_data<float>();
+    context_.ParallelFor(
+        Y->size(),
+        kMemoryBoundGrainSize,
+        [Ydata](std::size_t begin, std::size_t end) {
+          EigenVectorArrayMap<float> Y_arr(Ydata + begin, end - begin);
+          Y_arr = Y_arr.cwiseMax(0.f);
+        });
+    return true;
+  }
+
+ private:
+  std::unique_ptr<OperatorBase> op_;
+};
+
+namespace {
+
+std::vector<TensorShape> FusedReluShapeInference(
+    const OperatorDef& def,
+    const std::vector<TensorShape>& in) {
+  const OperatorDef inner_def = InnerOpDef(def);
+  const OpSchema* schema = OpSchemaRegistry::Schema(inner_def.type());
+  CAFFE_ENFORCE(schema, "No schema for ", inner_def.type());
+  return schema->InferTensor(inner_def, in);
+}
+
+} // namespace
+
+REGISTER_CPU_OPERATOR(ConvRelu, FusedReluOp);
+REGISTER_CPU_OPERATOR(FCRelu, FusedReluOp);
+
+OPERATOR_SCHEMA(ConvRelu)
+    .NumInputs(2, 3)
+    .NumOutputs(1)
+    .TensorInferenceFunction(FusedReluShapeInference)
+    .SetDoc(R"DOC(
+Conv followed by Relu on its output, as produced by the FuseActivation
+transform. Takes the inputs and arguments of Conv, and the engine selects the
+Conv engine.
+)DOC")
+    .Input(0, "X", "Input data blob, see Conv.")
+    .Input(1, "filter", "The filter blob, see Conv.")
+    .Input(2, "bias", "Optional 1D bias blob, see Conv.")
+    .Output(0, "Y", "Relu of the Conv output.");
+
+OPERATOR_SCHEMA(FCRelu)
+    .NumInputs(3)
+    .NumOutputs(1)
+    .TensorInferenceFunction(FusedReluShapeInference)
+    .SetDoc(R"DOC(
+FC followed by Relu on its output, as produced by the FuseActivation
+transform. Takes the inputs and arguments of FC, and the engine selects the
+FC engine.
+)DOC")
+    .Input(0, "X", "Input blob, see FC.")
+    .Input(1, "W", "Weight blob, see FC.")
+    .Input(2, "b", "Bias blob, see FC.")
+    .Output(0, "Y", "Relu of the FC output.");
+
+SHOULD_NOT_DO_GRADIENT(ConvRelu);
+SHOULD_NOT_DO_GRADIENT(FCRelu);
+
+} // namespace caffe2
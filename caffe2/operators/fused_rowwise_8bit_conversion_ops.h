@@ -0,0 +1,141 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_OPERATORS_FUSED_ROWWISE_8BIT_CONVERSION_OPS_H_
+#define CAFFE2_OPERATORS_FUSED_ROWWISE_8BIT_CONVERSION_OPS_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+// Number of bytes at the end of each fused row holding its float scale and
+// float bias.
+constexpr int kFused8BitRowwiseScaleBiasSize = 2 * sizeof(float);
+// Added to the range of a row so that constant rows quantize to zeros.
+constexpr float kFused8BitRowwiseEpsilon = 1e-8f;
+
+template <class Context>
+class FloatToFused8BitRowwiseQuantizedOp : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  USE_SIMPLE_CTOR_DTOR(FloatToFused8BitRowwiseQuantizedOp)
+
+  bool RunOnDevice() override {
+    const auto& input = Input(DATA_FLOAT);
+    auto* output = Output(DATA_FUSED_SCALE_BIAS_INT8);
+
+    const auto input_rows = input.dim(0);
+    const auto input_columns = input.dim(1);
+    CAFFE_ENFORCE_EQ(input.ndim(), 2, "Expect input to be a matrix");
+
+    // The "fused" representation stores the scale and bias with the row-wise
+    // quantized data in one tensor. Since we quantize with 8 bits (1 byte)
+    // and represent the scale and bias with 32-bit floats, we'll use the last
+    // 8 bytes of each row for scale (4 bytes) and bias (4 bytes).
+    // | ... int8 data ... | scale | bias |
+    // | number_of_columns |  4B   |  4B  |
+    const std::vector<TIndex> output_dimensions = {
+        input_rows, input_columns + kFused8BitRowwiseScaleBiasSize};
+    output->Resize(output_dimensions);
+
+    const auto* input_data = input.template data<float>();
+    auto* output_data = output->template mutable_data<uint8_t>();
+    const auto output_columns = output->dim(1);
+
+    for (TIndex row = 0; row < input_rows; ++row) {
+      ConstEigenVectorArrayMap<float> input_row(
+          input_data + row * input_columns, input_columns);
+
+      uint8_t* output_row = output_data + row * output_columns;
+      EigenVectorArrayMap<uint8_t> output_row_values(output_row, input_columns);
+
+      const float minimum_element = input_row.minCoeff();
+      const float maximum_element = input_row.maxCoeff();
+      const float range = maximum_element - minimum_element;
+
+      // The scale and bias are not necessarily aligned to 4 bytes.
+      const float scale_bias[2] = {range / 255.0f, minimum_element};
+      memcpy(output_row + input_columns, scale_bias, sizeof(scale_bias));
+      const auto inverse_scale = 255.0f / (range + kFused8BitRowwiseEpsilon);
+      output_row_values = ((input_row - minimum_element) * inverse_scale)
+                              .round()
+                              .template cast<uint8_t>();
+    }
+
+    return true;
+  }
+
+ private:
+  INPUT_TAGS(DATA_FLOAT);
+  OUTPUT_TAGS(DATA_FUSED_SCALE_BIAS_INT8);
+};
+
+template <class Context>
+class Fused8BitRowwiseQuantizedToFloatOp : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  USE_SIMPLE_CTOR_DTOR(Fused8BitRowwiseQuantizedToFloatOp)
+
+  bool RunOnDevice() override {
+    const auto& input = Input(DATA_FUSED_SCALE_BIAS_INT8);
+    auto* output = Output(DATA_FLOAT);
+
+    const auto input_rows = input.dim(0);
+    const auto input_columns = input.dim(1);
+    CAFFE_ENFORCE_EQ(input.ndim(), 2, "Expect input to be a matrix");
+    CAFFE_ENFORCE_GT(
+        input_columns,
+        kFused8BitRowwiseScaleBiasSize,
+        "Expect input to have more columns than the fused scale and bias");
+
+    // The last 8 bytes per row are the scale and the bias. The rest of
+    // input_columns is the number of values in the original row.
+    const std::vector<TIndex> output_dimensions = {
+        input_rows, input_columns - kFused8BitRowwiseScaleBiasSize};
+    output->Resize(output_dimensions);
+    const auto output_columns = output->dim(1);
+
+    const auto* input_data = input.template data<uint8_t>();
+    auto* output_data = output->template mutable_data<float>();
+
+    for (TIndex row = 0; row < input_rows; ++row) {
+      const uint8_t* input_row = input_data + row * input_columns;
+      ConstEigenVectorArrayMap<uint8_t> input_row_values(
+          input_row, output_columns);
+      // The scale and bias are not necessarily aligned to 4 bytes.
+      float scale_bias[2];
+      memcpy(scale_bias, input_row + output_columns, sizeof(scale_bias));
+
+      EigenVectorArrayMap<float> output_row(
+          output_data + row * output_columns, output_columns);
+
+      output_row = input_row_values.template cast<float>() * scale_bias[0] +
+          scale_bias[1];
+    }
+    return true;
+  }
+
+ private:
+  INPUT_TAGS(DATA_FUSED_SCALE_BIAS_INT8);
+  OUTPUT_TAGS(DATA_FLOAT);
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_OPERATORS_FUSED_ROWWISE_8BIT_CONVERSION_OPS_H_
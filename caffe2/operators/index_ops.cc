@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 
+#include <array>
 #include <atomic>
+#include <cstring>
 #include <limits>
 #include <mutex>
 #include <sstream>
@@ -28,6 +30,43 @@ namespace caffe2 {
 namespace {
 using IndexKeyTypes = TensorTypes<int32_t, int64_t, std::string>;
 using TIndexValue = int64_t;
+
+inline uint64_t MixHash(uint64_t h) {
+  // Finalizer of splitmix64.
+  h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+  return h ^ (h >> 31);
+}
+
+// Hashes used by frozen indexes. Unlike std::hash they are the same on every
+// platform, so that frozen tables can be serialized.
+inline uint64_t FrozenHash(int32_t key) {
+  return MixHash(static_cast<uint32_t>(key));
+}
+
+inline uint64_t FrozenHash(int64_t key) {
+  return MixHash(static_cast<uint64_t>(key));
+}
+
+inline uint64_t FrozenHash(const std::string& key) {
+  uint64_t h = key.size();
+  const char* data = key.data();
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= key.size(); i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data + i, sizeof(word));
+    h = MixHash(h ^ word);
+  }
+  uint64_t tail = 0;
+  memcpy(&tail, data + i, key.size() - i);
+  return MixHash(h ^ tail);
+}
+
+inline void PrefetchForRead(const void* address) {
+#ifdef __GNUC__
+  __builtin_prefetch(address, 0, 3);
+#endif
+}
 }  // namespace
 
 struct IndexBase {
@@ -37,7 +76,7 @@ struct IndexBase {
     , meta_(type)
     , frozen_{false} {}
 
-  void Freeze() { frozen_ = true; }
+  virtual void Freeze() { frozen_ = true; }
 
   bool isFrozen() const {
     return frozen_;
@@ -52,18 +91,41 @@ struct IndexBase {
   const TypeMeta& Type() const { return meta_; }
 
   TIndexValue Size() {
-    std::lock_guard<std::mutex> guard(dictMutex_);
-    return nextId_;
+    return nextId_.load();
   }
 
  protected:
+  // Atomically reserves the next id, failing once maxElements is reached.
+  // Callers must hold the lock of the shard the new key is inserted into, so
+  // that ids are only handed out for keys that actually get inserted.
+  bool ReserveId(TIndexValue* id) {
+    auto next = nextId_.load();
+    while (next < maxElements_) {
+      if (nextId_.compare_exchange_weak(next, next + 1)) {
+        *id = next;
+        return true;
+      }
+    }
+    return false;
+  }
+
   int64_t maxElements_;
   TypeMeta meta_;
-  TIndexValue nextId_{1}; // guarded by dictMutex_
+  std::atomic<TIndexValue> nextId_{1};
   std::atomic<bool> frozen_{false};
-  std::mutex dictMutex_;
 };
 
+// The dictionary is split into a fixed number of shards, each guarded by its
+// own mutex, so that concurrent IndexGet calls on an unfrozen index only
+// contend when they hit the same shard. Each shard grows on its own, which
+// also spreads rehashing cost over time. Ids are handed out from a single
+// atomic counter and stay consecutive.
+//
+// Freezing replaces the shards by two flat arrays: the keys in id order, and
+// an open addressing table with linear probing whose 64-bit slots hold the id
+// of a key in the low half and the top bits of its hash in the high half, so
+// that probes rarely touch a key that does not match. Ids must fit in 32 bits
+// to be frozen this way.
 template<typename T>
 struct Index: IndexBase {
   explicit Index(TIndexValue maxElements)
@@ -74,63 +136,227 @@ struct Index: IndexBase {
       FrozenGet(keys, values, numKeys);
       return;
     }
-    std::lock_guard<std::mutex> lock(dictMutex_);
     for (int i = 0; i < numKeys; ++i) {
-      auto it = dict_.find(keys[i]);
-      if (it != dict_.end()) {
+      auto& shard = shards_[ShardOf(keys[i])];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto it = shard.dict.find(keys[i]);
+      if (it != shard.dict.end()) {
         values[i] = it->second;
-      } else if (nextId_ < maxElements_) {
-        auto newValue = nextId_++;
-        dict_.insert({keys[i], newValue});
-        values[i] = newValue;
       } else {
-        CAFFE_THROW("Dict max size reached");
+        TIndexValue newValue;
+        if (!ReserveId(&newValue)) {
+          CAFFE_THROW("Dict max size reached");
+        }
+        shard.dict.insert({keys[i], newValue});
+        values[i] = newValue;
       }
     }
   }
 
+  void Freeze() override {
+    if (!frozen_) {
+      BuildFrozenTable();
+      frozen_ = true;
+    }
+  }
+
   bool Load(const T* keys, size_t numKeys) {
     CAFFE_ENFORCE(
         numKeys <= maxElements_,
         "Cannot load index: Tensor is larger than max_elements.");
-    decltype(dict_) dict;
+    std::array<std::unordered_map<T, TIndexValue>, kNumShards> dicts;
     for (int i = 0; i < numKeys; ++i) {
       CAFFE_ENFORCE(
-          dict.insert({keys[i], i + 1}).second,
+          dicts[ShardOf(keys[i])].insert({keys[i], i + 1}).second,
           "Repeated elements found: cannot load into dictionary.");
     }
     // assume no `get` is inflight while this happens
     {
-      std::lock_guard<std::mutex> lock(dictMutex_);
-      // let the old dict get destructed outside of the lock
-      dict_.swap(dict);
+      auto locks = LockAllShards();
+      // let the old dicts get destructed outside of the lock
+      for (int i = 0; i < kNumShards; ++i) {
+        shards_[i].dict.swap(dicts[i]);
+      }
       nextId_ = numKeys + 1;
     }
+    if (frozen_) {
+      BuildFrozenTable();
+    }
+    return true;
+  }
+
+  // Loads keys together with the table that was stored when they were
+  // frozen, which skips hashing the keys again. The index becomes frozen.
+  bool LoadFrozen(
+      const T* keys,
+      size_t numKeys,
+      const uint64_t* table,
+      size_t tableSize) {
+    CAFFE_ENFORCE(
+        numKeys <= maxElements_,
+        "Cannot load index: Tensor is larger than max_elements.");
+    CAFFE_ENFORCE(
+        tableSize > numKeys && (tableSize & (tableSize - 1)) == 0,
+        "Invalid frozen index table of size ",
+        tableSize,
+        " for ",
+        numKeys,
+        " keys.");
+    size_t numUsedSlots = 0;
+    for (size_t i = 0; i < tableSize; ++i) {
+      const auto id = SlotId(table[i]);
+      CAFFE_ENFORCE_LE(id, numKeys, "Invalid frozen index table.");
+      numUsedSlots += id != 0;
+    }
+    CAFFE_ENFORCE_EQ(numUsedSlots, numKeys, "Invalid frozen index table.");
+    {
+      auto locks = LockAllShards();
+      for (auto& shard : shards_) {
+        std::unordered_map<T, TIndexValue>().swap(shard.dict);
+      }
+      frozenKeys_.assign(keys, keys + numKeys);
+      frozenTable_.assign(table, table + tableSize);
+      frozenMask_ = tableSize - 1;
+      nextId_ = numKeys + 1;
+    }
+    frozen_ = true;
     return true;
   }
 
   template<typename Ctx>
   bool Store(Tensor<Ctx>* out) {
-    std::lock_guard<std::mutex> lock(dictMutex_);
+    auto locks = LockAllShards();
     out->Resize(nextId_ - 1);
     auto outData = out->template mutable_data<T>();
-    for (const auto& entry : dict_) {
-      outData[entry.second - 1] = entry.first;
+    if (frozen_) {
+      std::copy(frozenKeys_.begin(), frozenKeys_.end(), outData);
+      return true;
+    }
+    for (const auto& shard : shards_) {
+      for (const auto& entry : shard.dict) {
+        outData[entry.second - 1] = entry.first;
+      }
     }
     return true;
   }
 
+  // The table of a frozen index, empty if the index is not frozen.
+  const std::vector<uint64_t>& FrozenTable() const {
+    return frozenTable_;
+  }
+
  private:
+  static constexpr int kNumShardBits = 6;
+  static constexpr int kNumShards = 1 << kNumShardBits;
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<T, TIndexValue> dict;
+  };
+
+  // Uses the top bits of a multiplicative hash so that shard selection stays
+  // independent of the bucket selection done inside each unordered_map.
+  static int ShardOf(const T& key) {
+    uint64_t h = std::hash<T>()(key);
+    return static_cast<int>(
+        (h * 0x9E3779B97F4A7C15ULL) >> (64 - kNumShardBits));
+  }
+
+  std::vector<std::unique_lock<std::mutex>> LockAllShards() {
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(kNumShards);
+    for (auto& shard : shards_) {
+      locks.emplace_back(shard.mutex);
+    }
+    return locks;
+  }
+
+  // Number of keys whose slots are prefetched before the first one is probed.
+  static constexpr int kFrozenGetBatch = 16;
+
+  static uint64_t SlotId(uint64_t slot) {
+    return slot & 0xffffffffULL;
+  }
+
+  static uint64_t SlotTag(uint64_t hash) {
+    return hash & ~0xffffffffULL;
+  }
+
+  // Moves the keys out of the shards into the flat frozen arrays.
+  void BuildFrozenTable() {
+    auto locks = LockAllShards();
+    const size_t numKeys = nextId_ - 1;
+    CAFFE_ENFORCE_LE(
+        numKeys,
+        std::numeric_limits<uint32_t>::max(),
+        "Index too large to be frozen.");
+    std::vector<T> keys(numKeys);
+    for (auto& shard : shards_) {
+      for (const auto& entry : shard.dict) {
+        keys[entry.second - 1] = entry.first;
+      }
+      std::unordered_map<T, TIndexValue>().swap(shard.dict);
+    }
+    // Keep the load factor at most 3/4.
+    size_t tableSize = 16;
+    while (tableSize * 3 < numKeys * 4) {
+      tableSize *= 2;
+    }
+    std::vector<uint64_t> table(tableSize, 0);
+    const size_t mask = tableSize - 1;
+    for (size_t i = 0; i < numKeys; ++i) {
+      const uint64_t hash = FrozenHash(keys[i]);
+      size_t pos = hash & mask;
+      while (table[pos] != 0) {
+        pos = (pos + 1) & mask;
+      }
+      table[pos] = SlotTag(hash) | (i + 1);
+    }
+    frozenKeys_.swap(keys);
+    frozenTable_.swap(table);
+    frozenMask_ = mask;
+  }
+
   void FrozenGet(const T* keys, TIndexValue* values, size_t numKeys) {
-    for (int i = 0; i < numKeys; ++i) {
-      auto it = dict_.find(keys[i]);
-      values[i] = it != dict_.end() ? it->second : 0;
+    const uint64_t* table = frozenTable_.data();
+    std::array<uint64_t, kFrozenGetBatch> hashes;
+    for (size_t begin = 0; begin < numKeys; begin += kFrozenGetBatch) {
+      const size_t batchSize =
+          std::min<size_t>(kFrozenGetBatch, numKeys - begin);
+      for (size_t i = 0; i < batchSize; ++i) {
+        hashes[i] = FrozenHash(keys[begin + i]);
+        PrefetchForRead(table + (hashes[i] & frozenMask_));
+      }
+      for (size_t i = 0; i < batchSize; ++i) {
+        const uint64_t tag = SlotTag(hashes[i]);
+        size_t pos = hashes[i] & frozenMask_;
+        TIndexValue value = 0;
+        for (uint64_t slot = table[pos]; slot != 0;
+             pos = (pos + 1) & frozenMask_, slot = table[pos]) {
+          const auto id = SlotId(slot);
+          if (SlotTag(slot) == tag && frozenKeys_[id - 1] == keys[begin + i]) {
+            value = id;
+            break;
+          }
+        }
+        values[begin + i] = value;
+      }
     }
   }
 
-  std::unordered_map<T, TIndexValue> dict_;
+  std::array<Shard, kNumShards> shards_;
+
+  // Only used once the index is frozen.
+  std::vector<T> frozenKeys_;
+  std::vector<uint64_t> frozenTable_;
+  size_t frozenMask_{0};
 };
 
+template <typename T>
+constexpr int Index<T>::kNumShards;
+template <typename T>
+constexpr int Index<T>::kFrozenGetBatch;
+
 // TODO(azzolini): support sizes larger than int32
 template<class T>
 class IndexCreateOp: public Operator<CPUContext> {
@@ -195,6 +421,15 @@ class IndexLoadOp: public Operator<CPUContext> {
       ++keys_data;
       --keys_size;
     }
+    // IndexStore writes an empty table for an index that is not frozen.
+    if (InputSize() > 2 && Input(2).size() > 0) {
+      const auto& table = Input(2);
+      return dict->LoadFrozen(
+          keys_data,
+          keys_size,
+          reinterpret_cast<const uint64_t*>(table.data<int64_t>()),
+          table.size());
+    }
     return dict->Load(keys_data, keys_size);
   }
 
@@ -217,6 +452,15 @@ class IndexStoreOp: public Operator<CPUContext> {
     auto& base = OperatorBase::Input<std::unique_ptr<IndexBase>>(0);
     auto* dict = dynamic_cast_if_rtti<Index<T>*>(base.get());
     CAFFE_ENFORCE(dict);
+    if (OutputSize() > 1) {
+      const auto& table = dict->FrozenTable();
+      auto* out = Output(1);
+      out->Resize(table.size());
+      std::copy(
+          table.begin(),
+          table.end(),
+          reinterpret_cast<uint64_t*>(out->template mutable_data<int64_t>()));
+    }
     return dict->Store(Output(0));
   }
 };
@@ -295,6 +539,7 @@ Given an index handle and a tensor of keys, return an Int tensor of same shape
 containing the indices for each of the keys. If the index is frozen, unknown
 entries are given index 0. Otherwise, new entries are added into the index.
 If an insert is necessary but max_elements has been reached, fail.
+Multiple IndexGet ops may run concurrently on the same index.
 )DOC")
   .Input(0, "handle", "Pointer to an Index instance.")
   .Input(1, "keys", "Tensor of keys to be looked up.")
@@ -306,20 +551,29 @@ OPERATOR_SCHEMA(IndexFreeze)
     .SetDoc(R"DOC(
 Freezes the given index, disallowing creation of new index entries.
 Should not be called concurrently with IndexGet.
+
+Freezing moves the keys into a flat, read-only hash table which IndexGet
+probes without locks, prefetching the slots of several keys at once.
 )DOC")
     .Input(0, "handle", "Pointer to an Index instance.")
     .Output(0, "handle", "The input handle.")
     .EnforceInplace({{0, 0}});
 
 OPERATOR_SCHEMA(IndexLoad)
-    .NumInputs(2)
+    .NumInputs(2, 3)
     .NumOutputs(1)
     .SetDoc(R"DOC(
 Loads the index from the given 1-D tensor. Elements in the tensor will be given
 consecutive indexes starting at 1. Fails if tensor contains repeated elements.
+
+If the table stored by IndexStore for a frozen index is given as well, the
+index is loaded frozen without rebuilding its hash table. The elements are
+then trusted to be the ones the table was stored with. An empty table, as
+stored for an index that was not frozen, is ignored.
 )DOC")
     .Input(0, "handle", "Pointer to an Index instance.")
     .Input(1, "items", "1-D tensor with elements starting with index 1.")
+    .Input(2, "table", "Optional hash table of the frozen index.")
     .Output(0, "handle", "The input handle.")
     .EnforceInplace({{0, 0}})
     .Arg(
@@ -330,13 +584,18 @@ consecutive indexes starting at 1. Fails if tensor contains repeated elements.
 
 OPERATOR_SCHEMA(IndexStore)
   .NumInputs(1)
-  .NumOutputs(1)
+  .NumOutputs(1, 2)
   .SetDoc(R"DOC(
 Stores the keys of this index in a 1-D tensor. Since element 0 is reserved
 for unknowns, the first element of the output tensor will be element of index 1.
 )DOC")
   .Input(0, "handle", "Pointer to an Index instance.")
-  .Output(0, "items", "1-D tensor with elements starting with index 1.");
+  .Output(0, "items", "1-D tensor with elements starting with index 1.")
+  .Output(
+      1,
+      "table",
+      "Optional int64 tensor with the hash table of a frozen index, to be "
+      "given to IndexLoad. Empty if the index is not frozen.");
 
 OPERATOR_SCHEMA(IndexSize)
     .NumInputs(1)
@@ -368,13 +627,14 @@ class IndexSerializer : public BlobSerializerBase {
     auto& base = blob.template Get<std::unique_ptr<IndexBase>>();
     Blob tensor_blob;
     auto* tensor_out = tensor_blob.template GetMutable<Tensor<CPUContext>>();
+    std::vector<uint64_t> frozenTable;
 
     if (base->Type().Match<std::string>()) {
-      doStore<std::string>(base, tensor_out);
+      doStore<std::string>(base, tensor_out, &frozenTable);
     } else if (base->Type().Match<int32_t>()) {
-      doStore<int32_t>(base, tensor_out);
+      doStore<int32_t>(base, tensor_out, &frozenTable);
     } else if (base->Type().Match<int64_t>()) {
-      doStore<int64_t>(base, tensor_out);
+      doStore<int64_t>(base, tensor_out, &frozenTable);
     } else {
       CAFFE_THROW("Index of this type can't be serialized.");
     }
@@ -389,8 +649,16 @@ class IndexSerializer : public BlobSerializerBase {
     blob_proto.set_name(name);
     blob_proto.set_type("std::unique_ptr<caffe2::IndexBase>");
 
+    // A frozen index also stores its hash table, as raw bytes following the
+    // header line.
     std::ostringstream os;
     os << base->maxElements() << " " << base->isFrozen();
+    if (base->isFrozen()) {
+      os << " " << frozenTable.size() << "\n";
+      os.write(
+          reinterpret_cast<const char*>(frozenTable.data()),
+          frozenTable.size() * sizeof(uint64_t));
+    }
     blob_proto.set_content(os.str());
 
     acceptor(name, blob_proto.SerializeAsString());
@@ -400,10 +668,12 @@ class IndexSerializer : public BlobSerializerBase {
   template <typename T>
   void doStore(
       const std::unique_ptr<IndexBase>& base,
-      Tensor<CPUContext>* tensor_out) {
+      Tensor<CPUContext>* tensor_out,
+      std::vector<uint64_t>* frozenTable) {
     auto* dict = dynamic_cast_if_rtti<Index<T>*>(base.get());
     CAFFE_ENFORCE(dict, "Wrong dictionary type.");
     dict->Store(tensor_out);
+    *frozenTable = dict->FrozenTable();
   }
 };
 
@@ -414,20 +684,37 @@ class IndexDeserializer : public BlobDeserializerBase {
     Blob tensor_blob;
     deser.Deserialize(proto, &tensor_blob);
 
-    std::istringstream is(proto.content());
+    const auto& content = proto.content();
+    std::istringstream is(content);
     int64_t maxElements{std::numeric_limits<int64_t>::max()};
     bool isFrozen{false};
     is >> maxElements >> isFrozen;
+    // Frozen indexes saved before their tables were serialized are frozen
+    // again after loading.
+    std::vector<uint64_t> frozenTable;
+    size_t tableSize = 0;
+    if (isFrozen && is >> tableSize) {
+      const size_t tableBegin = static_cast<size_t>(is.tellg()) + 1;
+      CAFFE_ENFORCE_EQ(
+          content.size() - tableBegin,
+          tableSize * sizeof(uint64_t),
+          "Corrupted frozen index table.");
+      frozenTable.resize(tableSize);
+      memcpy(
+          frozenTable.data(),
+          content.data() + tableBegin,
+          tableSize * sizeof(uint64_t));
+    }
 
     auto& tensor_in = tensor_blob.template Get<Tensor<CPUContext>>();
     auto* base = blob->template GetMutable<std::unique_ptr<IndexBase>>();
 
     if (tensor_in.IsType<std::string>()) {
-      doLoad<std::string>(base, maxElements, tensor_in);
+      doLoad<std::string>(base, maxElements, tensor_in, frozenTable);
     } else if (tensor_in.IsType<int32_t>()) {
-      doLoad<int32_t>(base, maxElements, tensor_in);
+      doLoad<int32_t>(base, maxElements, tensor_in, frozenTable);
     } else if (tensor_in.IsType<int64_t>()) {
-      doLoad<int64_t>(base, maxElements, tensor_in);
+      doLoad<int64_t>(base, maxElements, tensor_in, frozenTable);
     } else {
       CAFFE_THROW("Index of this type cannot be deserialized.");
     }
@@ -442,9 +729,18 @@ class IndexDeserializer : public BlobDeserializerBase {
   void doLoad(
       std::unique_ptr<IndexBase>* base,
       int64_t maxElements,
-      const Tensor<CPUContext>& tensor_in) {
+      const Tensor<CPUContext>& tensor_in,
+      const std::vector<uint64_t>& frozenTable) {
     base->reset(new Index<T>(maxElements));
     auto* dict = dynamic_cast_if_rtti<Index<T>*>(base->get());
+    if (!frozenTable.empty()) {
+      dict->LoadFrozen(
+          tensor_in.data<T>(),
+          tensor_in.size(),
+          frozenTable.data(),
+          frozenTable.size());
+      return;
+    }
     dict->Load(tensor_in.data<T>(), tensor_in.size());
   }
 };
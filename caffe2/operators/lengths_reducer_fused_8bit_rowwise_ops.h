@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_OPERATORS_LENGTHS_REDUCER_FUSED_8BIT_ROWWISE_OPS_H_
+#define CAFFE2_OPERATORS_LENGTHS_REDUCER_FUSED_8BIT_ROWWISE_OPS_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/operators/embedding_lookup_prefetch_tuner.h"
+#include "caffe2/operators/fused_rowwise_8bit_conversion_ops.h"
+#include "caffe2/perfkernels/fused_8bit_rowwise_embedding_lookup.h"
+
+namespace caffe2 {
+
+template <class Context, bool with_weights = 0, bool is_mean = 0>
+class SparseLengthsFused8BitRowwiseOp : public Operator<Context> {
+ public:
+  static_assert(
+      !(with_weights && is_mean),
+      "Cannot have with_weights and is_mean at the same time");
+
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  SparseLengthsFused8BitRowwiseOp(const OperatorDef& def, Workspace* ws)
+      : Operator<Context>(def, ws), prefetch_distance_(*this) {}
+
+  bool RunOnDevice() override {
+    return DispatchHelper<TensorTypes<int32_t, int64_t>>::call(
+        this, Input(INDICES));
+  }
+
+  template <typename IndexType>
+  bool DoRunWithType() {
+    const auto& data = Input(DATA);
+    const auto& indices = Input(INDICES);
+    const auto& lengths = Input(LENGTHS);
+    auto* output = Output(0);
+
+    CAFFE_ENFORCE_EQ(indices.ndim(), 1, "INDICES must be a vector");
+    CAFFE_ENFORCE_EQ(lengths.ndim(), 1, "LENGTHS must be a vector");
+    CAFFE_ENFORCE_EQ(data.ndim(), 2, "DATA must be a matrix");
+    CAFFE_ENFORCE_GT(
+        data.dim(1),
+        kFused8BitRowwiseScaleBiasSize,
+        "DATA must have more columns than the fused scale and bias");
+
+    const float* weights = nullptr;
+    if (with_weights) {
+      const auto& weights_input = Input(WEIGHTS);
+      CAFFE_ENFORCE_EQ(weights_input.ndim(), 1, "WEIGHTS must be a vector");
+      CAFFE_ENFORCE_EQ(
+          weights_input.size(),
+          indices.size(),
+          "WEIGHTS should have the same length as INDICES.");
+      weights = weights_input.template data<float>();
+    }
+
+    // Subtract 8 from the #columns of data for the 4 bytes for scale and 4
+    // bytes for bias that we use in the fused representation (per row).
+    output->Resize(
+        lengths.dim(0), data.dim(1) - kFused8BitRowwiseScaleBiasSize);
+
+    prefetch_distance_.Run(
+        "fused_8bit_rowwise",
+        output->dim(1),
+        data.dim(0),
+        indices.size(),
+        [&](int prefetch_distance) {
+          Fused8BitRowwiseEmbeddingLookup(
+              /*block_size=*/output->dim(1),
+              /*output_size=*/output->dim(0),
+              /*index_size=*/indices.size(),
+              /*data_size=*/data.dim(0),
+              /*input=*/data.template data<uint8_t>(),
+              /*indices=*/indices.template data<IndexType>(),
+              /*lengths=*/lengths.template data<int>(),
+              /*weights=*/weights,
+              /*normalize_by_lengths=*/is_mean,
+              /*out=*/output->template mutable_data<float>(),
+              /*prefetch_distance=*/prefetch_distance);
+        });
+
+    return true;
+  }
+
+  enum {
+    DATA = 0,
+    WEIGHTS = 1,
+    INDICES = 1 + with_weights,
+    LENGTHS = 2 + with_weights,
+  };
+
+ private:
+  EmbeddingLookupPrefetchDistance prefetch_distance_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_OPERATORS_LENGTHS_REDUCER_FUSED_8BIT_ROWWISE_OPS_H_
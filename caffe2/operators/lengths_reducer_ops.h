@@ -17,6 +17,7 @@
 #pragma once
 #include "caffe2/core/context.h"
 #include "caffe2/core/operator.h"
+#include "caffe2/operators/embedding_lookup_prefetch_tuner.h"
 #include "caffe2/perfkernels/embedding_lookup.h"
 
 namespace caffe2 {
@@ -32,7 +33,7 @@ class CPUSparseLengthsReductionOp : public Operator<CPUContext> {
  public:
   USE_OPERATOR_FUNCTIONS(CPUContext);
   CPUSparseLengthsReductionOp(const OperatorDef& operator_def, Workspace* ws)
-      : Operator<CPUContext>(operator_def, ws) {
+      : Operator<CPUContext>(operator_def, ws), prefetch_distance_(*this) {
     static_assert(
         !(USE_WEIGHT & USE_MEAN), "Cannot both specify weight and mean.");
   }
@@ -87,22 +88,32 @@ class CPUSparseLengthsReductionOp : public Operator<CPUContext> {
     }
 
     // delegate work to perfkernel that branches based on architecture
-    EmbeddingLookup(
+    prefetch_distance_.Run(
+        TypeMeta::Name<InputType>(),
         D,
-        M,
-        indices_size,
         N,
-        in_data,
-        indices,
-        lengths,
-        in_weight,
-        nullptr, // scale_bias field is only used in SparseLengths8BitsRowwiseOp
-        USE_MEAN,
-        out_data);
+        indices_size,
+        [&](int prefetch_distance) {
+          EmbeddingLookup(
+              D,
+              M,
+              indices_size,
+              N,
+              in_data,
+              indices,
+              lengths,
+              in_weight,
+              nullptr, // scale_bias is only used in SparseLengths8BitsRowwiseOp
+              USE_MEAN,
+              out_data,
+              prefetch_distance);
+        });
     return true;
   }
 
  private:
+  EmbeddingLookupPrefetchDistance prefetch_distance_;
+
   enum {
     DATA = 0, // Data input.
     WEIGHT = 1, // Weight input used in SparseLengthsWeightedSum
@@ -45,6 +45,10 @@ REGISTER_CPU_OPERATOR(
 OPERATOR_SCHEMA(SparseLengthsSum8BitsRowwise)
     .NumInputs(4)
     .NumOutputs(1)
+    .Arg(
+        "prefetch_distance",
+        "Optional int argument: how many indices ahead rows of DATA are "
+        "prefetched. By default it is autotuned once per shape of DATA.")
     .SetDoc(R"DOC(Variation of SparseLengthsSum operator, where DATA is
     stored using 8bits. DATA was quantized with 8Bit row-wise
     quantization (see doc to FloatToRowwiseQuantized8Bits operator). To
@@ -75,6 +79,10 @@ OPERATOR_SCHEMA(SparseLengthsSum8BitsRowwise)
 OPERATOR_SCHEMA(SparseLengthsWeightedSum8BitsRowwise)
     .NumInputs(5)
     .NumOutputs(1)
+    .Arg(
+        "prefetch_distance",
+        "Optional int argument: how many indices ahead rows of DATA are "
+        "prefetched. By default it is autotuned once per shape of DATA.")
     .SetDoc(R"DOC(Variation of SparseLengthsWeightedSum operator, where
     DATA is stored using 8bits. DATA was quantized with 8Bit row-wise
     quantization (see doc to FloatToRowwiseQuantized8Bits operator). To
@@ -109,6 +117,10 @@ OPERATOR_SCHEMA(SparseLengthsWeightedSum8BitsRowwise)
 OPERATOR_SCHEMA(SparseLengthsMean8BitsRowwise)
     .NumInputs(4)
     .NumOutputs(1)
+    .Arg(
+        "prefetch_distance",
+        "Optional int argument: how many indices ahead rows of DATA are "
+        "prefetched. By default it is autotuned once per shape of DATA.")
     .SetDoc(R"DOC(Variation of SparseLengthsMean operator, where DATA is
     stored using 8bits. DATA was quantized with 8Bit row-wise
     quantization (see doc to FloatToRowwiseQuantized8Bits operator). To
@@ -139,6 +151,10 @@ OPERATOR_SCHEMA(SparseLengthsMean8BitsRowwise)
 OPERATOR_SCHEMA(SparseLengthsWeightedMean8BitsRowwise)
     .NumInputs(5)
     .NumOutputs(1)
+    .Arg(
+        "prefetch_distance",
+        "Optional int argument: how many indices ahead rows of DATA are "
+        "prefetched. By default it is autotuned once per shape of DATA.")
     .SetDoc(R"DOC(Variation of SparseLengthsWeightedMean operator, where
     DATA is stored using 8bits. DATA was quantized with 8Bit row-wise
     quantization (see doc to FloatToRowwiseQuantized8Bits operator). To
@@ -22,6 +22,7 @@
 #include "caffe2/core/context.h"
 #include "caffe2/core/logging.h"
 #include "caffe2/core/operator.h"
+#include "caffe2/operators/embedding_lookup_prefetch_tuner.h"
 #include "caffe2/operators/reducer_functors.h"
 #include "caffe2/perfkernels/embedding_lookup.h"
 #include "caffe2/utils/math.h"
@@ -40,7 +41,8 @@ template <
 class SparseLengths8BitsRowwiseOp : public Operator<Context> {
  public:
   USE_OPERATOR_CONTEXT_FUNCTIONS;
-  USE_SIMPLE_CTOR_DTOR(SparseLengths8BitsRowwiseOp);
+  SparseLengths8BitsRowwiseOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws), prefetch_distance_(*this) {}
 
   bool RunOnDevice() override {
     return DispatchHelper<TensorTypes<int32_t, int64_t>>::call(
@@ -86,18 +88,26 @@ class SparseLengths8BitsRowwiseOp : public Operator<Context> {
     // delegate work to perfkernel that branches based on architecture
     const TIndex indices_size = indicesInput.size();
     const TIndex N = dataInput.dim(0);
-    EmbeddingLookup(
+    prefetch_distance_.Run(
+        "uint8_rowwise",
         in_block_size,
-        outputSize,
+        N,
         indices_size,
-        N, // embeding table length
-        input_data,
-        indices,
-        lengths,
-        w,
-        scale_bias,
-        USE_MEAN,
-        out);
+        [&](int prefetch_distance) {
+          EmbeddingLookup(
+              in_block_size,
+              outputSize,
+              indices_size,
+              N, // embeding table length
+              input_data,
+              indices,
+              lengths,
+              w,
+              scale_bias,
+              USE_MEAN,
+              out,
+              prefetch_distance);
+        });
 
     return true;
   }
@@ -109,6 +119,9 @@ class SparseLengths8BitsRowwiseOp : public Operator<Context> {
     LENGTHS = 2 + USE_WEIGHTS,
     SCALE_BIAS = 3 + USE_WEIGHTS
   };
+
+ private:
+  EmbeddingLookupPrefetchDistance prefetch_distance_;
 };
 
 template <class Context>
@@ -58,6 +58,12 @@ If at least one input is passed, then it is assumed that that input blobs are a
 set of DBReaders to load from. Otherwise the db or dbs argument is used to load
 blobs from one single db or multiple dbs respectively. db_type argument is used
 to specify the type of the input db/dbs.
+
+When loading CPU tensors from a memory-mapped db such as mmapdb, tensors that
+were saved as a single raw chunk alias the mapping instead of being copied.
+
+Chunks saved with a codec are decoded by decode_threads threads while the
+operator keeps reading the db.
 )DOC")
     .Arg(
         "absolute_path",
@@ -98,7 +104,12 @@ to specify the type of the input db/dbs.
         "source_blob_names",
         "(list of strings) if set, used instead of output "
         "blob names, to specify which blobs in the db shall be loaded. Must be "
-        "the same length as number of output blobs.");
+        "the same length as number of output blobs.")
+    .Arg(
+        "decode_threads",
+        "(int, default --caffe2_max_tensor_serializer_threads) number of "
+        "threads decoding chunks saved with a codec into CPU tensors. 0 "
+        "decodes them on the calling thread.");
 
 OPERATOR_SCHEMA(Save)
     .NumInputs(1, INT_MAX)
@@ -107,6 +118,10 @@ OPERATOR_SCHEMA(Save)
 The Save operator saves a set of blobs to a db. It takes [1, infinity) number
 of inputs and has no output. The contents of the inputs are written into the
 db specified by the arguments.
+
+With a codec, tensor chunks are saved as raw chunks encoded with it. Chunks are
+encoded in parallel and written as soon as they are ready; a chunk that does
+not get smaller is saved as is.
 )DOC")
     .Arg(
         "absolute_path",
@@ -123,7 +138,17 @@ db specified by the arguments.
         "(list of strings) if set, used instead of original "
         "blob names. Must be the same length as number of blobs.")
     .Arg("db", "(string) the path to the db to load.")
-    .Arg("db_type", "(string) the type of the db.");
+    .Arg("db_type", "(string) the type of the db.")
+    .Arg(
+        "chunk_size",
+        "(int, default -1) number of elements per serialized tensor chunk. "
+        "-1 uses --caffe2_tensor_chunk_size and 0 disables chunking, which "
+        "lets Load alias tensors stored in a memory-mapped db.")
+    .Arg(
+        "codec",
+        "(string, default --caffe2_tensor_chunk_codec) codec pipeline to "
+        "encode tensor chunks with, e.g. \"zstd\" or \"shuffle+lz4\". "
+        "Stages are joined by '+', only the last one may compress.");
 
 OPERATOR_SCHEMA(Checkpoint)
     .NumInputs(1, INT_MAX)
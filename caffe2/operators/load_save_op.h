@@ -18,6 +18,9 @@
 #define CAFFE2_OPERATORS_LOAD_SAVE_OP_H_
 
 #include <cstdio>
+#include <cstring>
+#include <functional>
+#include <future>
 #include <map>
 #include <unordered_set>
 
@@ -28,6 +31,7 @@
 #include "caffe2/core/operator.h"
 #include "caffe2/utils/math.h"
 #include "caffe2/utils/proto_utils.h"
+#include "caffe2/utils/simple_queue.h"
 
 namespace caffe2 {
 
@@ -46,6 +50,65 @@ struct BlobState {
         current_size(current_size),
         is_tensor(is_tensor) {}
 };
+
+// Decodes encoded raw tensor chunks on a few threads while the Load operator
+// goes on reading entries from the db. The threads are only started when the
+// first encoded chunk shows up.
+class ChunkDecodeQueue {
+ public:
+  explicit ChunkDecodeQueue(int num_threads) : num_threads_(num_threads) {}
+  ~ChunkDecodeQueue() {
+    try {
+      Wait();
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "Exception while decoding tensor chunks: " << e.what();
+    }
+  }
+
+  void Push(const std::function<void()>& task) {
+#ifndef __ANDROID__
+    if (num_threads_ > 0) {
+      if (futures_.empty()) {
+        for (int i = 0; i < num_threads_; ++i) {
+          futures_.emplace_back(std::async(std::launch::async, [this]() {
+            std::function<void()> task;
+            while (queue_.Pop(&task)) {
+              task();
+            }
+          }));
+        }
+      }
+      queue_.Push(task);
+      return;
+    }
+#endif
+    task();
+  }
+
+  // Waits for all pushed chunks to be decoded and rethrows the first error.
+  void Wait() {
+    queue_.NoMoreJobs();
+    std::exception_ptr error;
+    for (auto& future : futures_) {
+      try {
+        future.get();
+      } catch (...) {
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+    futures_.clear();
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+ private:
+  const int num_threads_;
+  SimpleQueue<std::function<void()>> queue_;
+  std::vector<std::future<void>> futures_;
+};
 } // namespace
 
 using db::Cursor;
@@ -101,6 +164,9 @@ class LoadOp final : public Operator<Context> {
         load_all_(OperatorBase::GetSingleArgument<int>("load_all", 0)),
         allow_incomplete_(
             OperatorBase::GetSingleArgument<bool>("allow_incomplete", false)),
+        decode_threads_(OperatorBase::GetSingleArgument<int>(
+            "decode_threads",
+            FLAGS_caffe2_max_tensor_serializer_threads)),
         blob_names_(
             OperatorBase::GetRepeatedArgument<string>("source_blob_names")) {
     if (InputSize() == 0) {
@@ -151,6 +217,8 @@ class LoadOp final : public Operator<Context> {
   bool RunOnDevice() override {
     int total_loaded_blobs = 0;
     std::unordered_map<string, BlobState> blob_states;
+    ChunkDecodeQueue decode_queue(decode_threads_);
+    decode_queue_ = &decode_queue;
     if (InputSize() > 0) {
       for (int i = 0; i < InputSize(); ++i) {
         const db::DBReader& reader = OperatorBase::Input<db::DBReader>(i);
@@ -168,6 +236,8 @@ class LoadOp final : public Operator<Context> {
         extract(i, cursor.get(), &blob_states, &total_loaded_blobs);
       }
     }
+    decode_queue.Wait();
+    decode_queue_ = nullptr;
 
     validateBlobStates(blob_states);
     // Loaded all the needed blobs.
@@ -230,16 +300,8 @@ class LoadOp final : public Operator<Context> {
         key_to_dbid_[key] = db_id;
       }
 
-      BlobProto proto;
-      CAFFE_ENFORCE(
-          proto.ParseFromString(cursor->value()), "Couldn't parse Proto");
-      if (!keep_device_) {
-        // If we are not keeping the device as the one specified in the
-        // proto, we will set the current device.
-        SetCurrentDevice(&proto);
-      }
       Blob* blob = ws_->CreateBlob(key);
-      ProcessBlob(blob, proto, blob_states, key, &loaded_blobs);
+      ProcessEntry(blob, cursor, blob_states, key, &loaded_blobs);
     }
     *total_loaded_blobs += loaded_blobs;
   }
@@ -264,16 +326,9 @@ class LoadOp final : public Operator<Context> {
         }
 
         VLOG(2) << "Deserializing blob " << key;
-        BlobProto proto;
-        CAFFE_ENFORCE(proto.ParseFromString(cursor->value()));
-        if (!keep_device_) {
-          // If we are not keeping the device as the one specified in the
-          // proto, we will set the current device.
-          SetCurrentDevice(&proto);
-        }
         auto blobIndex = output_indices_[key];
         Blob* blob = outputs.at(blobIndex);
-        ProcessBlob(blob, proto, blob_states, key, &loaded_blobs);
+        ProcessEntry(blob, cursor, blob_states, key, &loaded_blobs);
 
         if (*total_loaded_blobs + loaded_blobs == OutputSize()) {
           break;
@@ -297,6 +352,171 @@ class LoadOp final : public Operator<Context> {
   }
 
  private:
+  // Deserializes the current value of the cursor, which is either a
+  // BlobProto or a raw tensor chunk, into blob.
+  void ProcessEntry(
+      Blob* blob,
+      Cursor* cursor,
+      std::unordered_map<string, BlobState>* blob_states,
+      const string& key,
+      int* loaded_blobs) {
+    const char* data = nullptr;
+    size_t size = 0;
+    std::shared_ptr<void> owner;
+    if (cursor->MappedValue(&data, &size, &owner) &&
+        IsRawTensorChunk(data, size)) {
+      if (!ShareMappedTensorChunk(
+              blob, data, size, owner, blob_states, key, loaded_blobs)) {
+        ProcessRawTensorChunk(
+            blob, data, size, owner, blob_states, key, loaded_blobs);
+      }
+      return;
+    }
+    auto value = std::make_shared<string>(cursor->value());
+    if (IsRawTensorChunk(*value)) {
+      ProcessRawTensorChunk(
+          blob,
+          value->data(),
+          value->size(),
+          value,
+          blob_states,
+          key,
+          loaded_blobs);
+      return;
+    }
+    BlobProto proto;
+    CAFFE_ENFORCE(proto.ParseFromString(*value), "Couldn't parse Proto");
+    if (!keep_device_) {
+      // If we are not keeping the device as the one specified in the
+      // proto, we will set the current device.
+      SetCurrentDevice(&proto);
+    }
+    ProcessBlob(blob, proto, blob_states, key, loaded_blobs);
+  }
+
+  // If a raw chunk holding a whole CPU tensor lives in memory owned by the
+  // db (e.g. a memory-mapped file), the tensor is made to alias that memory
+  // instead of copying it. Returns false if the chunk has to be copied.
+  bool ShareMappedTensorChunk(
+      Blob* blob,
+      const char* data,
+      size_t size,
+      const std::shared_ptr<void>& owner,
+      std::unordered_map<string, BlobState>* blob_states,
+      const string& key,
+      int* loaded_blobs) {
+    if (!std::is_same<Context, CPUContext>::value || blob_states->count(key)) {
+      return false;
+    }
+    RawTensorChunkHeader header;
+    ParseRawTensorChunkHeader(data, size, &header);
+    int64_t total_size = 1;
+    for (const auto dim : header.dims) {
+      total_size *= dim;
+    }
+    const char* chunk_data = data + header.data_offset;
+    if (!header.codec.empty() || header.begin != 0 ||
+        header.end != total_size || total_size == 0 ||
+        reinterpret_cast<uintptr_t>(chunk_data) % gCaffe2Alignment != 0) {
+      return false;
+    }
+    const TypeMeta& meta = DataTypeToTypeMeta(header.data_type);
+    const size_t nbytes = total_size * meta.itemsize();
+    CAFFE_ENFORCE_EQ(
+        size - header.data_offset, nbytes, "Incorrect raw tensor chunk size.");
+    blob->Reset();
+    auto* tensor = blob->GetMutable<TensorCPU>();
+    tensor->Resize(header.dims);
+    // The deleter keeps the mapping alive for as long as the tensor uses it.
+    tensor->ShareExternalPointer(
+        const_cast<char*>(chunk_data), meta, nbytes, [owner](void*) {});
+    ProcessTensorChunk(
+        total_size,
+        true /* has_segment */,
+        header.begin,
+        header.end,
+        blob_states,
+        key,
+        loaded_blobs);
+    return true;
+  }
+
+  // A chunk of a tensor that is already being loaded has to agree with the
+  // earlier ones on type and dims. Otherwise loading it would resize the
+  // tensor and could free memory that the decode queue is still writing to.
+  void EnforceSameTensorChunkShape(
+      const Blob& blob,
+      TensorProto::DataType data_type,
+      const vector<TIndex>& dims,
+      const string& key) {
+    if (!blob.IsType<Tensor<Context>>()) {
+      return;
+    }
+    const auto& tensor = blob.Get<Tensor<Context>>();
+    CAFFE_ENFORCE(
+        tensor.meta() == DataTypeToTypeMeta(data_type) &&
+            tensor.dims() == dims,
+        "Chunks of a different type or shape for tensor: ",
+        key);
+  }
+
+  // Raw tensor chunks carry no device information, so they are always loaded
+  // into a Tensor<Context> on the device of this operator. Encoded chunks of
+  // CPU tensors are decoded by the decode queue; owner keeps data alive until
+  // then.
+  void ProcessRawTensorChunk(
+      Blob* blob,
+      const char* data,
+      size_t size,
+      const std::shared_ptr<void>& owner,
+      std::unordered_map<string, BlobState>* blob_states,
+      const string& key,
+      int* loaded_blobs) {
+    RawTensorChunkHeader header;
+    if (blob_states->count(key) == 0) {
+      blob->Reset();
+    } else {
+      ParseRawTensorChunkHeader(data, size, &header);
+      EnforceSameTensorChunkShape(*blob, header.data_type, header.dims, key);
+    }
+    auto* tensor = blob->GetMutable<Tensor<Context>>();
+    TensorDeserializer<Context> deserializer;
+    if (std::is_same<Context, CPUContext>::value) {
+      // The tensor is resized and allocated on this thread, so that chunks of
+      // the same tensor can be decoded concurrently into their own ranges.
+      char* dst = deserializer.PrepareRaw(data, size, tensor, &header);
+      const size_t itemsize = tensor->itemsize();
+      const size_t nbytes = (header.end - header.begin) * itemsize;
+      const char* src = data + header.data_offset;
+      const size_t src_size = size - header.data_offset;
+      if (header.codec.empty()) {
+        if (nbytes > 0) {
+          memcpy(dst, src, nbytes);
+        }
+      } else if (nbytes > 0) {
+        const string codec = header.codec;
+        decode_queue_->Push([=]() {
+          (void)owner;
+          DecodeTensorChunk(codec, src, src_size, itemsize, dst, nbytes);
+        });
+      }
+    } else {
+      deserializer.DeserializeRaw(data, size, tensor, &header);
+    }
+    int64_t total_size = 1;
+    for (const auto dim : header.dims) {
+      total_size *= dim;
+    }
+    ProcessTensorChunk(
+        total_size,
+        true /* has_segment */,
+        header.begin,
+        header.end,
+        blob_states,
+        key,
+        loaded_blobs);
+  }
+
   // We are tracking sizes of already read tensor parts while reading data
   // chunks. This way we can make sure that all chunks were loaded in the end.
   void ProcessBlob(
@@ -313,6 +533,13 @@ class LoadOp final : public Operator<Context> {
       // into an existing TensorCUDA that has pre-allocated memory on a
       // different GPU.
       blob->Reset();
+    } else if (proto.has_tensor()) {
+      EnforceSameTensorChunkShape(
+          *blob,
+          proto.tensor().data_type(),
+          vector<TIndex>(
+              proto.tensor().dims().begin(), proto.tensor().dims().end()),
+          key);
     }
     blob->Deserialize(proto);
     if (proto.has_content_num_chunks()) {
@@ -354,32 +581,45 @@ class LoadOp final : public Operator<Context> {
       return;
     }
     CAFFE_ENFORCE(proto.has_tensor());
+    int64_t total_size = 1;
+    for (const auto& dim : proto.tensor().dims()) {
+      total_size *= dim;
+    }
+    ProcessTensorChunk(
+        total_size,
+        proto.tensor().has_segment(),
+        proto.tensor().segment().begin(),
+        proto.tensor().segment().end(),
+        blob_states_ptr,
+        key,
+        loaded_blobs);
+  }
+
+  void ProcessTensorChunk(
+      int64_t total_size,
+      bool has_segment,
+      int64_t segment_begin,
+      int64_t segment_end,
+      std::unordered_map<string, BlobState>* blob_states_ptr,
+      const string& key,
+      int* loaded_blobs) {
+    auto& blob_states = *blob_states_ptr;
     if (blob_states.count(key)) {
       CAFFE_ENFORCE(blob_states[key].is_tensor, "Must be tensor ", key);
       CAFFE_ENFORCE(
           blob_states[key].current_size < blob_states[key].total_size,
           "Found an extra part for an already filled tensor: ",
           key);
-      CAFFE_ENFORCE(
-          proto.tensor().has_segment(),
-          "Partial tensor must have a segment: ",
-          key);
-      blob_states[key].current_size +=
-          proto.tensor().segment().end() - proto.tensor().segment().begin();
+      CAFFE_ENFORCE(has_segment, "Partial tensor must have a segment: ", key);
+      blob_states[key].current_size += segment_end - segment_begin;
       CAFFE_ENFORCE(
           blob_states[key].current_size <= blob_states[key].total_size,
           "Tensor parts are bigger than target size for tensor: ",
           key);
     } else {
-      const auto& dims = proto.tensor().dims();
-      int64_t total_size = 1;
-      for (const auto& dim : dims) {
-        total_size *= dim;
-      }
       auto current_size = total_size;
-      if (proto.tensor().has_segment()) {
-        current_size =
-            proto.tensor().segment().end() - proto.tensor().segment().begin();
+      if (has_segment) {
+        current_size = segment_end - segment_begin;
       }
       blob_states[key] =
           BlobState(total_size, current_size, true /* is_tensor */);
@@ -415,6 +655,8 @@ class LoadOp final : public Operator<Context> {
   bool keep_device_;
   bool load_all_;
   bool allow_incomplete_;
+  int decode_threads_;
+  ChunkDecodeQueue* decode_queue_ = nullptr;
   std::map<string, int> output_indices_;
   std::map<string, int> key_to_dbid_;
   std::vector<std::string> blob_names_;
@@ -434,9 +676,18 @@ class SaveOp final : public Operator<Context> {
         db_name_(OperatorBase::GetSingleArgument<string>("db", "")),
         db_type_(OperatorBase::GetSingleArgument<string>("db_type", "")),
         blob_names_(
-            OperatorBase::GetRepeatedArgument<string>("blob_name_overrides")) {
+            OperatorBase::GetRepeatedArgument<string>("blob_name_overrides")),
+        chunk_size_(OperatorBase::GetSingleArgument<int>(
+            "chunk_size",
+            kDefaultChunkSize)),
+        codec_(OperatorBase::GetSingleArgument<string>(
+            "codec",
+            FLAGS_caffe2_tensor_chunk_codec)) {
     CAFFE_ENFORCE_GT(db_name_.size(), 0, "Must specify a db name.");
     CAFFE_ENFORCE_GT(db_type_.size(), 0, "Must specify a db type.");
+    if (!codec_.empty()) {
+      ParseTensorChunkCodec(codec_);
+    }
     CAFFE_ENFORCE(
         blob_names_.empty() ||
             blob_names_.size() == OperatorBase::Inputs().size(),
@@ -487,7 +738,7 @@ class SaveOp final : public Operator<Context> {
 
     const vector<const Blob*>& inputs = OperatorBase::Inputs();
     for (int i = 0; i < inputs.size(); ++i) {
-      inputs[i]->Serialize(blob_names_[i], acceptor);
+      inputs[i]->Serialize(blob_names_[i], acceptor, chunk_size_, codec_);
     }
     out_db->Close();
     return true;
@@ -500,6 +751,8 @@ class SaveOp final : public Operator<Context> {
   string db_name_;
   string db_type_;
   std::vector<std::string> blob_names_;
+  int chunk_size_;
+  string codec_;
 };
 
 template <typename... Ts>
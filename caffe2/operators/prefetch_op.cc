@@ -0,0 +1,45 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/operators/prefetch_op.h"
+
+CAFFE2_DEFINE_int(
+    caffe2_prefetch_pool_size,
+    4,
+    "Number of threads of the pool shared by the prefetching operators that "
+    "run with prefetch_shared_pool=1.");
+
+namespace caffe2 {
+
+std::shared_ptr<TaskThreadPool> GetPrefetchThreadPool() {
+  static std::weak_ptr<TaskThreadPool> pool;
+  static std::mutex pool_mutex;
+  std::lock_guard<std::mutex> lock(pool_mutex);
+
+  auto shared_pool = pool.lock();
+  if (!shared_pool) {
+    CAFFE_ENFORCE_GT(
+        FLAGS_caffe2_prefetch_pool_size,
+        0,
+        "caffe2_prefetch_pool_size must be positive.");
+    shared_pool =
+        std::make_shared<TaskThreadPool>(FLAGS_caffe2_prefetch_pool_size);
+    pool = shared_pool;
+  }
+  return shared_pool;
+}
+
+} // namespace caffe2
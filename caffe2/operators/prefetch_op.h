@@ -17,22 +17,45 @@
 #ifndef CAFFE2_OPERATORS_PREFETCH_OP_H_
 #define CAFFE2_OPERATORS_PREFETCH_OP_H_
 
+#include <chrono>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <thread> // NOLINT
 
 #include "caffe2/core/context.h"
 #include "caffe2/core/operator.h"
+#include "caffe2/core/stats.h"
+#include "caffe2/utils/thread_pool.h"
 
 namespace caffe2 {
 
-// PrefetchOperator is an operator that prefetches the next batch. It should
+// Thread pool shared by the PrefetchOperators that run with
+// prefetch_shared_pool=1, sized by --caffe2_prefetch_pool_size. Released
+// once no operator holds it anymore.
+std::shared_ptr<TaskThreadPool> GetPrefetchThreadPool();
+
+// PrefetchOperator is an operator that prefetches the next batches. It should
 // almost always be used to read things from disk, so I am setting the input to
 // zero blobs.
 //
 // For any operator that is derived from PrefetchOperator, it should
 // explicitly call the Finalize() function in its destructor, so that the
 // prefetching thread is properly destructed.
+//
+// By default a derived class prefetches one batch ahead into its own buffers
+// with Prefetch() and copies it to the outputs with CopyPrefetched(). A
+// derived class that can write a batch into any set of blobs may instead
+// return true from SupportsPrefetchSlots() and implement PrefetchToSlot().
+// It then prefetches up to prefetch_depth batches ahead into a ring of slots,
+// each holding one blob per output, and Run() swaps the blobs of the oldest
+// slot with the outputs instead of copying them. The previous outputs are
+// reused for a later batch, so the outputs must not be aliased by other blobs
+// across iterations.
+//
+// The batches are prefetched by a thread owned by the operator, or with
+// prefetch_shared_pool=1 by tasks on GetPrefetchThreadPool(), at most one
+// per operator at a time.
 
 // Note: We inherit from OperatorBase since we control the
 // synchronization properties of this operator ourselves (we inform
@@ -44,35 +67,38 @@ class PrefetchOperator : public OperatorBase {
   PrefetchOperator(const OperatorDef& operator_def, Workspace* ws)
       : OperatorBase(operator_def, ws),
         context_(operator_def.device_option()),
-        prefetched_(false),
-        prefetch_success_(true),
-        finalize_(false) {
+        prefetch_depth_(GetSingleArgument<int>("prefetch_depth", 1)),
+        use_shared_pool_(
+            GetSingleArgument<bool>("prefetch_shared_pool", false)),
+        stats_(
+            "prefetch/" +
+            (operator_def.name().empty() && operator_def.output_size() > 0
+                 ? operator_def.output(0)
+                 : operator_def.name())) {
+    CAFFE_ENFORCE_GE(prefetch_depth_, 1, "prefetch_depth must be positive.");
     context_.SwitchToDevice(0);
   }
 
   virtual ~PrefetchOperator() noexcept {
-    CHECK(finalize_ || !prefetch_thread_.get()) <<
+    CHECK(finalize_ || (!prefetch_thread_.get() && !producing_)) <<
         "YOU MADE A PROGRAMING ERROR: derived class of PrefetchOperator "
         "should call Finalize() in its destructor so the prefetching "
         "thread is joined. ";
   }
 
   void Finalize() {
-    if (prefetch_thread_.get()) {
-      {
-        std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
-        while (!prefetched_)
-          consumer_.wait(lock);
-        finalize_ = true;
-        prefetched_ = false;
+    {
+      std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
+      finalize_ = true;
+      producer_.notify_all();
+      // Wait for the batch being prefetched, if any.
+      while (producing_) {
+        consumer_.wait(lock);
       }
-      producer_.notify_one();
+    }
+    if (prefetch_thread_.get()) {
       prefetch_thread_->join();
       prefetch_thread_.reset();
-    } else {
-      // If we never initialized the prefetch thread, just set
-      // finalize anyway.
-      finalize_ = true;
     }
   }
 
@@ -80,67 +106,195 @@ class PrefetchOperator : public OperatorBase {
     // Note(jiayq): We only start the prefetch_thread at the Run() function
     // instead of in the constructor, because the prefetch_thread needs to start
     // after all derived classes' constructors finish.
-    if (!prefetch_thread_) {
-      prefetch_thread_.reset(
-          new std::thread([this] { this->PrefetchWorker(); }));
+    if (!started_) {
+      StartPrefetching();
     }
     context_.SwitchToDevice(0);
     std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
-    while (!prefetched_)
-      consumer_.wait(lock);
-    if (!prefetch_success_) {
+    CAFFE_EVENT(stats_, prefetch_buffered_batches, ready_);
+    if (ready_ == 0 && prefetch_success_) {
+      const auto stall_start = std::chrono::steady_clock::now();
+      while (ready_ == 0 && prefetch_success_) {
+        consumer_.wait(lock);
+      }
+      CAFFE_EVENT(
+          stats_,
+          prefetch_stall_us,
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - stall_start)
+              .count());
+    }
+    // Batches prefetched before a failure are still returned.
+    if (ready_ == 0) {
       LOG(ERROR) << "Prefetching failed.";
       return false;
     }
-    if (!CopyPrefetched()) {
-      LOG(ERROR) << "Error when copying prefetched data.";
-      return false;
+    if (slots_.empty()) {
+      if (!CopyPrefetched()) {
+        LOG(ERROR) << "Error when copying prefetched data.";
+        return false;
+      }
+    } else {
+      auto& slot = slots_[head_];
+      for (int i = 0; i < OutputSize(); ++i) {
+        Outputs()[i]->swap(slot[i]);
+      }
+      head_ = (head_ + 1) % prefetch_depth_;
     }
-    prefetched_ = false;
+    --ready_;
     context_.FinishDeviceComputation();
-    producer_.notify_one();
+    if (shared_pool_) {
+      SchedulePrefetch();
+    } else {
+      producer_.notify_one();
+    }
     return true;
   }
 
   void PrefetchWorker() {
     context_.SwitchToDevice();
     std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
-    while (prefetched_)
-      producer_.wait(lock);
-    while (!finalize_) {
-      // We will need to run a FinishDeviceComputation() call because the
-      // prefetcher thread and the main thread are potentially using different
-      // streams (like on GPU).
-      try {
-        prefetch_success_ = Prefetch();
-        context_.FinishDeviceComputation();
-      } catch (const std::exception& e) {
-        // TODO: propagate exception_ptr to the caller side
-        LOG(ERROR) << "Prefetching error " << e.what();
-        prefetch_success_ = false;
-      }
-      prefetched_ = true;
-      consumer_.notify_one();
-      while (prefetched_)
+    while (true) {
+      while (!finalize_ && ready_ == prefetch_depth_) {
         producer_.wait(lock);
+      }
+      if (finalize_ || !prefetch_success_) {
+        break;
+      }
+      producing_ = true;
+      lock.unlock();
+      const bool success = PrefetchOne();
+      lock.lock();
+      FinishPrefetch(success);
     }
   }
 
-  // You will need to implement this instead of the Run function.
-  virtual bool Prefetch() = 0;
-  virtual bool CopyPrefetched() = 0;
+  // You will need to implement either Prefetch() and CopyPrefetched(), or
+  // PrefetchToSlot() along with SupportsPrefetchSlots(), instead of Run().
+  virtual bool Prefetch() {
+    CAFFE_THROW("Prefetch() is not implemented.");
+  }
+  virtual bool CopyPrefetched() {
+    CAFFE_THROW("CopyPrefetched() is not implemented.");
+  }
+  virtual bool SupportsPrefetchSlots() const {
+    return false;
+  }
+  // Writes the next batch into the given slot, which holds one blob per
+  // output. The blobs keep whatever a previous batch or output left in them.
+  virtual bool PrefetchToSlot(vector<Blob>* /* unused */) {
+    CAFFE_THROW("PrefetchToSlot() is not implemented.");
+  }
 
  protected:
   Context context_;
   std::mutex prefetch_access_mutex_;
   std::condition_variable producer_, consumer_;
-  // prefetched_ is used to tell the operator that it is done.
-  std::atomic<bool> prefetched_;
-  // prefetch_success_ is used to see if prefetching failed or not.
-  std::atomic<bool> prefetch_success_;
+  // Number of batches prefetched and not returned yet, at most
+  // prefetch_depth_.
+  int ready_{0};
+  // producing_ is set while a batch is being prefetched.
+  bool producing_{false};
+  // prefetch_success_ is cleared once prefetching a batch fails, after which
+  // no more batches are prefetched.
+  bool prefetch_success_{true};
   // finalize_ is used to tell the prefetcher to quit.
-  std::atomic<bool> finalize_;
+  bool finalize_{false};
   unique_ptr<std::thread> prefetch_thread_;
+
+ private:
+  void StartPrefetching() {
+    if (SupportsPrefetchSlots()) {
+      slots_.resize(prefetch_depth_);
+      for (auto& slot : slots_) {
+        slot.resize(OutputSize());
+      }
+    } else {
+      CAFFE_ENFORCE_EQ(
+          prefetch_depth_,
+          1,
+          "Operator ",
+          debug_def().type(),
+          " only prefetches one batch ahead.");
+    }
+    started_ = true;
+    if (use_shared_pool_) {
+      shared_pool_ = GetPrefetchThreadPool();
+      std::lock_guard<std::mutex> lock(prefetch_access_mutex_);
+      SchedulePrefetch();
+    } else {
+      prefetch_thread_.reset(
+          new std::thread([this] { this->PrefetchWorker(); }));
+    }
+  }
+
+  // Runs Prefetch() or PrefetchToSlot() for the next batch without holding
+  // prefetch_access_mutex_: with slots Run() only touches the other slots, and
+  // without them Run() waits until the batch is done.
+  bool PrefetchOne() {
+    bool success = false;
+    // We will need to run a FinishDeviceComputation() call because the
+    // prefetcher thread and the main thread are potentially using different
+    // streams (like on GPU).
+    try {
+      success = slots_.empty() ? Prefetch() : PrefetchToSlot(&slots_[tail_]);
+      context_.FinishDeviceComputation();
+    } catch (const std::exception& e) {
+      // TODO: propagate exception_ptr to the caller side
+      LOG(ERROR) << "Prefetching error " << e.what();
+      success = false;
+    }
+    return success;
+  }
+
+  // Called with prefetch_access_mutex_ held once a batch is done.
+  void FinishPrefetch(bool success) {
+    producing_ = false;
+    if (success) {
+      tail_ = (tail_ + 1) % prefetch_depth_;
+      ++ready_;
+    } else {
+      prefetch_success_ = false;
+    }
+    consumer_.notify_all();
+  }
+
+  // Queues a task prefetching the next batch on the shared pool, unless one
+  // is already running or there is no free slot. Each task queues the next
+  // one, so that an operator never has more than one task at a time. Called
+  // with prefetch_access_mutex_ held.
+  void SchedulePrefetch() {
+    if (producing_ || finalize_ || !prefetch_success_ ||
+        ready_ == prefetch_depth_) {
+      return;
+    }
+    producing_ = true;
+    shared_pool_->runTask([this]() {
+      context_.SwitchToDevice();
+      const bool success = PrefetchOne();
+      std::lock_guard<std::mutex> lock(prefetch_access_mutex_);
+      FinishPrefetch(success);
+      SchedulePrefetch();
+    });
+  }
+
+  const int prefetch_depth_;
+  const bool use_shared_pool_;
+  bool started_{false};
+  std::shared_ptr<TaskThreadPool> shared_pool_;
+  // Ring of prefetch_depth_ slots when SupportsPrefetchSlots(). Run() returns
+  // slot head_ and the prefetcher fills slot tail_.
+  vector<vector<Blob>> slots_;
+  int head_{0};
+  int tail_{0};
+
+  struct PrefetchStats {
+    CAFFE_STAT_CTOR(PrefetchStats);
+    // Number of prefetched batches ready when Run() is called.
+    CAFFE_AVG_EXPORTED_STAT(prefetch_buffered_batches);
+    // Microseconds Run() waited for a batch.
+    CAFFE_EXPORTED_STAT(prefetch_stall_us);
+  } stats_;
 };
 
 } // namespace caffe2
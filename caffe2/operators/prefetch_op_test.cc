@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <set>
+
+#include "caffe2/operators/prefetch_op.h"
+#include "caffe2/utils/proto_utils.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+namespace {
+
+// Returns batches 0, 1, 2, ... as single int tensors, either through
+// Prefetch() and CopyPrefetched() or through prefetch slots. Fails after
+// fail_after batches if that argument is set.
+class CountingPrefetchOp final : public PrefetchOperator<CPUContext> {
+ public:
+  CountingPrefetchOp(const OperatorDef& def, Workspace* ws, bool slots)
+      : PrefetchOperator<CPUContext>(def, ws),
+        slots_(slots),
+        fail_after_(GetSingleArgument<int>("fail_after", -1)) {}
+  ~CountingPrefetchOp() {
+    Finalize();
+  }
+
+  bool Prefetch() override {
+    return Fill(&prefetched_);
+  }
+  bool CopyPrefetched() override {
+    Output(0)->CopyFrom(prefetched_, &context_);
+    return true;
+  }
+  bool SupportsPrefetchSlots() const override {
+    return slots_;
+  }
+  bool PrefetchToSlot(vector<Blob>* slot) override {
+    return Fill((*slot)[0].GetMutable<TensorCPU>());
+  }
+
+ private:
+  TensorCPU* Output(int idx) {
+    return OperatorBase::Output<TensorCPU>(idx);
+  }
+
+  bool Fill(TensorCPU* tensor) {
+    if (next_ == fail_after_) {
+      return false;
+    }
+    tensor->Resize(1);
+    tensor->mutable_data<int>()[0] = next_++;
+    return true;
+  }
+
+  const bool slots_;
+  const int fail_after_;
+  int next_{0};
+  TensorCPU prefetched_;
+};
+
+OperatorDef MakeDef(const string& output, const vector<Argument>& args) {
+  return CreateOperatorDef("CountingPrefetch", "", {}, {output}, args);
+}
+
+int RunAndGet(OperatorBase* op, Workspace* ws, const string& output) {
+  EXPECT_TRUE(op->Run());
+  return ws->GetBlob(output)->Get<TensorCPU>().data<int>()[0];
+}
+
+TEST(PrefetchOperatorTest, OneBatchAhead) {
+  Workspace ws;
+  CountingPrefetchOp op(MakeDef("out", {}), &ws, false);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(i, RunAndGet(&op, &ws, "out"));
+  }
+}
+
+TEST(PrefetchOperatorTest, SlotsAreSwappedIntoOutput) {
+  Workspace ws;
+  const int depth = 3;
+  CountingPrefetchOp op(
+      MakeDef("out", {MakeArgument<int>("prefetch_depth", depth)}),
+      &ws,
+      true);
+  std::set<const void*> buffers;
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_EQ(i, RunAndGet(&op, &ws, "out"));
+    buffers.insert(ws.GetBlob("out")->Get<TensorCPU>().raw_data());
+  }
+  // The output takes turns with the slots instead of being copied into.
+  EXPECT_LE(buffers.size(), depth + 1);
+}
+
+TEST(PrefetchOperatorTest, SharedPool) {
+  Workspace ws;
+  const vector<Argument> args{MakeArgument<int>("prefetch_depth", 2),
+                              MakeArgument<int>("prefetch_shared_pool", 1)};
+  CountingPrefetchOp slots_op(MakeDef("a", args), &ws, true);
+  CountingPrefetchOp copy_op(
+      MakeDef("b", {MakeArgument<int>("prefetch_shared_pool", 1)}),
+      &ws,
+      false);
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_EQ(i, RunAndGet(&slots_op, &ws, "a"));
+    EXPECT_EQ(i, RunAndGet(&copy_op, &ws, "b"));
+  }
+}
+
+TEST(PrefetchOperatorTest, BatchesBeforeFailureAreReturned) {
+  for (bool shared_pool : {false, true}) {
+    Workspace ws;
+    CountingPrefetchOp op(
+        MakeDef(
+            "out",
+            {MakeArgument<int>("prefetch_depth", 4),
+             MakeArgument<int>("prefetch_shared_pool", shared_pool),
+             MakeArgument<int>("fail_after", 2)}),
+        &ws,
+        true);
+    EXPECT_EQ(0, RunAndGet(&op, &ws, "out"));
+    EXPECT_EQ(1, RunAndGet(&op, &ws, "out"));
+    EXPECT_FALSE(op.Run(0));
+    EXPECT_FALSE(op.Run(0));
+  }
+}
+
+TEST(PrefetchOperatorTest, DepthNeedsSlots) {
+  Workspace ws;
+  CountingPrefetchOp op(
+      MakeDef("out", {MakeArgument<int>("prefetch_depth", 2)}), &ws, false);
+  EXPECT_THROW(op.Run(0), EnforceNotMet);
+}
+
+} // namespace
+} // namespace caffe2
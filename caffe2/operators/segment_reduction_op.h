@@ -2020,6 +2020,11 @@ i.e. `len(LENGTHS)`. Other dimensions are inherited from the input tensor.
         "OUTPUT",
         "Aggregated output tensor. Has the first dimension of K "
         "(the number of segments).");
+    schema.Arg(
+        "prefetch_distance",
+        "Optional int argument of the CPU SparseLengths[Sum,WeightedSum,Mean] "
+        "ops: how many indices ahead rows of DATA are prefetched. By default "
+        "it is autotuned once per shape of DATA.");
     ReducerDef::PopulateSchema(schema);
   }
   using Reducer = typename ReducerDef::template Reducer<T, Context>;
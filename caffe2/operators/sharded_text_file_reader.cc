@@ -0,0 +1,234 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/operators/sharded_text_file_reader.h"
+
+#include <algorithm>
+
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+ShardedTextFileReader::ShardedTextFileReader(
+    const std::vector<std::string>& filenames,
+    const std::vector<int>& fieldTypes,
+    const ShardedTextFileReaderOptions& options)
+    : options_(options),
+      fieldTypes_(fieldTypes),
+      buffers_(std::max(options.numThreads, 0)) {
+  CAFFE_ENFORCE(!filenames.empty(), "Need at least one file to read.");
+  CAFFE_ENFORCE(!fieldTypes_.empty(), "field_types arg must be non-empty");
+  CAFFE_ENFORCE_GT(options_.numThreads, 0);
+  CAFFE_ENFORCE_GT(options_.rowsPerChunk, 0);
+  CAFFE_ENFORCE_GT(options_.maxBufferedChunks, 0);
+  for (const auto dt : fieldTypes_) {
+    fieldMetas_.push_back(
+        DataTypeToTypeMeta(static_cast<TensorProto_DataType>(dt)));
+  }
+
+  size_t shardBytes = options_.shardBytes;
+  if (shardBytes == 0) {
+    // A few shards per thread keep the workers busy when lines are uneven.
+    size_t total = 0;
+    for (const auto& shard : ShardTextFiles(filenames, SIZE_MAX)) {
+      total += shard.end - shard.begin;
+    }
+    const size_t numShards = options_.numThreads * 4;
+    shardBytes = (total + numShards - 1) / numShards;
+  }
+  shards_ = ShardTextFiles(filenames, shardBytes);
+  numTasks_ = shards_.size() * options_.numPasses;
+
+  for (int i = 0; i < options_.numThreads; ++i) {
+    workers_.emplace_back([this, i]() { workerLoop(i); });
+  }
+}
+
+ShardedTextFileReader::~ShardedTextFileReader() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stop_ = true;
+  }
+  producerCv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+std::unique_ptr<TextFileChunk> ShardedTextFileReader::newChunk() const {
+  std::unique_ptr<TextFileChunk> chunk(new TextFileChunk());
+  for (const auto& meta : fieldMetas_) {
+    chunk->fields.emplace_back(new TensorCPU());
+    chunk->fields.back()->Resize(options_.rowsPerChunk);
+    chunk->fields.back()->raw_mutable_data(meta);
+  }
+  return chunk;
+}
+
+bool ShardedTextFileReader::push(
+    int worker,
+    std::unique_ptr<TextFileChunk> chunk) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto& buffer = buffers_[worker];
+  producerCv_.wait(lock, [this, &buffer]() {
+    return stop_ || buffer.chunks.size() < options_.maxBufferedChunks;
+  });
+  if (stop_) {
+    return false;
+  }
+  buffer.chunks.push_back(std::move(chunk));
+  lock.unlock();
+  consumerCv_.notify_all();
+  return true;
+}
+
+void ShardedTextFileReader::workerLoop(int worker) {
+  try {
+    for (size_t task = worker; task < numTasks_;
+         task += options_.numThreads) {
+      readShard(worker, shards_[task % shards_.size()]);
+      // In order-preserving mode a null chunk tells the consumer to move on
+      // to the next shard.
+      if (options_.preserveOrder && !push(worker, nullptr)) {
+        break;
+      }
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (stop_) {
+        break;
+      }
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (!error_) {
+      error_ = std::current_exception();
+    }
+  }
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    buffers_[worker].finished = true;
+  }
+  consumerCv_.notify_all();
+}
+
+void ShardedTextFileReader::readShard(int worker, const FileShard& shard) {
+  FileReader fileReader(
+      shard.filename, options_.readBufferSize, shard.begin, shard.end);
+  BufferedTokenizer tokenizer(Tokenizer({'\n', '\t'}, '\0'), &fileReader);
+  const int numFields = fieldTypes_.size();
+  std::vector<char*> datas(numFields);
+  std::unique_ptr<TextFileChunk> chunk;
+  size_t rowsRead = 0;
+  Token token;
+  for (;;) {
+    if (!chunk) {
+      chunk = newChunk();
+      for (int i = 0; i < numFields; ++i) {
+        datas[i] = static_cast<char*>(chunk->fields[i]->raw_mutable_data());
+      }
+    }
+    bool finished = false;
+    for (int field = 0; field < numFields; ++field) {
+      finished = !tokenizer.next(token);
+      if (finished) {
+        CAFFE_ENFORCE(
+            field == 0,
+            "Invalid number of fields at end of file ",
+            shard.filename);
+        break;
+      }
+      CAFFE_ENFORCE(
+          (field == 0 && token.startDelimId == 0) ||
+              (field > 0 && token.startDelimId == 1),
+          "Invalid number of columns at row ",
+          rowsRead + 1,
+          " of the shard starting at byte ",
+          shard.begin,
+          " of ",
+          shard.filename);
+      ConvertTextField(
+          (TensorProto_DataType)fieldTypes_[field],
+          token.start,
+          token.end,
+          datas[field]);
+      datas[field] += fieldMetas_[field].itemsize();
+    }
+    if (!finished) {
+      ++rowsRead;
+      ++chunk->numRows;
+    }
+    if (chunk->numRows == options_.rowsPerChunk ||
+        (finished && chunk->numRows > 0)) {
+      for (auto& field : chunk->fields) {
+        field->Shrink(chunk->numRows);
+      }
+      if (!push(worker, std::move(chunk))) {
+        return;
+      }
+    }
+    if (finished) {
+      return;
+    }
+  }
+}
+
+bool ShardedTextFileReader::next(std::unique_ptr<TextFileChunk>& chunk) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const size_t numWorkers = buffers_.size();
+  for (;;) {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    if (options_.preserveOrder) {
+      if (currentTask_ >= numTasks_) {
+        return false;
+      }
+      auto& buffer = buffers_[currentTask_ % numWorkers];
+      if (!buffer.chunks.empty()) {
+        chunk = std::move(buffer.chunks.front());
+        buffer.chunks.pop_front();
+        lock.unlock();
+        producerCv_.notify_all();
+        lock.lock();
+        if (!chunk) {
+          ++currentTask_;
+          continue;
+        }
+        return true;
+      }
+      CAFFE_ENFORCE(!buffer.finished, "Text file reader stopped early.");
+    } else {
+      bool allFinished = true;
+      for (size_t i = 0; i < numWorkers; ++i) {
+        auto& buffer = buffers_[(nextWorker_ + i) % numWorkers];
+        if (!buffer.chunks.empty()) {
+          chunk = std::move(buffer.chunks.front());
+          buffer.chunks.pop_front();
+          nextWorker_ = (nextWorker_ + i + 1) % numWorkers;
+          lock.unlock();
+          producerCv_.notify_all();
+          return true;
+        }
+        allFinished = allFinished && buffer.finished;
+      }
+      if (allFinished) {
+        return false;
+      }
+    }
+    consumerCv_.wait(lock);
+  }
+}
+
+} // namespace caffe2
@@ -0,0 +1,144 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_OPERATORS_SHARDED_TEXT_FILE_READER_H
+#define CAFFE2_OPERATORS_SHARDED_TEXT_FILE_READER_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/tensor.h"
+#include "caffe2/core/types.h"
+#include "caffe2/operators/text_file_reader_utils.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+
+// Parses the text of one field into an element of the given type.
+inline void ConvertTextField(
+    TensorProto_DataType dst_type,
+    const char* src_start,
+    const char* src_end,
+    void* dst) {
+  switch (dst_type) {
+    case TensorProto_DataType_STRING: {
+      static_cast<std::string*>(dst)->assign(src_start, src_end);
+    } break;
+    case TensorProto_DataType_FLOAT: {
+      // TODO(azzolini): avoid copy, use faster convertion
+      std::string str_copy(src_start, src_end);
+      const char* src_copy = str_copy.c_str();
+      char* src_copy_end;
+      float val = strtof(src_copy, &src_copy_end);
+      if (src_copy == src_copy_end) {
+        throw std::runtime_error("Invalid float: " + str_copy);
+      }
+      *static_cast<float*>(dst) = val;
+    } break;
+    default:
+      throw std::runtime_error("Unsupported type.");
+  }
+}
+
+// A block of consecutive rows, stored column by column.
+struct TextFileChunk {
+  std::vector<std::unique_ptr<TensorCPU>> fields;
+  size_t numRows{0};
+};
+
+struct ShardedTextFileReaderOptions {
+  int numThreads{4};
+  // Keep the rows in file order. Otherwise chunks are handed out as soon as
+  // any worker produced them.
+  bool preserveOrder{false};
+  int numPasses{1};
+  // Bytes requested from the file per read call.
+  size_t readBufferSize{4 << 20};
+  // Rows are split into shards of this size; 0 picks numThreads * 4 shards.
+  size_t shardBytes{0};
+  size_t rowsPerChunk{1024};
+  // Maximum number of chunks buffered per worker thread.
+  size_t maxBufferedChunks{8};
+};
+
+// Reads rows of <TAB> separated fields from one or more text files using a
+// pool of threads. The files are split into shards at line boundaries and
+// each worker tokenizes and converts its shards independently, handing the
+// resulting TextFileChunks to the consumer through a bounded buffer.
+//
+// Worker w processes shards w, w + numThreads, ... (over all passes) and owns
+// its own buffer, which lets the consumer restore file order by visiting the
+// workers round robin without any worker racing ahead by more than
+// maxBufferedChunks chunks.
+class ShardedTextFileReader {
+ public:
+  ShardedTextFileReader(
+      const std::vector<std::string>& filenames,
+      const std::vector<int>& fieldTypes,
+      const ShardedTextFileReaderOptions& options);
+  ~ShardedTextFileReader();
+
+  // Returns the next chunk of rows, or false once all passes are exhausted.
+  // Errors raised by the workers are rethrown here. Not thread-safe.
+  bool next(std::unique_ptr<TextFileChunk>& chunk);
+
+  const std::vector<TypeMeta>& fieldMetas() const {
+    return fieldMetas_;
+  }
+  size_t numShards() const {
+    return shards_.size();
+  }
+
+ private:
+  struct WorkerBuffer {
+    std::deque<std::unique_ptr<TextFileChunk>> chunks;
+    bool finished{false};
+  };
+
+  void workerLoop(int worker);
+  void readShard(int worker, const FileShard& shard);
+  std::unique_ptr<TextFileChunk> newChunk() const;
+  // Blocks until there is room in the worker's buffer; false when stopping.
+  bool push(int worker, std::unique_ptr<TextFileChunk> chunk);
+
+  const ShardedTextFileReaderOptions options_;
+  const std::vector<int> fieldTypes_;
+  std::vector<TypeMeta> fieldMetas_;
+  std::vector<FileShard> shards_;
+  size_t numTasks_;
+
+  std::mutex mutex_;
+  std::condition_variable producerCv_;
+  std::condition_variable consumerCv_;
+  std::vector<WorkerBuffer> buffers_;
+  bool stop_{false};
+  std::exception_ptr error_;
+  // Consumer state, only used by next().
+  size_t currentTask_{0};
+  size_t nextWorker_{0};
+
+  std::vector<std::thread> workers_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_OPERATORS_SHARDED_TEXT_FILE_READER_H
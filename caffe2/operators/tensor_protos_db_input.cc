@@ -35,6 +35,19 @@ corresponding index in the TensorProtos objects in the DB.
   .Arg("batch_size", "(int, default 0) the number of samples in a batch. The "
        "default value of 0 means that the operator will attempt to insert the "
        "entire data in a single output blob.")
+  .Arg("num_readers", "(int, default 1) the number of threads reading and "
+       "deserializing a batch, each through its own cursor over a disjoint "
+       "part of the db. See DBReader::SplitCursors.")
+  .Arg("deterministic", "(bool, default true) with num_readers > 1, whether "
+       "item i of a batch always comes from cursor i % num_readers, making "
+       "batches independent of thread timing. Otherwise readers take the "
+       "next free item.")
+  .Arg("prefetch_depth", "(int, default 1) the number of batches prefetched "
+       "ahead of the one being returned. Each one is kept in its own set of "
+       "tensors, which are swapped into the outputs without a copy.")
+  .Arg("prefetch_shared_pool", "(bool, default false) prefetch batches on the "
+       "thread pool shared by input operators (see "
+       "--caffe2_prefetch_pool_size) instead of a thread of this operator.")
   .Input(0, "data", "A pre-initialized DB reader. Typically, this is obtained "
          "by calling CreateDB operator with a db_name and a db_type. The "
          "resulting output blob is a DB Reader tensor")
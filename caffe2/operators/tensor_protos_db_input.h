@@ -17,11 +17,14 @@
 #ifndef CAFFE2_OPERATORS_TENSOR_PROTOS_DB_INPUT_H_
 #define CAFFE2_OPERATORS_TENSOR_PROTOS_DB_INPUT_H_
 
+#include <atomic>
+#include <exception>
 #include <iostream>
 #include <mutex>
 
 #include "caffe2/core/db.h"
 #include "caffe2/operators/prefetch_op.h"
+#include "caffe2/utils/thread_pool.h"
 
 namespace caffe2 {
 
@@ -35,14 +38,34 @@ class TensorProtosDBInput final : public PrefetchOperator<Context> {
     PrefetchOperator<Context>::Finalize();
   }
 
-  bool Prefetch() override;
-  bool CopyPrefetched() override;
+  bool SupportsPrefetchSlots() const override {
+    return true;
+  }
+  bool PrefetchToSlot(vector<Blob>* slot) override;
 
  private:
-  // Prefetch will always just happen on the CPU side.
+  // Deserializes the batch into the TensorCPUs of the given blobs.
+  void PrefetchBatch(vector<Blob>* batch);
+  // Deserializes one record into position item_id of the batch. Item 0 sets
+  // the shapes of the batch, after which the other items may be deserialized
+  // concurrently.
+  void DeserializeItem(
+      const string& value,
+      int item_id,
+      vector<Blob>* batch,
+      vector<TensorCPU>* temp_tensors,
+      CPUContext* context);
+  // Reads the items of the batch through num_readers_ cursors of the reader.
+  void ParallelPrefetch(const db::DBReader& reader, vector<Blob>* batch);
+
+  // Prefetch will always just happen on the CPU side: on other devices the
+  // batch is deserialized here and then copied to the slot.
   vector<Blob> prefetched_blobs_;
   int batch_size_;
-  bool shape_inferred_ = false;
+  int num_readers_;
+  bool deterministic_;
+  CPUContext cpu_context_;
+  std::unique_ptr<TaskThreadPool> thread_pool_;
   string key_;
   string value_;
 };
@@ -54,10 +77,103 @@ TensorProtosDBInput<Context>::TensorProtosDBInput(
     : PrefetchOperator<Context>(operator_def, ws),
       prefetched_blobs_(operator_def.output_size()),
       batch_size_(
-          OperatorBase::template GetSingleArgument<int>("batch_size", 0)) {}
+          OperatorBase::template GetSingleArgument<int>("batch_size", 0)),
+      num_readers_(
+          OperatorBase::template GetSingleArgument<int>("num_readers", 1)),
+      deterministic_(OperatorBase::template GetSingleArgument<bool>(
+          "deterministic",
+          true)) {
+  CAFFE_ENFORCE_GE(num_readers_, 1);
+  if (num_readers_ > 1 && batch_size_ > 1) {
+    thread_pool_.reset(new TaskThreadPool(num_readers_));
+  }
+}
+
+template <class Context>
+void TensorProtosDBInput<Context>::DeserializeItem(
+    const string& value,
+    int item_id,
+    vector<Blob>* batch,
+    vector<TensorCPU>* temp_tensors,
+    CPUContext* context) {
+  TensorDeserializer<CPUContext> deserializer;
+  TensorProtos protos;
+  CAFFE_ENFORCE(protos.ParseFromString(value));
+  CAFFE_ENFORCE(protos.protos_size() == OutputSize());
+  if (item_id == 0) {
+    // First, set the shape of all the blobs.
+    for (int i = 0; i < protos.protos_size(); ++i) {
+      vector<int> dims(
+          protos.protos(i).dims().begin(), protos.protos(i).dims().end());
+      dims.insert(dims.begin(), batch_size_);
+      (*batch)[i].template GetMutable<TensorCPU>()->Resize(dims);
+    }
+  }
+  for (int i = 0; i < protos.protos_size(); ++i) {
+    TensorCPU* dst = (*batch)[i].template GetMutable<TensorCPU>();
+    TensorCPU& src = (*temp_tensors)[i];
+    if (protos.protos(i).has_device_detail()) {
+      protos.mutable_protos(i)->clear_device_detail();
+    }
+    deserializer.Deserialize(protos.protos(i), &src);
+    DCHECK_EQ(src.size() * batch_size_, dst->size());
+    context->template CopyItems<CPUContext, CPUContext>(
+        src.meta(),
+        src.size(),
+        src.raw_data(),
+        static_cast<char*>(dst->raw_mutable_data(src.meta())) +
+            src.nbytes() * item_id);
+  }
+}
+
+template <class Context>
+void TensorProtosDBInput<Context>::ParallelPrefetch(
+    const db::DBReader& reader,
+    vector<Blob>* batch) {
+  reader.SplitCursors(num_readers_);
+  {
+    // Item 0 allocates the batch before the readers fill it in.
+    vector<TensorCPU> temp_tensors(OutputSize());
+    reader.Read(0, &key_, &value_);
+    DeserializeItem(value_, 0, batch, &temp_tensors, &cpu_context_);
+  }
+
+  // In deterministic mode cursor r reads items r, r + num_readers_, ... so
+  // the batch does not depend on thread timing. Otherwise the readers take
+  // the next free item, which balances slow cursors.
+  std::atomic<int> next_item{1};
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  for (int r = 0; r < num_readers_; ++r) {
+    thread_pool_->runTask([&, r]() {
+      try {
+        CPUContext context;
+        vector<TensorCPU> temp_tensors(OutputSize());
+        string key;
+        string value;
+        int item_id = deterministic_ ? (r == 0 ? num_readers_ : r)
+                                     : next_item++;
+        while (item_id < batch_size_) {
+          reader.Read(r, &key, &value);
+          DeserializeItem(value, item_id, batch, &temp_tensors, &context);
+          item_id = deterministic_ ? item_id + num_readers_ : next_item++;
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> guard(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    });
+  }
+  thread_pool_->waitWorkComplete();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
 
 template <class Context>
-bool TensorProtosDBInput<Context>::Prefetch() {
+void TensorProtosDBInput<Context>::PrefetchBatch(vector<Blob>* batch) {
   const db::DBReader& reader = OperatorBase::Input<db::DBReader>(0);
   TensorDeserializer<CPUContext> deserializer;
   if (batch_size_ == 0) {
@@ -72,49 +188,29 @@ bool TensorProtosDBInput<Context>::Prefetch() {
         protos.mutable_protos(i)->clear_device_detail();
       }
       deserializer.Deserialize(
-          protos.protos(i),
-          prefetched_blobs_[i].template GetMutable<TensorCPU>());
+          protos.protos(i), (*batch)[i].template GetMutable<TensorCPU>());
     }
+  } else if (thread_pool_) {
+    ParallelPrefetch(reader, batch);
   } else {
     vector<TensorCPU> temp_tensors(OutputSize());
     for (int item_id = 0; item_id < batch_size_; ++item_id) {
       reader.Read(&key_, &value_);
-      TensorProtos protos;
-      CAFFE_ENFORCE(protos.ParseFromString(value_));
-      CAFFE_ENFORCE(protos.protos_size() == OutputSize());
-      if (!shape_inferred_) {
-        // First, set the shape of all the blobs.
-        for (int i = 0; i < protos.protos_size(); ++i) {
-          vector<int> dims(
-              protos.protos(i).dims().begin(), protos.protos(i).dims().end());
-          dims.insert(dims.begin(), batch_size_);
-          prefetched_blobs_[i].template GetMutable<TensorCPU>()->Resize(dims);
-        }
-      }
-      for (int i = 0; i < protos.protos_size(); ++i) {
-        TensorCPU* dst = prefetched_blobs_[i].template GetMutable<TensorCPU>();
-        TensorCPU& src = temp_tensors[i];
-        if (protos.protos(i).has_device_detail()) {
-          protos.mutable_protos(i)->clear_device_detail();
-        }
-        deserializer.Deserialize(protos.protos(i), &src);
-        DCHECK_EQ(src.size() * batch_size_, dst->size());
-        this->context_.template CopyItems<CPUContext, CPUContext>(
-            src.meta(),
-            src.size(),
-            src.raw_data(),
-            static_cast<char*>(dst->raw_mutable_data(src.meta())) +
-                src.nbytes() * item_id);
-      }
+      DeserializeItem(value_, item_id, batch, &temp_tensors, &cpu_context_);
     }
   }
-  return true;
 }
 
 template <class Context>
-bool TensorProtosDBInput<Context>::CopyPrefetched() {
+bool TensorProtosDBInput<Context>::PrefetchToSlot(vector<Blob>* slot) {
+  if (std::is_same<Context, CPUContext>::value) {
+    // The slot is swapped into the outputs as is.
+    PrefetchBatch(slot);
+    return true;
+  }
+  PrefetchBatch(&prefetched_blobs_);
   for (int i = 0; i < OutputSize(); ++i) {
-    OperatorBase::Output<Tensor<Context>>(i)->CopyFrom(
+    (*slot)[i].template GetMutable<Tensor<Context>>()->CopyFrom(
         prefetched_blobs_[i].template Get<TensorCPU>(), &this->context_);
   }
   return true;
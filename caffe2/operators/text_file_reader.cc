@@ -18,6 +18,7 @@
 #include "caffe2/core/operator.h"
 #include "caffe2/core/tensor.h"
 #include "caffe2/core/types.h"
+#include "caffe2/operators/sharded_text_file_reader.h"
 #include "caffe2/operators/text_file_reader_utils.h"
 #include "caffe2/utils/string_utils.h"
 
@@ -30,9 +31,26 @@ struct TextFileReaderInstance {
       const std::string& filename,
       int numPasses,
       const std::vector<int>& types)
-      : fileReader(filename),
-        tokenizer(Tokenizer(delims, escape), &fileReader, numPasses),
+      : fileReader(new FileReader(filename)),
+        tokenizer(new BufferedTokenizer(
+            Tokenizer(delims, escape),
+            fileReader.get(),
+            numPasses)),
         fieldTypes(types) {
+    initFieldMetas();
+  }
+
+  // Reads the files with a pool of threads, see ShardedTextFileReader.
+  TextFileReaderInstance(
+      const std::vector<std::string>& filenames,
+      const std::vector<int>& types,
+      const ShardedTextFileReaderOptions& options)
+      : shardedReader(new ShardedTextFileReader(filenames, types, options)),
+        fieldTypes(types) {
+    initFieldMetas();
+  }
+
+  void initFieldMetas() {
     for (const auto dt : fieldTypes) {
       fieldMetas.push_back(
           DataTypeToTypeMeta(static_cast<TensorProto_DataType>(dt)));
@@ -40,15 +58,22 @@ struct TextFileReaderInstance {
     }
   }
 
-  FileReader fileReader;
-  BufferedTokenizer tokenizer;
+  // Single-threaded reading.
+  std::unique_ptr<FileReader> fileReader;
+  std::unique_ptr<BufferedTokenizer> tokenizer;
+
+  // Multi-threaded reading: the chunk currently being copied out.
+  std::unique_ptr<ShardedTextFileReader> shardedReader;
+  std::unique_ptr<TextFileChunk> chunk;
+  size_t chunkRow{0};
+
   std::vector<int> fieldTypes;
   std::vector<TypeMeta> fieldMetas;
   std::vector<size_t> fieldByteSizes;
   size_t rowsRead{0};
 
-  // hack to guarantee thread-safeness of the read op
-  // TODO(azzolini): support multi-threaded reading.
+  // hack to guarantee thread-safeness of the read op. With shardedReader the
+  // lock only covers copying rows out of already parsed chunks.
   std::mutex globalMutex_;
 };
 
@@ -57,49 +82,46 @@ class CreateTextFileReaderOp : public Operator<CPUContext> {
   CreateTextFileReaderOp(const OperatorDef& operator_def, Workspace* ws)
       : Operator<CPUContext>(operator_def, ws),
         filename_(GetSingleArgument<string>("filename", "")),
+        filenames_(GetRepeatedArgument<string>("filenames")),
         numPasses_(GetSingleArgument<int>("num_passes", 1)),
         fieldTypes_(GetRepeatedArgument<int>("field_types")) {
     CAFFE_ENFORCE(fieldTypes_.size() > 0, "field_types arg must be non-empty");
+    shardedOptions_.numThreads = GetSingleArgument<int>("num_threads", 0);
+    shardedOptions_.preserveOrder =
+        GetSingleArgument<bool>("preserve_order", true);
+    shardedOptions_.numPasses = numPasses_;
+    shardedOptions_.readBufferSize = GetSingleArgument<int>(
+        "read_buffer_size", shardedOptions_.readBufferSize);
+    shardedOptions_.maxBufferedChunks = GetSingleArgument<int>(
+        "max_buffered_chunks", shardedOptions_.maxBufferedChunks);
+    if (!filename_.empty()) {
+      filenames_.insert(filenames_.begin(), filename_);
+    }
+    CAFFE_ENFORCE(!filenames_.empty(), "Need filename or filenames arg.");
   }
 
   bool RunOnDevice() override {
-    *OperatorBase::Output<std::unique_ptr<TextFileReaderInstance>>(0) =
-        std::unique_ptr<TextFileReaderInstance>(new TextFileReaderInstance(
-            {'\n', '\t'}, '\0', filename_, numPasses_, fieldTypes_));
+    auto* instance =
+        OperatorBase::Output<std::unique_ptr<TextFileReaderInstance>>(0);
+    if (shardedOptions_.numThreads > 0 || filenames_.size() > 1) {
+      shardedOptions_.numThreads = std::max(shardedOptions_.numThreads, 1);
+      instance->reset(new TextFileReaderInstance(
+          filenames_, fieldTypes_, shardedOptions_));
+    } else {
+      instance->reset(new TextFileReaderInstance(
+          {'\n', '\t'}, '\0', filenames_[0], numPasses_, fieldTypes_));
+    }
     return true;
   }
 
  private:
   std::string filename_;
+  std::vector<std::string> filenames_;
   int numPasses_;
   std::vector<int> fieldTypes_;
+  ShardedTextFileReaderOptions shardedOptions_;
 };
 
-inline void convert(
-    TensorProto_DataType dst_type,
-    const char* src_start,
-    const char* src_end,
-    void* dst) {
-  switch (dst_type) {
-    case TensorProto_DataType_STRING: {
-      static_cast<std::string*>(dst)->assign(src_start, src_end);
-    } break;
-    case TensorProto_DataType_FLOAT: {
-      // TODO(azzolini): avoid copy, use faster convertion
-      std::string str_copy(src_start, src_end);
-      const char* src_copy = str_copy.c_str();
-      char* src_copy_end;
-      float val = strtof(src_copy, &src_copy_end);
-      if (src_copy == src_copy_end) {
-        throw std::runtime_error("Invalid float: " + str_copy);
-      }
-      *static_cast<float*>(dst) = val;
-    } break;
-    default:
-      throw std::runtime_error("Unsupported type.");
-  }
-}
-
 class TextFileReaderReadOp : public Operator<CPUContext> {
  public:
   TextFileReaderReadOp(const OperatorDef& operator_def, Workspace* ws)
@@ -129,8 +151,35 @@ class TextFileReaderReadOp : public Operator<CPUContext> {
     }
 
     int rowsRead = 0;
-    {
-      // TODO(azzolini): support multi-threaded reading
+    if (instance->shardedReader) {
+      std::lock_guard<std::mutex> guard(instance->globalMutex_);
+
+      auto& chunk = instance->chunk;
+      while (rowsRead < batchSize_) {
+        if (!chunk || instance->chunkRow == chunk->numRows) {
+          if (!instance->shardedReader->next(chunk)) {
+            break;
+          }
+          instance->chunkRow = 0;
+        }
+        const size_t numRows = std::min<size_t>(
+            batchSize_ - rowsRead, chunk->numRows - instance->chunkRow);
+        for (int field = 0; field < numFields; ++field) {
+          const auto& meta = instance->fieldMetas[field];
+          const auto byteSize = instance->fieldByteSizes[field];
+          context_.CopyItems<CPUContext, CPUContext>(
+              meta,
+              numRows,
+              static_cast<const char*>(chunk->fields[field]->raw_data()) +
+                  instance->chunkRow * byteSize,
+              datas[field]);
+          datas[field] += numRows * byteSize;
+        }
+        instance->chunkRow += numRows;
+        rowsRead += numRows;
+      }
+      instance->rowsRead += rowsRead;
+    } else {
       std::lock_guard<std::mutex> guard(instance->globalMutex_);
 
       bool finished = false;
@@ -138,7 +187,7 @@ class TextFileReaderReadOp : public Operator<CPUContext> {
       while (!finished && (rowsRead < batchSize_)) {
         int field;
         for (field = 0; field < numFields; ++field) {
-          finished = !instance->tokenizer.next(token);
+          finished = !instance->tokenizer->next(token);
           if (finished) {
             CAFFE_ENFORCE(
                 field == 0, "Invalid number of fields at end of file.");
@@ -151,7 +200,7 @@ class TextFileReaderReadOp : public Operator<CPUContext> {
               instance->rowsRead + rowsRead + 1);
           const auto& meta = instance->fieldMetas[field];
           char*& data = datas[field];
-          convert(
+          ConvertTextField(
               (TensorProto_DataType)instance->fieldTypes[field],
               token.start,
               token.end,
@@ -183,12 +232,33 @@ REGISTER_CPU_OPERATOR(TextFileReaderRead, TextFileReaderReadOp);
 OPERATOR_SCHEMA(CreateTextFileReader)
     .NumInputs(0)
     .NumOutputs(1)
-    .SetDoc("Create a text file reader. Fields are delimited by <TAB>.")
+    .SetDoc(R"DOC(
+Create a text file reader. Fields are delimited by <TAB>.
+
+With num_threads > 0 or more than one file, the files are split into shards at
+line boundaries which are tokenized by a pool of threads. Parsed rows are
+buffered until TextFileReaderRead consumes them.
+)DOC")
     .Arg("filename", "Path to the file.")
+    .Arg("filenames", "List of paths to read after filename, in order.")
     .Arg("num_passes", "Number of passes over the file.")
     .Arg(
         "field_types",
         "List with type of each field. Type enum is found at core.DataType.")
+    .Arg(
+        "num_threads",
+        "Number of threads parsing the files, 0 (default) reads them on the "
+        "calling thread.")
+    .Arg(
+        "preserve_order",
+        "With several threads, whether rows are returned in file order "
+        "(default true).")
+    .Arg(
+        "read_buffer_size",
+        "With several threads, bytes read from the file at once.")
+    .Arg(
+        "max_buffered_chunks",
+        "With several threads, chunks of parsed rows each thread may buffer.")
     .Output(0, "handler", "Pointer to the created TextFileReaderInstance.");
 
 OPERATOR_SCHEMA(TextFileReaderRead)
@@ -17,6 +17,10 @@
 #include "caffe2/operators/text_file_reader_utils.h"
 
 #include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <sstream>
 
@@ -93,21 +97,31 @@ void Tokenizer::next(char* start, char* end, TokenizedString& tokenized) {
   }
 }
 
-FileReader::FileReader(const std::string& path, size_t bufferSize)
-    : bufferSize_(bufferSize), buffer_(new char[bufferSize]) {
+FileReader::FileReader(
+    const std::string& path,
+    size_t bufferSize,
+    int64_t begin,
+    int64_t end)
+    : bufferSize_(bufferSize),
+      begin_(begin),
+      end_(end),
+      offset_(begin),
+      buffer_(new char[bufferSize]) {
   fd_ = open(path.c_str(), O_RDONLY, 0777);
   if (fd_ < 0) {
     throw std::runtime_error(
         "Error opening file for reading: " + std::string(std::strerror(errno)) +
         " Path=" + path);
   }
+#ifdef POSIX_FADV_SEQUENTIAL
+  // Shards are streamed front to back; let the kernel read ahead aggressively.
+  posix_fadvise(
+      fd_, begin_, end_ < 0 ? 0 : end_ - begin_, POSIX_FADV_SEQUENTIAL);
+#endif
 }
 
 void FileReader::reset() {
-  if (lseek(fd_, 0, SEEK_SET) == -1) {
-    throw std::runtime_error(
-        "Error reseting file cursor: " + std::string(std::strerror(errno)));
-  }
+  offset_ = begin_;
 }
 
 FileReader::~FileReader() {
@@ -118,7 +132,14 @@ FileReader::~FileReader() {
 
 void FileReader::operator()(CharRange& range) {
   char* buffer = buffer_.get();
-  auto numRead = read(fd_, buffer, bufferSize_);
+  size_t toRead = bufferSize_;
+  if (end_ >= 0) {
+    toRead = std::min<int64_t>(toRead, std::max<int64_t>(end_ - offset_, 0));
+  }
+  ssize_t numRead = 0;
+  if (toRead > 0) {
+    numRead = pread(fd_, buffer, toRead, offset_);
+  }
   if (numRead == -1) {
     throw std::runtime_error(
         "Error reading file: " + std::string(std::strerror(errno)));
@@ -128,7 +149,67 @@ void FileReader::operator()(CharRange& range) {
     range.end = nullptr;
     return;
   }
+  offset_ += numRead;
   range.start = buffer;
   range.end = buffer + numRead;
 }
+
+namespace {
+
+// Returns the offset right after the first '\n' at or after pos, or the size
+// of the file if there is none.
+int64_t NextLineStart(int fd, int64_t pos, int64_t size) {
+  char buffer[4096];
+  while (pos < size) {
+    auto numRead = pread(fd, buffer, sizeof(buffer), pos);
+    if (numRead <= 0) {
+      throw std::runtime_error(
+          "Error reading file: " + std::string(std::strerror(errno)));
+    }
+    auto* newline = static_cast<char*>(std::memchr(buffer, '\n', numRead));
+    if (newline) {
+      return pos + (newline - buffer) + 1;
+    }
+    pos += numRead;
+  }
+  return size;
+}
+
+} // namespace
+
+std::vector<FileShard> ShardTextFiles(
+    const std::vector<std::string>& filenames,
+    size_t targetShardBytes) {
+  const int64_t target = std::max<int64_t>(
+      1, std::min<uint64_t>(targetShardBytes, INT64_MAX));
+  std::vector<FileShard> shards;
+  for (const auto& filename : filenames) {
+    int fd = open(filename.c_str(), O_RDONLY, 0777);
+    if (fd < 0) {
+      throw std::runtime_error(
+          "Error opening file for reading: " +
+          std::string(std::strerror(errno)) + " Path=" + filename);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      throw std::runtime_error(
+          "Error reading file size: " + std::string(std::strerror(errno)) +
+          " Path=" + filename);
+    }
+    const int64_t size = st.st_size;
+    int64_t begin = 0;
+    while (begin < size) {
+      int64_t end = size;
+      if (size - begin > target) {
+        end = NextLineStart(fd, begin + target - 1, size);
+      }
+      shards.push_back({filename, begin, end});
+      begin = end;
+    }
+    close(fd);
+  }
+  return shards;
 }
+
+} // namespace caffe2
@@ -122,17 +122,42 @@ class BufferedTokenizer {
 
 class FileReader : public StringProvider {
  public:
-  explicit FileReader(const std::string& path, size_t bufferSize = 65536);
+  // Reads the bytes [begin, end) of the file, end == -1 meaning until EOF.
+  explicit FileReader(
+      const std::string& path,
+      size_t bufferSize = 65536,
+      int64_t begin = 0,
+      int64_t end = -1);
   ~FileReader();
   void operator()(CharRange& range) override;
   void reset() override;
 
  private:
   const size_t bufferSize_;
+  const int64_t begin_;
+  const int64_t end_;
+  int64_t offset_;
   int fd_;
   std::unique_ptr<char[]> buffer_;
 };
 
+// Byte range of a text file that starts at the beginning of a line and ends
+// right after a newline (or at the end of the file).
+struct FileShard {
+  std::string filename;
+  int64_t begin;
+  int64_t end;
+};
+
+// Splits the given files into shards of roughly targetShardBytes each, moving
+// every split point forward to the next '\n'. Shards are returned in file
+// order, so reading them in sequence yields the rows in their original order.
+// Split points do not look at escape characters: a line break that is escaped
+// within a field may end up as a shard boundary.
+std::vector<FileShard> ShardTextFiles(
+    const std::vector<std::string>& filenames,
+    size_t targetShardBytes);
+
 } // namespace caffe2
 
 #endif // CAFFE2_OPERATORS_TEXT_FILE_READER_UTILS_H
@@ -135,4 +135,42 @@ TEST(TextFileReaderUtilsTest, TokenizeTest) {
   std::remove(tmpname);
 }
 
+TEST(TextFileReaderUtilsTest, ShardTest) {
+  std::string ch;
+  for (int i = 0; i < 100; ++i) {
+    ch += "row" + caffe2::to_string(i) + "\t" + std::string(i % 7, 'x') + "\n";
+  }
+  char* tmpname = std::tmpnam(nullptr);
+  std::ofstream outFile;
+  outFile.open(tmpname);
+  outFile << ch;
+  outFile.close();
+
+  for (size_t shardBytes : {1, 10, 64, 1000, 100000}) {
+    auto shards = ShardTextFiles({tmpname, tmpname}, shardBytes);
+    std::string joined;
+    int64_t lastEnd = 0;
+    for (const auto& shard : shards) {
+      if (shard.begin == 0) {
+        lastEnd = 0;
+      }
+      EXPECT_EQ(lastEnd, shard.begin);
+      EXPECT_LT(shard.begin, shard.end);
+      // every shard holds complete lines
+      EXPECT_TRUE(shard.begin == 0 || ch[shard.begin - 1] == '\n');
+      EXPECT_EQ('\n', ch[shard.end - 1]);
+      lastEnd = shard.end;
+
+      // tokenizing one shard reads exactly its own bytes
+      FileReader fr(shard.filename, 7, shard.begin, shard.end);
+      CharRange range;
+      for (fr(range); range.start; fr(range)) {
+        joined.append(range.start, range.end);
+      }
+    }
+    EXPECT_EQ(ch + ch, joined);
+  }
+  std::remove(tmpname);
+}
+
 } // namespace caffe2
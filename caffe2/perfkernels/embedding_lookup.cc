@@ -37,7 +37,8 @@ static void EmbeddingLookupGenericSlow(
     const float* weights, // optional, can be null for sum reducer
     const float* scale_bias, // optional scale & bias params for uint8 input
     bool normalize_by_lengths,
-    OutType* out) {
+    OutType* out,
+    int prefetch_distance) {
   TIndex current = 0;
   for (int m = 0; m < output_size; ++m) {
     memset(out, 0, sizeof(OutType) * block_size);
@@ -55,8 +56,9 @@ static void EmbeddingLookupGenericSlow(
           data_size);
       CAFFE_ENFORCE_LT(idx, data_size);
 #ifdef __GNUC__
-      if (current + 1 < index_size) {
-        __builtin_prefetch(input + block_size * indices[current + 1], 0, 1);
+      if (current + prefetch_distance < index_size) {
+        __builtin_prefetch(
+            input + block_size * indices[current + prefetch_distance], 0, 1);
       }
 #endif // __GNUC__
 
@@ -105,7 +107,8 @@ static void EmbeddingLookupGenericSlow(
       const float* weights,                                        \
       const float* scale_bias,                                     \
       bool normalize_by_lengths,                                   \
-      OutType* out) {                                              \
+      OutType* out,                                                \
+      int prefetch_distance) {                                     \
     EmbeddingLookupGenericSlow<IndexType, InType, OutType>(        \
         block_size,                                                \
         output_size,                                               \
@@ -117,7 +120,8 @@ static void EmbeddingLookupGenericSlow(
         weights,                                                   \
         scale_bias,                                                \
         normalize_by_lengths,                                      \
-        out);                                                      \
+        out,                                                       \
+        prefetch_distance);                                        \
   }                                                                \
   template <>                                                      \
   void EmbeddingLookup(                                            \
@@ -131,7 +135,22 @@ static void EmbeddingLookupGenericSlow(
       const float* weights,                                        \
       const float* scale_bias,                                     \
       bool normalize_by_lengths,                                   \
-      OutType* out) {                                              \
+      OutType* out,                                                \
+      int prefetch_distance) {                                     \
+    AVX512_DO(                                                     \
+        EmbeddingLookup_##IndexType##_##InType##_##OutType,        \
+        block_size,                                                \
+        output_size,                                               \
+        index_size,                                                \
+        data_size,                                                 \
+        input,                                                     \
+        indices,                                                   \
+        lengths,                                                   \
+        weights,                                                   \
+        scale_bias,                                                \
+        normalize_by_lengths,                                      \
+        out,                                                       \
+        prefetch_distance);                                        \
     AVX2_FMA_DO(                                                   \
         EmbeddingLookup_##IndexType##_##InType##_##OutType,        \
         block_size,                                                \
@@ -144,7 +163,8 @@ static void EmbeddingLookupGenericSlow(
         weights,                                                   \
         scale_bias,                                                \
         normalize_by_lengths,                                      \
-        out);                                                      \
+        out,                                                       \
+        prefetch_distance);                                        \
     BASE_DO(                                                       \
         EmbeddingLookup_##IndexType##_##InType##_##OutType,        \
         block_size,                                                \
@@ -157,7 +177,8 @@ static void EmbeddingLookupGenericSlow(
         weights,                                                   \
         scale_bias,                                                \
         normalize_by_lengths,                                      \
-        out);                                                      \
+        out,                                                       \
+        prefetch_distance);                                        \
   }
 
 EMBEDDING_SPECIALIZATION(int32_t, float, float);
@@ -20,6 +20,8 @@
 
 namespace caffe2 {
 
+constexpr int kEmbeddingLookupDefaultPrefetchDistance = 16;
+
 /**
  * Embedding lookup with reduction.
  *
@@ -45,6 +47,9 @@ namespace caffe2 {
  *     for (k = 0..block_size-1)
  *       out[i*block_size + k] /= lengths[i]
  *
+ * `prefetch_distance` is how many indices ahead of the current one the
+ * vectorized kernels prefetch rows of `input`. The best value depends on the
+ * row size and on the memory subsystem, so it is exposed for tuning.
  */
 template <typename IndexType, typename InType, typename OutType>
 void EmbeddingLookup(
@@ -58,6 +63,7 @@ void EmbeddingLookup(
     const float* weights, // optional, can be null for non-weighted sum
     const float* scale_bias, // optional scale & bias params for uint8 input
     bool normalize_by_lengths,
-    OutType* out);
+    OutType* out,
+    int prefetch_distance = kEmbeddingLookupDefaultPrefetchDistance);
 
 } // namespace caffe2
@@ -38,8 +38,9 @@ void EmbeddingLookup_int32_t_float_float__avx2_fma(
     const float* weights,
     const float* scale_bias,
     bool normalize_by_lengths,
-    float* out) {
-  const int32_t prefdist_T0 = 16;
+    float* out,
+    int prefetch_distance) {
+  const int32_t prefdist_T0 = prefetch_distance;
   CAFFE_ENFORCE(scale_bias == nullptr, "scale_bias must be nullptr");
   if (block_size == 128) {
     // unrolling 16 times
@@ -401,8 +402,9 @@ void EmbeddingLookup_int64_t_float_float__avx2_fma(
     const float* weights,
     const float* scale_bias,
     bool normalize_by_lengths,
-    float* out) {
-  const int64_t prefdist_T0 = 16;
+    float* out,
+    int prefetch_distance) {
+  const int64_t prefdist_T0 = prefetch_distance;
   CAFFE_ENFORCE(scale_bias == nullptr, "scale_bias must be nullptr");
   if (block_size == 128) {
     // unrolling 16 times
@@ -764,8 +766,9 @@ void EmbeddingLookup_int32_t_float16_float__avx2_fma(
     const float* weights,
     const float* scale_bias,
     bool normalize_by_lengths,
-    float* out) {
-  const int32_t prefdist_T0 = 16;
+    float* out,
+    int prefetch_distance) {
+  const int32_t prefdist_T0 = prefetch_distance;
   CAFFE_ENFORCE(scale_bias == nullptr, "scale_bias must be nullptr");
   if (block_size == 128) {
     // unrolling 16 times
@@ -1253,8 +1256,9 @@ void EmbeddingLookup_int64_t_float16_float__avx2_fma(
     const float* weights,
     const float* scale_bias,
     bool normalize_by_lengths,
-    float* out) {
-  const int64_t prefdist_T0 = 16;
+    float* out,
+    int prefetch_distance) {
+  const int64_t prefdist_T0 = prefetch_distance;
   CAFFE_ENFORCE(scale_bias == nullptr, "scale_bias must be nullptr");
   if (block_size == 128) {
     // unrolling 16 times
@@ -1742,8 +1746,9 @@ void EmbeddingLookup_int32_t_uint8_t_float__avx2_fma(
     const float* weights,
     const float* scale_bias,
     bool normalize_by_lengths,
-    float* out) {
-  const int32_t prefdist_T0 = 16;
+    float* out,
+    int prefetch_distance) {
+  const int32_t prefdist_T0 = prefetch_distance;
   CAFFE_ENFORCE(scale_bias != nullptr, "scale_bias must not be nullptr");
   if (block_size == 128) {
     // unrolling 16 times
@@ -2249,8 +2254,9 @@ void EmbeddingLookup_int64_t_uint8_t_float__avx2_fma(
     const float* weights,
     const float* scale_bias,
     bool normalize_by_lengths,
-    float* out) {
-  const int64_t prefdist_T0 = 16;
+    float* out,
+    int prefetch_distance) {
+  const int64_t prefdist_T0 = prefetch_distance;
   CAFFE_ENFORCE(scale_bias != nullptr, "scale_bias must not be nullptr");
   if (block_size == 128) {
     // unrolling 16 times
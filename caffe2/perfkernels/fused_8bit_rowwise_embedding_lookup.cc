@@ -0,0 +1,190 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/perfkernels/fused_8bit_rowwise_embedding_lookup.h"
+
+#include <cstring>
+
+#include "caffe2/core/types.h"
+#include "caffe2/perfkernels/common.h"
+#include "caffe2/perfkernels/typed_axpy.h"
+#include "caffe2/utils/cpuid.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+// Base implementation does runtime dispatch for each segment of reduction
+template <typename IndexType, typename InType, typename OutType>
+static void Fused8BitRowwiseEmbeddingLookupGenericSlow(
+    const TIndex block_size,
+    const TIndex output_size,
+    const TIndex index_size,
+    const TIndex data_size,
+    const InType* input,
+    const IndexType* indices,
+    const int* lengths,
+    const float* weights, // optional, can be null for sum reducer
+    bool normalize_by_lengths,
+    OutType* out,
+    int prefetch_distance) {
+  // block_size is the number of elements and fused_block_size is the size of
+  // an entire row, including scale and bias.
+  const auto scale_bias_offset = 8 / sizeof(InType);
+  const TIndex fused_block_size = block_size + scale_bias_offset;
+  TIndex current = 0;
+  for (int m = 0; m < output_size; ++m) {
+    memset(out, 0, sizeof(OutType) * block_size);
+    EigenVectorArrayMap<OutType> out_vector(out, block_size);
+    for (int i = 0; i < lengths[m]; ++i) {
+      CAFFE_ENFORCE_LT(current, index_size);
+      TIndex idx = indices[current];
+      CAFFE_ENFORCE(
+          0 <= idx && idx < data_size,
+          "Index ",
+          current,
+          " is out of bounds: ",
+          idx,
+          ", range 0 to ",
+          data_size);
+#ifdef __GNUC__
+      if (current + prefetch_distance < index_size) {
+        __builtin_prefetch(
+            input + fused_block_size * indices[current + prefetch_distance],
+            0,
+            1);
+      }
+#endif // __GNUC__
+
+      // The scale and bias are not necessarily aligned to 4 bytes.
+      float scale_bias[2];
+      memcpy(
+          scale_bias,
+          input + fused_block_size * indices[current] + block_size,
+          sizeof(scale_bias));
+
+      const float weight = weights ? weights[current] : 1.0f;
+      const float scale = weight * scale_bias[0];
+      const float bias = weight * scale_bias[1];
+
+      TypedAxpy<InType, OutType>(
+          block_size, scale, input + fused_block_size * indices[current], out);
+
+      out_vector += bias;
+
+      ++current;
+    }
+    if (normalize_by_lengths && lengths[m]) {
+      // hack: context is not really used
+      math::Scale<OutType, CPUContext>(
+          block_size, 1.f / lengths[m], out, out, nullptr);
+    }
+    out += block_size;
+  }
+  CAFFE_ENFORCE_EQ(
+      current,
+      index_size,
+      "Your input seems to be incorrect: the sum of lengths values should be "
+      "the size of the indices tensor, but it appears not.");
+}
+
+// Proxy back to generic implementation
+#define FUSED_8BIT_ROWWISE_EMBEDDING_SPECIALIZATION(IndexType, OutType)        \
+  void                                                                         \
+      Fused8BitRowwiseEmbeddingLookup_##IndexType##_uint8_t_##OutType##__base( \
+          const TIndex block_size,                                             \
+          const TIndex output_size,                                            \
+          const TIndex index_size,                                             \
+          const TIndex data_size,                                              \
+          const uint8_t* input,                                                \
+          const IndexType* indices,                                            \
+          const int* lengths,                                                  \
+          const float* weights,                                                \
+          bool normalize_by_lengths,                                           \
+          OutType* out,                                                        \
+          int prefetch_distance) {                                             \
+    Fused8BitRowwiseEmbeddingLookupGenericSlow<IndexType, uint8_t, OutType>(   \
+        block_size,                                                            \
+        output_size,                                                           \
+        index_size,                                                            \
+        data_size,                                                             \
+        input,                                                                 \
+        indices,                                                               \
+        lengths,                                                               \
+        weights,                                                               \
+        normalize_by_lengths,                                                  \
+        out,                                                                   \
+        prefetch_distance);                                                    \
+  }                                                                            \
+  template <>                                                                  \
+  void Fused8BitRowwiseEmbeddingLookup(                                        \
+      const TIndex block_size,                                                 \
+      const TIndex output_size,                                                \
+      const TIndex index_size,                                                 \
+      const TIndex data_size,                                                  \
+      const uint8_t* input,                                                    \
+      const IndexType* indices,                                                \
+      const int* lengths,                                                      \
+      const float* weights,                                                    \
+      bool normalize_by_lengths,                                               \
+      OutType* out,                                                            \
+      int prefetch_distance) {                                                 \
+    AVX512_DO(                                                                 \
+        Fused8BitRowwiseEmbeddingLookup_##IndexType##_uint8_t_##OutType,       \
+        block_size,                                                            \
+        output_size,                                                           \
+        index_size,                                                            \
+        data_size,                                                             \
+        input,                                                                 \
+        indices,                                                               \
+        lengths,                                                               \
+        weights,                                                               \
+        normalize_by_lengths,                                                  \
+        out,                                                                   \
+        prefetch_distance);                                                    \
+    AVX2_FMA_DO(                                                               \
+        Fused8BitRowwiseEmbeddingLookup_##IndexType##_uint8_t_##OutType,       \
+        block_size,                                                            \
+        output_size,                                                           \
+        index_size,                                                            \
+        data_size,                                                             \
+        input,                                                                 \
+        indices,                                                               \
+        lengths,                                                               \
+        weights,                                                               \
+        normalize_by_lengths,                                                  \
+        out,                                                                   \
+        prefetch_distance);                                                    \
+    BASE_DO(                                                                   \
+        Fused8BitRowwiseEmbeddingLookup_##IndexType##_uint8_t_##OutType,       \
+        block_size,                                                            \
+        output_size,                                                           \
+        index_size,                                                            \
+        data_size,                                                             \
+        input,                                                                 \
+        indices,                                                               \
+        lengths,                                                               \
+        weights,                                                               \
+        normalize_by_lengths,                                                  \
+        out,                                                                   \
+        prefetch_distance);                                                    \
+  }
+
+FUSED_8BIT_ROWWISE_EMBEDDING_SPECIALIZATION(int32_t, float);
+FUSED_8BIT_ROWWISE_EMBEDDING_SPECIALIZATION(int64_t, float);
+
+#undef FUSED_8BIT_ROWWISE_EMBEDDING_SPECIALIZATION
+
+} // namespace caffe2
@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "caffe2/core/common.h"
+#include "caffe2/perfkernels/embedding_lookup.h"
+
+namespace caffe2 {
+
+/**
+ * Embedding lookup with reduction on rows quantized to 8 bits, where the
+ * scale and bias of each row are stored as two floats right after its
+ * block_size bytes, so that a row only touches a single contiguous range of
+ * memory.
+ *
+ * `input` of size data_size * (block_size + 8 bytes)
+ * `indices` of size index_size
+ * `lengths` of size output_size
+ * `weights` nullptr or array of size index_size
+ * `out` of size output_size * block_size
+ * sum(lengths[i]) == index_size
+ *
+ * Note that block_size should be the number of quantized values per row in
+ * the data, i.e. excluding the scale and bias. The total (fused) block size
+ * is assumed to be this block_size + 8.
+ *
+ * Behavior is roughly equivalent to pseudocode:
+ *
+ * fused_block_size = block_size + 8B // quantized values and scale and bias
+ * pos = 0
+ * for (i = 0..index_size-1)
+ *   for (k = 0..block_size-1)
+ *     out[i*block_size + k] = 0
+ *   for (j = 0..lengths[i]-1)
+ *     scale = input[indices[pos]*(fused_block_size) + block_size]
+ *     bias = input[indices[pos]*(fused_block_size) + block_size + 4]
+ *     for (k = 0..block_size-1)
+ *       out[i*block_size + k] += (input[indices[pos]*(fused_block_size) + k] *
+ *                                 scale + bias) *
+ *                                (weights ? weights[pos] : 1.0)
+ *     pos += 1
+ *   if (normalize_weights && lengths[i] > 0)
+ *     for (k = 0..block_size-1)
+ *       out[i*block_size + k] /= lengths[i]
+ *
+ */
+template <typename IndexType, typename InType, typename OutType>
+void Fused8BitRowwiseEmbeddingLookup(
+    const TIndex block_size,
+    const TIndex output_size,
+    const TIndex index_size,
+    const TIndex data_size,
+    const InType* input,
+    const IndexType* indices,
+    const int* lengths,
+    const float* weights, // optional, can be null for non-weighted sum
+    bool normalize_by_lengths,
+    OutType* out,
+    int prefetch_distance = kEmbeddingLookupDefaultPrefetchDistance);
+
+} // namespace caffe2
@@ -21,46 +21,126 @@ import argparse
 import sys
 
 
-def unroll(uf, IndexType, InType, OutType, use_weights, isa):
-
-    def sizeof(InType):
-        size = 0
-        if InType == "float":
-            size = 4
-        elif InType == "float16":
-            size = 2
-        elif InType == "uint8_t":
-            size = 1
+# Per-ISA vocabulary. Each ISA computes on registers of `width` floats.
+ISAS = {
+    "avx2": {
+        "width": 8,
+        "vtype": "__m256",
+        "prefix": "_mm256",
+        "suffix": "__avx2_fma",
+        "unroll": [(128, 16), (64, 8), (32, 4), (16, 2)],
+    },
+    "avx512": {
+        "width": 16,
+        "vtype": "__m512",
+        "prefix": "_mm512",
+        "suffix": "__avx512",
+        "unroll": [(128, 8), (64, 4), (32, 2), (16, 1)],
+    },
+}
+
+
+def sizeof(InType):
+    size = 0
+    if InType == "float":
+        size = 4
+    elif InType == "float16":
+        size = 2
+    elif InType == "uint8_t":
+        size = 1
+    else:
+        assert False
+
+    return size
+
+
+def load(InType, isa, addr):
+    # Returns an expression that loads isa["width"] elements of InType from
+    # addr and converts them to floats.
+    p = isa["prefix"]
+    if InType == "float":
+        return "%s_loadu_ps(%s)" % (p, addr)
+    elif InType == "float16":
+        if isa["width"] == 8:
+            return ("_mm256_cvtph_ps(_mm_loadu_si128("
+                    "reinterpret_cast<const __m128i*>(%s)))" % addr)
+        return ("_mm512_cvtph_ps(_mm256_loadu_si256("
+                "reinterpret_cast<const __m256i*>(%s)))" % addr)
+    elif InType == "uint8_t":
+        if isa["width"] == 8:
+            return ("_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64("
+                    "reinterpret_cast<const __m128i*>(%s))))" % addr)
+        return ("_mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128("
+                "reinterpret_cast<const __m128i*>(%s))))" % addr)
+    else:
+        assert False
+
+
+def weights_and_bias(IndexType, InType, OutType, fused, isa):
+    # Computes wgt (and bio for uint8_t input) for the current row.
+    p = isa["prefix"]
+    vtype = isa["vtype"]
+    code = []
+    code.append(OutType + " wgt = 1.f;")
+    if InType == "uint8_t":
+        code.append(OutType + " bio;")
+    code.append("if (weights) {")
+    code.append("wgt = weights[dataInd];")
+    code.append("}")
+    if InType == "uint8_t":
+        if fused:
+            # The scale and bias are not necessarily aligned to 4 bytes.
+            code.append("float scale_bias[2];")
+            code.append(
+                "memcpy(scale_bias, "
+                "&input[idx * fused_block_size + block_size], "
+                "sizeof(scale_bias));")
+            code.append("bio = wgt * scale_bias[1];")
+            code.append("wgt = wgt * scale_bias[0];")
         else:
-            assert False
+            code.append("bio = wgt * scale_bias[2 * idx + 1];")
+            code.append("wgt = wgt * scale_bias[2 * idx];")
+        code.append("%s vbio = %s_set1_ps(bio);" % (vtype, p))
+    code.append("%s vwgt = %s_set1_ps(wgt);" % (vtype, p))
+    return code
+
+
+def row_setup(IndexType, InType, fused):
+    # Locates the current row and the row prefdist_T0 lookups ahead of it.
+    stride = "fused_block_size" if fused else "block_size"
+    code = []
+    code.append("const " + InType + "* ip = &input[idx * " + stride + "];")
+    code.append("const " + IndexType +
+                " next_T0 = (dataInd < index_size - prefdist_T0) ? "
+                "(dataInd + prefdist_T0) : dataInd;")
+    code.append("const " + IndexType + " idx_pref_T0 = indices[next_T0];")
+    code.append("CAFFE_ENFORCE(idx_pref_T0 >= 0 && idx_pref_T0 < data_size);")
+    code.append("const " + InType + "* ip_next_T0 = &input[idx_pref_T0 * " +
+                stride + "];")
+    return code
+
 
-        return size
+def unroll(uf, IndexType, InType, OutType, use_weights, isa, fused):
+
+    p = isa["prefix"]
+    vtype = isa["vtype"]
+    width = isa["width"]
 
     def compute(regid, InType, use_weights, isa, prefetch):
         code = []
 
-        if InType == "float":
-            code.append("vop%d = _mm256_fmadd_ps(vwgt,  \
-                  _mm256_loadu_ps(ip + (%d)), vop%d);" % (regid, regid, regid))
-
-        elif InType == "float16":
-            code.append("vop%d = _mm256_fmadd_ps(vwgt,  \
-                   _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ip + (%d)))), \
-                   vop%d);"
-                        % (regid, regid, regid))
-        elif InType == "uint8_t":
-            code.append("vop%d = _mm256_fmadd_ps(vwgt,  \
-                   _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(ip + (%d))))), \
-                   _mm256_add_ps(vop%d, vbio));"
-                        % (regid, regid, regid))
-        else:
-            assert False
-
+        acc = "vop%d" % regid
+        if InType == "uint8_t":
+            acc = "%s_add_ps(vop%d, vbio)" % (p, regid)
+        code.append("vop%d = %s_fmadd_ps(vwgt, %s, %s);" % (
+            regid, p, load(InType, isa, "ip + (%d)" % regid), acc))
 
-        if prefetch == True:
-            code.append("_mm_prefetch((&ip_next_T0[%d]), _MM_HINT_T0);" % (regid))
+        if prefetch:
+            code.append(
+                "_mm_prefetch((&ip_next_T0[%d]), _MM_HINT_T0);" % (regid))
         else:
-            code.append("// skip unecassery prefetch of (&ip_next_T0[%d])" % (regid))
+            code.append(
+                "// skip unecassery prefetch of (&ip_next_T0[%d])" % (regid))
 
         return code
 
@@ -69,45 +149,23 @@ def unroll(uf, IndexType, InType, OutType, use_weights, isa):
     code.append(IndexType + " dataInd = 0;")
     code.append("for (" + IndexType +
                 " rangeIndex = 0; rangeIndex < output_size; ++rangeIndex) {")
-    code.append(OutType + " *op = &out[rangeIndex * block_size];")
+    code.append(OutType + "* op = &out[rangeIndex * block_size];")
     for i in range(0, uf):
-        j = 8 * i
-        code.append("__m256 vop" + str(j) + " = _mm256_setzero_ps();")
+        j = width * i
+        code.append("%s vop%d = %s_setzero_ps();" % (vtype, j, p))
 
     # inner loop
-    code.append("for (" + IndexType +
-                " start = dataInd; dataInd < start + lengths[rangeIndex]; ++dataInd) {")
-    code.append("const  " + IndexType + " idx = indices[dataInd];")
+    code.append("for (" + IndexType + " start = dataInd; "
+                "dataInd < start + lengths[rangeIndex]; ++dataInd) {")
+    code.append("const " + IndexType + " idx = indices[dataInd];")
     code.append(
-        'CAFFE_ENFORCE(idx >=0 && idx < data_size, "Index ", dataInd, " is out of bounds: ", idx, ", range 0 to ", data_size);')
-
-    if InType == "uint8_t":
-        code.append(OutType + " wgt = 1.f;")
-        code.append(OutType + " bio;")
-        code.append("if (weights) {")
-        code.append("wgt = weights[dataInd];")
-        code.append("}")
-        code.append("bio = wgt * scale_bias[2 * idx + 1];");
-        code.append("wgt = wgt * scale_bias[2 * idx];");
-        code.append("__m256 vbio = _mm256_set1_ps(bio);")
-    else:
-        code.append(OutType + " wgt = 1.f;")
-        code.append("if (weights) {")
-        code.append("wgt = weights[dataInd];")
-        code.append("}")
-    code.append("__m256 vwgt = _mm256_set1_ps(wgt);")
-
-    code.append("const  " + InType + " *ip = &input[idx * block_size];")
-    code.append("const  " + IndexType +
-                " next_T0 = (dataInd < index_size - prefdist_T0) ? (dataInd + prefdist_T0) : dataInd;");
-    code.append("const  " + IndexType + " idx_pref_T0 = indices[next_T0];")
-    code.append(
-        "CAFFE_ENFORCE(idx_pref_T0 >= 0 && idx_pref_T0 < data_size);")
-    code.append("const  " + InType +
-                " *ip_next_T0 = &input[idx_pref_T0 * block_size];")
+        'CAFFE_ENFORCE(idx >= 0 && idx < data_size, "Index ", dataInd, '
+        '" is out of bounds: ", idx, ", range 0 to ", data_size);')
+    code.extend(weights_and_bias(IndexType, InType, OutType, fused, isa))
+    code.extend(row_setup(IndexType, InType, fused))
 
     for i in range(0, uf):
-        j = 8 * i
+        j = width * i
         cachelinesize = 64
         byteoffset = sizeof(InType) * j
         prefetch = ((byteoffset % cachelinesize) == 0)
@@ -116,45 +174,35 @@ def unroll(uf, IndexType, InType, OutType, use_weights, isa):
 
     code.append("if (normalize_by_lengths == false) {")
     for i in range(0, uf):
-        j = 8 * i
-        code.append(
-            "_mm256_storeu_ps(&op[" + str(j) + "], vop" + str(j) + ");")
+        j = width * i
+        code.append("%s_storeu_ps(&op[%d], vop%d);" % (p, j, j))
     code.append("} else if (lengths[rangeIndex]) {")
     # inv of length
-    code.append(
-        "__m256 vlen_inv = _mm256_set1_ps(1.0f / lengths[rangeIndex]);")
+    code.append("%s vlen_inv = %s_set1_ps(1.0f / lengths[rangeIndex]);" %
+                (vtype, p))
     for i in range(0, uf):
-        j = 8 * i
-        code.append(
-            "_mm256_storeu_ps(&op[" + str(j) + "], _mm256_mul_ps(" + "vop" + str(j) + ", vlen_inv));")
+        j = width * i
+        code.append("%s_storeu_ps(&op[%d], %s_mul_ps(vop%d, vlen_inv));" %
+                    (p, j, p, j))
     code.append("}")
 
     code.append("}")
     return code
 
 
-def generic(IndexType, InType, OutType, use_weights, isa):
+def generic(IndexType, InType, OutType, use_weights, isa, fused):
+
+    p = isa["prefix"]
+    vtype = isa["vtype"]
+    width = isa["width"]
 
     def compute(InType, use_weights, isa):
         code = []
-        if InType == "float":
-            code.append("_mm256_storeu_ps(&op[j], \
-                                 _mm256_fmadd_ps(vwgt,_mm256_loadu_ps(&ip[j]), _mm256_loadu_ps(&op[j])) \
-                                   );")
-        elif InType == "float16":
-            code.append("_mm256_storeu_ps(&op[j], \
-                   _mm256_fmadd_ps(vwgt, \
-                     _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&ip[j]))), _mm256_loadu_ps(&op[j])) \
-                                   );")
-        elif InType == "uint8_t":
-            code.append("_mm256_storeu_ps(&op[j], \
-                   _mm256_fmadd_ps(vwgt, \
-                     _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&ip[j])))), \
-                     _mm256_add_ps(_mm256_loadu_ps(&op[j]), vbio) ) \
-                                   );")
-        else:
-            assert False
-
+        acc = "%s_loadu_ps(&op[j])" % p
+        if InType == "uint8_t":
+            acc = "%s_add_ps(%s, vbio)" % (p, acc)
+        code.append("%s_storeu_ps(&op[j], %s_fmadd_ps(vwgt, %s, %s));" % (
+            p, p, load(InType, isa, "&ip[j]"), acc))
 
         code.append("_mm_prefetch((&ip_next_T0[j]), _MM_HINT_T0);")
 
@@ -164,60 +212,43 @@ def generic(IndexType, InType, OutType, use_weights, isa):
     code.append(IndexType + " dataInd = 0;")
     code.append("for (" + IndexType +
                 " rangeIndex = 0; rangeIndex < output_size; ++rangeIndex) {")
-    code.append(OutType + " *op = &out[rangeIndex * block_size];")
+    code.append(OutType + "* op = &out[rangeIndex * block_size];")
 
     # initialize to 0
     code.append("TIndex j = 0;")
-    code.append("for(; j + 8 <= block_size; j += 8) {")
-    code.append("_mm256_storeu_ps(op + j, _mm256_setzero_ps());")
+    code.append("for (; j + %d <= block_size; j += %d) {" % (width, width))
+    code.append("%s_storeu_ps(op + j, %s_setzero_ps());" % (p, p))
     code.append("}")
-    code.append("for(; j < block_size; j++) {")
+    code.append("for (; j < block_size; j++) {")
     code.append("op[j] = 0.0f;")
     code.append("}")
 
     # inner loop
-    code.append("for (" + IndexType +
-                " start = dataInd; dataInd < start + lengths[rangeIndex]; ++dataInd) {")
-    code.append("const  " + IndexType + " idx = indices[dataInd];")
+    code.append("for (" + IndexType + " start = dataInd; "
+                "dataInd < start + lengths[rangeIndex]; ++dataInd) {")
+    code.append("const " + IndexType + " idx = indices[dataInd];")
     code.append(
-        'CAFFE_ENFORCE(idx >=0 && idx < data_size, "Index ", dataInd, " is out of bounds: ", idx, ", range 0 to ", data_size);')
-
-    if InType == "uint8_t":
-        code.append(OutType + " wgt = 1.f;")
-        code.append(OutType + " bio;")
-        code.append("if (weights) {")
-        code.append("wgt = weights[dataInd];")
-        code.append("}")
-        code.append("assert (scale_bias);")
-        code.append("bio = wgt * scale_bias[2 * idx + 1];");
-        code.append("wgt = wgt * scale_bias[2 * idx];");
-        code.append("__m256 vbio = _mm256_set1_ps(bio);")
+        'CAFFE_ENFORCE(idx >= 0 && idx < data_size, "Index ", dataInd, '
+        '" is out of bounds: ", idx, ", range 0 to ", data_size);')
+    if InType == "uint8_t" and not fused:
+        weights = weights_and_bias(IndexType, InType, OutType, fused, isa)
+        # scale_bias is dereferenced below, so make that explicit.
+        code.extend(weights[:5])
+        code.append("assert(scale_bias);")
+        code.extend(weights[5:])
     else:
-        code.append(OutType + " wgt = 1.f;")
-        code.append("if (weights) {")
-        code.append("wgt = weights[dataInd];")
-        code.append("}")
-    code.append("__m256 vwgt = _mm256_set1_ps(wgt);")
-
-    code.append("const  " + InType + " *ip = &input[idx * block_size];")
-    code.append("const  " + IndexType +
-                " next_T0 = (dataInd < index_size - prefdist_T0) ? (dataInd + prefdist_T0) : dataInd;");
-    code.append("const  " + IndexType + " idx_pref_T0 = indices[next_T0];")
-    code.append(
-        "CAFFE_ENFORCE(idx_pref_T0 >= 0 && idx_pref_T0 < data_size);")
-    code.append("const  " + InType +
-                " *ip_next_T0 = &input[idx_pref_T0 * block_size];")
+        code.extend(weights_and_bias(IndexType, InType, OutType, fused, isa))
+    code.extend(row_setup(IndexType, InType, fused))
 
     # compute and store main loop
     code.append("j = 0;")
-    code.append("for(; j + 8 <= block_size; j += 8) {")
+    code.append("for (; j + %d <= block_size; j += %d) {" % (width, width))
     code.extend(compute(InType, use_weights, isa))
     code.append("}")
     # leftover
     if InType == "float16":
-        #code.append("float16 vtmp1[8] __attribute__((aligned(64)));")
         code.append("float16 vtmp1[8] CAFFE2_ALIGNED(64);")
-    code.append("for(; j < block_size; j++) {")
+    code.append("for (; j < block_size; j++) {")
     if InType == "float":
         code.append("op[j] += wgt * ip[j];")
     elif InType == "float16":
@@ -235,13 +266,13 @@ def generic(IndexType, InType, OutType, use_weights, isa):
 
     code.append("if (normalize_by_lengths && lengths[rangeIndex]) {")
     code.append("float len_inv = 1.0f / lengths[rangeIndex];")
-    code.append("__m256 vlen_inv = _mm256_set1_ps(len_inv);")
+    code.append("%s vlen_inv = %s_set1_ps(len_inv);" % (vtype, p))
     code.append("j = 0;")
-    code.append("for(; j + 8 <= block_size; j += 8) {")
-    code.append(
-        "_mm256_storeu_ps(&op[j], _mm256_mul_ps(_mm256_loadu_ps(&op[j]), vlen_inv));")
+    code.append("for (; j + %d <= block_size; j += %d) {" % (width, width))
+    code.append("%s_storeu_ps(&op[j], %s_mul_ps(%s_loadu_ps(&op[j]), "
+                "vlen_inv));" % (p, p, p))
     code.append("}")
-    code.append("for(; j < block_size; j++) {")
+    code.append("for (; j < block_size; j++) {")
     code.append("op[j] = len_inv * op[j];")
     code.append("}")
 
@@ -251,12 +282,21 @@ def generic(IndexType, InType, OutType, use_weights, isa):
     return code
 
 
-
 # start main code
 parser = argparse.ArgumentParser()
 parser.add_argument('-f', nargs=1, help="file name")
+parser.add_argument(
+    '--isa', default="avx2", choices=sorted(ISAS.keys()),
+    help="instruction set to generate the kernels for")
+parser.add_argument(
+    '--fused', action='store_true',
+    help="generate kernels for rows with a fused 8-bit rowwise scale and bias")
 opts = parser.parse_args()
-filename = "embedding_lookup_avx2.cc"
+isa = ISAS[opts.isa]
+if opts.fused:
+    filename = "embedding_lookup_fused_8bit_rowwise_" + opts.isa + ".cc"
+else:
+    filename = "embedding_lookup_" + opts.isa + ".cc"
 if opts.f:
     filename = (opts.f)[0]
 fout = open(filename, 'w')
@@ -269,6 +309,11 @@ options = [["int32_t", "float",   "float"],
            ["int64_t", "uint8_t",  "float"],
           ]
 
+if opts.fused:
+    options = [["int32_t", "uint8_t", "float"],
+               ["int64_t", "uint8_t", "float"],
+              ]
+
 code = []
 # includes
 code.append(
@@ -298,14 +343,18 @@ code.append("//// --------------------------\n\n")
 code.append("#include \"caffe2/core/types.h\"")
 code.append("#include \"caffe2/core/common.h\"")
 code.append("#include <immintrin.h>")
+if opts.fused:
+    code.append("#include <cstring>")
 code.append("\n")
 
 code.append("namespace caffe2 {\n")
 for o in options:
     [IndexType, InType, OutType] = o
 
-    fn = "void EmbeddingLookup_" + IndexType + \
-        "_" + InType + "_" + OutType + "__avx2_fma"
+    prefix = "Fused8BitRowwiseEmbeddingLookup_" if opts.fused \
+        else "EmbeddingLookup_"
+    fn = "void " + prefix + IndexType + "_" + InType + "_" + OutType + \
+        isa["suffix"]
     code.append(fn + "(")
     code.append("const TIndex block_size,")
     code.append("const TIndex output_size,")
@@ -315,29 +364,34 @@ for o in options:
     code.append("const " + IndexType + "* indices,")
     code.append("const int* lengths,")
     code.append("const float* weights,")
-    code.append("const float* scale_bias,")
+    if not opts.fused:
+        code.append("const float* scale_bias,")
     code.append("bool normalize_by_lengths,")
-    code.append(OutType + "* out)")
+    code.append(OutType + "* out,")
+    code.append("int prefetch_distance)")
 
     code.append("{")
-    code.append("const " + IndexType + " prefdist_T0 = 16;")
-    #code.append("printf(\"calling " + fn + "\\n\");");
-    if InType != "uint8_t":
-        code.append("CAFFE_ENFORCE(scale_bias == nullptr, \"scale_bias must be nullptr\");");
+    code.append("const " + IndexType + " prefdist_T0 = prefetch_distance;")
+    if opts.fused:
+        # Each row holds block_size bytes followed by a float scale and bias.
+        code.append("const TIndex fused_block_size = block_size + 8;")
+    elif InType != "uint8_t":
+        code.append(
+            "CAFFE_ENFORCE(scale_bias == nullptr, "
+            "\"scale_bias must be nullptr\");")
     else:
-        code.append("CAFFE_ENFORCE(scale_bias != nullptr, \"scale_bias must not be nullptr\");");
-
-    code.append("if (block_size == 128) {")
-    code.extend(unroll(16, IndexType, InType, OutType, True, "AVX2"))
-    code.append("} else if (block_size == 64) {")
-    code.extend(unroll(8, IndexType, InType, OutType, True, "AVX2"))
-    code.append("} else if (block_size == 32) {")
-    code.extend(unroll(4, IndexType, InType, OutType, True, "AVX2"))
-    code.append("} else if (block_size == 16) {")
-    code.extend(unroll(2, IndexType, InType, OutType, True, "AVX2"))
+        code.append(
+            "CAFFE_ENFORCE(scale_bias != nullptr, "
+            "\"scale_bias must not be nullptr\");")
+
+    for i, (block_size, uf) in enumerate(isa["unroll"]):
+        code.append(("if" if i == 0 else "} else if") +
+                    " (block_size == %d) {" % block_size)
+        code.extend(
+            unroll(uf, IndexType, InType, OutType, True, isa, opts.fused))
     code.append("} else {")
     code.append("// generic code")
-    code.extend(generic(IndexType, InType, OutType, True, "AVX2"))
+    code.extend(generic(IndexType, InType, OutType, True, isa, opts.fused))
     code.append("}")
 
 
@@ -290,7 +290,7 @@ class TestOperators(hu.HypothesisTestCase):
 
     @given(axis=st.integers(min_value=1, max_value=4),
            num_output=st.integers(min_value=4, max_value=8),
-           engine=st.sampled_from(["", "PACKED"]),
+           engine=st.sampled_from(["", "PACKED", "PREPACKED"]),
            **hu.gcs)
     def test_fully_connected_axis(self, axis, num_output, engine, gc, dc):
         np.random.seed(1)
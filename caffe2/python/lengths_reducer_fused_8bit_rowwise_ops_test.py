@@ -0,0 +1,161 @@
+# Copyright (c) 2016-present, Facebook, Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##############################################################################
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+from caffe2.python import core, workspace
+import caffe2.python.hypothesis_test_util as hu
+
+from hypothesis import given
+import hypothesis.strategies as st
+import numpy as np
+
+
+def RandomLengths(total):
+    lengths = []
+    while total > 0:
+        lengths.append(np.random.randint(1, total + 1))
+        total -= lengths[-1]
+    return np.asarray(lengths, dtype=np.int32)
+
+
+class TestLengthsReducerOpsFused8BitRowwise(hu.HypothesisTestCase):
+    @given(
+        input_data=hu.tensor(min_dim=2, max_dim=2),
+        weighted=st.booleans(),
+        seed=st.integers(0, 2**32 - 1),
+    )
+    def test_sparse_lengths_sum(self, input_data, weighted, seed):
+        net = core.Net("bench")
+
+        np.random.seed(seed)
+
+        input_data = input_data.astype(np.float32)
+        indices = np.random.randint(
+            low=0,
+            high=len(input_data),
+            size=[np.random.randint(len(input_data))],
+            dtype=np.int32
+        )
+
+        weights = np.random.uniform(size=[len(indices)]).astype(np.float32)
+        lengths = RandomLengths(len(indices))
+
+        quantized_data = net.FloatToFused8BitRowwiseQuantized(
+            'input_data', 'quantized_data'
+        )
+        dequantized_data = net.Fused8BitRowwiseQuantizedToFloat(
+            quantized_data, 'dequantized_data'
+        )
+
+        if weighted:
+            net.SparseLengthsWeightedSum(
+                [dequantized_data, 'weights', 'indices', 'lengths'],
+                'sum_reference',
+            )
+            net.SparseLengthsWeightedSumFused8BitRowwise(
+                [quantized_data, 'weights', 'indices', 'lengths'],
+                'sum_quantized'
+            )
+        else:
+            net.SparseLengthsSum(
+                [dequantized_data, 'indices', 'lengths'], 'sum_reference',
+            )
+            net.SparseLengthsSumFused8BitRowwise(
+                [quantized_data, 'indices', 'lengths'], 'sum_quantized'
+            )
+
+        workspace.FeedBlob('input_data', input_data)
+        workspace.FeedBlob('weights', weights)
+        workspace.FeedBlob('indices', indices)
+        workspace.FeedBlob('lengths', lengths)
+
+        workspace.GlobalInit(['caffe2', '--caffe2_log_level=0'])
+        workspace.CreateNet(net)
+        workspace.RunNetOnce(net)
+
+        sum_reference = workspace.FetchBlob('sum_reference')
+        sum_quantized = workspace.FetchBlob('sum_quantized')
+        np.testing.assert_allclose(
+            sum_reference, sum_quantized, rtol=1e-4, atol=1e-4)
+
+    @given(
+        input_data=hu.tensor(min_dim=2, max_dim=2),
+        seed=st.integers(0, 2**32 - 1),
+    )
+    def test_sparse_lengths_mean(self, input_data, seed):
+        net = core.Net("bench")
+
+        np.random.seed(seed)
+
+        input_data = input_data.astype(np.float32)
+        indices = np.random.randint(
+            low=0,
+            high=len(input_data),
+            size=[np.random.randint(len(input_data))],
+            dtype=np.int64
+        )
+        lengths = RandomLengths(len(indices))
+
+        quantized_data = net.FloatToFused8BitRowwiseQuantized(
+            'input_data', 'quantized_data'
+        )
+        dequantized_data = net.Fused8BitRowwiseQuantizedToFloat(
+            quantized_data, 'dequantized_data'
+        )
+
+        net.SparseLengthsMean(
+            [dequantized_data, 'indices', 'lengths'],
+            'mean_reference'
+        )
+        net.SparseLengthsMeanFused8BitRowwise(
+            [quantized_data, 'indices', 'lengths'], 'mean_quantized'
+        )
+
+        workspace.FeedBlob('input_data', input_data)
+        workspace.FeedBlob('indices', indices)
+        workspace.FeedBlob('lengths', lengths)
+
+        workspace.GlobalInit(['caffe2', '--caffe2_log_level=0'])
+        workspace.CreateNet(net)
+        workspace.RunNetOnce(net)
+
+        mean_reference = workspace.FetchBlob('mean_reference')
+        mean_quantized = workspace.FetchBlob('mean_quantized')
+        np.testing.assert_allclose(
+            mean_reference, mean_quantized, rtol=1e-4, atol=1e-4)
+
+    def test_quantize_roundtrip(self):
+        input_data = np.float32(np.asarray([[801., 786, 235.2, 2353.3434],
+                                            [9., 9., 9., 9.]]))
+        workspace.FeedBlob('input_data', input_data)
+        workspace.RunOperatorOnce(core.CreateOperator(
+            'FloatToFused8BitRowwiseQuantized',
+            ['input_data'],
+            ['quantized_data']))
+        quantized_data = workspace.FetchBlob('quantized_data')
+        self.assertEqual(quantized_data.dtype, np.uint8)
+        self.assertEqual(quantized_data.shape, (2, 4 + 8))
+        workspace.RunOperatorOnce(core.CreateOperator(
+            'Fused8BitRowwiseQuantizedToFloat',
+            ['quantized_data'],
+            ['dequantized_data']))
+        result = workspace.FetchBlob('dequantized_data')
+        np.testing.assert_array_almost_equal(
+            result[0], input_data[0], decimal=-1)
+        np.testing.assert_array_equal(result[1], input_data[1])
@@ -135,6 +135,85 @@ class TestIndexOps(TestCase):
             result3 = workspace.FetchBlob('result3')
             np.testing.assert_array_equal([1, 4, 1, 5, 5], result3)
 
+    def _test_frozen_index_store_load(
+            self, entries, missing, dtype, index_create_op):
+        workspace.RunOperatorOnce(core.CreateOperator(
+            index_create_op, [], ['frozen_index']))
+        workspace.FeedBlob('frozen_entries', np.array(entries, dtype=dtype))
+        workspace.RunOperatorOnce(core.CreateOperator(
+            'IndexLoad', ['frozen_index', 'frozen_entries'], ['frozen_index']))
+        workspace.RunOperatorOnce(core.CreateOperator(
+            'IndexFreeze', ['frozen_index'], ['frozen_index']))
+        workspace.RunOperatorOnce(core.CreateOperator(
+            'IndexStore',
+            ['frozen_index'],
+            ['frozen_stored', 'frozen_table']))
+        self.assertGreater(workspace.FetchBlob('frozen_table').size,
+                           len(entries))
+
+        workspace.RunOperatorOnce(core.CreateOperator(
+            index_create_op, [], ['frozen_index2']))
+        workspace.RunOperatorOnce(core.CreateOperator(
+            'IndexLoad',
+            ['frozen_index2', 'frozen_stored', 'frozen_table'],
+            ['frozen_index2']))
+        query = np.array(entries[::-1] + entries[:1], dtype=dtype)
+        workspace.FeedBlob('frozen_query', query)
+        for index in ['frozen_index', 'frozen_index2']:
+            workspace.RunOperatorOnce(core.CreateOperator(
+                'IndexGet', [index, 'frozen_query'], ['frozen_result']))
+            np.testing.assert_array_equal(
+                list(range(len(entries), 0, -1)) + [1],
+                workspace.FetchBlob('frozen_result'))
+        # The reloaded index is frozen: unknown keys map to 0.
+        workspace.FeedBlob('frozen_missing', np.array([missing], dtype=dtype))
+        workspace.RunOperatorOnce(core.CreateOperator(
+            'IndexGet', ['frozen_index2', 'frozen_missing'], ['frozen_result']))
+        np.testing.assert_array_equal([0], workspace.FetchBlob('frozen_result'))
+        workspace.RunOperatorOnce(core.CreateOperator(
+            'IndexSize', ['frozen_index2'], ['frozen_size']))
+        self.assertEquals(workspace.FetchBlob('frozen_size'), len(entries) + 1)
+
+    def test_frozen_string_index_store_load(self):
+        self._test_frozen_index_store_load(
+            ['entry{}'.format(i) for i in range(100)], 'missing', str,
+            'StringIndexCreate')
+
+    def test_frozen_long_index_store_load(self):
+        self._test_frozen_index_store_load(
+            list(range(0, 1000, 7)), -1, np.int64, 'LongIndexCreate')
+
+    def test_unfrozen_index_store_load_with_table(self):
+        entries = list(range(10, 20))
+        workspace.RunOperatorOnce(core.CreateOperator(
+            'LongIndexCreate', [], ['unfrozen_index']))
+        workspace.FeedBlob('unfrozen_entries', np.array(entries, np.int64))
+        workspace.RunOperatorOnce(core.CreateOperator(
+            'IndexLoad',
+            ['unfrozen_index', 'unfrozen_entries'],
+            ['unfrozen_index']))
+        workspace.RunOperatorOnce(core.CreateOperator(
+            'IndexStore',
+            ['unfrozen_index'],
+            ['unfrozen_stored', 'unfrozen_table']))
+        self.assertEqual(workspace.FetchBlob('unfrozen_table').size, 0)
+
+        # The empty table is ignored and the index is loaded unfrozen.
+        workspace.RunOperatorOnce(core.CreateOperator(
+            'LongIndexCreate', [], ['unfrozen_index2']))
+        workspace.RunOperatorOnce(core.CreateOperator(
+            'IndexLoad',
+            ['unfrozen_index2', 'unfrozen_stored', 'unfrozen_table'],
+            ['unfrozen_index2']))
+        workspace.FeedBlob(
+            'unfrozen_query', np.array([19, 10, 42], np.int64))
+        workspace.RunOperatorOnce(core.CreateOperator(
+            'IndexGet',
+            ['unfrozen_index2', 'unfrozen_query'],
+            ['unfrozen_result']))
+        np.testing.assert_array_equal(
+            [10, 1, 11], workspace.FetchBlob('unfrozen_result'))
+
     def test_string_index_ops(self):
         self._test_index_ops([
             'entry1', 'entry2', 'entry3', 'new_entry1',
@@ -77,6 +77,95 @@ class TestTextFileReader(TestCase):
                         else:
                             np.testing.assert_array_equal(col_batch, results[i])
 
+    def test_threaded_text_file_reader(self):
+        schema = Struct(
+            ('field1', Scalar(dtype=str)),
+            ('field2', Scalar(dtype=np.float32)))
+        num_rows = 10
+        with tempfile.NamedTemporaryFile(mode='w+', delete=False) as txt_file:
+            for r in range(num_rows):
+                txt_file.write('r{}\t{}\n'.format(r, r))
+            txt_file.flush()
+            expected_keys = ['r{}'.format(r) for r in range(num_rows)]
+
+            for num_passes in range(1, 3):
+                for batch_size in [1, 3, num_rows + 1]:
+                    for num_threads in [1, 3]:
+                        init_net = core.Net('init_net')
+                        reader = TextFileReader(
+                            init_net,
+                            filename=txt_file.name,
+                            schema=schema,
+                            batch_size=batch_size,
+                            num_passes=num_passes,
+                            num_threads=num_threads)
+                        workspace.RunNetOnce(init_net)
+
+                        net = core.Net('read_net')
+                        should_stop, record = reader.read_record(net)
+                        keys = []
+                        values = []
+                        while True:
+                            workspace.RunNetOnce(net)
+                            arrays = FetchRecord(record).field_blobs()
+                            keys.extend(arrays[0])
+                            values.extend(arrays[1])
+                            if workspace.FetchBlob(should_stop):
+                                break
+                        keys = [
+                            k.decode() if isinstance(k, bytes) else k
+                            for k in keys]
+                        self.assertEqual(expected_keys * num_passes, keys)
+                        np.testing.assert_array_equal(
+                            np.tile(np.arange(num_rows), num_passes), values)
+
+    def test_sharded_text_file_reader(self):
+        schema = Struct(
+            ('key', Scalar(dtype=str)),
+            ('value', Scalar(dtype=np.float32)))
+        num_files = 3
+        rows_per_file = 1000
+        filenames = []
+        for f in range(num_files):
+            with tempfile.NamedTemporaryFile(
+                    mode='w', delete=False) as txt_file:
+                for r in range(rows_per_file):
+                    txt_file.write('k{}_{}\t{}\n'.format(f, r, r))
+                filenames.append(txt_file.name)
+        expected_keys = [
+            'k{}_{}'.format(f, r)
+            for f in range(num_files) for r in range(rows_per_file)]
+
+        for preserve_order in [True, False]:
+            init_net = core.Net('init_net')
+            reader = TextFileReader(
+                init_net,
+                filename=filenames,
+                schema=schema,
+                batch_size=64,
+                num_threads=4,
+                preserve_order=preserve_order)
+            workspace.RunNetOnce(init_net)
+
+            net = core.Net('read_net')
+            should_stop, record = reader.read_record(net)
+            keys = []
+            values = []
+            while True:
+                workspace.RunNetOnce(net)
+                arrays = FetchRecord(record).field_blobs()
+                keys.extend(arrays[0])
+                values.extend(arrays[1])
+                if workspace.FetchBlob(should_stop):
+                    break
+            keys = [k.decode() if isinstance(k, bytes) else k for k in keys]
+            if preserve_order:
+                self.assertEqual(expected_keys, keys)
+            else:
+                self.assertEqual(sorted(expected_keys), sorted(keys))
+            expected_sum = num_files * rows_per_file * (rows_per_file - 1) / 2
+            self.assertEqual(expected_sum, sum(values))
+
 if __name__ == "__main__":
     import unittest
     unittest.main()
@@ -28,17 +28,21 @@ class TextFileReader(Reader):
     """
     Wrapper around operators for reading from text files.
     """
-    def __init__(self, init_net, filename, schema, num_passes=1, batch_size=1):
+    def __init__(self, init_net, filename, schema, num_passes=1, batch_size=1,
+                 num_threads=0, preserve_order=True):
         """
         Create op for building a TextFileReader instance in the workspace.
 
         Args:
             init_net   : Net that will be run only once at startup.
-            filename   : Path to file to read from.
+            filename   : Path to file to read from, or list of paths.
             schema     : schema.Struct representing the schema of the data.
                          Currently, only support Struct of strings.
             num_passes : Number of passes over the data.
             batch_size : Number of rows to read at a time.
+            num_threads: Number of threads parsing the files. 0 reads them
+                         sequentially in the reading net.
+            preserve_order: With num_threads > 0, return rows in file order.
         """
         assert isinstance(schema, Struct), 'Schema must be a schema.Struct'
         for name, child in schema.get_children():
@@ -47,11 +51,14 @@ class TextFileReader(Reader):
         field_types = [
             data_type_for_dtype(dtype) for dtype in schema.field_types()]
         Reader.__init__(self, schema)
+        filenames = filename if isinstance(filename, list) else [filename]
         self._reader = init_net.CreateTextFileReader(
             [],
-            filename=filename,
+            filenames=filenames,
             num_passes=num_passes,
-            field_types=field_types)
+            field_types=field_types,
+            num_threads=num_threads,
+            preserve_order=preserve_order)
         self._batch_size = batch_size
 
     def read(self, net):
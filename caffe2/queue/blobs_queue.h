@@ -46,31 +46,26 @@ class BlobsQueue : public std::enable_shared_from_this<BlobsQueue> {
       bool enforceUniqueName,
       const std::vector<std::string>& fieldNames = {});
 
-  ~BlobsQueue() {
+  virtual ~BlobsQueue() {
     close();
   }
 
-  bool blockingRead(
+  virtual bool blockingRead(
       const std::vector<Blob*>& inputs,
       float timeout_secs = 0.0f);
-  bool tryWrite(const std::vector<Blob*>& inputs);
-  bool blockingWrite(const std::vector<Blob*>& inputs);
-  void close();
+  virtual bool tryWrite(const std::vector<Blob*>& inputs);
+  virtual bool blockingWrite(const std::vector<Blob*>& inputs);
+  virtual void close();
   size_t getNumBlobs() const {
     return numBlobs_;
   }
 
- private:
-  bool canWrite();
-  void doWrite(const std::vector<Blob*>& inputs);
-
+ protected:
+  // Slots of the circular buffer and stats, shared with the lock-free
+  // implementation in LockFreeBlobsQueue.
   std::atomic<bool> closing_{false};
 
   size_t numBlobs_;
-  std::mutex mutex_; // protects all variables in the class.
-  std::condition_variable cv_;
-  int64_t reader_{0};
-  int64_t writer_{0};
   std::vector<std::vector<Blob*>> queue_;
   const std::string name_;
 
@@ -80,5 +75,14 @@ class BlobsQueue : public std::enable_shared_from_this<BlobsQueue> {
     CAFFE_EXPORTED_STAT(queue_dequeued_records);
     CAFFE_DETAILED_EXPORTED_STAT(queue_dequeued_bytes);
   } stats_;
+
+ private:
+  bool canWrite();
+  void doWrite(const std::vector<Blob*>& inputs);
+
+  std::mutex mutex_; // protects reader_ and writer_.
+  std::condition_variable cv_;
+  int64_t reader_{0};
+  int64_t writer_{0};
 };
 } // namespace caffe2
@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/tensor.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/queue/blobs_queue.h"
+#include "caffe2/queue/lock_free_blobs_queue.h"
+
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+template <typename Queue>
+class BlobsQueueTest : public ::testing::Test {
+ protected:
+  std::shared_ptr<BlobsQueue> makeQueue(
+      size_t capacity,
+      const std::string& name = "queue") {
+    return std::make_shared<Queue>(&ws_, name, capacity, 1, true);
+  }
+
+  Workspace ws_;
+};
+
+typedef ::testing::Types<BlobsQueue, LockFreeBlobsQueue> QueueTypes;
+TYPED_TEST_CASE(BlobsQueueTest, QueueTypes);
+
+void SetValue(Blob* blob, int value) {
+  auto* tensor = blob->GetMutable<TensorCPU>();
+  tensor->Resize(1);
+  tensor->template mutable_data<int>()[0] = value;
+}
+
+int GetValue(const Blob& blob) {
+  return blob.Get<TensorCPU>().template data<int>()[0];
+}
+
+} // namespace
+
+TYPED_TEST(BlobsQueueTest, FifoOrder) {
+  auto queue = this->makeQueue(4);
+  Blob blob;
+  for (int i = 0; i < 4; ++i) {
+    SetValue(&blob, i);
+    EXPECT_TRUE(queue->tryWrite({&blob}));
+  }
+  SetValue(&blob, 4);
+  EXPECT_FALSE(queue->tryWrite({&blob}));
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(queue->blockingRead({&blob}));
+    EXPECT_EQ(GetValue(blob), i);
+  }
+}
+
+TYPED_TEST(BlobsQueueTest, CloseDrainsThenFails) {
+  auto queue = this->makeQueue(2);
+  Blob blob;
+  SetValue(&blob, 7);
+  EXPECT_TRUE(queue->blockingWrite({&blob}));
+  queue->close();
+  EXPECT_TRUE(queue->blockingRead({&blob}));
+  EXPECT_EQ(GetValue(blob), 7);
+  EXPECT_FALSE(queue->blockingRead({&blob}));
+}
+
+TYPED_TEST(BlobsQueueTest, CloseWakesUpBlockedThreads) {
+  auto queue = this->makeQueue(1);
+  Blob full;
+  SetValue(&full, 0);
+  EXPECT_TRUE(queue->tryWrite({&full}));
+  std::thread writer([&]() {
+    Blob blob;
+    SetValue(&blob, 1);
+    EXPECT_FALSE(queue->blockingWrite({&blob}));
+  });
+  auto emptyQueue = this->makeQueue(1, "empty_queue");
+  std::thread reader([&]() {
+    Blob blob;
+    EXPECT_FALSE(emptyQueue->blockingRead({&blob}));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  queue->close();
+  emptyQueue->close();
+  writer.join();
+  reader.join();
+}
+
+TYPED_TEST(BlobsQueueTest, ReadTimesOut) {
+  auto queue = this->makeQueue(1);
+  Blob blob;
+  EXPECT_FALSE(queue->blockingRead({&blob}, 0.05));
+}
+
+TYPED_TEST(BlobsQueueTest, ManyProducersManyConsumers) {
+  const int kThreads = 4;
+  const int kRecords = 2000;
+  auto queue = this->makeQueue(8);
+  std::atomic<int64_t> sum{0};
+  std::atomic<int> count{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&]() {
+      Blob blob;
+      for (int i = 1; i <= kRecords; ++i) {
+        SetValue(&blob, i);
+        EXPECT_TRUE(queue->blockingWrite({&blob}));
+      }
+    });
+  }
+  std::vector<std::thread> readers;
+  for (int t = 0; t < kThreads; ++t) {
+    readers.emplace_back([&]() {
+      Blob blob;
+      while (queue->blockingRead({&blob})) {
+        sum += GetValue(blob);
+        ++count;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  queue->close();
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(count, kThreads * kRecords);
+  EXPECT_EQ(sum, int64_t(kThreads) * kRecords * (kRecords + 1) / 2);
+}
+
+} // namespace caffe2
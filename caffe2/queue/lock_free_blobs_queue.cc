@@ -0,0 +1,311 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/queue/lock_free_blobs_queue.h"
+
+#include <climits>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "caffe2/core/blob_stats.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/stats.h"
+
+namespace caffe2 {
+
+// Constants for user tracepoints, same as in blobs_queue.cc
+static constexpr int SDT_NONBLOCKING_OP = 0;
+static constexpr int SDT_BLOCKING_OP = 1;
+static constexpr uint64_t SDT_TIMEOUT = (uint64_t)-1;
+static constexpr uint64_t SDT_ABORT = (uint64_t)-2;
+static constexpr uint64_t SDT_CANCEL = (uint64_t)-3;
+
+uint32_t FutexParker::prepareWait() {
+  waiters_.fetch_add(1, std::memory_order_seq_cst);
+  // Pairs with the fence in notify(): either the signaller sees us as a waiter
+  // or we see whatever it published before signalling.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return epoch_.load(std::memory_order_acquire);
+}
+
+void FutexParker::cancelWait() {
+  waiters_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+#ifdef __linux__
+
+static_assert(
+    sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+    "futex requires a plain 32-bit word");
+
+bool FutexParker::wait(
+    uint32_t epoch,
+    const std::chrono::steady_clock::time_point* deadline) {
+  bool timedOut = false;
+  while (epoch_.load(std::memory_order_acquire) == epoch) {
+    struct timespec ts;
+    struct timespec* timeout = nullptr;
+    if (deadline) {
+      const auto remaining = *deadline - std::chrono::steady_clock::now();
+      if (remaining <= std::chrono::steady_clock::duration::zero()) {
+        timedOut = true;
+        break;
+      }
+      const auto ns =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(remaining)
+              .count();
+      ts.tv_sec = ns / 1000000000;
+      ts.tv_nsec = ns % 1000000000;
+      timeout = &ts;
+    }
+    // Returns immediately with EAGAIN if the epoch has already moved on;
+    // spurious wakeups and EINTR are handled by re-checking the epoch.
+    syscall(
+        SYS_futex,
+        reinterpret_cast<uint32_t*>(&epoch_),
+        FUTEX_WAIT_PRIVATE,
+        epoch,
+        timeout,
+        nullptr,
+        0);
+  }
+  waiters_.fetch_sub(1, std::memory_order_relaxed);
+  return !timedOut;
+}
+
+void FutexParker::notify(bool all) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiters_.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  epoch_.fetch_add(1, std::memory_order_release);
+  syscall(
+      SYS_futex,
+      reinterpret_cast<uint32_t*>(&epoch_),
+      FUTEX_WAKE_PRIVATE,
+      all ? INT_MAX : 1,
+      nullptr,
+      nullptr,
+      0);
+}
+
+#else
+
+bool FutexParker::wait(
+    uint32_t epoch,
+    const std::chrono::steady_clock::time_point* deadline) {
+  bool woken = true;
+  {
+    std::unique_lock<std::mutex> g(mutex_);
+    auto changed = [this, epoch]() {
+      return epoch_.load(std::memory_order_acquire) != epoch;
+    };
+    if (deadline) {
+      woken = cv_.wait_until(g, *deadline, changed);
+    } else {
+      cv_.wait(g, changed);
+    }
+  }
+  waiters_.fetch_sub(1, std::memory_order_relaxed);
+  return woken;
+}
+
+void FutexParker::notify(bool all) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiters_.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> g(mutex_);
+    epoch_.fetch_add(1, std::memory_order_release);
+  }
+  if (all) {
+    cv_.notify_all();
+  } else {
+    cv_.notify_one();
+  }
+}
+
+#endif // __linux__
+
+LockFreeBlobsQueue::LockFreeBlobsQueue(
+    Workspace* ws,
+    const std::string& queueName,
+    size_t capacity,
+    size_t numBlobs,
+    bool enforceUniqueName,
+    const std::vector<std::string>& fieldNames)
+    : BlobsQueue(
+          ws,
+          queueName,
+          capacity,
+          numBlobs,
+          enforceUniqueName,
+          fieldNames),
+      capacity_(capacity),
+      sequence_(new std::atomic<uint64_t>[capacity]) {
+  CAFFE_ENFORCE_GT(capacity, 0, "Queue capacity must be positive.");
+  for (uint64_t i = 0; i < capacity_; ++i) {
+    sequence_[i].store(2 * i, std::memory_order_relaxed);
+  }
+}
+
+bool LockFreeBlobsQueue::blockingRead(
+    const std::vector<Blob*>& inputs,
+    float timeout_secs) {
+  auto keeper = this->shared_from_this();
+  const auto& name = name_.c_str();
+  CAFFE_SDT(queue_read_start, name, (void*)this, SDT_BLOCKING_OP);
+  CAFFE_EVENT(stats_, queue_balance, -1);
+  const bool hasDeadline = timeout_secs > 0;
+  const auto deadline = std::chrono::steady_clock::now() +
+      std::chrono::milliseconds(int(timeout_secs * 1000));
+  bool timedOut = false;
+  while (!tryDequeue(inputs)) {
+    if (closing_ || timedOut) {
+      if (hasDeadline && !closing_) {
+        LOG(ERROR) << "DequeueBlobs timed out in " << timeout_secs << " secs";
+        CAFFE_SDT(queue_read_end, name, (void*)this, SDT_TIMEOUT);
+      } else {
+        CAFFE_SDT(queue_read_end, name, (void*)this, SDT_CANCEL);
+      }
+      return false;
+    }
+    const auto epoch = notEmpty_.prepareWait();
+    if (closing_ || size() > 0) {
+      notEmpty_.cancelWait();
+      continue;
+    }
+    timedOut = !notEmpty_.wait(epoch, hasDeadline ? &deadline : nullptr);
+  }
+  CAFFE_SDT(queue_read_end, name, (void*)this, size() + 1);
+  CAFFE_EVENT(stats_, queue_dequeued_records);
+  return true;
+}
+
+bool LockFreeBlobsQueue::tryWrite(const std::vector<Blob*>& inputs) {
+  auto keeper = this->shared_from_this();
+  const auto& name = name_.c_str();
+  CAFFE_SDT(queue_write_start, name, (void*)this, SDT_NONBLOCKING_OP);
+  if (!tryEnqueue(inputs)) {
+    CAFFE_SDT(queue_write_end, name, (void*)this, SDT_ABORT);
+    return false;
+  }
+  CAFFE_EVENT(stats_, queue_balance, 1);
+  return true;
+}
+
+bool LockFreeBlobsQueue::blockingWrite(const std::vector<Blob*>& inputs) {
+  auto keeper = this->shared_from_this();
+  const auto& name = name_.c_str();
+  CAFFE_SDT(queue_write_start, name, (void*)this, SDT_BLOCKING_OP);
+  CAFFE_EVENT(stats_, queue_balance, 1);
+  while (!tryEnqueue(inputs)) {
+    if (closing_) {
+      CAFFE_SDT(queue_write_end, name, (void*)this, SDT_ABORT);
+      return false;
+    }
+    const auto epoch = notFull_.prepareWait();
+    if (closing_ || size() < capacity_) {
+      notFull_.cancelWait();
+      continue;
+    }
+    notFull_.wait(epoch, nullptr);
+  }
+  return true;
+}
+
+void LockFreeBlobsQueue::close() {
+  closing_ = true;
+  notEmpty_.notify(true);
+  notFull_.notify(true);
+}
+
+bool LockFreeBlobsQueue::tryDequeue(const std::vector<Blob*>& inputs) {
+  // Validate before claiming a slot, a throw afterwards would wedge the ring.
+  CAFFE_ENFORCE(inputs.size() >= numBlobs_);
+  auto pos = dequeuePos_.load(std::memory_order_relaxed);
+  for (;;) {
+    const auto seq = sequence_[pos % capacity_].load(std::memory_order_acquire);
+    const auto diff = static_cast<int64_t>(seq - (2 * pos + 1));
+    if (diff == 0) {
+      if (dequeuePos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The slot has not been published yet: queue is empty.
+      return false;
+    } else {
+      pos = dequeuePos_.load(std::memory_order_relaxed);
+    }
+  }
+  auto& result = queue_[pos % capacity_];
+  for (auto i = 0; i < result.size(); ++i) {
+    auto bytes = BlobStat::sizeBytes(*result[i]);
+    CAFFE_EVENT(stats_, queue_dequeued_bytes, bytes, i);
+    using std::swap;
+    swap(*(inputs[i]), *(result[i]));
+  }
+  sequence_[pos % capacity_].store(
+      2 * (pos + capacity_), std::memory_order_release);
+  notFull_.notify();
+  return true;
+}
+
+bool LockFreeBlobsQueue::tryEnqueue(const std::vector<Blob*>& inputs) {
+  CAFFE_ENFORCE(inputs.size() >= numBlobs_);
+  auto pos = enqueuePos_.load(std::memory_order_relaxed);
+  for (;;) {
+    const auto seq = sequence_[pos % capacity_].load(std::memory_order_acquire);
+    const auto diff = static_cast<int64_t>(seq - 2 * pos);
+    if (diff == 0) {
+      if (enqueuePos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The slot has not been consumed yet: queue is full.
+      return false;
+    } else {
+      pos = enqueuePos_.load(std::memory_order_relaxed);
+    }
+  }
+  auto& result = queue_[pos % capacity_];
+  for (auto i = 0; i < result.size(); ++i) {
+    using std::swap;
+    swap(*(inputs[i]), *(result[i]));
+  }
+  sequence_[pos % capacity_].store(2 * pos + 1, std::memory_order_release);
+  const auto& name = name_.c_str();
+  CAFFE_SDT(queue_write_end, name, (void*)this, capacity_ - size());
+  notEmpty_.notify();
+  return true;
+}
+
+uint64_t LockFreeBlobsQueue::size() const {
+  // Only a snapshot: both positions may move while we read them.
+  const auto dequeued = dequeuePos_.load(std::memory_order_acquire);
+  const auto enqueued = enqueuePos_.load(std::memory_order_acquire);
+  return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+} // namespace caffe2
@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "caffe2/queue/blobs_queue.h"
+
+namespace caffe2 {
+
+// Lets threads sleep until an event is signalled without a shared mutex.
+// Waiters register themselves and snapshot the epoch before re-checking their
+// condition; signallers bump the epoch and only enter the kernel when somebody
+// is actually parked. On Linux this maps directly onto futex(2), elsewhere it
+// falls back to a condition variable.
+class FutexParker {
+ public:
+  // Registers the caller as a waiter and returns the epoch to wait on. Must be
+  // followed by either cancelWait() or wait().
+  uint32_t prepareWait();
+  void cancelWait();
+  // Sleeps while the epoch is unchanged. Returns false if the deadline passed.
+  bool wait(
+      uint32_t epoch,
+      const std::chrono::steady_clock::time_point* deadline);
+  // Wakes up one parked waiter (or all of them if `all` is set).
+  void notify(bool all = false);
+
+ private:
+  std::atomic<uint32_t> epoch_{0};
+  std::atomic<uint32_t> waiters_{0};
+#ifndef __linux__
+  std::mutex mutex_;
+  std::condition_variable cv_;
+#endif
+};
+
+// Bounded multi-producer/multi-consumer BlobsQueue that does not serialize
+// readers and writers on a mutex. Slots are claimed with a CAS on the
+// enqueue/dequeue position and handed over through per-slot sequence numbers
+// (D. Vyukov's bounded MPMC queue); blocked threads park on a FutexParker so
+// that a write only wakes up a single reader and vice versa.
+//
+// Semantics (stats, tracepoints, timeouts and close) are the same as for
+// BlobsQueue. Readers still drain the records that were written before close.
+class LockFreeBlobsQueue : public BlobsQueue {
+ public:
+  LockFreeBlobsQueue(
+      Workspace* ws,
+      const std::string& queueName,
+      size_t capacity,
+      size_t numBlobs,
+      bool enforceUniqueName,
+      const std::vector<std::string>& fieldNames = {});
+
+  ~LockFreeBlobsQueue() override {
+    close();
+  }
+
+  bool blockingRead(
+      const std::vector<Blob*>& inputs,
+      float timeout_secs = 0.0f) override;
+  bool tryWrite(const std::vector<Blob*>& inputs) override;
+  bool blockingWrite(const std::vector<Blob*>& inputs) override;
+  void close() override;
+
+ private:
+  bool tryDequeue(const std::vector<Blob*>& inputs);
+  bool tryEnqueue(const std::vector<Blob*>& inputs);
+  uint64_t size() const;
+
+  const uint64_t capacity_;
+  // Per-slot turn counter: 2 * pos while the slot is free for the write at
+  // position pos, 2 * pos + 1 once that record is published. Doubling keeps the
+  // two states apart even for a queue of capacity 1.
+  std::unique_ptr<std::atomic<uint64_t>[]> sequence_;
+
+  // Keep the hot positions on separate cache lines.
+  alignas(64) std::atomic<uint64_t> enqueuePos_{0};
+  alignas(64) std::atomic<uint64_t> dequeuePos_{0};
+
+  alignas(64) FutexParker notEmpty_;
+  FutexParker notFull_;
+};
+
+} // namespace caffe2
@@ -33,7 +33,20 @@ REGISTER_CPU_OPERATOR(
     WeightedSampleDequeueBlobs,
     WeightedSampleDequeueBlobsOp<CPUContext>);
 
-OPERATOR_SCHEMA(CreateBlobsQueue).NumInputs(0).NumOutputs(1);
+OPERATOR_SCHEMA(CreateBlobsQueue)
+    .NumInputs(0)
+    .NumOutputs(1)
+    .Arg("capacity", "Maximum number of records in the queue, default 1")
+    .Arg("num_blobs", "Number of blobs per record, default 1")
+    .Arg(
+        "enforce_unique_name",
+        "Fail if the queue's internal blobs already exist, default false")
+    .Arg("field_names", "Optional names of the blobs, used for stats")
+    .Arg(
+        "lock_free",
+        "If set, use the lock-free MPMC implementation which scales better "
+        "with many concurrent readers and writers, default false")
+    .Output(0, "queue", "The shared pointer for the BlobsQueue");
 OPERATOR_SCHEMA(EnqueueBlobs)
     .NumInputsOutputs([](int inputs, int outputs) {
       return inputs >= 2 && outputs >= 1 && inputs == outputs + 1;
@@ -15,131 +15,37 @@
  */
 
 #include "rebatching_queue.h"
-#include "caffe2/utils/smart_tensor_printer.h"
 
 namespace caffe2 {
 
-namespace {
-
-// This concat function will always create a new first dimension to concat
-void concat(
-    CPUContext& context,
-    const std::vector<std::vector<TensorCPU>>& inputs,
-    const std::vector<TensorCPU*>& outputs) {
-  CAFFE_ENFORCE(!inputs.empty());
-
-  const auto& inputZero = inputs[0];
-  const auto numTensors = inputZero.size();
-  const auto numRows = inputs.size();
-
-  // Precompute the output sizes to avoid resizing
-  std::vector<std::vector<TIndex>> outputDims(numTensors);
-
-  for (int i = 0; i < numTensors; ++i) {
-    SmartTensorPrinter::PrintTensor(inputZero.at(i));
-    outputDims[i] = inputZero.at(i).dims();
-    outputDims[i].insert(outputDims[i].begin(), numRows);
-  }
-
-  // Resize to the final output size
-  std::vector<void*> destinations(numTensors);
-  for (int i = 0; i < numTensors; ++i) {
-    outputs[i]->Resize(outputDims[i]);
-    destinations[i] = outputs[i]->raw_mutable_data(inputZero[i].meta());
-  }
-
-  for (int i = 0; i < numRows; ++i) {
-    CAFFE_ENFORCE_EQ(inputs[i].size(), numTensors);
-
-    for (int j = 0; j < numTensors; ++j) {
-      const auto& input = inputs[i][j];
-
-      CAFFE_ENFORCE(inputZero[j].meta() == input.meta());
-      CAFFE_ENFORCE_EQ(inputZero[j].itemsize(), input.itemsize());
-      CAFFE_ENFORCE_EQ(inputZero[j].ndim(), input.ndim());
-      for (int k = 0; k < input.ndim(); ++k) {
-        CAFFE_ENFORCE_EQ(input.dims()[k], inputZero[j].dims()[k]);
-      }
-
-      // Skip empty tensors
-      if (input.size() == 0) {
-        continue;
-      }
-
-      context.CopyItems<CPUContext, CPUContext>(
-          input.meta(),
-          input.size(),
-          input.raw_data() /* src */,
-          destinations[j] /* dst */
-          );
-
-      destinations[j] =
-          (char*)destinations[j] + input.size() * input.itemsize();
-    }
-  }
-}
-
-std::vector<std::vector<TensorCPU>> split(
-    CPUContext& context,
-    const std::vector<const TensorCPU*>& inputs) {
-  CAFFE_ENFORCE(!inputs.empty());
-
-  const auto outputSize = inputs[0]->dims().at(0);
-  std::vector<std::vector<TensorCPU>> outputs(outputSize);
-
-  for (const auto* inputPtr : inputs) {
-    CAFFE_ENFORCE(inputPtr);
-
-    const auto& input = *inputPtr;
-    const auto innerSize = input.size_from_dim(1);
-    const auto itemSize = input.meta().itemsize();
-
-    auto outputDims = input.dims();
-    CAFFE_ENFORCE(!outputDims.empty());
-    outputDims.erase(outputDims.begin());
-    CAFFE_ENFORCE_EQ(input.dims().at(0), outputSize);
-
-    for (int i = 0; i < outputSize; ++i) {
-      outputs[i].push_back(TensorCPU(outputDims));
-      context.CopyItems<CPUContext, CPUContext>(
-          input.meta(),
-          innerSize,
-          (char*)input.raw_data() + i * innerSize * itemSize /* src */,
-          outputs[i].back().raw_mutable_data(input.meta()) /* dst */);
-    }
-  }
-
-  return outputs;
-}
-} // anonymous namespace
-
 RebatchingQueue::RebatchingQueue(size_t capacity, size_t numBlobs)
-    : capacity_(capacity), numBlobs_(numBlobs), queue_(capacity) {}
+    : capacity_(capacity), numBlobs_(numBlobs) {}
 
 RebatchingQueue::~RebatchingQueue() {
   close();
 }
 
 bool RebatchingQueue::canRead() const {
-  return tail_ < head_;
+  return size_ > 0;
 }
 
 bool RebatchingQueue::dequeue(
     CPUContext& context,
     size_t numElements,
     const std::vector<TensorCPU*>& outputs) {
-  std::vector<std::vector<TensorCPU>> results;
-  results.reserve(numElements);
-
-  for (;;) {
-    if (results.size() == numElements) {
-      break;
-    }
+  std::vector<RowRange> ranges;
+  size_t numRows = 0;
 
+  while (numRows < numElements) {
+    bool notify;
     {
       std::unique_lock<std::mutex> lock(mutex_);
 
-      cvEmpty_.wait(lock, [this] { return canRead() || isClosed_; });
+      if (!canRead() && !isClosed_) {
+        ++numWaitingReaders_;
+        cvEmpty_.wait(lock, [this] { return canRead() || isClosed_; });
+        --numWaitingReaders_;
+      }
 
       // We only want to stop reading if the queue is empty and closed
       if (!canRead() && isClosed_) {
@@ -147,66 +53,147 @@ bool RebatchingQueue::dequeue(
       }
 
       do {
-        results.push_back(std::move(queue_[tail_++ % capacity()]));
-      } while (canRead() && results.size() < numElements);
+        auto& front = queue_.front();
+        const size_t n =
+            std::min(front.end - front.begin, numElements - numRows);
+        ranges.push_back(RowRange{front.chunk, front.begin, front.begin + n});
+        front.begin += n;
+        size_ -= n;
+        numRows += n;
+        if (front.begin == front.end) {
+          queue_.pop_front();
+        }
+      } while (canRead() && numRows < numElements);
+
+      notify = numWaitingWriters_ > 0;
     }
 
-    if (numElements == 1) {
-      cvOverflow_.notify_one();
-    } else {
-      cvOverflow_.notify_all();
+    if (notify) {
+      if (numElements == 1) {
+        cvOverflow_.notify_one();
+      } else {
+        cvOverflow_.notify_all();
+      }
     }
   }
 
-  if (results.empty()) {
+  if (ranges.empty()) {
     return false;
   }
 
-  concat(context, results, outputs);
+  const auto& first = ranges[0].chunk->tensors;
+  const auto numTensors = first.size();
+  CAFFE_ENFORCE_EQ(outputs.size(), numTensors);
+
+  if (ranges.size() == 1 && ranges[0].begin == 0 &&
+      ranges[0].end == ranges[0].chunk->numRows) {
+    // The rows are a whole chunk, which is no longer referenced by the queue,
+    // so the outputs can take over its memory.
+    for (int i = 0; i < numTensors; ++i) {
+      outputs[i]->ResizeLike(first[i]);
+      outputs[i]->ShareData(first[i]);
+    }
+    return true;
+  }
+
+  for (int i = 0; i < numTensors; ++i) {
+    auto dims = first[i].dims();
+    dims[0] = numRows;
+    outputs[i]->Resize(dims);
+    auto* destination =
+        static_cast<char*>(outputs[i]->raw_mutable_data(first[i].meta()));
+
+    for (const auto& range : ranges) {
+      CAFFE_ENFORCE_EQ(range.chunk->tensors.size(), numTensors);
+      const auto& input = range.chunk->tensors[i];
+
+      CAFFE_ENFORCE(first[i].meta() == input.meta());
+      CAFFE_ENFORCE_EQ(first[i].ndim(), input.ndim());
+      for (int k = 1; k < input.ndim(); ++k) {
+        CAFFE_ENFORCE_EQ(input.dims()[k], first[i].dims()[k]);
+      }
+
+      const auto rowBytes = input.size_from_dim(1) * input.itemsize();
+      const auto numBytes = (range.end - range.begin) * rowBytes;
+      // Skip empty tensors
+      if (numBytes == 0) {
+        continue;
+      }
+
+      context.CopyItems<CPUContext, CPUContext>(
+          input.meta(),
+          (range.end - range.begin) * input.size_from_dim(1),
+          static_cast<const char*>(input.raw_data()) +
+              range.begin * rowBytes /* src */,
+          destination /* dst */
+          );
+
+      destination += numBytes;
+    }
+  }
 
   return true;
 }
 
 bool RebatchingQueue::canWrite() const {
-  return tail_ + capacity() > head_;
+  return size_ < capacity_;
 }
 
 bool RebatchingQueue::enqueueOne(
-    CPUContext& /*context*/,
+    CPUContext& context,
     const std::vector<const TensorCPU*>& inputs) {
-  std::vector<std::vector<TensorCPU>> splittedInputs;
-  splittedInputs.emplace_back();
-  auto& tensorVector = splittedInputs.back();
-  tensorVector.reserve(inputs.size());
+  auto chunk = std::make_shared<Chunk>();
+  chunk->numRows = 1;
+  chunk->tensors.reserve(inputs.size());
   for (const auto* tensorPtr : inputs) {
-    tensorVector.push_back(*tensorPtr);
+    CAFFE_ENFORCE(tensorPtr);
+    auto dims = tensorPtr->dims();
+    dims.insert(dims.begin(), 1);
+    chunk->tensors.emplace_back(dims);
+    context.CopyItems<CPUContext, CPUContext>(
+        tensorPtr->meta(),
+        tensorPtr->size(),
+        tensorPtr->raw_data() /* src */,
+        chunk->tensors.back().raw_mutable_data(tensorPtr->meta()) /* dst */);
   }
 
-  return enqueue(std::move(splittedInputs));
+  return enqueue(std::move(chunk));
 }
 
 bool RebatchingQueue::enqueueMany(
     CPUContext& context,
     const std::vector<const TensorCPU*>& inputs) {
   CAFFE_ENFORCE_EQ(numBlobs_, inputs.size());
+  CAFFE_ENFORCE(!inputs.empty());
 
-  std::vector<std::vector<TensorCPU>> splittedInputs;
-  splittedInputs = split(context, inputs);
-  return enqueue(std::move(splittedInputs));
-}
+  auto chunk = std::make_shared<Chunk>();
+  CAFFE_ENFORCE(inputs[0]);
+  CAFFE_ENFORCE_GT(inputs[0]->ndim(), 0);
+  chunk->numRows = inputs[0]->dim(0);
+  chunk->tensors.reserve(inputs.size());
+  for (const auto* tensorPtr : inputs) {
+    CAFFE_ENFORCE(tensorPtr);
+    CAFFE_ENFORCE_GT(tensorPtr->ndim(), 0);
+    CAFFE_ENFORCE_EQ(tensorPtr->dim(0), chunk->numRows);
+    chunk->tensors.emplace_back();
+    chunk->tensors.back().CopyFrom(*tensorPtr, &context);
+  }
 
-bool RebatchingQueue::enqueue(
-    std::vector<std::vector<TensorCPU>> splittedInputs) {
-  int idx = 0;
-  for (;;) {
-    if (idx >= splittedInputs.size()) {
-      break;
-    }
+  return enqueue(std::move(chunk));
+}
 
+bool RebatchingQueue::enqueue(std::shared_ptr<const Chunk> chunk) {
+  size_t begin = 0;
+  while (begin < chunk->numRows) {
+    bool notify;
     {
       std::unique_lock<std::mutex> lock(mutex_);
 
-      cvOverflow_.wait(lock, [this] { return canWrite() || isClosed_; });
+      if (!canWrite() && !isClosed_) {
+        ++numWaitingWriters_;
+        cvOverflow_.wait(lock, [this] { return canWrite() || isClosed_; });
+        --numWaitingWriters_;
+      }
 
       if (isClosed_) {
         // If we are here it means that we didn't apply the entire batch and if
@@ -214,12 +201,18 @@ bool RebatchingQueue::enqueue(
         return false;
       }
 
-      do {
-        queue_[head_++ % capacity()] = std::move(splittedInputs[idx++]);
-      } while (canWrite() && idx < splittedInputs.size());
+      // Enqueue as many rows as fit, the rest once readers make room.
+      const size_t n = std::min(chunk->numRows - begin, capacity_ - size_);
+      queue_.push_back(RowRange{chunk, begin, begin + n});
+      size_ += n;
+      begin += n;
+
+      notify = numWaitingReaders_ > 0;
     }
 
-    cvEmpty_.notify_all();
+    if (notify) {
+      cvEmpty_.notify_all();
+    }
   }
 
   return true;
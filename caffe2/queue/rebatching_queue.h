@@ -16,11 +16,10 @@
 
 #pragma once
 
-#include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <memory>
 #include <mutex>
-#include <queue>
 
 #include "caffe2/core/logging.h"
 #include "caffe2/core/operator.h"
@@ -29,10 +28,15 @@
 
 namespace caffe2 {
 
-// TODO: This is a very naive implementation with a single mutex. We can do the
-// atomic index + circular queue optimizations or pull something more
-// heavy-weight later
-
+// Queue of rows that are enqueued one at a time or in batches, and dequeued in
+// batches of any size.
+//
+// Every enqueue copies its inputs once into a chunk, a set of tensors sharing
+// their first dimension, which the queue then holds as ranges of rows. A
+// dequeue copies its rows straight from the chunks into the outputs, or, when
+// it returns exactly one whole chunk, shares the chunk's memory with the
+// outputs without copying. The mutex only guards moving ranges of rows in and
+// out of the queue, so it is never held while copying data.
 class RebatchingQueue {
  public:
   RebatchingQueue(size_t capacity, size_t numBlobs);
@@ -61,7 +65,21 @@ class RebatchingQueue {
   void close();
 
  private:
-  bool enqueue(std::vector<std::vector<TensorCPU>> splittedInputs);
+  // Tensors of an enqueue, with the rows along the first dimension. Immutable
+  // once enqueued.
+  struct Chunk {
+    std::vector<TensorCPU> tensors;
+    size_t numRows;
+  };
+
+  // Rows [begin, end) of a chunk.
+  struct RowRange {
+    std::shared_ptr<const Chunk> chunk;
+    size_t begin;
+    size_t end;
+  };
+
+  bool enqueue(std::shared_ptr<const Chunk> chunk);
 
   bool canWrite() const;
   bool canRead() const;
@@ -73,12 +91,16 @@ class RebatchingQueue {
 
   bool isClosed_{false};
 
-  uint64_t head_{0};
-  uint64_t tail_{0};
+  // Rows in queue_, at most capacity_.
+  size_t size_{0};
+  // Threads waiting on each condition variable, so that notifying is skipped
+  // when nobody waits.
+  int numWaitingReaders_{0};
+  int numWaitingWriters_{0};
 
   std::condition_variable cvEmpty_;
   std::condition_variable cvOverflow_;
 
-  std::vector<std::vector<TensorCPU>> queue_;
+  std::deque<RowRange> queue_;
 };
 } // caffe2
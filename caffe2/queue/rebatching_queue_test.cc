@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/tensor.h"
+#include "caffe2/queue/rebatching_queue.h"
+
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// Returns a (numRows, 2) int tensor with rows {v, -v} for v = first, ...
+TensorCPU MakeRows(int first, int numRows) {
+  TensorCPU tensor(std::vector<TIndex>{numRows, 2});
+  auto* data = tensor.mutable_data<int>();
+  for (int i = 0; i < numRows; ++i) {
+    data[2 * i] = first + i;
+    data[2 * i + 1] = -(first + i);
+  }
+  return tensor;
+}
+
+void ExpectRows(const TensorCPU& tensor, int first, int numRows) {
+  ASSERT_EQ(2, tensor.ndim());
+  ASSERT_EQ(numRows, tensor.dim(0));
+  ASSERT_EQ(2, tensor.dim(1));
+  for (int i = 0; i < numRows; ++i) {
+    EXPECT_EQ(first + i, tensor.data<int>()[2 * i]);
+    EXPECT_EQ(-(first + i), tensor.data<int>()[2 * i + 1]);
+  }
+}
+
+} // namespace
+
+TEST(RebatchingQueueTest, WholeChunks) {
+  CPUContext context;
+  RebatchingQueue queue(10, 1);
+  const auto input = MakeRows(0, 4);
+  ASSERT_TRUE(queue.enqueueMany(context, {&input}));
+  TensorCPU output;
+  ASSERT_TRUE(queue.dequeue(context, 4, {&output}));
+  ExpectRows(output, 0, 4);
+  EXPECT_NE(input.raw_data(), output.raw_data());
+}
+
+TEST(RebatchingQueueTest, SplitsAndJoinsChunks) {
+  CPUContext context;
+  RebatchingQueue queue(10, 1);
+  const auto first = MakeRows(0, 3);
+  const auto second = MakeRows(3, 5);
+  ASSERT_TRUE(queue.enqueueMany(context, {&first}));
+  ASSERT_TRUE(queue.enqueueMany(context, {&second}));
+  TensorCPU output;
+  ASSERT_TRUE(queue.dequeue(context, 2, {&output}));
+  ExpectRows(output, 0, 2);
+  ASSERT_TRUE(queue.dequeue(context, 4, {&output}));
+  ExpectRows(output, 2, 4);
+  queue.close();
+  // Only two rows are left, which a closed queue still returns.
+  ASSERT_TRUE(queue.dequeue(context, 4, {&output}));
+  ExpectRows(output, 6, 2);
+  EXPECT_FALSE(queue.dequeue(context, 4, {&output}));
+}
+
+TEST(RebatchingQueueTest, EnqueueOne) {
+  CPUContext context;
+  RebatchingQueue queue(10, 2);
+  TensorCPU row(std::vector<TIndex>{2});
+  TensorCPU label(std::vector<TIndex>{});
+  for (int i = 0; i < 3; ++i) {
+    row.mutable_data<int>()[0] = i;
+    row.mutable_data<int>()[1] = -i;
+    label.mutable_data<float>()[0] = i;
+    ASSERT_TRUE(queue.enqueueOne(context, {&row, &label}));
+  }
+  TensorCPU rows;
+  TensorCPU labels;
+  ASSERT_TRUE(queue.dequeue(context, 1, {&rows, &labels}));
+  ExpectRows(rows, 0, 1);
+  ASSERT_TRUE(queue.dequeue(context, 2, {&rows, &labels}));
+  ExpectRows(rows, 1, 2);
+  ASSERT_EQ(std::vector<TIndex>{2}, labels.dims());
+  EXPECT_EQ(1, labels.data<float>()[0]);
+  EXPECT_EQ(2, labels.data<float>()[1]);
+}
+
+TEST(RebatchingQueueTest, BatchLargerThanCapacity) {
+  CPUContext context;
+  RebatchingQueue queue(3, 1);
+  const int numRows = 100;
+  std::thread producer([&]() {
+    CPUContext producerContext;
+    const auto input = MakeRows(0, numRows);
+    EXPECT_TRUE(queue.enqueueMany(producerContext, {&input}));
+    queue.close();
+  });
+  TensorCPU output;
+  int next = 0;
+  while (queue.dequeue(context, 7, {&output})) {
+    ASSERT_LE(output.dim(0), 7);
+    ExpectRows(output, next, output.dim(0));
+    next += output.dim(0);
+  }
+  producer.join();
+  EXPECT_EQ(numRows, next);
+}
+
+TEST(RebatchingQueueTest, CloseWakesUpBlockedWriter) {
+  CPUContext context;
+  RebatchingQueue queue(2, 1);
+  std::thread producer([&]() {
+    CPUContext producerContext;
+    const auto input = MakeRows(0, 5);
+    EXPECT_FALSE(queue.enqueueMany(producerContext, {&input}));
+  });
+  TensorCPU output;
+  ASSERT_TRUE(queue.dequeue(context, 1, {&output}));
+  ExpectRows(output, 0, 1);
+  queue.close();
+  producer.join();
+}
+
+} // namespace caffe2
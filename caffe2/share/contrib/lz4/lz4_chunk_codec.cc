@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <lz4.h>
+
+#include <limits>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/core/tensor_chunk_codec.h"
+
+namespace caffe2 {
+
+namespace {
+
+// LZ4 block compression: faster than zstd to encode and decode, at a lower
+// compression ratio.
+class Lz4ChunkCodec : public TensorChunkCodec {
+ public:
+  void Encode(
+      const char* data,
+      size_t size,
+      size_t /*itemsize*/,
+      std::string* out) const override {
+    CAFFE_ENFORCE_LE(
+        size,
+        LZ4_MAX_INPUT_SIZE,
+        "Tensor chunk is too large for lz4, use a smaller chunk_size.");
+    const size_t offset = out->size();
+    const int bound = LZ4_compressBound(size);
+    out->resize(offset + bound);
+    const int compressed =
+        LZ4_compress_default(data, &(*out)[offset], size, bound);
+    CAFFE_ENFORCE_GT(compressed, 0, "lz4 compression failed.");
+    out->resize(offset + compressed);
+  }
+
+  void Decode(
+      const char* data,
+      size_t size,
+      size_t /*itemsize*/,
+      char* out,
+      size_t out_size) const override {
+    CAFFE_ENFORCE(
+        size <= std::numeric_limits<int>::max() &&
+            out_size <= std::numeric_limits<int>::max(),
+        "Corrupted lz4 tensor chunk.");
+    const int decompressed = LZ4_decompress_safe(data, out, size, out_size);
+    CAFFE_ENFORCE_EQ(
+        decompressed, out_size, "Corrupted lz4 tensor chunk.");
+  }
+};
+
+REGISTER_TENSOR_CHUNK_CODEC(lz4, Lz4ChunkCodec);
+
+} // namespace
+
+} // namespace caffe2
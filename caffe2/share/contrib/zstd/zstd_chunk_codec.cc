@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <zstd.h>
+
+#include "caffe2/core/flags.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/tensor_chunk_codec.h"
+
+CAFFE2_DEFINE_int(
+    caffe2_zstd_chunk_level,
+    3,
+    "Compression level of the zstd tensor chunk codec.");
+
+namespace caffe2 {
+
+namespace {
+
+class ZstdChunkCodec : public TensorChunkCodec {
+ public:
+  void Encode(
+      const char* data,
+      size_t size,
+      size_t /*itemsize*/,
+      std::string* out) const override {
+    const size_t offset = out->size();
+    out->resize(offset + ZSTD_compressBound(size));
+    const size_t compressed = ZSTD_compress(
+        &(*out)[offset],
+        out->size() - offset,
+        data,
+        size,
+        FLAGS_caffe2_zstd_chunk_level);
+    CAFFE_ENFORCE(
+        !ZSTD_isError(compressed),
+        "zstd compression failed: ",
+        ZSTD_getErrorName(compressed));
+    out->resize(offset + compressed);
+  }
+
+  void Decode(
+      const char* data,
+      size_t size,
+      size_t /*itemsize*/,
+      char* out,
+      size_t out_size) const override {
+    const size_t decompressed = ZSTD_decompress(out, out_size, data, size);
+    CAFFE_ENFORCE(
+        !ZSTD_isError(decompressed),
+        "zstd decompression failed: ",
+        ZSTD_getErrorName(decompressed));
+    CAFFE_ENFORCE_EQ(
+        decompressed, out_size, "Corrupted zstd tensor chunk.");
+  }
+};
+
+REGISTER_TENSOR_CHUNK_CODEC(zstd, ZstdChunkCodec);
+
+} // namespace
+
+} // namespace caffe2
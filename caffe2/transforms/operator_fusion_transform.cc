@@ -0,0 +1,518 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/transforms/operator_fusion_transform.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/types.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+using transform::Graph;
+
+namespace {
+
+bool IsCPUOp(const OperatorDef& op) {
+  return !op.has_device_option() || op.device_option().device_type() == CPU;
+}
+
+// Returns the float tensor in blob name of ws, or nullptr if there is none.
+const TensorCPU* GetFloatTensor(Workspace* ws, const string& name) {
+  if (!ws->HasBlob(name)) {
+    return nullptr;
+  }
+  const Blob* blob = ws->GetBlob(name);
+  if (!blob->IsType<TensorCPU>()) {
+    return nullptr;
+  }
+  const auto& tensor = blob->Get<TensorCPU>();
+  return tensor.IsType<float>() ? &tensor : nullptr;
+}
+
+string GetOrder(const OperatorDef& op) {
+  return ArgumentHelper(op).GetSingleArgument<string>("order", "NCHW");
+}
+
+// Checks that the parameters of a Conv are in ws, and returns its number of
+// output channels, or 0 if they are not.
+int GetConvOutputChannels(Workspace* ws, const OperatorDef& conv) {
+  if (conv.type() != "Conv" || conv.input_size() < 2) {
+    return 0;
+  }
+  const auto* filter = GetFloatTensor(ws, conv.input(1));
+  if (!filter || filter->ndim() < 3) {
+    return 0;
+  }
+  const int M = filter->dim32(0);
+  if (conv.input_size() == 3) {
+    const auto* bias = GetFloatTensor(ws, conv.input(2));
+    if (!bias || bias->size() != M) {
+      return 0;
+    }
+  }
+  return M;
+}
+
+// Only the arguments of binary elementwise ops that select their broadcast.
+bool HasOnlyBroadcastArguments(const OperatorDef& op) {
+  for (const auto& arg : op.arg()) {
+    if (arg.name() != "broadcast" && arg.name() != "axis" &&
+        arg.name() != "axis_str" && arg.name() != "order") {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Gets the broadcast axis of a binary elementwise op as an index, -1 meaning
+// the default. Returns false if it cannot be resolved.
+bool GetBroadcastAxis(const OperatorDef& op, int* axis) {
+  ArgumentHelper helper(op);
+  *axis = helper.GetSingleArgument<int>("axis", -1);
+  const auto axis_str = helper.GetSingleArgument<string>("axis_str", "");
+  if (!axis_str.empty()) {
+    const auto order = helper.GetSingleArgument<string>("order", "NCHW");
+    const auto pos = order.find(axis_str);
+    if (*axis != -1 || axis_str.size() != 1 || pos == string::npos) {
+      return false;
+    }
+    *axis = pos;
+  }
+  return true;
+}
+
+bool IsBroadcast(const OperatorDef& op) {
+  return ArgumentHelper(op).GetSingleArgument<int>("broadcast", 0);
+}
+
+std::vector<const OperatorDef*> GetChain(
+    const Graph& g,
+    const std::vector<int>& subgraph) {
+  std::vector<const OperatorDef*> chain;
+  for (int idx : subgraph) {
+    chain.push_back(&g.node(idx).op);
+  }
+  return chain;
+}
+
+} // namespace
+
+bool ChainFusionTransform::PatternRule(
+    const Graph& g,
+    const std::vector<int>& subgraph,
+    int idx) {
+  const auto& op = g.node(idx).op;
+  if (!IsCPUOp(op) || op.output_size() != 1) {
+    return false;
+  }
+  if (subgraph.size() == 0) {
+    return MatchFirst(op);
+  }
+  // op has to be the only reader of the output of the chain so far...
+  const auto& last = g.node(subgraph.back());
+  const string& blob = last.op.output(0);
+  if (last.children.size() != 1 || !last.children.count(idx) ||
+      std::count(op.input().begin(), op.input().end(), blob) != 1) {
+    return false;
+  }
+  // ...and the net may not return it, unless op overwrites it.
+  if (g.external_output().count(blob) && op.output(0) != blob) {
+    return false;
+  }
+  return MatchNext(GetChain(g, subgraph), op);
+}
+
+bool ChainFusionTransform::ValidatorRule(
+    const Graph& g,
+    const std::vector<int>& subgraph) {
+  if (subgraph.size() == 0 || !IsComplete(GetChain(g, subgraph))) {
+    return false;
+  }
+  // The fused op runs where the head of the chain is, so it reads what the
+  // rest of the chain reads and writes the output of the tail earlier than
+  // they did. No op in between may write those inputs, or read or write
+  // that output.
+  const std::set<int> members(subgraph.begin(), subgraph.end());
+  const string& output = g.node(subgraph.back()).op.output(0);
+  std::set<string> inputs;
+  for (int i = 1; i < subgraph.size(); ++i) {
+    const auto& op = g.node(subgraph[i]).op;
+    inputs.insert(op.input().begin(), op.input().end());
+  }
+  for (int idx = subgraph.front() + 1; idx < subgraph.back(); ++idx) {
+    const auto& node = g.node(idx);
+    if (!node.active || members.count(idx)) {
+      continue;
+    }
+    for (const auto& blob : node.op.output()) {
+      if (blob == output || inputs.count(blob)) {
+        return false;
+      }
+    }
+    for (const auto& blob : node.op.input()) {
+      if (blob == output) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool ChainFusionTransform::ReplaceRule(
+    const std::vector<int>& subgraph,
+    Graph* g_ptr) {
+  CHECK(g_ptr);
+  auto& g = *g_ptr;
+
+  const auto chain = GetChain(g, subgraph);
+  OperatorDef fused;
+  Fuse(chain, &fused);
+  const auto& first = *chain.front();
+  if (first.has_name()) {
+    fused.set_name(first.name());
+  }
+  if (first.has_device_option()) {
+    fused.mutable_device_option()->CopyFrom(first.device_option());
+  }
+  fused.clear_output();
+  fused.add_output(chain.back()->output(0));
+  for (int i = 0; i + 1 < chain.size(); ++i) {
+    eliminated_outputs_.push_back(chain[i]->output(0));
+  }
+
+  // The fused op replaces the first one of the chain. It reads what the
+  // others read from outside of the chain...
+  const int head = subgraph.front();
+  const std::set<int> members(subgraph.begin(), subgraph.end());
+  for (int i = 1; i < subgraph.size(); ++i) {
+    for (const auto& edge : g.node(subgraph[i]).parents) {
+      const int parent = edge.first;
+      if (members.count(parent)) {
+        continue;
+      }
+      auto& blobs = g.node(head).parents[parent];
+      blobs.insert(blobs.end(), edge.second.begin(), edge.second.end());
+      g.node(parent).children[head] = blobs;
+    }
+  }
+
+  // ...and is read by the readers of the last one.
+  const auto children = g.node(subgraph.back()).children;
+  g.DeactivateSubgraph(std::vector<int>(subgraph.begin() + 1, subgraph.end()));
+  for (const auto& edge : children) {
+    g.node(head).children[edge.first] = edge.second;
+    g.node(edge.first).parents[head] = edge.second;
+  }
+  g.node(head).op = fused;
+  return true;
+}
+
+bool FoldConvBatchNormTransform::MatchFirst(const OperatorDef& op) {
+  return ws_ && GetConvOutputChannels(ws_, op) > 0;
+}
+
+bool FoldConvBatchNormTransform::MatchNext(
+    const std::vector<const OperatorDef*>& chain,
+    const OperatorDef& op) {
+  if (chain.size() != 1 || op.type() != "SpatialBN" || op.input_size() != 5 ||
+      op.input(0) != chain[0]->output(0)) {
+    return false;
+  }
+  if (!ArgumentHelper(op).GetSingleArgument<int>(OpSchema::Arg_IsTest, 0) ||
+      GetOrder(op) != GetOrder(*chain[0])) {
+    return false;
+  }
+  const int M = GetConvOutputChannels(ws_, *chain[0]);
+  for (int i = 1; i < op.input_size(); ++i) {
+    const auto* param = GetFloatTensor(ws_, op.input(i));
+    if (!param || param->size() != M) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void FoldConvBatchNormTransform::Fuse(
+    const std::vector<const OperatorDef*>& chain,
+    OperatorDef* fused) {
+  const auto& conv = *chain[0];
+  const auto& bn = *chain[1];
+  const auto& filter = *GetFloatTensor(ws_, conv.input(1));
+  const int M = filter.dim32(0);
+  const int filter_size = filter.size() / M;
+  const float epsilon =
+      ArgumentHelper(bn).GetSingleArgument<float>("epsilon", 1e-5f);
+
+  // SpatialBN computes (y - mean) / sqrt(var + epsilon) * scale + bias, which
+  // for y = conv(x, W) + b is conv(x, W * multiplier) + (b - mean) *
+  // multiplier + bias, with multiplier = scale / sqrt(var + epsilon) per
+  // output channel. Filters are stored with the output channel first in both
+  // orders.
+  ConstEigenVectorArrayMap<float> scale(
+      GetFloatTensor(ws_, bn.input(1))->data<float>(), M);
+  ConstEigenVectorArrayMap<float> bn_bias(
+      GetFloatTensor(ws_, bn.input(2))->data<float>(), M);
+  ConstEigenVectorArrayMap<float> mean(
+      GetFloatTensor(ws_, bn.input(3))->data<float>(), M);
+  ConstEigenVectorArrayMap<float> var(
+      GetFloatTensor(ws_, bn.input(4))->data<float>(), M);
+  Eigen::Array<float, Eigen::Dynamic, 1> multiplier =
+      scale * (var + epsilon).sqrt().inverse();
+
+  const string filter_name = "transform/" + bn.output(0) + "_filter";
+  auto* folded_filter = ws_->CreateBlob(filter_name)->GetMutable<TensorCPU>();
+  folded_filter->ResizeLike(filter);
+  EigenArrayMap<float>(folded_filter->mutable_data<float>(), filter_size, M) =
+      ConstEigenArrayMap<float>(filter.data<float>(), filter_size, M)
+          .rowwise() *
+      multiplier.transpose();
+
+  const string bias_name = "transform/" + bn.output(0) + "_bias";
+  auto* folded_bias = ws_->CreateBlob(bias_name)->GetMutable<TensorCPU>();
+  folded_bias->Resize(M);
+  EigenVectorArrayMap<float> folded_bias_arr(
+      folded_bias->mutable_data<float>(), M);
+  if (conv.input_size() == 3) {
+    folded_bias_arr = ConstEigenVectorArrayMap<float>(
+        GetFloatTensor(ws_, conv.input(2))->data<float>(), M);
+  } else {
+    folded_bias_arr.setZero();
+  }
+  folded_bias_arr = (folded_bias_arr - mean) * multiplier + bn_bias;
+
+  fused->CopyFrom(conv);
+  fused->set_input(1, filter_name);
+  if (fused->input_size() == 3) {
+    fused->set_input(2, bias_name);
+  } else {
+    fused->add_input(bias_name);
+  }
+}
+
+bool FoldConvBiasTransform::MatchFirst(const OperatorDef& op) {
+  return ws_ && GetConvOutputChannels(ws_, op) > 0;
+}
+
+bool FoldConvBiasTransform::MatchNext(
+    const std::vector<const OperatorDef*>& chain,
+    const OperatorDef& op) {
+  if (chain.size() != 1 || op.type() != "Add" || op.input_size() != 2 ||
+      op.input(0) != chain[0]->output(0) || !HasOnlyBroadcastArguments(op) ||
+      !IsBroadcast(op)) {
+    return false;
+  }
+  const auto& conv = *chain[0];
+  const int M = GetConvOutputChannels(ws_, conv);
+  const auto* bias = GetFloatTensor(ws_, op.input(1));
+  if (!bias || bias->ndim() != 1 || bias->size() != M) {
+    return false;
+  }
+  // The bias has to line up with the channels of the Conv output, whose rank
+  // is the one of the filter.
+  const int ndim = GetFloatTensor(ws_, conv.input(1))->ndim();
+  const int channel_axis = GetOrder(conv) == "NCHW" ? 1 : ndim - 1;
+  int axis;
+  if (!GetBroadcastAxis(op, &axis)) {
+    return false;
+  }
+  return (axis == -1 ? ndim - 1 : axis) == channel_axis;
+}
+
+void FoldConvBiasTransform::Fuse(
+    const std::vector<const OperatorDef*>& chain,
+    OperatorDef* fused) {
+  const auto& conv = *chain[0];
+  const auto& add = *chain[1];
+  fused->CopyFrom(conv);
+  if (conv.input_size() == 2) {
+    fused->add_input(add.input(1));
+    return;
+  }
+  const auto& conv_bias = *GetFloatTensor(ws_, conv.input(2));
+  const auto& add_bias = *GetFloatTensor(ws_, add.input(1));
+  const string bias_name = "transform/" + add.output(0) + "_bias";
+  auto* folded_bias = ws_->CreateBlob(bias_name)->GetMutable<TensorCPU>();
+  folded_bias->ResizeLike(conv_bias);
+  const int M = conv_bias.size();
+  EigenVectorArrayMap<float>(folded_bias->mutable_data<float>(), M) =
+      ConstEigenVectorArrayMap<float>(conv_bias.data<float>(), M) +
+      ConstEigenVectorArrayMap<float>(add_bias.data<float>(), M);
+  fused->set_input(2, bias_name);
+}
+
+bool FuseActivationTransform::MatchFirst(const OperatorDef& op) {
+  return op.type() == "Conv" || op.type() == "FC";
+}
+
+bool FuseActivationTransform::MatchNext(
+    const std::vector<const OperatorDef*>& chain,
+    const OperatorDef& op) {
+  return chain.size() == 1 && op.type() == "Relu" && op.input_size() == 1 &&
+      op.arg_size() == 0;
+}
+
+void FuseActivationTransform::Fuse(
+    const std::vector<const OperatorDef*>& chain,
+    OperatorDef* fused) {
+  fused->CopyFrom(*chain[0]);
+  fused->set_type(chain[0]->type() + "Relu");
+}
+
+namespace {
+
+bool IsFusableElementwise(const OperatorDef& op) {
+  if (!op.engine().empty()) {
+    return false;
+  }
+  if (op.type() == "Relu") {
+    return op.input_size() == 1 && op.arg_size() == 0;
+  }
+  if (op.type() != "Add" && op.type() != "Sub" && op.type() != "Mul" &&
+      op.type() != "Div") {
+    return false;
+  }
+  int axis;
+  return op.input_size() == 2 && HasOnlyBroadcastArguments(op) &&
+      GetBroadcastAxis(op, &axis);
+}
+
+} // namespace
+
+bool FuseElementwiseTransform::MatchFirst(const OperatorDef& op) {
+  return IsFusableElementwise(op);
+}
+
+bool FuseElementwiseTransform::MatchNext(
+    const std::vector<const OperatorDef*>& chain,
+    const OperatorDef& op) {
+  // Only the second operand of an op can be broadcast, so the result of the
+  // chain has to be the first one.
+  return IsFusableElementwise(op) &&
+      (op.type() == "Relu" || !IsBroadcast(op) ||
+       op.input(0) == chain.back()->output(0));
+}
+
+bool FuseElementwiseTransform::IsComplete(
+    const std::vector<const OperatorDef*>& chain) {
+  if (chain.size() < 2) {
+    return false;
+  }
+  // The fused op resizes its output before it reads the broadcast operands.
+  const string& output = chain.back()->output(0);
+  for (const auto* op : chain) {
+    if (op->type() != "Relu" && IsBroadcast(*op) && op->input(1) == output) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void FuseElementwiseTransform::Fuse(
+    const std::vector<const OperatorDef*>& chain,
+    OperatorDef* fused) {
+  fused->set_type("FusedElementwise");
+  fused->add_input(chain[0]->input(0));
+  std::vector<string> ops;
+  std::vector<int> broadcast;
+  std::vector<int> axis;
+  std::vector<int> reverse;
+  // The output of the previous op, empty for the first one.
+  string running;
+  for (const auto* op : chain) {
+    ops.push_back(op->type());
+    int op_axis = -1;
+    bool op_reverse = false;
+    if (op->type() != "Relu") {
+      GetBroadcastAxis(*op, &op_axis);
+      op_reverse = !running.empty() && op->input(1) == running;
+      fused->add_input(op->input(op_reverse ? 0 : 1));
+    }
+    broadcast.push_back(op->type() != "Relu" && IsBroadcast(*op));
+    axis.push_back(broadcast.back() ? op_axis : -1);
+    reverse.push_back(op_reverse);
+    running = op->output(0);
+  }
+  fused->add_arg()->CopyFrom(MakeArgument("ops", ops));
+  fused->add_arg()->CopyFrom(MakeArgument("broadcast", broadcast));
+  fused->add_arg()->CopyFrom(MakeArgument("axis", axis));
+  fused->add_arg()->CopyFrom(MakeArgument("reverse", reverse));
+}
+
+NetDef FuseOperators(const NetDef& net, Workspace* ws, FusionStats* stats) {
+  std::vector<std::unique_ptr<ChainFusionTransform>> transforms;
+  if (ws) {
+    transforms.emplace_back(new FoldConvBatchNormTransform(ws));
+    transforms.emplace_back(new FoldConvBiasTransform(ws));
+  }
+  transforms.emplace_back(new FuseActivationTransform());
+  transforms.emplace_back(new FuseElementwiseTransform());
+
+  NetDef fused_net = net;
+  std::vector<string> eliminated_outputs;
+  for (auto& transform : transforms) {
+    fused_net = transform->ApplyTo(fused_net);
+    eliminated_outputs.insert(
+        eliminated_outputs.end(),
+        transform->eliminated_outputs().begin(),
+        transform->eliminated_outputs().end());
+  }
+
+  FusionStats fusion_stats;
+  fusion_stats.ops_removed = net.op_size() - fused_net.op_size();
+  if (ws && !eliminated_outputs.empty()) {
+    std::vector<std::unique_ptr<NetDef>> nets;
+    nets.emplace_back(new NetDef(net));
+    const auto shapes = InferBlobShapesAndTypesFromWorkspace(ws, nets);
+    std::unordered_map<string, const TensorShape*> shape_of;
+    for (const auto& shape : shapes.shapes()) {
+      shape_of[shape.name()] = &shape;
+    }
+    for (const auto& blob : eliminated_outputs) {
+      auto it = shape_of.find(blob);
+      if (it == shape_of.end() || it->second->unknown_shape() ||
+          it->second->data_type() == TensorProto_DataType_UNDEFINED) {
+        continue;
+      }
+      int64_t size = 1;
+      for (const auto d : it->second->dims()) {
+        size *= d;
+      }
+      fusion_stats.activation_bytes_saved +=
+          size * DataTypeToTypeMeta(it->second->data_type()).itemsize();
+    }
+  }
+  VLOG(1) << "Operator fusion removed " << fusion_stats.ops_removed
+          << " operators of net " << net.name() << ", saving "
+          << fusion_stats.activation_bytes_saved
+          << " bytes of activations per run.";
+  if (stats) {
+    *stats = fusion_stats;
+  }
+  return fused_net;
+}
+
+REGISTER_TRANSFORM(FuseActivation, FuseActivationTransform);
+REGISTER_TRANSFORM(FuseElementwise, FuseElementwiseTransform);
+
+} // namespace caffe2
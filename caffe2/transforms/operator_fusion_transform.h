@@ -0,0 +1,182 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/transform.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+/**
+ * Chain Fusion Transform Base class
+ *
+ * Replaces chains of operators with a single operator. In a chain every
+ * operator reads the single output of the operator before it, and is the
+ * only one to do so. The fused operator takes the inputs of the chain that
+ * come from outside of it and writes the output of the last operator, so the
+ * outputs of the other operators are never written.
+ *
+ * Outputs that the net declares in external_output are kept. All operators
+ * of a chain have to run on CPU.
+ *
+ * Transforms which derive from ChainFusionTransform need to override:
+ * MatchFirst, MatchNext and Fuse.
+ */
+class ChainFusionTransform : public Transform {
+ public:
+  /**
+   * The outputs that the operators fused so far no longer write, once per
+   * removed operator.
+   */
+  const std::vector<string>& eliminated_outputs() const {
+    return eliminated_outputs_;
+  }
+
+ protected:
+  bool PatternRule(
+      const transform::Graph& g,
+      const std::vector<int>& subgraph,
+      int idx) override;
+  bool ValidatorRule(
+      const transform::Graph& g,
+      const std::vector<int>& subgraph) override;
+  bool ReplaceRule(const std::vector<int>& subgraph, transform::Graph* g_ptr)
+      override;
+
+  // Whether a chain can start with op.
+  virtual bool MatchFirst(const OperatorDef& op) = 0;
+
+  // Whether op can be appended to chain. It reads the output of chain.back()
+  // exactly once.
+  virtual bool MatchNext(
+      const std::vector<const OperatorDef*>& chain,
+      const OperatorDef& op) = 0;
+
+  // Whether chain can be replaced. Longer chains are preferred.
+  virtual bool IsComplete(const std::vector<const OperatorDef*>& chain) {
+    return chain.size() >= 2;
+  }
+
+  // Sets the type, inputs and arguments of the operator replacing chain.
+  // Its output, name and device option are those of the chain.
+  virtual void Fuse(
+      const std::vector<const OperatorDef*>& chain,
+      OperatorDef* fused) = 0;
+
+ private:
+  std::vector<string> eliminated_outputs_;
+};
+
+/**
+ * Folds a SpatialBN in test mode into the Conv whose output it normalizes,
+ * by scaling the filter and adjusting the bias of the Conv. The folded filter
+ * and bias are written to the workspace as new blobs, next to the original
+ * ones, so the parameters of the Conv and the SpatialBN must be in it.
+ */
+class FoldConvBatchNormTransform : public ChainFusionTransform {
+ public:
+  explicit FoldConvBatchNormTransform(Workspace* ws) : ws_(ws) {}
+
+ protected:
+  bool MatchFirst(const OperatorDef& op) override;
+  bool MatchNext(
+      const std::vector<const OperatorDef*>& chain,
+      const OperatorDef& op) override;
+  void Fuse(const std::vector<const OperatorDef*>& chain, OperatorDef* fused)
+      override;
+
+ private:
+  Workspace* ws_;
+};
+
+/**
+ * Folds an Add that broadcasts a per channel bias over the output of a Conv
+ * into the bias of the Conv. The bias has to be in the workspace; if the Conv
+ * already has one, their sum is written to the workspace as a new blob.
+ */
+class FoldConvBiasTransform : public ChainFusionTransform {
+ public:
+  explicit FoldConvBiasTransform(Workspace* ws) : ws_(ws) {}
+
+ protected:
+  bool MatchFirst(const OperatorDef& op) override;
+  bool MatchNext(
+      const std::vector<const OperatorDef*>& chain,
+      const OperatorDef& op) override;
+  void Fuse(const std::vector<const OperatorDef*>& chain, OperatorDef* fused)
+      override;
+
+ private:
+  Workspace* ws_;
+};
+
+/**
+ * Replaces Conv + Relu with ConvRelu and FC + Relu with FCRelu, which apply
+ * the Relu to the output of the Conv or FC in place. This saves an operator
+ * dispatch and the intermediate blob; the Relu is still a separate pass over
+ * the output, not an epilogue of the Conv or FC kernels.
+ */
+class FuseActivationTransform : public ChainFusionTransform {
+ protected:
+  bool MatchFirst(const OperatorDef& op) override;
+  bool MatchNext(
+      const std::vector<const OperatorDef*>& chain,
+      const OperatorDef& op) override;
+  void Fuse(const std::vector<const OperatorDef*>& chain, OperatorDef* fused)
+      override;
+};
+
+/**
+ * Replaces chains of Add, Sub, Mul, Div and Relu with a FusedElementwise,
+ * which runs the whole chain in one pass over its input.
+ */
+class FuseElementwiseTransform : public ChainFusionTransform {
+ protected:
+  bool MatchFirst(const OperatorDef& op) override;
+  bool MatchNext(
+      const std::vector<const OperatorDef*>& chain,
+      const OperatorDef& op) override;
+  bool IsComplete(const std::vector<const OperatorDef*>& chain) override;
+  void Fuse(const std::vector<const OperatorDef*>& chain, OperatorDef* fused)
+      override;
+};
+
+struct FusionStats {
+  // Number of operators removed from the net.
+  int ops_removed = 0;
+  // Bytes the removed operators wrote to their outputs in one run of the
+  // net, counting the outputs whose shapes could be inferred.
+  int64_t activation_bytes_saved = 0;
+};
+
+/**
+ * Runs all of the fusion transforms above on net and returns the fused net.
+ *
+ * The transforms which fold parameters into a Conv need the parameters in
+ * ws, and are skipped if ws is nullptr. activation_bytes_saved is inferred
+ * from the shapes of the blobs in ws, so the inputs of the net should be fed
+ * into it beforehand; it is 0 without ws.
+ */
+NetDef FuseOperators(
+    const NetDef& net,
+    Workspace* ws = nullptr,
+    FusionStats* stats = nullptr);
+
+} // namespace caffe2
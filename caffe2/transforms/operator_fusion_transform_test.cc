@@ -0,0 +1,284 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/transforms/operator_fusion_transform.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+namespace {
+
+using transform::Graph;
+
+void FillTensor(
+    Workspace* ws,
+    const string& name,
+    const std::vector<TIndex>& dims,
+    float min = -1,
+    float max = 1) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  CPUContext context;
+  math::RandUniform<float, CPUContext>(
+      tensor->size(), min, max, tensor->mutable_data<float>(), &context);
+}
+
+// Runs net and fused_net in ws, and checks that they compute the same output.
+void ExpectSameOutput(
+    Workspace* ws,
+    const NetDef& net,
+    const NetDef& fused_net,
+    const string& output) {
+  ASSERT_TRUE(ws->RunNetOnce(net));
+  TensorCPU expected(ws->GetBlob(output)->Get<TensorCPU>());
+  ws->RemoveBlob(output);
+  ASSERT_TRUE(ws->RunNetOnce(fused_net));
+  const auto& actual = ws->GetBlob(output)->Get<TensorCPU>();
+  ASSERT_EQ(actual.dims(), expected.dims());
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_NEAR(actual.data<float>()[i], expected.data<float>()[i], 1e-4);
+  }
+}
+
+OperatorDef* AddConv(NetDef* net, std::vector<string> inputs, string output) {
+  auto* op = AddOp(net, "Conv", inputs, {output});
+  AddArgument("kernel", 3, op);
+  AddArgument("pad", 1, op);
+  return op;
+}
+
+/**
+ *  Before: (Conv)-->(Relu)-->(FC)-->(Relu)
+ *  After : (ConvRelu)-->(FCRelu)
+ */
+TEST(OperatorFusionTest, FuseActivation) {
+  Workspace ws;
+  FillTensor(&ws, "X", {2, 3, 6, 6});
+  FillTensor(&ws, "W", {4, 3, 3, 3});
+  FillTensor(&ws, "b", {4});
+  FillTensor(&ws, "fc_w", {5, 4 * 6 * 6});
+  FillTensor(&ws, "fc_b", {5});
+
+  NetDef netdef;
+  AddConv(&netdef, {"X", "W", "b"}, "conv");
+  AddOp(&netdef, "Relu", {"conv"}, {"conv"});
+  AddOp(&netdef, "FC", {"conv", "fc_w", "fc_b"}, {"fc"});
+  AddOp(&netdef, "Relu", {"fc"}, {"out"});
+
+  auto t = TransformRegistry()->Create("FuseActivation");
+  CHECK(t);
+  EXPECT_EQ(t->PatternMatch(Graph(netdef)).size(), 2);
+  NetDef fused = t->ApplyTo(netdef);
+  ASSERT_EQ(fused.op_size(), 2);
+  EXPECT_EQ(fused.op(0).type(), "ConvRelu");
+  EXPECT_EQ(fused.op(0).output(0), "conv");
+  EXPECT_EQ(fused.op(1).type(), "FCRelu");
+  EXPECT_EQ(fused.op(1).input(0), "conv");
+  EXPECT_EQ(fused.op(1).output(0), "out");
+
+  ExpectSameOutput(&ws, netdef, fused, "out");
+}
+
+// Outputs that other operators or the caller read have to be kept.
+TEST(OperatorFusionTest, KeepsOutputsThatAreRead) {
+  NetDef netdef;
+  AddOp(&netdef, "FC", {"X", "W", "b"}, {"fc1"});
+  AddOp(&netdef, "Relu", {"fc1"}, {"relu1"});
+  AddOp(&netdef, "Sigmoid", {"fc1"}, {"sigmoid1"});
+  AddOp(&netdef, "FC", {"X", "W", "b"}, {"fc2"});
+  AddOp(&netdef, "Relu", {"fc2"}, {"relu2"});
+  netdef.add_external_output("fc2");
+  AddOp(&netdef, "FC", {"X", "W", "b"}, {"fc3"});
+  AddOp(&netdef, "Relu", {"fc3"}, {"fc3"});
+  netdef.add_external_output("fc3");
+
+  auto t = TransformRegistry()->Create("FuseActivation");
+  NetDef fused = t->ApplyTo(netdef);
+  ASSERT_EQ(fused.op_size(), 6);
+  EXPECT_EQ(fused.op(5).type(), "FCRelu");
+  EXPECT_EQ(fused.op(5).output(0), "fc3");
+}
+
+/**
+ *  Before: (Mul)-->(Add)-->(Relu)-->(Sub)-->(Div)
+ *  After : (FusedElementwise)
+ */
+TEST(OperatorFusionTest, FuseElementwise) {
+  Workspace ws;
+  FillTensor(&ws, "X", {2, 3, 4, 5});
+  FillTensor(&ws, "scale", {3});
+  FillTensor(&ws, "bias", {3});
+  FillTensor(&ws, "Z", {2, 3, 4, 5});
+  FillTensor(&ws, "D", {2, 3, 4, 5}, 1, 2);
+
+  NetDef netdef;
+  auto* op = AddOp(&netdef, "Mul", {"X", "scale"}, {"a"});
+  AddArgument("broadcast", 1, op);
+  AddArgument("axis", 1, op);
+  op = AddOp(&netdef, "Add", {"a", "bias"}, {"b"});
+  AddArgument("broadcast", 1, op);
+  AddArgument("axis_str", string("C"), op);
+  AddOp(&netdef, "Relu", {"b"}, {"b"});
+  AddOp(&netdef, "Sub", {"Z", "b"}, {"c"});
+  AddOp(&netdef, "Div", {"c", "D"}, {"out"});
+
+  auto t = TransformRegistry()->Create("FuseElementwise");
+  NetDef fused = t->ApplyTo(netdef);
+  ASSERT_EQ(fused.op_size(), 1);
+  const auto& fused_op = fused.op(0);
+  EXPECT_EQ(fused_op.type(), "FusedElementwise");
+  EXPECT_EQ(
+      std::vector<string>(fused_op.input().begin(), fused_op.input().end()),
+      (std::vector<string>{"X", "scale", "bias", "Z", "D"}));
+  ArgumentHelper helper(fused_op);
+  EXPECT_EQ(
+      helper.GetRepeatedArgument<string>("ops"),
+      (std::vector<string>{"Mul", "Add", "Relu", "Sub", "Div"}));
+  EXPECT_EQ(
+      helper.GetRepeatedArgument<int>("axis"),
+      (std::vector<int>{1, 1, -1, -1, -1}));
+  EXPECT_EQ(
+      helper.GetRepeatedArgument<int>("reverse"),
+      (std::vector<int>{0, 0, 0, 1, 0}));
+
+  ExpectSameOutput(&ws, netdef, fused, "out");
+}
+
+// The fused op runs at the position of the head of the chain, so ops in
+// between may not change what the rest of the chain reads...
+TEST(OperatorFusionTest, KeepsChainsWithInputsWrittenInBetween) {
+  Workspace ws;
+  FillTensor(&ws, "A", {2, 3});
+  FillTensor(&ws, "s", {2, 3});
+  FillTensor(&ws, "C", {2, 3});
+
+  NetDef netdef;
+  AddOp(&netdef, "Mul", {"A", "s"}, {"B"});
+  AddOp(&netdef, "Relu", {"C"}, {"A"});
+  AddOp(&netdef, "Add", {"B", "A"}, {"D"});
+
+  // Only the Relu can be fused with the Add.
+  auto t = TransformRegistry()->Create("FuseElementwise");
+  NetDef fused = t->ApplyTo(netdef);
+  ASSERT_EQ(fused.op_size(), 2);
+  EXPECT_EQ(fused.op(0).type(), "Mul");
+  EXPECT_EQ(fused.op(1).type(), "FusedElementwise");
+  EXPECT_EQ(
+      ArgumentHelper(fused.op(1)).GetRepeatedArgument<string>("ops"),
+      (std::vector<string>{"Relu", "Add"}));
+
+  // The net overwrites A, so put it back before running the fused one.
+  TensorCPU A(ws.GetBlob("A")->Get<TensorCPU>());
+  ASSERT_TRUE(ws.RunNetOnce(netdef));
+  TensorCPU expected(ws.GetBlob("D")->Get<TensorCPU>());
+  ws.GetBlob("A")->GetMutable<TensorCPU>()->CopyFrom(A);
+  ASSERT_TRUE(ws.RunNetOnce(fused));
+  const auto& actual = ws.GetBlob("D")->Get<TensorCPU>();
+  ASSERT_EQ(actual.dims(), expected.dims());
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_NEAR(actual.data<float>()[i], expected.data<float>()[i], 1e-4);
+  }
+}
+
+// ...nor read or write its output.
+TEST(OperatorFusionTest, KeepsChainsWithOutputUsedInBetween) {
+  auto t = TransformRegistry()->Create("FuseActivation");
+  for (const bool reads_output : {true, false}) {
+    NetDef netdef;
+    AddConv(&netdef, {"X", "W", "b"}, "y");
+    if (reads_output) {
+      AddOp(&netdef, "Sigmoid", {"z"}, {"s"});
+    } else {
+      AddOp(&netdef, "Sigmoid", {"X"}, {"z"});
+    }
+    AddOp(&netdef, "Relu", {"y"}, {"z"});
+    NetDef fused = t->ApplyTo(netdef);
+    ASSERT_EQ(fused.op_size(), 3);
+    EXPECT_EQ(fused.op(0).type(), "Conv");
+  }
+
+  // Unrelated ops in between do not prevent the fusion.
+  NetDef netdef;
+  AddConv(&netdef, {"X", "W", "b"}, "y");
+  AddOp(&netdef, "Sigmoid", {"X"}, {"s"});
+  AddOp(&netdef, "Relu", {"y"}, {"z"});
+  NetDef fused = t->ApplyTo(netdef);
+  ASSERT_EQ(fused.op_size(), 2);
+  EXPECT_EQ(fused.op(0).type(), "ConvRelu");
+  EXPECT_EQ(fused.op(1).type(), "Sigmoid");
+}
+
+/**
+ *  Before: (Conv)-->(SpatialBN)-->(Relu)-->(Conv)-->(Add)-->(Relu)
+ *  After : (ConvRelu)-->(ConvRelu)
+ *  Without the workspace, only (Add)-->(Relu) is fused.
+ */
+TEST(OperatorFusionTest, FuseOperators) {
+  Workspace ws;
+  FillTensor(&ws, "X", {2, 3, 6, 6});
+  FillTensor(&ws, "W", {4, 3, 3, 3});
+  FillTensor(&ws, "b", {4});
+  FillTensor(&ws, "bn_scale", {4});
+  FillTensor(&ws, "bn_bias", {4});
+  FillTensor(&ws, "bn_mean", {4});
+  FillTensor(&ws, "bn_var", {4}, 0.5, 1.5);
+  FillTensor(&ws, "W2", {4, 4, 3, 3});
+  FillTensor(&ws, "b2", {4});
+
+  NetDef netdef;
+  AddConv(&netdef, {"X", "W", "b"}, "conv");
+  auto* op = AddOp(
+      &netdef,
+      "SpatialBN",
+      {"conv", "bn_scale", "bn_bias", "bn_mean", "bn_var"},
+      {"bn"});
+  AddArgument(OpSchema::Arg_IsTest, 1, op);
+  AddArgument("epsilon", 1e-3f, op);
+  AddOp(&netdef, "Relu", {"bn"}, {"bn"});
+  AddConv(&netdef, {"bn", "W2"}, "conv2");
+  op = AddOp(&netdef, "Add", {"conv2", "b2"}, {"conv2_bias"});
+  AddArgument("broadcast", 1, op);
+  AddArgument("axis", 1, op);
+  AddOp(&netdef, "Relu", {"conv2_bias"}, {"out"});
+
+  FusionStats stats;
+  NetDef fused = FuseOperators(netdef, &ws, &stats);
+  ASSERT_EQ(fused.op_size(), 2);
+  EXPECT_EQ(fused.op(0).type(), "ConvRelu");
+  EXPECT_EQ(fused.op(0).input(1), "transform/bn_filter");
+  EXPECT_EQ(fused.op(0).input(2), "transform/bn_bias");
+  EXPECT_EQ(fused.op(1).type(), "ConvRelu");
+  EXPECT_EQ(fused.op(1).input(2), "b2");
+  EXPECT_EQ(stats.ops_removed, 4);
+  // Each removed operator wrote a 2x4x6x6 activation.
+  EXPECT_EQ(stats.activation_bytes_saved, 4 * (2 * 4 * 6 * 6) * sizeof(float));
+
+  ExpectSameOutput(&ws, netdef, fused, "out");
+
+  // Without a workspace only the activations are fused.
+  fused = FuseOperators(netdef);
+  ASSERT_EQ(fused.op_size(), 5);
+  EXPECT_EQ(fused.op(0).type(), "Conv");
+  EXPECT_EQ(fused.op(1).type(), "SpatialBN");
+  EXPECT_EQ(fused.op(4).type(), "FusedElementwise");
+}
+
+} // namespace
+
+} // namespace caffe2
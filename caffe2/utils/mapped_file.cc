@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/utils/mapped_file.h"
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+#ifndef _MSC_VER
+
+MappedFile::MappedFile(const std::string& source, bool copy_on_write)
+    : data_(nullptr), size_(0), copy_on_write_(copy_on_write) {
+  int fd = open(source.c_str(), O_RDONLY);
+  CAFFE_ENFORCE(fd >= 0, "Cannot open file: ", source);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    CAFFE_THROW("Cannot stat file: ", source);
+  }
+  size_ = st.st_size;
+  if (size_ > 0) {
+    const int prot = copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* addr = mmap(nullptr, size_, prot, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      close(fd);
+      CAFFE_THROW("Cannot mmap file: ", source, " ", strerror(errno));
+    }
+    data_ = static_cast<char*>(addr);
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    munmap(data_, size_);
+  }
+}
+
+void MappedFile::AdviseRandomAccess() {
+  if (data_ && madvise(data_, size_, MADV_RANDOM) != 0) {
+    LOG(WARNING) << "madvise failed: " << strerror(errno);
+  }
+}
+
+#else // _MSC_VER
+
+MappedFile::MappedFile(const std::string& source, bool copy_on_write)
+    : data_(nullptr), size_(0), copy_on_write_(copy_on_write) {
+  CAFFE_THROW("Memory-mapped files are not supported on Windows: ", source);
+}
+
+MappedFile::~MappedFile() {}
+
+void MappedFile::AdviseRandomAccess() {}
+
+#endif // _MSC_VER
+
+} // namespace caffe2
@@ -0,0 +1,64 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_UTILS_MAPPED_FILE_H_
+#define CAFFE2_UTILS_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+// A file mapped into memory for reading. By default the mapping is
+// read-only, so it is not charged against the commit limit and writing to
+// it faults. A copy-on-write mapping may be modified in place instead, in
+// which case only the modified pages become private to the process and the
+// file is left untouched. Not available on Windows.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& source, bool copy_on_write = false);
+  ~MappedFile();
+
+  // Hints that the file will be read at random places, which turns off
+  // read-ahead of the pages around each access.
+  void AdviseRandomAccess();
+
+  const char* data() const {
+    return data_;
+  }
+  // Only for copy-on-write mappings.
+  char* mutable_data() {
+    CAFFE_ENFORCE(copy_on_write_, "The mapping is read-only.");
+    return data_;
+  }
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  char* data_;
+  size_t size_;
+  bool copy_on_write_;
+
+  DISABLE_COPY_AND_ASSIGN(MappedFile);
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_UTILS_MAPPED_FILE_H_
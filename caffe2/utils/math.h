@@ -124,10 +124,24 @@ CAFFE2_DECLARE_BINARY_OP_BINARY_RESULT(Xor);
 
 #undef CAFFE2_DECLARE_BINARY_OP_BINARY_RESULT
 
+// The overloads taking dims compute C = A op B, broadcasting A and B against
+// each other in the numpy sense: dims are aligned on the right, and a dim of
+// size 1 (or a missing one) is repeated to match the other operand. C has
+// the broadcast shape.
 #define CAFFE2_DECLARE_BINARY_OP(name)                                    \
   template <typename T, class Context>                                    \
   void name(const int N, const T* a, const T* b, T* y, Context* context); \
   template <typename T, class Context>                                    \
+  void name(                                                              \
+      const int A_ndim,                                                   \
+      const int* A_dims,                                                  \
+      const int B_ndim,                                                   \
+      const int* B_dims,                                                  \
+      const T* A,                                                         \
+      const T* B,                                                         \
+      T* C,                                                               \
+      Context* context);                                                  \
+  template <typename T, class Context>                                    \
   void name##ToRow(                                                       \
       const int M,                                                        \
       const int N,                                                        \
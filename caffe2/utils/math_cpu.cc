@@ -37,6 +37,7 @@
 
 #include "caffe2/utils/math.h"
 #include "caffe2/utils/cpu_neon.h"
+#include "caffe2/utils/parallel_for.h"
 #include "caffe2/core/context.h"
 #include "Eigen/Core"
 #include "Eigen/Dense"
@@ -56,6 +57,159 @@
 namespace caffe2 {
 namespace math {
 
+namespace {
+// The elementwise, broadcast and reduction kernels below are memory bound and
+// split between the threads of the context's intra-op pool.
+constexpr size_t kParallelGrainSize = kMemoryBoundGrainSize;
+
+inline size_t RowGrainSize(size_t row_size) {
+  return MemoryBoundRowGrainSize(row_size);
+}
+
+// Callers without a context get the default pool.
+template <typename Func>
+inline void
+ParallelFor(CPUContext* context, size_t n, size_t grain_size, Func&& fn) {
+  caffe2::ParallelFor(
+      context ? context->intraOpThreadPool() : nullptr,
+      n,
+      grain_size,
+      std::forward<Func>(fn));
+}
+
+// Adds up f(begin, end) over ranges of kParallelGrainSize items, which are
+// computed in parallel. The ranges do not depend on the number of threads,
+// so neither does the rounding of the result.
+template <typename T, typename F>
+T ParallelReduce(CPUContext* context, size_t n, F f) {
+  if (n <= kParallelGrainSize) {
+    return f(0, n);
+  }
+  const size_t num_ranges = (n + kParallelGrainSize - 1) / kParallelGrainSize;
+  std::vector<T> partial(num_ranges);
+  ParallelFor(context, num_ranges, 1, [&](size_t begin, size_t end) {
+    for (size_t r = begin; r < end; ++r) {
+      partial[r] = f(
+          r * kParallelGrainSize, std::min(n, (r + 1) * kParallelGrainSize));
+    }
+  });
+  T sum = 0;
+  for (const auto& value : partial) {
+    sum += value;
+  }
+  return sum;
+}
+
+// Computes C = A op B, broadcasting A and B against each other in the numpy
+// sense without materializing the broadcast operands. Dims of size 1 are
+// dropped and consecutive dims along which A and B are both either spanned
+// or broadcast are merged, so that the innermost run is as long as possible.
+// Each run of C is computed by op, or by op_scalar_b / op_scalar_a when B /
+// A is broadcast along the innermost dim, and the runs are split between
+// threads.
+template <
+    typename T,
+    typename Op,
+    typename OpScalarB,
+    typename OpScalarA>
+void BroadcastBinaryFunction(
+    CPUContext* context,
+    const int A_ndim,
+    const int* A_dims,
+    const int B_ndim,
+    const int* B_dims,
+    const T* A,
+    const T* B,
+    T* C,
+    Op op,
+    OpScalarB op_scalar_b,
+    OpScalarA op_scalar_a) {
+  const int ndim = std::max(A_ndim, B_ndim);
+  std::vector<int> dims;
+  std::vector<bool> a_spans;
+  std::vector<bool> b_spans;
+  for (int i = 0; i < ndim; ++i) {
+    const int a = i < ndim - A_ndim ? 1 : A_dims[i - ndim + A_ndim];
+    const int b = i < ndim - B_ndim ? 1 : B_dims[i - ndim + B_ndim];
+    CAFFE_ENFORCE(
+        a == b || a == 1 || b == 1,
+        "Cannot broadcast dimension ",
+        a,
+        " against ",
+        b);
+    const int c = a == 1 ? b : a;
+    if (c == 0) {
+      return;
+    }
+    if (c == 1) {
+      continue;
+    }
+    if (!dims.empty() && a_spans.back() == (a == c) &&
+        b_spans.back() == (b == c)) {
+      dims.back() *= c;
+    } else {
+      dims.push_back(c);
+      a_spans.push_back(a == c);
+      b_spans.push_back(b == c);
+    }
+  }
+  if (dims.empty()) {
+    op(1, A, B, C);
+    return;
+  }
+
+  const int outer_ndim = dims.size() - 1;
+  std::vector<size_t> a_strides(outer_ndim);
+  std::vector<size_t> b_strides(outer_ndim);
+  size_t a_size = a_spans.back() ? dims.back() : 1;
+  size_t b_size = b_spans.back() ? dims.back() : 1;
+  size_t num_runs = 1;
+  for (int i = outer_ndim - 1; i >= 0; --i) {
+    a_strides[i] = a_spans[i] ? a_size : 0;
+    b_strides[i] = b_spans[i] ? b_size : 0;
+    a_size *= a_spans[i] ? dims[i] : 1;
+    b_size *= b_spans[i] ? dims[i] : 1;
+    num_runs *= dims[i];
+  }
+  const int inner = dims.back();
+  const bool a_spans_inner = a_spans.back();
+  const bool b_spans_inner = b_spans.back();
+  const auto compute_runs = [&](size_t begin, size_t end) {
+    std::vector<int> index(outer_ndim);
+    size_t a_offset = 0;
+    size_t b_offset = 0;
+    size_t rest = begin;
+    for (int i = outer_ndim - 1; i >= 0; --i) {
+      index[i] = rest % dims[i];
+      rest /= dims[i];
+      a_offset += index[i] * a_strides[i];
+      b_offset += index[i] * b_strides[i];
+    }
+    for (size_t run = begin; run < end; ++run) {
+      T* c = C + run * inner;
+      if (a_spans_inner && b_spans_inner) {
+        op(inner, A + a_offset, B + b_offset, c);
+      } else if (a_spans_inner) {
+        op_scalar_b(inner, A + a_offset, B[b_offset], c);
+      } else {
+        op_scalar_a(inner, A[a_offset], B + b_offset, c);
+      }
+      for (int i = outer_ndim - 1; i >= 0; --i) {
+        a_offset += a_strides[i];
+        b_offset += b_strides[i];
+        if (++index[i] < dims[i]) {
+          break;
+        }
+        a_offset -= a_strides[i] * dims[i];
+        b_offset -= b_strides[i] * dims[i];
+        index[i] = 0;
+      }
+    }
+  };
+  ParallelFor(context, num_runs, RowGrainSize(inner), compute_runs);
+}
+} // namespace
+
 ////////////////////////////////////////////////////////////////////////////////
 // BLAS alternatives.
 // Depending on whether we have specified an external BLAS library or not, we
@@ -580,10 +734,12 @@ DELEGATE_POWX_FUNCTION(float)
 template <>                                                                    \
 void Funcname<T, CPUContext>(                                                  \
     const int N, const T* a, const T* b, T* y,                                 \
-    CPUContext*) {                                                             \
-  EigenVectorMap<T>(y, N) =                                                    \
-      ConstEigenVectorMap<T>(a, N).array() expr                                \
-      ConstEigenVectorMap<T>(b, N).array();                                    \
+    CPUContext* context) {                                                     \
+  ParallelFor(context, N, kParallelGrainSize, [=](size_t begin, size_t end) {  \
+    EigenVectorMap<T>(y + begin, end - begin) =                                \
+        ConstEigenVectorMap<T>(a + begin, end - begin).array() expr            \
+        ConstEigenVectorMap<T>(b + begin, end - begin).array();                \
+  });                                                                          \
 }
 
 #ifdef CAFFE2_USE_MKL
@@ -645,22 +801,32 @@ CAFFE2_SPECIALIZED_REDUCEMAX(int64_t)
 
 #undef CAFFE2_SPECIALIZED_REDUCEMAX
 
-#define CAFFE2_SPECIALIZED_ROWWISEMAX(T)                         \
-  template <>                                                    \
-  void RowwiseMax<T, CPUContext>(                                \
-      const int N, const int D, const T* x, T* y, CPUContext*) { \
-    EigenVectorMap<T>(y, N) =                                    \
-        ConstEigenMatrixMap<T>(x, D, N).colwise().maxCoeff();    \
+#define CAFFE2_SPECIALIZED_ROWWISEMAX(T)                                      \
+  template <>                                                                 \
+  void RowwiseMax<T, CPUContext>(                                             \
+      const int N, const int D, const T* x, T* y, CPUContext* context) {      \
+    ParallelFor(context, N, RowGrainSize(D), [=](size_t begin, size_t end) {  \
+      EigenVectorMap<T>(y + begin, end - begin) =                             \
+          ConstEigenMatrixMap<T>(x + begin * D, D, end - begin)               \
+              .colwise()                                                      \
+              .maxCoeff();                                                    \
+    });                                                                       \
   }
 CAFFE2_SPECIALIZED_ROWWISEMAX(float)
 #undef CAFFE2_SPECIALIZED_ROWWISEMAX
 
-#define CAFFE2_SPECIALIZED_COLWISEMAX(T)                         \
-  template <>                                                    \
-  void ColwiseMax<T, CPUContext>(                                \
-      const int N, const int D, const T* x, T* y, CPUContext*) { \
-    EigenVectorMap<T>(y, D) =                                    \
-        ConstEigenMatrixMap<T>(x, D, N).rowwise().maxCoeff();    \
+// Each range of columns scans all the rows.
+#define CAFFE2_SPECIALIZED_COLWISEMAX(T)                                      \
+  template <>                                                                 \
+  void ColwiseMax<T, CPUContext>(                                             \
+      const int N, const int D, const T* x, T* y, CPUContext* context) {      \
+    ParallelFor(context, D, RowGrainSize(N), [=](size_t begin, size_t end) {  \
+      EigenVectorMap<T>(y + begin, end - begin) =                             \
+          ConstEigenMatrixMap<T>(x, D, N)                                     \
+              .middleRows(begin, end - begin)                                 \
+              .rowwise()                                                      \
+              .maxCoeff();                                                    \
+    });                                                                       \
   }
 CAFFE2_SPECIALIZED_COLWISEMAX(float)
 #undef CAFFE2_SPECIALIZED_COLWISEMAX
@@ -688,26 +854,71 @@ CAFFE2_SPECIALIZED_MAXIMUM(float)
 
 // AddToRow and AddToCol adds the corresponding row/col vector b to the matrix a
 // of shape M x N. The actual implementation uses eigen which is column major,
-// so notice the row/column swap in the actual implementation.
+// so notice the row/column swap in the actual implementation. The M rows are
+// split between threads.
 #define DELEGATE_BROADCAST_BINARY_FUNCTION(T, Funcname, expr)                \
   template <>                                                                \
   void Funcname##ToRow<T, CPUContext>(                                       \
-      const int M, const int N, const T* a, const T* b, T* y, CPUContext*) { \
-    EigenArrayMap<T>(y, N, M) = ConstEigenArrayMap<T>(a, N, M).colwise()     \
-                                    expr ConstEigenVectorArrayMap<T>(b, N);  \
+      const int M,                                                           \
+      const int N,                                                           \
+      const T* a,                                                            \
+      const T* b,                                                            \
+      T* y,                                                                  \
+      CPUContext* context) {                                                 \
+    ParallelFor(context, M, RowGrainSize(N), [=](size_t begin, size_t end) { \
+      EigenArrayMap<T>(y + begin * N, N, end - begin) =                      \
+          ConstEigenArrayMap<T>(a + begin * N, N, end - begin).colwise()     \
+              expr ConstEigenVectorArrayMap<T>(b, N);                        \
+    });                                                                      \
   }                                                                          \
   /* inplace versions */                                                     \
   template <>                                                                \
   void Funcname##ToRow<T, CPUContext>(                                       \
-      const int M, const int N, const T* x, T* y, CPUContext*) {             \
-    EigenArrayMap<T>(y, N, M).colwise() expr## =                             \
-        ConstEigenVectorArrayMap<T>(x, N);                                   \
+      const int M, const int N, const T* x, T* y, CPUContext* context) {     \
+    ParallelFor(context, M, RowGrainSize(N), [=](size_t begin, size_t end) { \
+      EigenArrayMap<T>(y + begin * N, N, end - begin).colwise() expr## =     \
+          ConstEigenVectorArrayMap<T>(x, N);                                 \
+    });                                                                      \
   }                                                                          \
   template <>                                                                \
   void Funcname##ToCol<T, CPUContext>(                                       \
-      const int M, const int N, const T* x, T* y, CPUContext*) {             \
-    EigenArrayMap<T>(y, N, M).rowwise() expr## =                             \
-        ConstEigenVectorArrayMap<T>(x, M).transpose();                       \
+      const int M, const int N, const T* x, T* y, CPUContext* context) {     \
+    ParallelFor(context, M, RowGrainSize(N), [=](size_t begin, size_t end) { \
+      EigenArrayMap<T>(y + begin * N, N, end - begin).rowwise() expr## =     \
+          ConstEigenVectorArrayMap<T>(x + begin, end - begin).transpose();   \
+    });                                                                      \
+  }                                                                          \
+  template <>                                                                \
+  void Funcname<T, CPUContext>(                                              \
+      const int A_ndim,                                                      \
+      const int* A_dims,                                                     \
+      const int B_ndim,                                                      \
+      const int* B_dims,                                                     \
+      const T* A,                                                            \
+      const T* B,                                                            \
+      T* C,                                                                  \
+      CPUContext* context) {                                                 \
+    BroadcastBinaryFunction(                                                 \
+        context,                                                             \
+        A_ndim,                                                              \
+        A_dims,                                                              \
+        B_ndim,                                                              \
+        B_dims,                                                              \
+        A,                                                                   \
+        B,                                                                   \
+        C,                                                                   \
+        [](int n, const T* a, const T* b, T* c) {                            \
+          EigenVectorArrayMap<T>(c, n) = ConstEigenVectorArrayMap<T>(a, n)   \
+              expr ConstEigenVectorArrayMap<T>(b, n);                        \
+        },                                                                   \
+        [](int n, const T* a, T b, T* c) {                                   \
+          EigenVectorArrayMap<T>(c, n) =                                     \
+              ConstEigenVectorArrayMap<T>(a, n) expr b;                      \
+        },                                                                   \
+        [](int n, T a, const T* b, T* c) {                                   \
+          EigenVectorArrayMap<T>(c, n) =                                     \
+              a expr ConstEigenVectorArrayMap<T>(b, n);                      \
+        });                                                                  \
   }
 
 #define DEFINE_BROADCAST_BINARY_FUNCTION(name, op)                       \
@@ -882,15 +1093,17 @@ void RandGaussian<float, CPUContext>(
   }
 }
 
-#define CAFFE2_SPECIALIZED_SUM(T)            \
-  template <>                                \
-  void Sum<T, CPUContext>(                   \
-      const int N,                           \
-      const T* x,                            \
-      T* y,                                  \
-      CPUContext* /* unused */,              \
-      Tensor<CPUContext>* /* unused */) {    \
-    *y = ConstEigenVectorMap<T>(x, N).sum(); \
+#define CAFFE2_SPECIALIZED_SUM(T)                                           \
+  template <>                                                               \
+  void Sum<T, CPUContext>(                                                  \
+      const int N,                                                          \
+      const T* x,                                                           \
+      T* y,                                                                 \
+      CPUContext* context,                                                  \
+      Tensor<CPUContext>* /* unused */) {                                   \
+    *y = ParallelReduce<T>(context, N, [x](size_t begin, size_t end) {      \
+      return ConstEigenVectorMap<T>(x + begin, end - begin).sum();          \
+    });                                                                     \
   }
 
 CAFFE2_SPECIALIZED_SUM(float);
@@ -904,9 +1117,11 @@ void SumSqr<float, CPUContext>(
     const int N,
     const float* x,
     float* y,
-    CPUContext* /*context*/ /* unused */,
+    CPUContext* context,
     Tensor<CPUContext>* /*scratch_ptr*/ /* unused */) {
-  *y = ConstEigenVectorMap<float>(x, N).squaredNorm();
+  *y = ParallelReduce<float>(context, N, [x](size_t begin, size_t end) {
+    return ConstEigenVectorMap<float>(x + begin, end - begin).squaredNorm();
+  });
 }
 
 template <>
@@ -15,12 +15,17 @@
  */
 
 #include <gtest/gtest.h>
+#include <functional>
+#include <random>
 #include "caffe2/core/blob.h"
 #include "caffe2/core/context.h"
 #include "caffe2/core/tensor.h"
 #include "caffe2/proto/caffe2.pb.h"
 #include "caffe2/utils/conversions.h"
 #include "caffe2/utils/math.h"
+#include "caffe2/utils/parallel_for.h"
+
+CAFFE2_DECLARE_int(caffe2_intra_op_num_threads);
 
 namespace caffe2 {
 
@@ -295,4 +300,199 @@ TEST(MathTest, TranposeTest) {
   }
 }
 
+namespace {
+
+// Computes A op B with numpy broadcasting one output element at a time.
+std::vector<float> ReferenceBroadcast(
+    const std::vector<int>& A_dims,
+    const std::vector<int>& B_dims,
+    const std::vector<float>& A,
+    const std::vector<float>& B,
+    const std::function<float(float, float)>& op) {
+  const int ndim = std::max(A_dims.size(), B_dims.size());
+  std::vector<int> a_dims(ndim - A_dims.size(), 1);
+  a_dims.insert(a_dims.end(), A_dims.begin(), A_dims.end());
+  std::vector<int> b_dims(ndim - B_dims.size(), 1);
+  b_dims.insert(b_dims.end(), B_dims.begin(), B_dims.end());
+  std::vector<int> c_dims(ndim);
+  int c_size = 1;
+  for (int i = 0; i < ndim; ++i) {
+    c_dims[i] = std::max(a_dims[i], b_dims[i]);
+    c_size *= c_dims[i];
+  }
+  std::vector<float> C(c_size);
+  for (int c = 0; c < c_size; ++c) {
+    int a = 0;
+    int b = 0;
+    int rest = c;
+    int a_stride = 1;
+    int b_stride = 1;
+    for (int i = ndim - 1; i >= 0; --i) {
+      const int index = rest % c_dims[i];
+      rest /= c_dims[i];
+      a += (a_dims[i] == 1 ? 0 : index) * a_stride;
+      b += (b_dims[i] == 1 ? 0 : index) * b_stride;
+      a_stride *= a_dims[i];
+      b_stride *= b_dims[i];
+    }
+    C[c] = op(A[a], B[b]);
+  }
+  return C;
+}
+
+std::vector<float> RandomVector(int size, std::mt19937* gen) {
+  std::uniform_real_distribution<float> dist(0.5f, 2.0f);
+  std::vector<float> x(size);
+  for (auto& value : x) {
+    value = dist(*gen);
+  }
+  return x;
+}
+
+int Product(const std::vector<int>& dims) {
+  int size = 1;
+  for (const int d : dims) {
+    size *= d;
+  }
+  return size;
+}
+
+} // namespace
+
+TEST(MathTest, BroadcastBinaryOps) {
+  DeviceOption option;
+  CPUContext cpu_context(option);
+  std::mt19937 gen(0);
+  const std::vector<std::pair<std::vector<int>, std::vector<int>>> shapes = {
+      {{2, 3, 4}, {2, 3, 4}},
+      {{2, 1, 4}, {3, 1}},
+      {{3, 1}, {2, 1, 4}},
+      {{5, 4}, {}},
+      {{}, {5, 4}},
+      {{1}, {1, 1}},
+      {{2, 3, 4, 5}, {3, 1, 5}},
+      {{4, 1, 3, 1}, {1, 6, 1, 2}},
+      {{64, 1}, {1, 2048}},
+      {{700, 300}, {300}},
+      {{700, 300}, {700, 1}},
+  };
+  // Runs once without and once with intra-op threads.
+  for (const int num_threads : {1, 4}) {
+    SetIntraOpNumThreads(num_threads);
+    for (const auto& shape : shapes) {
+      const auto& A_dims = shape.first;
+      const auto& B_dims = shape.second;
+      const auto A = RandomVector(Product(A_dims), &gen);
+      const auto B = RandomVector(Product(B_dims), &gen);
+      const auto check = [&](
+          const std::function<float(float, float)>& op,
+          const std::function<void(float*)>& run) {
+        const auto expected = ReferenceBroadcast(A_dims, B_dims, A, B, op);
+        std::vector<float> C(expected.size(), -1.0f);
+        run(C.data());
+        for (int i = 0; i < expected.size(); ++i) {
+          EXPECT_FLOAT_EQ(expected[i], C[i]) << i;
+        }
+      };
+#define TEST_BROADCAST_BINARY_OP(name, expr)                        \
+  check([](float a, float b) { return a expr b; }, [&](float* C) {  \
+    math::name<float, CPUContext>(                                  \
+        A_dims.size(),                                              \
+        A_dims.data(),                                              \
+        B_dims.size(),                                              \
+        B_dims.data(),                                              \
+        A.data(),                                                   \
+        B.data(),                                                   \
+        C,                                                          \
+        &cpu_context);                                              \
+  });
+      TEST_BROADCAST_BINARY_OP(Add, +)
+      TEST_BROADCAST_BINARY_OP(Sub, -)
+      TEST_BROADCAST_BINARY_OP(Mul, *)
+      TEST_BROADCAST_BINARY_OP(Div, /)
+#undef TEST_BROADCAST_BINARY_OP
+    }
+  }
+  SetIntraOpNumThreads(FLAGS_caffe2_intra_op_num_threads);
+
+  // Empty dims produce an empty output.
+  const std::vector<int> A_dims = {3, 0};
+  const std::vector<int> B_dims = {1};
+  const float B = 1.0f;
+  math::Add<float, CPUContext>(
+      2, A_dims.data(), 1, B_dims.data(), nullptr, &B, nullptr, &cpu_context);
+  const std::vector<int> C_dims = {4};
+  EXPECT_THROW(
+      (math::Add<float, CPUContext>(
+          2,
+          A_dims.data(),
+          1,
+          C_dims.data(),
+          nullptr,
+          &B,
+          nullptr,
+          &cpu_context)),
+      EnforceNotMet);
+}
+
+TEST(MathTest, ParallelKernelsMatchSerial) {
+  DeviceOption option;
+  CPUContext cpu_context(option);
+  std::mt19937 gen(0);
+  const int M = 513;
+  const int N = 1031;
+  const auto X = RandomVector(M * N, &gen);
+  const auto row = RandomVector(N, &gen);
+  const auto col = RandomVector(M, &gen);
+
+  std::vector<float> sum(2);
+  std::vector<float> sum_sqr(2);
+  std::vector<std::vector<float>> rowwise_max(2, std::vector<float>(M));
+  std::vector<std::vector<float>> colwise_max(2, std::vector<float>(N));
+  std::vector<std::vector<float>> add_to_row(2, std::vector<float>(M * N));
+  std::vector<std::vector<float>> mul_to_col(2, X);
+  std::vector<std::vector<float>> add(2, std::vector<float>(M * N));
+  const std::vector<int> threads = {1, 4};
+  for (int t = 0; t < threads.size(); ++t) {
+    SetIntraOpNumThreads(threads[t]);
+    math::Sum<float, CPUContext>(M * N, X.data(), &sum[t], &cpu_context);
+    math::SumSqr<float, CPUContext>(
+        M * N, X.data(), &sum_sqr[t], &cpu_context);
+    math::RowwiseMax<float, CPUContext>(
+        M, N, X.data(), rowwise_max[t].data(), &cpu_context);
+    math::ColwiseMax<float, CPUContext>(
+        M, N, X.data(), colwise_max[t].data(), &cpu_context);
+    math::AddToRow<float, CPUContext>(
+        M, N, X.data(), row.data(), add_to_row[t].data(), &cpu_context);
+    math::MulToCol<float, CPUContext>(
+        M, N, col.data(), mul_to_col[t].data(), &cpu_context);
+    math::Add<float, CPUContext>(
+        M * N, X.data(), X.data(), add[t].data(), &cpu_context);
+  }
+  SetIntraOpNumThreads(FLAGS_caffe2_intra_op_num_threads);
+
+  // Reductions add up the same partial sums whatever the number of threads.
+  EXPECT_EQ(sum[0], sum[1]);
+  EXPECT_EQ(sum_sqr[0], sum_sqr[1]);
+  double expected_sum = 0;
+  for (const float x : X) {
+    expected_sum += x;
+  }
+  EXPECT_NEAR(expected_sum, sum[0], 1e-5 * expected_sum);
+  EXPECT_EQ(rowwise_max[0], rowwise_max[1]);
+  EXPECT_EQ(colwise_max[0], colwise_max[1]);
+  EXPECT_EQ(add_to_row[0], add_to_row[1]);
+  EXPECT_EQ(mul_to_col[0], mul_to_col[1]);
+  EXPECT_EQ(add[0], add[1]);
+  for (int i = 0; i < M; ++i) {
+    EXPECT_EQ(
+        *std::max_element(X.begin() + i * N, X.begin() + (i + 1) * N),
+        rowwise_max[0][i]);
+    for (int j = 0; j < N; ++j) {
+      EXPECT_EQ(X[i * N + j] + row[j], add_to_row[0][i * N + j]);
+      EXPECT_EQ(X[i * N + j] * col[i], mul_to_col[0][i * N + j]);
+    }
+  }
+}
+
 } // namespace caffe2
@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/utils/packed_gemm.h"
+
+#include <algorithm>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+constexpr int PackedGemmMatrix::kPanelN;
+constexpr int PackedGemmMatrix::kBlockK;
+
+namespace {
+
+constexpr int kPanelN = PackedGemmMatrix::kPanelN;
+constexpr int kBlockK = PackedGemmMatrix::kBlockK;
+// Rows of X multiplied with a panel at a time. 4 x kPanelN sums plus a panel
+// row fit in the 16 vector registers of SSE and NEON.
+constexpr int kBlockM = 4;
+
+using PanelRow = Eigen::Array<float, kPanelN, 1>;
+
+// Computes kRows x n outputs from kc rows of a packed panel w. The sums start
+// from c (with row stride ldc, 0 to broadcast a bias) or from zero if c is
+// nullptr, and are kept in registers over the whole K block. Eigen fixed
+// size arrays make the compiler vectorize across the panel instead of
+// turning the loop over k into a reduction. With fewer than kBlockM rows,
+// consecutive k go to separate sums so that the additions do not wait on
+// each other.
+template <int kRows>
+void PackedGemmKernel(
+    int kc,
+    const float* x,
+    int ldx,
+    const float* w,
+    const float* c,
+    int ldc,
+    float* y,
+    int ldy,
+    int n) {
+  constexpr int kSplit = kBlockM / kRows;
+  PanelRow acc[kSplit][kRows];
+  for (int s = 0; s < kSplit; ++s) {
+    for (int i = 0; i < kRows; ++i) {
+      acc[s][i].setZero();
+    }
+  }
+  if (c) {
+    for (int i = 0; i < kRows; ++i) {
+      acc[0][i].head(n) = ConstEigenVectorArrayMap<float>(c + i * ldc, n);
+    }
+  }
+  int k = 0;
+  for (; k + kSplit <= kc; k += kSplit) {
+    for (int s = 0; s < kSplit; ++s) {
+      const PanelRow wk = Eigen::Map<const PanelRow>(w + (k + s) * kPanelN);
+      for (int i = 0; i < kRows; ++i) {
+        acc[s][i] += x[i * ldx + k + s] * wk;
+      }
+    }
+  }
+  for (; k < kc; ++k) {
+    const PanelRow wk = Eigen::Map<const PanelRow>(w + k * kPanelN);
+    for (int i = 0; i < kRows; ++i) {
+      acc[0][i] += x[i * ldx + k] * wk;
+    }
+  }
+  for (int s = 1; s < kSplit; ++s) {
+    for (int i = 0; i < kRows; ++i) {
+      acc[0][i] += acc[s][i];
+    }
+  }
+  for (int i = 0; i < kRows; ++i) {
+    if (n == kPanelN) {
+      Eigen::Map<PanelRow>(y + i * ldy) = acc[0][i];
+    } else {
+      EigenVectorArrayMap<float>(y + i * ldy, n) = acc[0][i].head(n);
+    }
+  }
+}
+
+} // namespace
+
+void PackedGemmMatrix::Pack(int N, int K, const float* W, bool transposed) {
+  CAFFE_ENFORCE_GE(N, 0);
+  CAFFE_ENFORCE_GE(K, 0);
+  N_ = N;
+  K_ = K;
+  paddedN_ = (N + kPanelN - 1) / kPanelN * kPanelN;
+  data_.assign(static_cast<size_t>(paddedN_) * K, 0.f);
+  for (int kb = 0; kb * kBlockK < K; ++kb) {
+    const int k0 = kb * kBlockK;
+    const int kc = BlockSize(kb);
+    for (int nb = 0; nb * kPanelN < N; ++nb) {
+      const int n0 = nb * kPanelN;
+      const int n = std::min(kPanelN, N - n0);
+      float* dst = data_.data() + k0 * paddedN_ + nb * kPanelN * kc;
+      for (int k = 0; k < kc; ++k) {
+        for (int j = 0; j < n; ++j) {
+          dst[k * kPanelN + j] = transposed
+              ? W[static_cast<size_t>(n0 + j) * K + k0 + k]
+              : W[static_cast<size_t>(k0 + k) * N + n0 + j];
+        }
+      }
+    }
+  }
+}
+
+void PackedGemm(
+    int M,
+    const float* X,
+    const PackedGemmMatrix& W,
+    const float* bias,
+    float* Y) {
+  const int N = W.N();
+  const int K = W.K();
+  if (K == 0) {
+    for (int m = 0; m < M; ++m) {
+      for (int n = 0; n < N; ++n) {
+        Y[m * N + n] = bias ? bias[n] : 0;
+      }
+    }
+    return;
+  }
+  for (int kb = 0; kb * kBlockK < K; ++kb) {
+    const int k0 = kb * kBlockK;
+    const int kc = W.BlockSize(kb);
+    for (int nb = 0; nb * kPanelN < N; ++nb) {
+      const int n0 = nb * kPanelN;
+      const int n = std::min(kPanelN, N - n0);
+      const float* w = W.panel(kb, nb);
+      for (int m0 = 0; m0 < M; m0 += kBlockM) {
+        const float* x = X + static_cast<size_t>(m0) * K + k0;
+        float* y = Y + static_cast<size_t>(m0) * N + n0;
+        // The first K block starts from the bias, the others from the
+        // partial sums already stored in Y.
+        const float* c = kb == 0 ? (bias ? bias + n0 : nullptr) : y;
+        const int ldc = kb == 0 ? 0 : N;
+        switch (std::min(kBlockM, M - m0)) {
+          case 1:
+            PackedGemmKernel<1>(kc, x, K, w, c, ldc, y, N, n);
+            break;
+          case 2:
+            PackedGemmKernel<2>(kc, x, K, w, c, ldc, y, N, n);
+            break;
+          case 3:
+            PackedGemmKernel<3>(kc, x, K, w, c, ldc, y, N, n);
+            break;
+          default:
+            PackedGemmKernel<kBlockM>(kc, x, K, w, c, ldc, y, N, n);
+            break;
+        }
+      }
+    }
+  }
+}
+
+} // namespace caffe2
@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_UTILS_PACKED_GEMM_H_
+#define CAFFE2_UTILS_PACKED_GEMM_H_
+
+#include <vector>
+
+namespace caffe2 {
+
+// Weight matrix of a fully connected layer packed for PackedGemm. The N
+// output columns are split into panels of kPanelN columns (the last one zero
+// padded) and K into blocks of kBlockK, and each (K block, panel) pair is
+// stored contiguously as [k][kPanelN]. A panel of a K block stays in L1
+// while it is multiplied with every group of rows of X, so the packed
+// weights are streamed from memory once per product, which is what bounds
+// the small batches of online inference.
+class PackedGemmMatrix {
+ public:
+  static constexpr int kPanelN = 8;
+  static constexpr int kBlockK = 256;
+
+  PackedGemmMatrix() {}
+
+  // Packs W, which is N x K if transposed (the layout of FC weights) and
+  // K x N otherwise (the layout of FCTransposed weights), both row major.
+  void Pack(int N, int K, const float* W, bool transposed);
+
+  int N() const {
+    return N_;
+  }
+  int K() const {
+    return K_;
+  }
+  bool empty() const {
+    return data_.empty();
+  }
+
+  // Panel nb of K block kb, holding rows [kb * kBlockK, kb * kBlockK + kc)
+  // of the transposed weights where kc is the size of that block.
+  const float* panel(int kb, int nb) const {
+    return data_.data() + kb * kBlockK * paddedN_ +
+        nb * kPanelN * BlockSize(kb);
+  }
+
+  int BlockSize(int kb) const {
+    return kb * kBlockK + kBlockK <= K_ ? kBlockK : K_ - kb * kBlockK;
+  }
+
+ private:
+  int N_{0};
+  int K_{0};
+  int paddedN_{0};
+  std::vector<float> data_;
+};
+
+// Computes Y = X * W^T + bias where X is M x K and Y is M x N, both row
+// major, and W^T is the K x N matrix held by the packed weights. bias is a
+// vector of N values and may be nullptr.
+void PackedGemm(
+    int M,
+    const float* X,
+    const PackedGemmMatrix& W,
+    const float* bias,
+    float* Y);
+
+} // namespace caffe2
+
+#endif // CAFFE2_UTILS_PACKED_GEMM_H_
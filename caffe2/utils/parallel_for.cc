@@ -0,0 +1,292 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/utils/parallel_for.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#if !defined(_MSC_VER) && !defined(__APPLE__)
+#include <sched.h>
+#endif
+
+#include "caffe2/core/flags.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/utils/work_stealing_thread_pool.h"
+
+CAFFE2_DEFINE_int(
+    caffe2_intra_op_num_threads,
+    1,
+    "Number of threads a CPU operator may use to split its work, 0 meaning "
+    "one per core. The default of 1 disables intra-op parallelism.");
+CAFFE2_DEFINE_string(
+    caffe2_intra_op_cpus,
+    "",
+    "CPUs to pin the threads of the default intra-op pool to, as a list "
+    "such as 0-3,8. Empty leaves them to the OS scheduler.");
+CAFFE2_DEFINE_int(
+    caffe2_intra_op_numa_node,
+    -1,
+    "NUMA node whose CPUs the threads of the default intra-op pool are "
+    "pinned to, -1 for none.");
+
+namespace caffe2 {
+
+namespace {
+
+// Ranges handed out per thread, so that threads that start late or run
+// slower do not hold up the others.
+constexpr std::size_t kRangesPerThread = 4;
+
+// Set while the current thread runs a range, to run nested loops inline.
+thread_local bool t_in_parallel_for = false;
+
+// The default pool is created on first use, after flags have been parsed.
+// The atomics let ParallelFor read it without taking the mutex.
+std::mutex g_default_pool_mutex;
+std::unique_ptr<IntraOpThreadPool> g_default_pool;
+std::atomic<IntraOpThreadPool*> g_default_pool_ptr{nullptr};
+
+int NumCores() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void PinCurrentThread(int cpu) {
+#if !defined(_MSC_VER) && !defined(__APPLE__)
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  CPU_SET(cpu, &mask);
+  if (sched_setaffinity(0, sizeof(cpu_set_t), &mask)) {
+    LOG(WARNING) << "Could not pin intra-op thread to CPU " << cpu;
+  }
+#else
+  LOG(WARNING) << "Intra-op thread affinity is not supported on this "
+               << "platform, CPU " << cpu << " ignored";
+#endif
+}
+
+// Options of the default pool with num_threads threads.
+IntraOpThreadPoolOptions DefaultPoolOptions(int num_threads) {
+  IntraOpThreadPoolOptions options;
+  options.numThreads = num_threads;
+  options.cpus = ParseCPUList(FLAGS_caffe2_intra_op_cpus);
+  options.numaNode = FLAGS_caffe2_intra_op_numa_node;
+  return options;
+}
+
+struct ParallelForState {
+  std::size_t n;
+  std::size_t num_ranges;
+  const std::function<void(std::size_t, std::size_t)>* fn;
+  std::atomic<std::size_t> next{0};
+  std::atomic<std::size_t> done{0};
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::exception_ptr error;
+};
+
+// Runs ranges until none is left. Workers that only get here after the
+// caller returned find no range and never touch fn.
+void RunRanges(const std::shared_ptr<ParallelForState>& state) {
+  const bool was_in_parallel_for = t_in_parallel_for;
+  t_in_parallel_for = true;
+  for (;;) {
+    const std::size_t range = state->next++;
+    if (range >= state->num_ranges) {
+      break;
+    }
+    try {
+      (*state->fn)(
+          state->n * range / state->num_ranges,
+          state->n * (range + 1) / state->num_ranges);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (!state->error) {
+        state->error = std::current_exception();
+      }
+    }
+    if (++state->done == state->num_ranges) {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->cv.notify_all();
+    }
+  }
+  t_in_parallel_for = was_in_parallel_for;
+}
+
+} // namespace
+
+IntraOpThreadPool::IntraOpThreadPool(const IntraOpThreadPoolOptions& options)
+    : numThreads_(options.numThreads), cpus_(options.cpus) {
+  CAFFE_ENFORCE_GE(numThreads_, 0);
+  if (options.numaNode >= 0) {
+    cpus_ = GetNumaNodeCPUs(options.numaNode);
+  }
+  if (numThreads_ == 0) {
+    numThreads_ = cpus_.empty() ? NumCores() : cpus_.size();
+  }
+  if (numThreads_ > 1) {
+    std::function<void(std::size_t)> init_worker;
+    if (!cpus_.empty()) {
+      const auto cpus = cpus_;
+      init_worker = [cpus](std::size_t index) {
+        PinCurrentThread(cpus[index % cpus.size()]);
+      };
+    }
+    workers_.reset(new WorkStealingThreadPool(numThreads_ - 1, init_worker));
+  }
+}
+
+IntraOpThreadPool::~IntraOpThreadPool() {}
+
+void IntraOpThreadPool::parallelFor(
+    std::size_t n,
+    std::size_t grain_size,
+    const std::function<void(std::size_t, std::size_t)>& fn) {
+  const std::size_t num_threads =
+      workers_ && !t_in_parallel_for ? numThreads_ : 1;
+  grain_size = std::max<std::size_t>(grain_size, 1);
+  const std::size_t num_ranges =
+      std::min(n / grain_size, num_threads * kRangesPerThread);
+  if (num_ranges <= 1) {
+    if (n > 0) {
+      fn(0, n);
+    }
+    return;
+  }
+
+  auto state = std::make_shared<ParallelForState>();
+  state->n = n;
+  state->num_ranges = num_ranges;
+  state->fn = &fn;
+  const std::size_t num_helpers = std::min(num_threads - 1, num_ranges - 1);
+  for (std::size_t i = 0; i < num_helpers; ++i) {
+    workers_->run([state]() { RunRanges(state); });
+  }
+  RunRanges(state);
+  {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(
+        lock, [&state]() { return state->done == state->num_ranges; });
+  }
+  if (state->error) {
+    std::rethrow_exception(state->error);
+  }
+}
+
+IntraOpThreadPool* GetDefaultIntraOpThreadPool() {
+  IntraOpThreadPool* pool = g_default_pool_ptr;
+  if (!pool) {
+    std::lock_guard<std::mutex> lock(g_default_pool_mutex);
+    if (!g_default_pool) {
+      g_default_pool.reset(new IntraOpThreadPool(
+          DefaultPoolOptions(FLAGS_caffe2_intra_op_num_threads)));
+      g_default_pool_ptr = g_default_pool.get();
+    }
+    pool = g_default_pool.get();
+  }
+  return pool;
+}
+
+int GetIntraOpNumThreads() {
+  return GetDefaultIntraOpThreadPool()->numThreads();
+}
+
+void SetIntraOpNumThreads(int num_threads) {
+  std::unique_ptr<IntraOpThreadPool> pool(
+      new IntraOpThreadPool(DefaultPoolOptions(num_threads)));
+  std::lock_guard<std::mutex> lock(g_default_pool_mutex);
+  g_default_pool_ptr = pool.get();
+  g_default_pool.swap(pool);
+}
+
+std::shared_ptr<IntraOpThreadPool> GetSharedIntraOpThreadPool(
+    const IntraOpThreadPoolOptions& options) {
+  static std::mutex pools_mutex;
+  static std::vector<
+      std::pair<IntraOpThreadPoolOptions, std::weak_ptr<IntraOpThreadPool>>>
+      pools;
+  std::lock_guard<std::mutex> lock(pools_mutex);
+  pools.erase(
+      std::remove_if(
+          pools.begin(),
+          pools.end(),
+          [](const std::pair<
+              IntraOpThreadPoolOptions,
+              std::weak_ptr<IntraOpThreadPool>>& entry) {
+            return entry.second.expired();
+          }),
+      pools.end());
+  for (const auto& entry : pools) {
+    if (entry.first == options) {
+      auto pool = entry.second.lock();
+      if (pool) {
+        return pool;
+      }
+    }
+  }
+  auto pool = std::make_shared<IntraOpThreadPool>(options);
+  pools.emplace_back(options, pool);
+  return pool;
+}
+
+std::vector<int> ParseCPUList(const std::string& cpu_list) {
+  std::vector<int> cpus;
+  std::stringstream stream(cpu_list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    item.erase(
+        std::remove_if(item.begin(), item.end(), ::isspace), item.end());
+    if (item.empty()) {
+      continue;
+    }
+    const auto dash = item.find('-');
+    try {
+      const int first = std::stoi(item.substr(0, dash));
+      const int last =
+          dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+      CAFFE_ENFORCE(0 <= first && first <= last, "Invalid CPU range ", item);
+      for (int cpu = first; cpu <= last; ++cpu) {
+        cpus.push_back(cpu);
+      }
+    } catch (const std::logic_error&) {
+      CAFFE_THROW("Invalid CPU list ", cpu_list);
+    }
+  }
+  return cpus;
+}
+
+std::vector<int> GetNumaNodeCPUs(int node) {
+  const std::string path =
+      "/sys/devices/system/node/node" + caffe2::to_string(node) + "/cpulist";
+  std::ifstream file(path);
+  CAFFE_ENFORCE(
+      file, "Cannot read the CPUs of NUMA node ", node, " from ", path);
+  std::string cpu_list;
+  std::getline(file, cpu_list);
+  auto cpus = ParseCPUList(cpu_list);
+  CAFFE_ENFORCE(!cpus.empty(), "NUMA node ", node, " has no CPU");
+  return cpus;
+}
+
+} // namespace caffe2
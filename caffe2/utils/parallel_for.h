@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_UTILS_PARALLEL_FOR_H_
+#define CAFFE2_UTILS_PARALLEL_FOR_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace caffe2 {
+
+class WorkStealingThreadPool;
+
+// Items per range that amortize handing the range to another thread for
+// memory bound kernels of a few cycles per item, such as elementwise math.
+constexpr std::size_t kMemoryBoundGrainSize = 1 << 15;
+
+// Grain in rows for such kernels when they are split along rows of row_size
+// items.
+inline std::size_t MemoryBoundRowGrainSize(std::size_t row_size) {
+  return row_size >= kMemoryBoundGrainSize
+      ? 1
+      : kMemoryBoundGrainSize / (row_size > 0 ? row_size : 1);
+}
+
+struct IntraOpThreadPoolOptions {
+  // Threads splitting a loop, the calling thread included. 0 means one per
+  // core, or one per CPU the threads are pinned to.
+  int numThreads{0};
+  // CPUs the pool's threads are pinned to, handed out round-robin. Empty
+  // leaves them to the OS scheduler.
+  std::vector<int> cpus;
+  // When not negative, pins the threads to the CPUs of this NUMA node
+  // instead, so that they run next to the memory the node allocates them.
+  int numaNode{-1};
+
+  bool operator==(const IntraOpThreadPoolOptions& other) const {
+    return numThreads == other.numThreads && cpus == other.cpus &&
+        numaNode == other.numaNode;
+  }
+};
+
+/**
+ * Threads that a CPU operator uses to split its own work, as opposed to the
+ * inter-op pools of the nets that run several operators at once.
+ *
+ * The thread calling parallelFor always takes part, so a pool of numThreads()
+ * threads holds one worker less. Several threads may run loops on the same
+ * pool at once; ranges of nested loops, e.g. a kernel that runs another
+ * parallel kernel per range, are run inline by the thread that makes them.
+ */
+class IntraOpThreadPool {
+ public:
+  explicit IntraOpThreadPool(const IntraOpThreadPoolOptions& options);
+  ~IntraOpThreadPool();
+
+  int numThreads() const {
+    return numThreads_;
+  }
+
+  // CPUs the workers are pinned to, empty if they are not.
+  const std::vector<int>& cpus() const {
+    return cpus_;
+  }
+
+  // Calls fn(begin, end) on disjoint ranges covering [0, n), each of at least
+  // grain_size items unless n is smaller, and returns once all of them are
+  // done. The first exception thrown by fn is rethrown.
+  void parallelFor(
+      std::size_t n,
+      std::size_t grain_size,
+      const std::function<void(std::size_t, std::size_t)>& fn);
+
+ private:
+  int numThreads_;
+  std::vector<int> cpus_;
+  std::unique_ptr<WorkStealingThreadPool> workers_;
+};
+
+// Process-wide pool sized by --caffe2_intra_op_num_threads (0 meaning one
+// thread per core; the default of 1 disables intra-op parallelism) and
+// pinned according to --caffe2_intra_op_cpus and --caffe2_intra_op_numa_node.
+// It serves CPU contexts that were not given a pool of their own and code
+// running outside operators.
+IntraOpThreadPool* GetDefaultIntraOpThreadPool();
+
+// Number of threads of the default pool.
+int GetIntraOpNumThreads();
+
+// Replaces the default pool with one of num_threads threads (0 meaning one
+// per core, or per CPU it is pinned to). Must not be called while a loop is
+// running on it.
+void SetIntraOpNumThreads(int num_threads);
+
+// Returns a pool with the given options, shared with every caller asking for
+// the same options while any of them holds it.
+std::shared_ptr<IntraOpThreadPool> GetSharedIntraOpThreadPool(
+    const IntraOpThreadPoolOptions& options);
+
+// Parses a Linux CPU list such as "0-3,8,10-11".
+std::vector<int> ParseCPUList(const std::string& cpu_list);
+
+// CPUs of the given NUMA node, read from sysfs. Throws if there is no such
+// node or the platform does not expose them.
+std::vector<int> GetNumaNodeCPUs(int node);
+
+// Runs fn(begin, end) over [0, n) on pool, or on the default pool if pool is
+// nullptr; see IntraOpThreadPool::parallelFor. Loops of at most grain_size
+// items run directly on the calling thread.
+//
+// grain_size should be large enough for a range to amortize waking up a
+// thread, a few tens of microseconds of work.
+template <typename Func>
+inline void ParallelFor(
+    IntraOpThreadPool* pool,
+    std::size_t n,
+    std::size_t grain_size,
+    Func&& fn) {
+  if (n <= grain_size) {
+    if (n > 0) {
+      fn(std::size_t(0), n);
+    }
+    return;
+  }
+  (pool ? pool : GetDefaultIntraOpThreadPool())
+      ->parallelFor(n, grain_size, std::forward<Func>(fn));
+}
+
+template <typename Func>
+inline void ParallelFor(std::size_t n, std::size_t grain_size, Func&& fn) {
+  ParallelFor(nullptr, n, grain_size, std::forward<Func>(fn));
+}
+
+} // namespace caffe2
+
+#endif // CAFFE2_UTILS_PARALLEL_FOR_H_
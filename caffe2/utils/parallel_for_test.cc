@@ -0,0 +1,207 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if !defined(_MSC_VER) && !defined(__APPLE__)
+#include <sched.h>
+#endif
+
+#include "caffe2/core/flags.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/utils/parallel_for.h"
+#include <gtest/gtest.h>
+
+CAFFE2_DECLARE_int(caffe2_intra_op_num_threads);
+
+namespace caffe2 {
+
+namespace {
+
+class ParallelForTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    SetIntraOpNumThreads(4);
+  }
+  void TearDown() override {
+    SetIntraOpNumThreads(FLAGS_caffe2_intra_op_num_threads);
+  }
+};
+
+} // namespace
+
+TEST_F(ParallelForTest, CoversRangeOnce) {
+  EXPECT_EQ(GetIntraOpNumThreads(), 4);
+  for (const size_t n : {0, 1, 7, 100, 100000}) {
+    std::vector<std::atomic<int>> counts(n);
+    std::atomic<size_t> num_ranges(0);
+    ParallelFor(n, 10, [&](size_t begin, size_t end) {
+      EXPECT_LT(begin, end);
+      EXPECT_TRUE(end - begin >= 10 || end == n);
+      for (size_t i = begin; i < end; ++i) {
+        ++counts[i];
+      }
+      ++num_ranges;
+    });
+    for (size_t i = 0; i < n; ++i) {
+      EXPECT_EQ(counts[i], 1) << i;
+    }
+    EXPECT_LE(num_ranges, std::max<size_t>(n / 10, 1));
+  }
+}
+
+TEST_F(ParallelForTest, UsesSeveralThreads) {
+  std::mutex mutex;
+  std::vector<std::thread::id> ids;
+  // Ranges block until another thread showed up, or give up after a while
+  // on a loaded machine.
+  std::atomic<int> started(0);
+  ParallelFor(4, 1, [&](size_t, size_t) {
+    ++started;
+    for (int i = 0; i < 1000 && started < 2; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    ids.push_back(std::this_thread::get_id());
+  });
+  EXPECT_EQ(ids.size(), 4);
+  EXPECT_GE(started, 2);
+}
+
+TEST_F(ParallelForTest, NestedLoopsRunInline) {
+  std::atomic<int> total(0);
+  ParallelFor(8, 1, [&](size_t begin, size_t end) {
+    const auto id = std::this_thread::get_id();
+    for (size_t i = begin; i < end; ++i) {
+      ParallelFor(1000, 1, [&](size_t inner_begin, size_t inner_end) {
+        EXPECT_EQ(std::this_thread::get_id(), id);
+        total += inner_end - inner_begin;
+      });
+    }
+  });
+  EXPECT_EQ(total, 8000);
+}
+
+TEST_F(ParallelForTest, RethrowsExceptions) {
+  std::atomic<int> done(0);
+  EXPECT_THROW(
+      ParallelFor(
+          100,
+          1,
+          [&](size_t begin, size_t end) {
+            if (begin <= 50 && 50 < end) {
+              throw std::runtime_error("range failed");
+            }
+            ++done;
+          }),
+      std::runtime_error);
+  // All other ranges still ran, and the pool is usable afterwards.
+  EXPECT_GT(done, 0);
+  std::atomic<size_t> covered(0);
+  ParallelFor(100, 1, [&](size_t begin, size_t end) {
+    covered += end - begin;
+  });
+  EXPECT_EQ(covered, 100);
+}
+
+TEST_F(ParallelForTest, SingleThread) {
+  SetIntraOpNumThreads(1);
+  EXPECT_EQ(GetIntraOpNumThreads(), 1);
+  EXPECT_EQ(GetDefaultIntraOpThreadPool()->numThreads(), 1);
+  const auto id = std::this_thread::get_id();
+  size_t covered = 0;
+  ParallelFor(1000, 1, [&](size_t begin, size_t end) {
+    EXPECT_EQ(std::this_thread::get_id(), id);
+    covered += end - begin;
+  });
+  EXPECT_EQ(covered, 1000);
+}
+
+TEST_F(ParallelForTest, Pools) {
+  IntraOpThreadPoolOptions options;
+  options.numThreads = 3;
+  auto pool = GetSharedIntraOpThreadPool(options);
+  EXPECT_EQ(pool->numThreads(), 3);
+  EXPECT_EQ(pool, GetSharedIntraOpThreadPool(options));
+  std::atomic<size_t> covered(0);
+  ParallelFor(pool.get(), 1000, 1, [&](size_t begin, size_t end) {
+    covered += end - begin;
+  });
+  EXPECT_EQ(covered, 1000);
+
+  options.numThreads = 2;
+  EXPECT_NE(pool, GetSharedIntraOpThreadPool(options));
+  EXPECT_EQ(GetSharedIntraOpThreadPool(options)->numThreads(), 2);
+}
+
+TEST(IntraOpThreadPoolTest, ParseCPUList) {
+  EXPECT_EQ(
+      ParseCPUList("0-3,8, 10-11\n"),
+      (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(ParseCPUList("5"), std::vector<int>{5});
+  EXPECT_TRUE(ParseCPUList("").empty());
+  EXPECT_THROW(ParseCPUList("3-1"), EnforceNotMet);
+  EXPECT_THROW(ParseCPUList("a"), EnforceNotMet);
+}
+
+#if !defined(_MSC_VER) && !defined(__APPLE__)
+TEST(IntraOpThreadPoolTest, PinsWorkers) {
+  IntraOpThreadPoolOptions options;
+  options.numThreads = 3;
+  options.cpus = {0};
+  IntraOpThreadPool pool(options);
+  EXPECT_EQ(pool.cpus(), std::vector<int>{0});
+  const auto caller = std::this_thread::get_id();
+  std::atomic<int> pinned(0);
+  std::atomic<int> on_workers(0);
+  pool.parallelFor(4, 1, [&](size_t, size_t) {
+    if (std::this_thread::get_id() == caller) {
+      return;
+    }
+    ++on_workers;
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    ASSERT_EQ(sched_getaffinity(0, sizeof(cpu_set_t), &mask), 0);
+    if (CPU_COUNT(&mask) == 1 && CPU_ISSET(0, &mask)) {
+      ++pinned;
+    }
+  });
+  EXPECT_EQ(pinned, on_workers);
+}
+
+TEST(IntraOpThreadPoolTest, NumaNode) {
+  // Every Linux machine has node 0, unless sysfs is not mounted.
+  std::vector<int> cpus;
+  try {
+    cpus = GetNumaNodeCPUs(0);
+  } catch (const EnforceNotMet&) {
+    return;
+  }
+  EXPECT_FALSE(cpus.empty());
+  IntraOpThreadPoolOptions options;
+  options.numaNode = 0;
+  IntraOpThreadPool pool(options);
+  EXPECT_EQ(pool.cpus(), cpus);
+  EXPECT_EQ(pool.numThreads(), cpus.size());
+}
+#endif
+
+} // namespace caffe2
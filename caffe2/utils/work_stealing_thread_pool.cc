@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/utils/work_stealing_thread_pool.h"
+
+namespace caffe2 {
+
+namespace {
+// The pool and index of the worker running on the current thread, if any.
+thread_local const WorkStealingThreadPool* t_pool = nullptr;
+thread_local std::size_t t_worker_index = 0;
+} // namespace
+
+WorkStealingThreadPool::WorkStealingThreadPool(
+    std::size_t pool_size,
+    const std::function<void(std::size_t)>& init_worker)
+    : running_(true), pending_(0), sleeping_(0) {
+  queues_.reserve(pool_size);
+  for (std::size_t i = 0; i < pool_size; ++i) {
+    queues_.emplace_back(new TaskQueue());
+  }
+  workers_.reserve(pool_size);
+  for (std::size_t i = 0; i < pool_size; ++i) {
+    workers_.emplace_back(
+        &WorkStealingThreadPool::mainLoop, this, i, init_worker);
+  }
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    running_ = false;
+  }
+  sleep_cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void WorkStealingThreadPool::run(const std::function<void()>& func) {
+  TaskQueue* queue = t_pool == this ? queues_[t_worker_index].get()
+                                    : &injection_queue_;
+  // Count the task before publishing it, so that pending_ never drops below
+  // the number of tasks in the queues.
+  ++pending_;
+  {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->tasks.push_back(func);
+  }
+  notify();
+}
+
+void WorkStealingThreadPool::notify() {
+  if (sleeping_ > 0) {
+    // Taking the lock makes sure a worker that saw no pending tasks is
+    // already waiting on the condition variable.
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    sleep_cv_.notify_one();
+  }
+}
+
+bool WorkStealingThreadPool::popTask(
+    std::size_t index,
+    std::function<void()>* task) {
+  {
+    auto& own = *queues_[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      *task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(injection_queue_.mutex);
+    if (!injection_queue_.tasks.empty()) {
+      *task = std::move(injection_queue_.tasks.front());
+      injection_queue_.tasks.pop_front();
+      return true;
+    }
+  }
+  for (std::size_t i = 1; i < queues_.size(); ++i) {
+    auto& victim = *queues_[(index + i) % queues_.size()];
+    std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+    if (lock.owns_lock() && !victim.tasks.empty()) {
+      *task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingThreadPool::mainLoop(
+    std::size_t index,
+    std::function<void(std::size_t)> init_worker) {
+  t_pool = this;
+  t_worker_index = index;
+  if (init_worker) {
+    init_worker(index);
+  }
+  std::function<void()> task;
+  while (running_) {
+    if (pending_ > 0 && popTask(index, &task)) {
+      --pending_;
+      // Suppress all exceptions, as TaskThreadPool does.
+      try {
+        task();
+      } catch (const std::exception&) {
+      }
+      task = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    ++sleeping_;
+    // A task may be counted but not pushed yet, or skipped because its
+    // queue was busy while stealing, so only sleep if nothing is pending.
+    sleep_cv_.wait(lock, [this]() { return pending_ > 0 || !running_; });
+    --sleeping_;
+  }
+}
+
+} // namespace caffe2
@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAFFE2_UTILS_WORK_STEALING_THREAD_POOL_H_
+#define CAFFE2_UTILS_WORK_STEALING_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace caffe2 {
+
+/**
+ * A thread pool where every worker owns a deque of tasks.
+ *
+ * Tasks submitted from one of the pool's own workers are pushed to the back
+ * of that worker's deque, and the worker pops from the back, so the most
+ * recently spawned task (e.g. a child made ready by the task that just
+ * finished) runs next on the same thread with warm caches. Tasks submitted
+ * from outside the pool go to a shared injection queue. Idle workers steal
+ * from the front of other workers' deques, so the only lock taken on the
+ * common path is the uncontended lock of the worker's own deque.
+ *
+ * Workers with nothing to do park on a condition variable, which is only
+ * signalled when some worker is actually parked.
+ */
+class WorkStealingThreadPool {
+ public:
+  // init_worker, if given, is called by each worker with its index before
+  // it runs any task, e.g. to set the affinity of its thread.
+  explicit WorkStealingThreadPool(
+      std::size_t pool_size,
+      const std::function<void(std::size_t)>& init_worker = nullptr);
+  ~WorkStealingThreadPool();
+
+  void run(const std::function<void()>& func);
+
+  std::size_t size() const {
+    return workers_.size();
+  }
+
+ private:
+  struct TaskQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  void mainLoop(
+      std::size_t index,
+      std::function<void(std::size_t)> init_worker);
+  bool popTask(std::size_t index, std::function<void()>* task);
+  void notify();
+
+  std::vector<std::unique_ptr<TaskQueue>> queues_;
+  TaskQueue injection_queue_;
+  std::vector<std::thread> workers_;
+
+  std::atomic<bool> running_;
+  // Number of tasks sitting in any queue.
+  std::atomic<std::size_t> pending_;
+  // Number of workers parked, or about to park, on sleep_cv_.
+  std::atomic<std::size_t> sleeping_;
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_UTILS_WORK_STEALING_THREAD_POOL_H_
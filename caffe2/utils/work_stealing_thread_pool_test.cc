@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "caffe2/utils/work_stealing_thread_pool.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+class Latch {
+ public:
+  explicit Latch(int count) : count_(count) {}
+
+  void CountDown() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--count_ == 0) {
+      cv_.notify_all();
+    }
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return count_ == 0; });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  int count_;
+};
+
+} // namespace
+
+TEST(WorkStealingThreadPoolTest, RunsExternalTasks) {
+  WorkStealingThreadPool pool(4);
+  const int kNumTasks = 1000;
+  std::atomic<int> done(0);
+  Latch latch(kNumTasks);
+  for (int i = 0; i < kNumTasks; ++i) {
+    pool.run([&]() {
+      ++done;
+      latch.CountDown();
+    });
+  }
+  latch.Wait();
+  EXPECT_EQ(kNumTasks, done.load());
+}
+
+TEST(WorkStealingThreadPoolTest, RunsNestedTasks) {
+  WorkStealingThreadPool pool(4);
+  const int kFanOut = 8;
+  const int kDepth = 3;
+  // 8 + 64 + 512 tasks spawned from inside the pool.
+  const int kNumTasks = 8 + 64 + 512;
+  std::atomic<int> done(0);
+  Latch latch(kNumTasks);
+  std::function<void(int)> spawn = [&](int depth) {
+    ++done;
+    if (depth < kDepth) {
+      for (int i = 0; i < kFanOut; ++i) {
+        pool.run([&spawn, depth]() { spawn(depth + 1); });
+      }
+    }
+    latch.CountDown();
+  };
+  for (int i = 0; i < kFanOut; ++i) {
+    pool.run([&spawn]() { spawn(1); });
+  }
+  latch.Wait();
+  EXPECT_EQ(kNumTasks, done.load());
+}
+
+} // namespace caffe2
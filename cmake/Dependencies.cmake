@@ -13,6 +13,14 @@ if(USE_THREADS)
   list(APPEND Caffe2_DEPENDENCY_LIBS ${CMAKE_THREAD_LIBS_INIT})
 endif()
 
+# ---[ librt, for shm_open in shmdb with glibc older than 2.34
+if(UNIX AND NOT APPLE AND NOT ANDROID)
+  find_library(RT_LIBRARY rt)
+  if(RT_LIBRARY)
+    list(APPEND Caffe2_DEPENDENCY_LIBS ${RT_LIBRARY})
+  endif()
+endif()
+
 # ---[ protobuf
 if(USE_LITE_PROTO)
   set(CAFFE2_USE_LITE_PROTO 1)
@@ -191,6 +199,18 @@ if(USE_ZMQ)
   endif()
 endif()
 
+# ---[ LZ4
+if(USE_LZ4)
+  find_package(LZ4)
+  if(LZ4_FOUND)
+    caffe2_include_directories(${LZ4_INCLUDE_DIR})
+    list(APPEND Caffe2_DEPENDENCY_LIBS ${LZ4_LIBRARIES})
+  else()
+    message(WARNING "Not compiling with LZ4. Suppress this warning with -DUSE_LZ4=OFF")
+    set(USE_LZ4 OFF)
+  endif()
+endif()
+
 # ---[ Redis
 if(USE_REDIS)
   find_package(Hiredis)
@@ -99,6 +99,30 @@ if (CAFFE2_COMPILER_SUPPORTS_AVX2_EXTENSIONS)
 endif()
 cmake_pop_check_state()
 
+# ---[ Check if the compiler has AVX512 support. The avx512 perfkernels are
+# only built on top of the avx2 ones.
+cmake_push_check_state(RESET)
+if (MSVC)
+  set(CMAKE_REQUIRED_FLAGS "/arch:AVX512")
+else()
+  set(CMAKE_REQUIRED_FLAGS "-mavx512f")
+endif()
+CHECK_CXX_SOURCE_COMPILES(
+    "#include <immintrin.h>
+     int main() {
+       __m512 a, b;
+       a = _mm512_set1_ps(1.f);
+       b = _mm512_fmadd_ps(a, a, a);
+       return 0;
+     }" CAFFE2_COMPILER_SUPPORTS_AVX512_EXTENSIONS)
+if (CAFFE2_COMPILER_SUPPORTS_AVX512_EXTENSIONS)
+  message(STATUS "Current compiler supports avx512f extention. Will build avx512 perfkernels.")
+  if (NOT MSVC AND CAFFE2_PERF_WITH_AVX2)
+    set(CAFFE2_PERF_WITH_AVX512 1)
+  endif()
+endif()
+cmake_pop_check_state()
+
 # ---[ If we are using msvc, set no warning flags
 # Note(jiayq): if you are going to add a warning flag, check if this is
 # totally necessary, and only add when you see fit. If it is needed due to
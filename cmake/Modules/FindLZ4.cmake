@@ -0,0 +1,23 @@
+# Find the LZ4 libraries
+#
+# The following variables are optionally searched for defaults
+#  LZ4_ROOT_DIR:    Base directory where all LZ4 components are found
+#
+# The following are set after configuration is done:
+#  LZ4_FOUND
+#  LZ4_INCLUDE_DIR
+#  LZ4_LIBRARIES
+
+find_path(LZ4_INCLUDE_DIR NAMES lz4.h
+                          PATHS ${LZ4_ROOT_DIR} ${LZ4_ROOT_DIR}/include)
+
+find_library(LZ4_LIBRARIES NAMES lz4
+                           PATHS ${LZ4_ROOT_DIR} ${LZ4_ROOT_DIR}/lib)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LZ4 DEFAULT_MSG LZ4_INCLUDE_DIR LZ4_LIBRARIES)
+
+if(LZ4_FOUND)
+  message(STATUS "Found LZ4     (include: ${LZ4_INCLUDE_DIR}, library: ${LZ4_LIBRARIES})")
+  mark_as_advanced(LZ4_INCLUDE_DIR LZ4_LIBRARIES)
+endif()
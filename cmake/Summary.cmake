@@ -45,6 +45,7 @@ function (caffe2_print_configuration_summary)
   if(${USE_LMDB})
     message(STATUS "    LMDB version        : ${LMDB_VERSION}")
   endif()
+  message(STATUS "  USE_LZ4               : ${USE_LZ4}")
   message(STATUS "  USE_METAL             : ${USE_METAL}")
   message(STATUS "  USE_MKL               : ${CAFFE2_USE_MKL}")
   message(STATUS "  USE_MOBILE_OPENGL     : ${USE_MOBILE_OPENGL}")